@@ -5,9 +5,7 @@
 #ifndef __GST_BBDECODE_H__
 #define __GST_BBDECODE_H__
 
-#include <gst/gst.h>
-#include <gst/video/gstvideometa.h>
-#include "libtensordecode.h"
+#include "gsttensordecode.h"
 
 G_BEGIN_DECLS
 
@@ -26,20 +24,15 @@ G_BEGIN_DECLS
 typedef struct _GstBBDecode      GstBBDecode;
 typedef struct _GstBBDecodeClass GstBBDecodeClass;
 
+/* tensordecode in mode=bb, under its original name */
 struct _GstBBDecode
 {
-  GstElement element;
-
-  GstPad *sinkpad, *srcpad;
-
-  const gchar *labels_path;
-  const gchar *labels[LABEL_SIZE];
-  gboolean silent;
+  GstTensorDecode decoder;
 };
 
-struct _GstBBDecodeClass 
+struct _GstBBDecodeClass
 {
-  GstElementClass parent_class;
+  GstTensorDecodeClass parent_class;
 };
 
 GType gst_bbdecode_get_type (void);
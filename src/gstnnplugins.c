@@ -0,0 +1,57 @@
+/*
+ * No license installed
+ */
+
+/*
+ * the nnplugins plug-in: every element of this package, in one library
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+
+#include "gsttensordecode.h"
+#include "gstssddecode.h"
+#include "gstbbdecode.h"
+#include "gstroitracker.h"
+#include "gstsegdecode.h"
+
+#define NNPLUGINS_DESC "Decode and track detections and segmentation maps from neural network tensors"
+
+/* entry point to initialize the plug-in
+ * initialize the plug-in itself
+ * register the element factories and other features
+ */
+static gboolean
+nnplugins_init (GstPlugin * nnplugins)
+{
+  return gst_element_register (nnplugins, "tensordecode", GST_RANK_NONE, GST_TYPE_TENSORDECODE) &&
+      gst_element_register (nnplugins, "ssddecode", GST_RANK_NONE, GST_TYPE_SSDDECODE) &&
+      gst_element_register (nnplugins, "bbdecode", GST_RANK_NONE, GST_TYPE_BBDECODE) &&
+      gst_element_register (nnplugins, "roitracker", GST_RANK_NONE, GST_TYPE_ROITRACKER) &&
+      gst_element_register (nnplugins, "segdecode", GST_RANK_NONE, GST_TYPE_SEGDECODE);
+}
+
+/* PACKAGE: this is usually set by autotools depending on some _INIT macro
+ * in configure.ac and then written into and defined in config.h, but we can
+ * just set it ourselves here in case someone doesn't use autotools to
+ * compile this code. GST_PLUGIN_DEFINE needs PACKAGE to be defined.
+ */
+#ifndef PACKAGE
+#define PACKAGE "nnplugins"
+#endif
+
+/* gstreamer looks for this structure to register the elements */
+GST_PLUGIN_DEFINE (
+    GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    nnplugins,
+    NNPLUGINS_DESC,
+    nnplugins_init,
+    PACKAGE_VERSION,
+    GST_LICENSE,
+    GST_PACKAGE_NAME,
+    GST_PACKAGE_ORIGIN
+)
@@ -0,0 +1,283 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:element-roitracker
+ *
+ * Track the objects of a decoder's GstTensorDetectionsMeta across frames, and
+ * predict their boxes on frames without inference results.
+ *
+ * On frames carrying detections, each detection is associated with the track
+ * of the same stream and class whose predicted box overlaps it most, and
+ * corrects that track's constant-velocity Kalman filter. On frames without
+ * detections, the tracks are only predicted. Either way the frame leaves with
+ * one GstTensorDetectionsMeta holding the current box of every track, with
+ * its track id.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 ... ! ssddecode bundle=PATH name=decoder decoder.video_src ! roitracker ! videoconvert ! autovideosink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+
+#include "gstroitracker.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_roitracker_debug);
+#define GST_CAT_DEFAULT gst_roitracker_debug
+
+/* Filter signals and args */
+enum
+{
+  /* FILL ME */
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0, /* Anchor prop. Do not remove. */
+  PROP_MAX_TRACKS,
+  PROP_MAX_AGE,
+  PROP_MIN_HITS,
+  PROP_IOU_THRESHOLD,
+  PROP_SILENT
+};
+
+#define ROITRACKER_DESC "Track detected objects across frames"
+
+/* the capabilities of the inputs and outputs.
+ *
+ * detections travel as meta, so any stream carrying them will do
+ */
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("ANY")
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("ANY")
+    );
+
+#define gst_roitracker_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstRoiTracker, gst_roitracker, GST_TYPE_BASE_TRANSFORM,
+    GST_DEBUG_CATEGORY_INIT (gst_roitracker_debug, "roitracker", 0, ROITRACKER_DESC));
+
+static void gst_roitracker_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_roitracker_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static gboolean gst_roitracker_start (GstBaseTransform * trans);
+static gboolean gst_roitracker_stop (GstBaseTransform * trans);
+static gboolean gst_roitracker_sink_event (GstBaseTransform * trans, GstEvent * event);
+static GstFlowReturn gst_roitracker_transform_ip (GstBaseTransform * trans, GstBuffer * buf);
+
+/* GObject vmethod implementations */
+
+/* initialize the roitracker's class */
+static void
+gst_roitracker_class_init (GstRoiTrackerClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseTransformClass *trans_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  trans_class = (GstBaseTransformClass *) klass;
+
+  gobject_class->set_property = gst_roitracker_set_property;
+  gobject_class->get_property = gst_roitracker_get_property;
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_roitracker_start);
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_roitracker_stop);
+  trans_class->sink_event = GST_DEBUG_FUNCPTR (gst_roitracker_sink_event);
+  trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_roitracker_transform_ip);
+
+  g_object_class_install_property (gobject_class, PROP_MAX_TRACKS,
+      g_param_spec_uint ("max-tracks", "Max-Tracks", "Most tracks per stream; further objects are not tracked ?",
+          1, G_MAXUINT16, DEFAULT_MAX_TRACKS, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_AGE,
+      g_param_spec_uint ("max-age", "Max-Age", "Frames a track is predicted without detections before it is dropped ?",
+          0, G_MAXUINT, DEFAULT_MAX_AGE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MIN_HITS,
+      g_param_spec_uint ("min-hits", "Min-Hits", "Detections a track needs before it is reported ?",
+          1, G_MAXUINT, DEFAULT_MIN_HITS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_IOU_THRESHOLD,
+      g_param_spec_float ("iou-threshold", "IoU-Threshold", "Least overlap of a detection with the predicted box of its track ?",
+          0.f, 1.f, DEFAULT_TRACK_IOU, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SILENT,
+      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
+          FALSE, G_PARAM_READWRITE));
+
+  gst_element_class_set_details_simple(gstelement_class,
+    "ROITracker",
+    "ROI Tracker",
+    "ROI Tracker Element",
+    "Aaron Arthurs <aajarthurs@gmail.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+}
+
+/* initialize the new element
+ * the base class creates the pads; tracks replace the detections meta in place
+ * initialize instance structure
+ */
+static void
+gst_roitracker_init (GstRoiTracker * filter)
+{
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
+  /* properties */
+  filter->max_tracks = DEFAULT_MAX_TRACKS;
+  filter->max_age = DEFAULT_MAX_AGE;
+  filter->min_hits = DEFAULT_MIN_HITS;
+  filter->iou_threshold = DEFAULT_TRACK_IOU;
+  filter->tracker = NULL;
+  filter->silent = FALSE;
+}
+
+static void
+gst_roitracker_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRoiTracker *filter = GST_ROITRACKER (object);
+  switch (prop_id) {
+    case PROP_MAX_TRACKS:
+      filter->max_tracks = g_value_get_uint (value);
+      break;
+    case PROP_MAX_AGE:
+      filter->max_age = g_value_get_uint (value);
+      break;
+    case PROP_MIN_HITS:
+      filter->min_hits = g_value_get_uint (value);
+      break;
+    case PROP_IOU_THRESHOLD:
+      filter->iou_threshold = g_value_get_float (value);
+      break;
+    case PROP_SILENT:
+      filter->silent = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_roitracker_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRoiTracker *filter = GST_ROITRACKER (object);
+  switch (prop_id) {
+    case PROP_MAX_TRACKS:
+      g_value_set_uint (value, filter->max_tracks);
+      break;
+    case PROP_MAX_AGE:
+      g_value_set_uint (value, filter->max_age);
+      break;
+    case PROP_MIN_HITS:
+      g_value_set_uint (value, filter->min_hits);
+      break;
+    case PROP_IOU_THRESHOLD:
+      g_value_set_float (value, filter->iou_threshold);
+      break;
+    case PROP_SILENT:
+      g_value_set_boolean (value, filter->silent);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* this function sizes the tracks for max-tracks; it changes only in READY */
+static gboolean
+gst_roitracker_start (GstBaseTransform * trans)
+{
+  GstRoiTracker *filter = GST_ROITRACKER (trans);
+  filter->tracker = roi_tracker_new (filter->max_tracks);
+  return TRUE;
+}
+
+static gboolean
+gst_roitracker_stop (GstBaseTransform * trans)
+{
+  GstRoiTracker *filter = GST_ROITRACKER (trans);
+  roi_tracker_free (filter->tracker);
+  filter->tracker = NULL;
+  return TRUE;
+}
+
+/* this function forgets the tracks when the stream jumps or restarts */
+static gboolean
+gst_roitracker_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstRoiTracker *filter = GST_ROITRACKER (trans);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_STREAM_START:
+      if (filter->tracker)
+        roi_tracker_reset (filter->tracker);
+      break;
+    default:
+      break;
+  }
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+}
+
+/*
+ * this function advances the tracks by one frame, corrects them with the frame's detections if any,
+ * and replaces those detections with the tracks
+ */
+static GstFlowReturn
+gst_roitracker_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstRoiTracker *filter = GST_ROITRACKER (trans);
+  RoiTracker *tracker = filter->tracker;
+  GstTensorDetectionsMeta *meta;
+  guint n;
+
+  tracker->max_age = filter->max_age;
+  tracker->min_hits = filter->min_hits;
+  tracker->iou_threshold = filter->iou_threshold;
+
+  roi_tracker_predict (tracker);
+  meta = gst_buffer_get_tensor_detections_meta (buf);
+  if (meta) {
+    roi_tracker_update (tracker, meta->detections, meta->num_detections);
+    if (!filter->silent)
+      GST_LOG_OBJECT (filter, "%u detections at %" GST_TIME_FORMAT, meta->num_detections,
+          GST_TIME_ARGS (GST_BUFFER_PTS (buf)));
+    /* the array may be shared with other buffers, so it is replaced rather than rewritten */
+    gst_buffer_remove_meta (buf, (GstMeta *) meta);
+  }
+
+  n = roi_tracker_count (tracker);
+  if (!filter->silent)
+    GST_LOG_OBJECT (filter, "%u tracks at %" GST_TIME_FORMAT, n, GST_TIME_ARGS (GST_BUFFER_PTS (buf)));
+  if (!n)
+    return GST_FLOW_OK;
+  meta = gst_buffer_add_tensor_detections_meta (buf, n);
+  if (!meta) {
+    GST_ERROR_OBJECT (filter, "Failed to attach tracks");
+    return GST_FLOW_ERROR;
+  }
+  roi_tracker_write (tracker, meta->detections);
+  return GST_FLOW_OK;
+}
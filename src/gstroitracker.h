@@ -0,0 +1,51 @@
+/*
+ * No license installed
+ */
+
+#ifndef __GST_ROITRACKER_H__
+#define __GST_ROITRACKER_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gsttensordetectionsmeta.h"
+#include "roitracker.h"
+
+G_BEGIN_DECLS
+
+/* #defines don't like whitespacey bits */
+#define GST_TYPE_ROITRACKER \
+  (gst_roitracker_get_type())
+#define GST_ROITRACKER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_ROITRACKER,GstRoiTracker))
+#define GST_ROITRACKER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_ROITRACKER,GstRoiTrackerClass))
+#define GST_IS_ROITRACKER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_ROITRACKER))
+#define GST_IS_ROITRACKER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_ROITRACKER))
+
+typedef struct _GstRoiTracker      GstRoiTracker;
+typedef struct _GstRoiTrackerClass GstRoiTrackerClass;
+
+struct _GstRoiTracker
+{
+  GstBaseTransform element;
+
+  guint max_tracks; /* per stream */
+  guint max_age;
+  guint min_hits;
+  gfloat iou_threshold;
+  RoiTracker *tracker; /* between start and stop */
+  gboolean silent;
+};
+
+struct _GstRoiTrackerClass
+{
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_roitracker_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_ROITRACKER_H__ */
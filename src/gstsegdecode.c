@@ -0,0 +1,702 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:element-segdecode
+ *
+ * Decode the per-pixel class scores of a segmentation model into a map of class indices.
+ *
+ * The input is one tensor of C:W:H:1 scores, float32, uint8 or int64, as
+ * DeepLab models output them; each pixel gets the class of its highest score,
+ * with ties going to the lower class. Quantized uint8 scores are compared as
+ * they are, 16 or 32 classes at a time; zero-point and quant-scale only serve
+ * to dequantize the winning score for confidence. A tensor of one channel (1:W:H:1, or
+ * W:H:1) of int64, int32 or uint8 holds the indices of a model that argmaxes
+ * in-graph, which are only narrowed. As W:H:1 and C:W:1:1 look alike, a
+ * tensor of those types one pixel high is always taken as indices; scores of
+ * such a model must be reshaped first. The map is uint8, at the model's
+ * resolution.
+ *
+ * With output=tensor, the map replaces the scores as a 1:W:H:1 uint8 tensor,
+ * followed by a 1:W:H:1 float32 tensor of the winning scores if confidence is
+ * set. With output=meta, the scores pass through and the same memories are
+ * attached as GstTensorSegmapMeta. Maps come from a pool either way, and the
+ * pixels are split across the decode threads shared with tensordecode.
+ *
+ * With regions set, the 4-connected regions of each class but background, of
+ * at least min-area pixels, are found in one pass over the map and attached
+ * to the output as a GstTensorDetectionsMeta of their bounding boxes, as the
+ * detectors attach theirs; roi-meta-compat adds the older ROI metas.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 ... ! tensor_filter framework=tensorflow-lite model=deeplabv3_257_mv_gpu.tflite ! segdecode ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <limits.h>
+#include <gst/gst.h>
+#include <gst/video/gstvideometa.h>
+
+#include "gstsegdecode.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_segdecode_debug);
+#define GST_CAT_DEFAULT gst_segdecode_debug
+
+/* Filter signals and args */
+enum
+{
+  /* FILL ME */
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0, /* Anchor prop. Do not remove. */
+  PROP_OUTPUT,
+  PROP_CONFIDENCE,
+  PROP_ZERO_POINT,
+  PROP_QUANT_SCALE,
+  PROP_N_THREADS,
+  PROP_REGIONS,
+  PROP_MIN_AREA,
+  PROP_BACKGROUND,
+  PROP_LABELS,
+  PROP_ROI_META_COMPAT,
+  PROP_SILENT
+};
+
+#define SEGDECODE_DESC "Decode class-index maps from the output tensor of a segmentation model"
+
+#define DEFAULT_OUTPUT SEGDECODE_OUTPUT_TENSOR
+#define DEFAULT_CONFIDENCE FALSE
+#define DEFAULT_ZERO_POINT 0
+#define DEFAULT_QUANT_SCALE 1.0
+#define DEFAULT_REGIONS FALSE
+#define DEFAULT_ROI_META_COMPAT FALSE
+#define SEGDECODE_TASK_PIXELS 16384 /* pixels per decode task; a few hundred KiB of float32 scores */
+
+/* the capabilities of the inputs and outputs.
+ *
+ * describe the real formats here.
+ */
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
+    );
+
+/**
+ * @brief The pixels of one buffer, decoded SEGDECODE_TASK_PIXELS at a time.
+ */
+typedef struct _SegDecodeJob
+{
+  const guint8 *scores;
+  gsize pixel_size; /* bytes of the scores of one pixel */
+  tensor_type type;
+  guint num_classes;
+  guint num_pixels;
+  const QuantParams *quant; /* of uint8 scores */
+  guint8 *classes;
+  gfloat *confidence; /* NULL without confidence */
+} SegDecodeJob;
+
+#define gst_segdecode_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstSegDecode, gst_segdecode, GST_TYPE_BASE_TRANSFORM,
+    GST_DEBUG_CATEGORY_INIT (gst_segdecode_debug, "segdecode", 0, SEGDECODE_DESC));
+
+GType
+gst_segdecode_output_get_type (void)
+{
+  static gsize type = 0;
+  if (g_once_init_enter (&type)) {
+    static const GEnumValue values[] = {
+      { SEGDECODE_OUTPUT_TENSOR, "Replace the scores with the class-index tensor", "tensor" },
+      { SEGDECODE_OUTPUT_META, "Pass the scores and attach the class-index map as meta", "meta" },
+      { 0, NULL, NULL }
+    };
+    g_once_init_leave (&type, g_enum_register_static ("GstSegDecodeOutput", values));
+  }
+  return type;
+}
+
+static void gst_segdecode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_segdecode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_segdecode_finalize (GObject * object);
+static gboolean gst_segdecode_stop (GstBaseTransform * trans);
+static GstCaps *gst_segdecode_transform_caps (GstBaseTransform * trans, GstPadDirection direction,
+    GstCaps * caps, GstCaps * filter);
+static gboolean gst_segdecode_set_caps (GstBaseTransform * trans, GstCaps * incaps, GstCaps * outcaps);
+static GstFlowReturn gst_segdecode_prepare_output_buffer (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer ** outbuf);
+static GstFlowReturn gst_segdecode_transform (GstBaseTransform * trans, GstBuffer * inbuf, GstBuffer * outbuf);
+static GstFlowReturn gst_segdecode_transform_ip (GstBaseTransform * trans, GstBuffer * buf);
+
+/* GObject vmethod implementations */
+
+/* initialize the segdecode's class */
+static void
+gst_segdecode_class_init (GstSegDecodeClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseTransformClass *trans_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  trans_class = (GstBaseTransformClass *) klass;
+
+  gobject_class->set_property = gst_segdecode_set_property;
+  gobject_class->get_property = gst_segdecode_get_property;
+  gobject_class->finalize = gst_segdecode_finalize;
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_segdecode_stop);
+  trans_class->transform_caps = GST_DEBUG_FUNCPTR (gst_segdecode_transform_caps);
+  trans_class->set_caps = GST_DEBUG_FUNCPTR (gst_segdecode_set_caps);
+  trans_class->prepare_output_buffer = GST_DEBUG_FUNCPTR (gst_segdecode_prepare_output_buffer);
+  trans_class->transform = GST_DEBUG_FUNCPTR (gst_segdecode_transform);
+  trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_segdecode_transform_ip);
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT,
+      g_param_spec_enum ("output", "Output", "Whether the class-index map replaces the scores tensor or is attached to it as meta ?",
+          GST_TYPE_SEGDECODE_OUTPUT, DEFAULT_OUTPUT, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_CONFIDENCE,
+      g_param_spec_boolean ("confidence", "Confidence", "Also output the score of each pixel's class, as float32 ?",
+          DEFAULT_CONFIDENCE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_ZERO_POINT,
+      g_param_spec_int ("zero-point", "Zero-Point", "Zero-point of quantized uint8 scores, applied only to the confidence ?",
+          0, 255, DEFAULT_ZERO_POINT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_QUANT_SCALE,
+      g_param_spec_double ("quant-scale", "Quant-Scale", "Scale of quantized uint8 scores, applied only to the confidence ?",
+          G_MINDOUBLE, G_MAXDOUBLE, DEFAULT_QUANT_SCALE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "N-Threads", "Threads decoding a buffer, across ranges of pixels (0 = one per processor) ?",
+          0, 1024, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_REGIONS,
+      g_param_spec_boolean ("regions", "Regions", "Attach the connected regions of each class as detections ?",
+          DEFAULT_REGIONS, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MIN_AREA,
+      g_param_spec_uint ("min-area", "Min-Area", "Least pixels of the map in a region ?",
+          1, G_MAXUINT, DEFAULT_SEGMAP_MIN_AREA, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BACKGROUND,
+      g_param_spec_int ("background", "Background", "Class without regions (-1 = none) ?",
+          -1, SEGMAP_MAX_CLASSES - 1, DEFAULT_SEGMAP_BACKGROUND, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LABELS,
+      g_param_spec_string ("labels", "Labels", "Path to labels list file, one line per class from class 0 ?",
+          NULL, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_ROI_META_COMPAT,
+      g_param_spec_boolean ("roi-meta-compat", "ROI-Meta-Compat", "Also attach one GstVideoRegionOfInterestMeta per region ?",
+          DEFAULT_ROI_META_COMPAT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SILENT,
+      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
+          FALSE, G_PARAM_READWRITE));
+
+  gst_element_class_set_details_simple(gstelement_class,
+    "SegDecode",
+    "Segmentation Decoder",
+    "Segmentation Decoder Element",
+    "Aaron Arthurs <aajarthurs@gmail.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+}
+
+/* initialize the new element
+ * the base class creates the pads; set_caps decides whether it works in place
+ * initialize instance structure
+ */
+static void
+gst_segdecode_init (GstSegDecode * filter)
+{
+  /* properties */
+  filter->output = DEFAULT_OUTPUT;
+  filter->confidence = DEFAULT_CONFIDENCE;
+  filter->quant.zero_point = DEFAULT_ZERO_POINT;
+  filter->quant.scale = DEFAULT_QUANT_SCALE;
+  filter->n_threads = 0;
+  filter->regions = DEFAULT_REGIONS;
+  filter->min_area = DEFAULT_SEGMAP_MIN_AREA;
+  filter->background = DEFAULT_SEGMAP_BACKGROUND;
+  filter->labels_path = NULL;
+  filter->labels = NULL;
+  filter->roi_meta_compat = DEFAULT_ROI_META_COMPAT;
+  filter->silent = FALSE;
+  /* negotiated */
+  filter->type = _NNS_END;
+  filter->num_classes = 0;
+  filter->width = 0;
+  filter->height = 0;
+  filter->pool = NULL;
+  filter->labeller = NULL;
+}
+
+static void
+gst_segdecode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSegDecode *filter = GST_SEGDECODE (object);
+  switch (prop_id) {
+    case PROP_OUTPUT:
+      filter->output = g_value_get_enum (value);
+      break;
+    case PROP_CONFIDENCE:
+      filter->confidence = g_value_get_boolean (value);
+      break;
+    case PROP_ZERO_POINT:
+      filter->quant.zero_point = g_value_get_int (value);
+      break;
+    case PROP_QUANT_SCALE:
+      filter->quant.scale = g_value_get_double (value);
+      break;
+    case PROP_N_THREADS:
+      filter->n_threads = g_value_get_uint (value);
+      break;
+    case PROP_REGIONS:
+      filter->regions = g_value_get_boolean (value);
+      break;
+    case PROP_MIN_AREA:
+      filter->min_area = g_value_get_uint (value);
+      break;
+    case PROP_BACKGROUND:
+      filter->background = g_value_get_int (value);
+      break;
+    case PROP_LABELS:
+      g_free (filter->labels_path);
+      filter->labels_path = g_value_dup_string (value);
+      asset_cache_unref (filter->labels);
+      filter->labels = filter->labels_path ? asset_cache_get_labels (filter->labels_path) : NULL;
+      if (filter->labels_path && !filter->labels)
+        GST_ERROR_OBJECT (filter, "Failed to load labels from %s", filter->labels_path);
+      break;
+    case PROP_ROI_META_COMPAT:
+      filter->roi_meta_compat = g_value_get_boolean (value);
+      break;
+    case PROP_SILENT:
+      filter->silent = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_segdecode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSegDecode *filter = GST_SEGDECODE (object);
+  switch (prop_id) {
+    case PROP_OUTPUT:
+      g_value_set_enum (value, filter->output);
+      break;
+    case PROP_CONFIDENCE:
+      g_value_set_boolean (value, filter->confidence);
+      break;
+    case PROP_ZERO_POINT:
+      g_value_set_int (value, filter->quant.zero_point);
+      break;
+    case PROP_QUANT_SCALE:
+      g_value_set_double (value, filter->quant.scale);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, filter->n_threads);
+      break;
+    case PROP_REGIONS:
+      g_value_set_boolean (value, filter->regions);
+      break;
+    case PROP_MIN_AREA:
+      g_value_set_uint (value, filter->min_area);
+      break;
+    case PROP_BACKGROUND:
+      g_value_set_int (value, filter->background);
+      break;
+    case PROP_LABELS:
+      g_value_set_string (value, filter->labels_path);
+      break;
+    case PROP_ROI_META_COMPAT:
+      g_value_set_boolean (value, filter->roi_meta_compat);
+      break;
+    case PROP_SILENT:
+      g_value_set_boolean (value, filter->silent);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_segdecode_finalize (GObject * object)
+{
+  GstSegDecode *filter = GST_SEGDECODE (object);
+  asset_cache_unref (filter->labels);
+  filter->labels = NULL;
+  g_free (filter->labels_path);
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gst_segdecode_stop (GstBaseTransform * trans)
+{
+  GstSegDecode *filter = GST_SEGDECODE (trans);
+  if (filter->pool) {
+    gst_buffer_pool_set_active (filter->pool, FALSE);
+    gst_object_unref (filter->pool);
+    filter->pool = NULL;
+  }
+  segmap_regions_free (filter->labeller);
+  filter->labeller = NULL;
+  filter->num_classes = 0;
+  return TRUE;
+}
+
+/*
+ * this function reads the map geometry from fixed tensor caps: C:W:H:1 scores,
+ * or 1:W:H:1 and W:H:1 indices
+ */
+static gboolean
+gst_segdecode_parse_caps (const GstCaps * caps, tensor_type * type,
+    guint * num_classes, guint * width, guint * height)
+{
+  TensorsShape shape;
+  const guint *dims;
+  guint r, first;
+  if (!gst_caps_is_fixed (caps) || !tensors_shape_from_caps (caps, &shape) || shape.num_tensors != 1)
+    return FALSE;
+  dims = shape.dims[0];
+  *type = shape.types[0];
+  /* W:H:1 only makes sense for indices, whose class dimension is implied; C:W:1:1 scores of an index type read the same */
+  first = (dims[0] > 1 && dims[2] == 1 && dims[3] <= 1 &&
+      (*type == _NNS_INT64 || *type == _NNS_INT32 || *type == _NNS_UINT8)) ? 1 : 0;
+  *num_classes = first ? 1 : dims[0];
+  *width = dims[1 - first];
+  *height = dims[2 - first];
+  for (r = 3 - first; r < NNS_TENSOR_RANK_LIMIT; r++) {
+    if (dims[r] > 1)
+      return FALSE;
+  }
+  return *num_classes > 0 && *width > 0 && *height > 0;
+}
+
+/* this function builds the caps of the class-index tensor, and of the confidence tensor if asked for */
+static GstCaps *
+gst_segdecode_map_caps (GstSegDecode * filter, const GstCaps * incaps, guint width, guint height)
+{
+  GstCaps *caps;
+  gchar *dims;
+  gint fps_n, fps_d;
+  if (filter->confidence)
+    dims = g_strdup_printf ("1:%u:%u:1,1:%u:%u:1", width, height, width, height);
+  else
+    dims = g_strdup_printf ("1:%u:%u:1", width, height);
+  caps = gst_caps_new_simple ("other/tensors",
+      "num_tensors", G_TYPE_INT, filter->confidence ? 2 : 1,
+      "types", G_TYPE_STRING, filter->confidence ? "uint8,float32" : "uint8",
+      "dimensions", G_TYPE_STRING, dims,
+      NULL);
+  g_free (dims);
+  if (gst_structure_get_fraction (gst_caps_get_structure (incaps, 0), "framerate", &fps_n, &fps_d))
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION, fps_n, fps_d, NULL);
+  return caps;
+}
+
+/*
+ * with output=meta the caps pass through; with output=tensor, fixed score caps
+ * give the map caps and any tensor caps go upstream
+ */
+static GstCaps *
+gst_segdecode_transform_caps (GstBaseTransform * trans, GstPadDirection direction,
+    GstCaps * caps, GstCaps * filter)
+{
+  GstSegDecode *decoder = GST_SEGDECODE (trans);
+  GstCaps *result;
+  tensor_type type;
+  guint num_classes, width, height;
+  if (decoder->output == SEGDECODE_OUTPUT_META)
+    result = gst_caps_ref (caps);
+  else if (direction == GST_PAD_SRC)
+    result = gst_static_pad_template_get_caps (&sink_factory);
+  else if (gst_segdecode_parse_caps (caps, &type, &num_classes, &width, &height))
+    result = gst_segdecode_map_caps (decoder, caps, width, height);
+  else
+    result = gst_static_pad_template_get_caps (&src_factory);
+  if (filter) {
+    GstCaps *intersection = gst_caps_intersect_full (filter, result, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (result);
+    result = intersection;
+  }
+  return result;
+}
+
+/* the score caps are set: check the model's output and size the pool of maps */
+static gboolean
+gst_segdecode_set_caps (GstBaseTransform * trans, GstCaps * incaps, GstCaps * outcaps)
+{
+  GstSegDecode *filter = GST_SEGDECODE (trans);
+  tensor_type type;
+  guint num_classes, width, height;
+  filter->num_classes = 0;
+  if (!gst_segdecode_parse_caps (incaps, &type, &num_classes, &width, &height)) {
+    GST_ERROR_OBJECT (filter, "Expected one C:W:H:1 tensor, got %" GST_PTR_FORMAT, incaps);
+    return FALSE;
+  }
+  if (num_classes == 1) {
+    if (type != _NNS_INT64 && type != _NNS_INT32 && type != _NNS_UINT8) {
+      GST_ERROR_OBJECT (filter, "Class indices must be int64, int32 or uint8, not %s", tensor_type_to_string (type));
+      return FALSE;
+    }
+    if (filter->confidence) {
+      GST_ERROR_OBJECT (filter, "The model outputs class indices, there are no scores for 'confidence'");
+      return FALSE;
+    }
+  } else if (type != _NNS_FLOAT32 && type != _NNS_UINT8 && type != _NNS_INT64) {
+    GST_ERROR_OBJECT (filter, "Scores must be float32, uint8 or int64, not %s", tensor_type_to_string (type));
+    return FALSE;
+  } else if (num_classes > SEGMAP_MAX_CLASSES) {
+    GST_ERROR_OBJECT (filter, "%u classes do not fit a uint8 map (at most %u)", num_classes, SEGMAP_MAX_CLASSES);
+    return FALSE;
+  }
+
+  if (!filter->pool || filter->width * filter->height != width * height ||
+      ((GstTensorSegmapPool *) filter->pool)->confidence != filter->confidence) {
+    gst_segdecode_stop (trans);
+    filter->pool = gst_tensor_segmap_pool_new (width * height, filter->confidence);
+    if (!filter->pool) {
+      GST_ERROR_OBJECT (filter, "Failed to create a pool of %ux%u maps", width, height);
+      return FALSE;
+    }
+  }
+  /* the labeller holds one region per pixel at worst, so it is only sized for regions=TRUE */
+  if (filter->regions && (!filter->labeller || filter->labeller->width != width || filter->labeller->height != height)) {
+    segmap_regions_free (filter->labeller);
+    filter->labeller = segmap_regions_new (width, height);
+  } else if (!filter->regions) {
+    segmap_regions_free (filter->labeller);
+    filter->labeller = NULL;
+  }
+  gst_base_transform_set_in_place (trans, filter->output == SEGDECODE_OUTPUT_META);
+  filter->type = type;
+  filter->num_classes = num_classes;
+  filter->width = width;
+  filter->height = height;
+  return TRUE;
+}
+
+/* decode one task's range of pixels */
+static void
+gst_segdecode_decode_task (gpointer data, guint task)
+{
+  const SegDecodeJob *job = data;
+  guint first = task * SEGDECODE_TASK_PIXELS;
+  guint n = MIN (SEGDECODE_TASK_PIXELS, job->num_pixels - first);
+  gconstpointer scores = job->scores + first * job->pixel_size;
+  gfloat *confidence = job->confidence ? job->confidence + first : NULL;
+  if (job->num_classes == 1) {
+    segmap_from_indices (scores, job->type, n, job->classes + first);
+    return;
+  }
+  switch (job->type) {
+    case _NNS_FLOAT32:
+      segmap_argmax (scores, n, job->num_classes, job->classes + first, confidence);
+      break;
+    case _NNS_UINT8:
+      segmap_argmax_quant (scores, n, job->num_classes, job->quant, job->classes + first, confidence);
+      break;
+    default:
+      segmap_argmax_int64 (scores, n, job->num_classes, job->classes + first, confidence);
+      break;
+  }
+}
+
+/*
+ * this function attaches the regions just labelled to `buf`: one detections meta, in raster order of
+ * their first pixel, and with roi-meta-compat one ROI meta each
+ */
+static gboolean
+gst_segdecode_attach_regions (GstSegDecode * filter, GstBuffer * buf)
+{
+  const SegmapRegions *labeller = filter->labeller;
+  GstTensorDetectionsMeta *meta;
+  const gdouble x_scale = (gdouble) UINT_MAX / filter->width, y_scale = (gdouble) UINT_MAX / filter->height;
+  guint r;
+  if (!labeller->num_regions)
+    return TRUE;
+  meta = gst_buffer_add_tensor_detections_meta (buf, labeller->num_regions);
+  if (!meta) {
+    GST_ERROR_OBJECT (filter, "Failed to attach the detections meta");
+    return FALSE;
+  }
+  segmap_regions_write (labeller, filter->labels ? filter->labels->quarks : NULL,
+      filter->labels ? filter->labels->num_labels : 0, meta->detections);
+  /* Legacy consumers read one ROI meta per region, in the detectors' UINT_MAX-scaled coordinates */
+  for (r = 0; filter->roi_meta_compat && r < labeller->num_regions; r++) {
+    const SegmapRegion *region = &labeller->regions[r];
+    const gchar *label = meta->detections[r].label ? g_quark_to_string (meta->detections[r].label) : NULL;
+    GstStructure *s = gst_structure_new("detection",
+      "confidence", G_TYPE_DOUBLE, (gdouble) meta->detections[r].score,
+      "label_id", G_TYPE_UINT, region->class_id,
+      "label_name", G_TYPE_STRING, label,
+      "stream_id", G_TYPE_UINT, 0,
+      NULL /* terminator: do not remove */
+      );
+    GstVideoRegionOfInterestMeta *roi = gst_buffer_add_video_region_of_interest_meta(
+        buf,
+        label,
+        region->x0 * x_scale,
+        region->y0 * y_scale,
+        (region->x1 - region->x0 + 1) * x_scale,
+        (region->y1 - region->y0 + 1) * y_scale
+        );
+    gst_video_region_of_interest_meta_add_param(roi, s);
+  }
+  return TRUE;
+}
+
+/*
+ * this function fills the memories of the pooled `map` from the scores of `inbuf`, and with regions
+ * attaches the map's regions to `target`
+ */
+static GstFlowReturn
+gst_segdecode_decode (GstSegDecode * filter, GstBuffer * inbuf, GstBuffer * map, GstBuffer * target)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo in_info, classes_info, confidence_info;
+  GstMemory *in_mem, *confidence_mem = NULL;
+  SegDecodeJob job;
+  QuantParams quant; /* the properties may change while the tasks run */
+  gint64 start = g_get_monotonic_time ();
+
+  if (!filter->num_classes) {
+    GST_ERROR_OBJECT (filter, "Tensor caps have not been negotiated");
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  job.type = filter->type;
+  job.num_classes = filter->num_classes;
+  job.num_pixels = filter->width * filter->height;
+  job.pixel_size = job.num_classes * tensor_type_size (job.type);
+  quant = filter->quant;
+  job.quant = &quant;
+  in_mem = gst_buffer_peek_memory (inbuf, 0);
+  if (!gst_memory_map (in_mem, &in_info, GST_MAP_READ)) {
+    GST_ERROR_OBJECT (filter, "Failed to map the scores");
+    return GST_FLOW_ERROR;
+  }
+  if (in_info.size < job.num_pixels * job.pixel_size) {
+    GST_ERROR_OBJECT (filter, "Scores tensor of %" G_GSIZE_FORMAT " bytes, expected %" G_GSIZE_FORMAT,
+        in_info.size, job.num_pixels * job.pixel_size);
+    gst_memory_unmap (in_mem, &in_info);
+    return GST_FLOW_ERROR;
+  }
+  if (!gst_memory_map (gst_buffer_peek_memory (map, 0), &classes_info, GST_MAP_WRITE)) {
+    GST_ERROR_OBJECT (filter, "Failed to map the class indices");
+    gst_memory_unmap (in_mem, &in_info);
+    return GST_FLOW_ERROR;
+  }
+  if (filter->confidence) {
+    confidence_mem = gst_buffer_peek_memory (map, 1);
+    if (!gst_memory_map (confidence_mem, &confidence_info, GST_MAP_WRITE)) {
+      GST_ERROR_OBJECT (filter, "Failed to map the confidence");
+      gst_memory_unmap (gst_buffer_peek_memory (map, 0), &classes_info);
+      gst_memory_unmap (in_mem, &in_info);
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  job.scores = in_info.data;
+  job.classes = classes_info.data;
+  job.confidence = confidence_mem ? (gfloat *) confidence_info.data : NULL;
+  decode_pool_run ((job.num_pixels + SEGDECODE_TASK_PIXELS - 1) / SEGDECODE_TASK_PIXELS, filter->n_threads,
+      gst_segdecode_decode_task, &job);
+  /* the labelling follows the decode on this thread; it is one pass over the map, in cache */
+  if (filter->labeller) {
+    segmap_regions_label (filter->labeller, job.classes, filter->background, filter->min_area);
+    if (!gst_segdecode_attach_regions (filter, target))
+      ret = GST_FLOW_ERROR;
+  }
+
+  if (confidence_mem)
+    gst_memory_unmap (confidence_mem, &confidence_info);
+  gst_memory_unmap (gst_buffer_peek_memory (map, 0), &classes_info);
+  gst_memory_unmap (in_mem, &in_info);
+  if (!filter->silent)
+    GST_LOG_OBJECT (filter, "%ux%u map of %u classes, %u regions in %" G_GINT64_FORMAT " us", filter->width,
+        filter->height, filter->num_classes, filter->labeller ? filter->labeller->num_regions : 0,
+        g_get_monotonic_time () - start);
+  return ret;
+}
+
+/* with output=tensor, the map itself is the output buffer */
+static GstFlowReturn
+gst_segdecode_prepare_output_buffer (GstBaseTransform * trans, GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+  GstSegDecode *filter = GST_SEGDECODE (trans);
+  GstFlowReturn ret;
+  if (gst_base_transform_is_in_place (trans))
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->prepare_output_buffer (trans, inbuf, outbuf);
+  if (!filter->pool) {
+    GST_ERROR_OBJECT (filter, "Tensor caps have not been negotiated");
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  ret = gst_buffer_pool_acquire_buffer (filter->pool, outbuf, NULL);
+  if (ret != GST_FLOW_OK)
+    return ret;
+  gst_buffer_copy_into (*outbuf, inbuf, GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_segdecode_transform (GstBaseTransform * trans, GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  return gst_segdecode_decode (GST_SEGDECODE (trans), inbuf, outbuf, outbuf);
+}
+
+/* with output=meta, a pooled map is attached to the scores */
+static GstFlowReturn
+gst_segdecode_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstSegDecode *filter = GST_SEGDECODE (trans);
+  GstBuffer *map = NULL;
+  GstFlowReturn ret;
+  if (!filter->pool) {
+    GST_ERROR_OBJECT (filter, "Tensor caps have not been negotiated");
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  ret = gst_buffer_pool_acquire_buffer (filter->pool, &map, NULL);
+  if (ret != GST_FLOW_OK)
+    return ret;
+  ret = gst_segdecode_decode (filter, buf, map, buf);
+  if (ret == GST_FLOW_OK &&
+      !gst_buffer_add_tensor_segmap_meta (buf, map, filter->width, filter->height, filter->num_classes)) {
+    GST_ERROR_OBJECT (filter, "Failed to attach the map");
+    ret = GST_FLOW_ERROR;
+  }
+  /* the meta holds its own reference; the map returns to the pool with the buffer */
+  gst_buffer_unref (map);
+  return ret;
+}
@@ -0,0 +1,75 @@
+/*
+ * No license installed
+ */
+
+#ifndef __GST_SEGDECODE_H__
+#define __GST_SEGDECODE_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "libtensordecode.h"
+#include "gsttensorsegmapmeta.h"
+#include "segmapregions.h"
+
+G_BEGIN_DECLS
+
+/* #defines don't like whitespacey bits */
+#define GST_TYPE_SEGDECODE \
+  (gst_segdecode_get_type())
+#define GST_SEGDECODE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SEGDECODE,GstSegDecode))
+#define GST_SEGDECODE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_SEGDECODE,GstSegDecodeClass))
+#define GST_IS_SEGDECODE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SEGDECODE))
+#define GST_IS_SEGDECODE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_SEGDECODE))
+
+#define GST_TYPE_SEGDECODE_OUTPUT (gst_segdecode_output_get_type())
+
+typedef struct _GstSegDecode      GstSegDecode;
+typedef struct _GstSegDecodeClass GstSegDecodeClass;
+
+/* where the class-index map goes */
+typedef enum
+{
+  SEGDECODE_OUTPUT_TENSOR, /* replaces the scores tensor */
+  SEGDECODE_OUTPUT_META    /* attached to the scores buffer as GstTensorSegmapMeta */
+} GstSegDecodeOutput;
+
+struct _GstSegDecode
+{
+  GstBaseTransform element;
+
+  GstSegDecodeOutput output;
+  gboolean confidence;
+  QuantParams quant; /* of uint8 scores, for their confidence */
+  guint n_threads;
+  gboolean regions;
+  guint min_area;
+  gint background;
+  gchar *labels_path;
+  const LabelTable *labels; /* asset cache reference; NULL without labels */
+  gboolean roi_meta_compat;
+  gboolean silent;
+
+  /* negotiated */
+  tensor_type type;
+  guint num_classes; /* 1 if the model argmaxes in-graph */
+  guint width;
+  guint height;
+  GstBufferPool *pool; /* of maps of width x height, with confidence if asked for */
+  SegmapRegions *labeller; /* of width x height maps, with regions */
+};
+
+struct _GstSegDecodeClass
+{
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_segdecode_get_type (void);
+GType gst_segdecode_output_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_SEGDECODE_H__ */
@@ -7,6 +7,8 @@
  *
  * Decode boundary boxes from an SSD model and add results to the stream's GstMeta-space.
  *
+ * This is tensordecode starting in mode=ssd; see tensordecode for the properties and pads.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -23,370 +25,24 @@
 
 #include "gstssddecode.h"
 
-GST_DEBUG_CATEGORY_STATIC (gst_ssddecode_debug);
-#define GST_CAT_DEFAULT gst_ssddecode_debug
-
-/* Filter signals and args */
-enum
-{
-  /* FILL ME */
-  LAST_SIGNAL
-};
-
-enum
-{
-  PROP_0, /* Anchor prop. Do not remove. */
-  PROP_LABELS,
-  PROP_BOX_PRIORS,
-  PROP_DEQUANT,
-  PROP_BATCH_SIZE,
-  PROP_SILENT
-};
-
-#define SSDDECODE_DESC "Decode boundary boxes from an SSD model"
-
-/* the capabilities of the inputs and outputs.
- *
- * describe the real formats here.
- */
-static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
-    GST_PAD_SINK,
-    GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
-    );
-
-static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
-    GST_PAD_SRC,
-    GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
-    );
-
-#define gst_ssddecode_parent_class parent_class
-G_DEFINE_TYPE (GstSSDDecode, gst_ssddecode, GST_TYPE_ELEMENT);
-
-static void gst_ssddecode_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec);
-static void gst_ssddecode_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec);
-
-static gboolean gst_ssddecode_sink_event (GstPad * pad, GstObject * parent, GstEvent * event);
-static GstFlowReturn gst_ssddecode_chain (GstPad * pad, GstObject * parent, GstBuffer * buf);
-static GstBuffer *gst_ssddecode_process (GstSSDDecode *filter, GstBuffer *inbuf);
-
-/* GObject vmethod implementations */
+G_DEFINE_TYPE (GstSSDDecode, gst_ssddecode, GST_TYPE_TENSORDECODE);
 
 /* initialize the ssddecode's class */
 static void
 gst_ssddecode_class_init (GstSSDDecodeClass * klass)
 {
-  GObjectClass *gobject_class;
-  GstElementClass *gstelement_class;
-
-  gobject_class = (GObjectClass *) klass;
-  gstelement_class = (GstElementClass *) klass;
-
-  gobject_class->set_property = gst_ssddecode_set_property;
-  gobject_class->get_property = gst_ssddecode_get_property;
-
-  g_object_class_install_property (gobject_class, PROP_LABELS,
-      g_param_spec_string ("labels", "Labels", "Path to labels list file ?",
-          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_property (gobject_class, PROP_BOX_PRIORS,
-      g_param_spec_string ("boxpriors", "Box-Priors", "Path to box-priors file ?",
-          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_property (gobject_class, PROP_DEQUANT,
-      g_param_spec_boolean ("dequant", "Dequant", "Dequantize input tensors (workaround for NNStreamer multi-tensor support; consider tensor_split, tensor_transform and tensor_merge instead) ?",
-          FALSE, G_PARAM_READWRITE));
-
-  g_object_class_install_property (gobject_class, PROP_BATCH_SIZE,
-      g_param_spec_uint ("batch-size", "Batch-Size", "Frames per batch ?",
-          1, 1024, 1, G_PARAM_READWRITE));
-
-  g_object_class_install_property (gobject_class, PROP_SILENT,
-      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
-          FALSE, G_PARAM_READWRITE));
-
-  gst_element_class_set_details_simple(gstelement_class,
+  gst_element_class_set_details_simple(GST_ELEMENT_CLASS (klass),
     "SSDDecode",
     "SSD Decoder",
     "SSD Decoder Element",
     "Aaron Arthurs <aajarthurs@gmail.com>");
-
-  gst_element_class_add_pad_template (gstelement_class,
-      gst_static_pad_template_get (&src_factory));
-  gst_element_class_add_pad_template (gstelement_class,
-      gst_static_pad_template_get (&sink_factory));
 }
 
 /* initialize the new element
- * instantiate pads and add them to element
- * set pad calback functions
- * initialize instance structure
+ * tensordecode does the work; only the mode differs
  */
 static void
 gst_ssddecode_init (GstSSDDecode * filter)
 {
-  filter->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
-  gst_pad_set_event_function (filter->sinkpad,
-                              GST_DEBUG_FUNCPTR(gst_ssddecode_sink_event));
-  gst_pad_set_chain_function (filter->sinkpad,
-                              GST_DEBUG_FUNCPTR(gst_ssddecode_chain));
-  GST_PAD_SET_PROXY_CAPS (filter->sinkpad);
-  gst_element_add_pad (GST_ELEMENT (filter), filter->sinkpad);
-
-  filter->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
-  GST_PAD_SET_PROXY_CAPS (filter->srcpad);
-  gst_element_add_pad (GST_ELEMENT (filter), filter->srcpad);
-
-  filter->labels_path = NULL;
-  filter->need_dequant = FALSE;
-  filter->silent = FALSE;
-}
-
-static void
-gst_ssddecode_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec)
-{
-  GstSSDDecode *filter = GST_SSDDECODE (object);
-
-  switch (prop_id) {
-    case PROP_LABELS:
-      filter->labels_path = g_value_get_string (value);
-      if(!tflite_load_labels(filter->labels_path, filter->labels))
-        GST_ERROR_OBJECT(filter, "Failed to load labels from %s", filter->labels_path);
-      else if (!filter->silent) {
-        int irow = 0;
-        const gchar *row;
-        GST_LOG_OBJECT(filter, "Loaded labels from %s", filter->labels_path);
-        do {
-          row = filter->labels[irow];
-          GST_LOG_OBJECT(filter, "             label %d:'%s'", irow, row);
-          irow++;
-        } while(row && irow < LABEL_SIZE);
-      }
-      break;
-    case PROP_BOX_PRIORS:
-      filter->box_priors_path = g_value_get_string (value);
-      if(!tflite_load_box_priors(filter->box_priors_path, filter->box_priors))
-        GST_ERROR_OBJECT(filter, "Failed to load box-priors from %s", filter->box_priors_path);
-      else if (!filter->silent)
-        GST_LOG_OBJECT(filter, "Loaded box-priors from %s", filter->box_priors_path);
-      break;
-    case PROP_DEQUANT:
-      filter->need_dequant = g_value_get_boolean (value);
-      break;
-    case PROP_BATCH_SIZE:
-      filter->batch_size = g_value_get_uint (value);
-      break;
-    case PROP_SILENT:
-      filter->silent = g_value_get_boolean (value);
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
-  }
-}
-
-static void
-gst_ssddecode_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec)
-{
-  GstSSDDecode *filter = GST_SSDDECODE (object);
-
-  switch (prop_id) {
-    case PROP_LABELS:
-      g_value_set_string (value, filter->labels_path);
-      break;
-    case PROP_BOX_PRIORS:
-      g_value_set_string (value, filter->box_priors_path);
-      break;
-    case PROP_DEQUANT:
-      g_value_set_boolean (value, filter->need_dequant);
-      break;
-    case PROP_BATCH_SIZE:
-      g_value_set_uint (value, filter->batch_size);
-      break;
-    case PROP_SILENT:
-      g_value_set_boolean (value, filter->silent);
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
-  }
-}
-
-/* GstElement vmethod implementations */
-
-/* this function handles sink events */
-static gboolean
-gst_ssddecode_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
-{
-  GstSSDDecode *filter;
-  gboolean ret;
-
-  filter = GST_SSDDECODE (parent);
-
-  GST_LOG_OBJECT (filter, "Received %s event: %" GST_PTR_FORMAT,
-      GST_EVENT_TYPE_NAME (event), event);
-
-  switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_CAPS:
-    {
-      GstCaps * caps;
-
-      gst_event_parse_caps (event, &caps);
-      /* do something with the caps */
-
-      /* and forward */
-      ret = gst_pad_event_default (pad, parent, event);
-      break;
-    }
-    default:
-      ret = gst_pad_event_default (pad, parent, event);
-      break;
-  }
-  return ret;
-}
-
-/* chain function
- * this function is called when a buffer is pushed into the sink-pad
- */
-static GstFlowReturn
-gst_ssddecode_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
-{
-  GstSSDDecode *filter;
-  GstBuffer *outbuf;
-  gboolean sanity_check = TRUE;
-  filter = GST_SSDDECODE (parent);
-  if (!filter->labels_path) {
-    GST_ERROR_OBJECT(filter, "Required property 'labels' is missing");
-    sanity_check = FALSE;
-  }
-  if (!filter->box_priors_path) {
-    GST_ERROR_OBJECT(filter, "Required property 'boxpriors' is missing");
-    sanity_check = FALSE;
-  }
-  if (!sanity_check) return GST_FLOW_ERROR;
-  outbuf = gst_ssddecode_process (filter, buf);
-  if (!outbuf) return GST_FLOW_ERROR;
-  /* Push tensor buffer to srcpad */
-  return gst_pad_push (filter->srcpad, outbuf);
+  GST_TENSORDECODE (filter)->mode = TENSORDECODE_MODE_SSD;
 }
-
-/*
- * this function decodes and scales objects given the tensor
- * returns annotated buffer on success, NULL on error
- */
-static GstBuffer *
-gst_ssddecode_process (GstSSDDecode *filter, GstBuffer *inbuf)
-{
-  GstBuffer *outbuf;
-  gboolean sanity_check = TRUE;
-  GstMemory *in_mem[NNS_TENSOR_SIZE_LIMIT];
-  GstMapInfo in_info[NNS_TENSOR_SIZE_LIMIT];
-  gfloat boxes[DETECTION_MAX * BOX_SIZE];
-  gfloat predictions[DETECTION_MAX * LABEL_SIZE];
-  gfloat *pboxes;
-  gfloat *ppredictions;
-  DetectedObject detections[DETECTION_MAX * LABEL_SIZE];
-  guint num_detections = 0, b, i, j;
-  /* Map boxes and predictions tensors from model */
-  for (i=0; i<2; i++) {
-    in_mem[i] = gst_buffer_peek_memory (inbuf, i);
-    g_assert (gst_memory_map (in_mem[i], &in_info[i], GST_MAP_READ));
-  }
-  for (b=0; b<filter->batch_size; b++) {
-    if (filter->need_dequant) {
-      pboxes = boxes;
-      ppredictions = predictions;
-      for (i=0; i<DETECTION_MAX; i++)
-        for (j=0; j<BOX_SIZE; j++)
-          boxes[i*BOX_SIZE+j] = (gfloat)(((gfloat)(in_info[0].data[b*DETECTION_MAX*BOX_SIZE+i*BOX_SIZE+j])-180.0) * 0.0448576174609375);
-      for (i=0; i<DETECTION_MAX; i++)
-        for (j=0; j<LABEL_SIZE; j++)
-          predictions[i*LABEL_SIZE+j] = (gfloat)(((gfloat)(in_info[1].data[b*DETECTION_MAX*LABEL_SIZE+i*LABEL_SIZE+j])-128.0) / 128.0);
-    } else { // no dequant, read as-is
-      pboxes = (gfloat *)(in_info[0].data[b*DETECTION_MAX*BOX_SIZE]);
-      ppredictions = (gfloat *)(in_info[1].data[b*DETECTION_MAX*LABEL_SIZE]);
-    }
-    /* Process boxes and predictions into an array of DetectedObjects */
-    sanity_check = get_detected_objects (filter->box_priors, filter->labels, ppredictions, pboxes, detections, &num_detections);
-    /* Request write-access to tensor buffer to add ROIs, which will be pushed out the tensor srcpad */
-    outbuf = gst_buffer_make_writable(inbuf);
-    if (!gst_buffer_is_writable(outbuf)) {
-      GST_ERROR_OBJECT (filter, "Failed to gain write-access to tensor buffer: %" GST_PTR_FORMAT, outbuf);
-      sanity_check = FALSE;
-    }
-    if(!sanity_check) return NULL;
-    /* Attach ROIs to the tensor buffer */
-    for(i=0; i<num_detections; i++) {
-      DetectedObject *d = &detections[i];
-      GstStructure *s = gst_structure_new("detection",
-        "confidence", G_TYPE_DOUBLE, d->score,
-        "label_id", G_TYPE_UINT, d->class_id,
-        "label_name", G_TYPE_STRING, d->class_label,
-        "stream_id", G_TYPE_UINT, b,
-        NULL /* terminator: do not remove */
-        );
-      GstVideoRegionOfInterestMeta *meta = gst_buffer_add_video_region_of_interest_meta(
-          outbuf,
-          d->class_label,
-          d->x,
-          d->y,
-          d->width,
-          d->height
-          );
-      gst_video_region_of_interest_meta_add_param(meta, s);
-    }
-  }
-  /* Teardown tensor mapping */
-  for (i=0; i<2; i++) {
-    gst_memory_unmap (in_mem[i], &in_info[i]);
-  }
-  return outbuf;
-}
-
-/* entry point to initialize the plug-in
- * initialize the plug-in itself
- * register the element factories and other features
- */
-static gboolean
-ssddecode_init (GstPlugin * ssddecode)
-{
-  /* debug category for fltering log messages
-   *
-   * exchange the string 'Template ssddecode' with your description
-   */
-  GST_DEBUG_CATEGORY_INIT (gst_ssddecode_debug, "ssddecode",
-      0, SSDDECODE_DESC);
-
-  return gst_element_register (ssddecode, "ssddecode", GST_RANK_NONE,
-      GST_TYPE_SSDDECODE);
-}
-
-/* PACKAGE: this is usually set by autotools depending on some _INIT macro
- * in configure.ac and then written into and defined in config.h, but we can
- * just set it ourselves here in case someone doesn't use autotools to
- * compile this code. GST_PLUGIN_DEFINE needs PACKAGE to be defined.
- */
-#ifndef PACKAGE
-#define PACKAGE "ssddecode"
-#endif
-
-/* gstreamer looks for this structure to register ssddecodes
- *
- * exchange the string 'Template ssddecode' with your ssddecode description
- */
-GST_PLUGIN_DEFINE (
-    GST_VERSION_MAJOR,
-    GST_VERSION_MINOR,
-    ssddecode,
-    SSDDECODE_DESC,
-    ssddecode_init,
-    PACKAGE_VERSION,
-    GST_LICENSE,
-    GST_PACKAGE_NAME,
-    GST_PACKAGE_ORIGIN
-)
@@ -5,9 +5,7 @@
 #ifndef __GST_SSDDECODE_H__
 #define __GST_SSDDECODE_H__
 
-#include <gst/gst.h>
-#include <gst/video/gstvideometa.h>
-#include "libtensordecode.h"
+#include "gsttensordecode.h"
 
 G_BEGIN_DECLS
 
@@ -26,24 +24,15 @@ G_BEGIN_DECLS
 typedef struct _GstSSDDecode      GstSSDDecode;
 typedef struct _GstSSDDecodeClass GstSSDDecodeClass;
 
+/* tensordecode in mode=ssd, under its original name */
 struct _GstSSDDecode
 {
-  GstElement element;
-
-  GstPad *sinkpad, *srcpad;
-
-  const gchar *labels_path;
-  const gchar *box_priors_path;
-  gfloat box_priors[BOX_SIZE][DETECTION_MAX];
-  const gchar *labels[LABEL_SIZE];
-  gboolean silent;
-  gboolean need_dequant;
-  guint batch_size;
+  GstTensorDecode decoder;
 };
 
 struct _GstSSDDecodeClass
 {
-  GstElementClass parent_class;
+  GstTensorDecodeClass parent_class;
 };
 
 GType gst_ssddecode_get_type (void);
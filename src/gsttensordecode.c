@@ -0,0 +1,1448 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:element-tensordecode
+ *
+ * Decode detections from the output tensors of a model and add results to the stream's GstMeta-space.
+ *
+ * The 'mode' property picks the backend that reads the tensors: 'ssd' decodes
+ * SSD box encodings and class logits against anchors, 'bb' reads the boxes,
+ * classes, scores and counts of the TFLite detections postprocessor. Either
+ * way, the element attaches one GstTensorDetectionsMeta per buffer, decodes
+ * batches on the shared decode pool, and offers the same pads: video_sink and
+ * video_src attach detections to frames, detections_src carries them as a
+ * tensor, and src_%u carry one stream of a batch each.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -v -m fakesrc ! tensordecode mode=ssd boxpriors=PATH labels=PATH ! fakesink silent=TRUE
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+
+#include "gsttensordecode.h"
+
+GST_DEBUG_CATEGORY (gst_tensordecode_debug);
+#define GST_CAT_DEFAULT gst_tensordecode_debug
+
+/* Filter signals and args */
+enum
+{
+  /* FILL ME */
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0, /* Anchor prop. Do not remove. */
+  PROP_MODE,
+  PROP_LABELS,
+  PROP_DEQUANT,
+  PROP_BATCH_SIZE,
+  PROP_N_THREADS,
+  PROP_MAX_DETECTIONS,
+  PROP_MAX_PER_CLASS,
+  PROP_BOX_ZERO_POINT,
+  PROP_BOX_QUANT_SCALE,
+  PROP_SCORE_ZERO_POINT,
+  PROP_SCORE_QUANT_SCALE,
+  PROP_ASYNC,
+  PROP_QUEUE_SIZE,
+  PROP_ROI_META_COMPAT,
+  PROP_VIDEO_POLICY,
+  PROP_SYNC_TOLERANCE,
+  PROP_MAX_WAIT,
+  PROP_SILENT,
+  PROP_BACKENDS /* the backends' properties follow, in mode order */
+};
+
+#define TENSORDECODE_DESC "Decode detections from the output tensors of a model"
+
+#define DEFAULT_MODE TENSORDECODE_MODE_SSD
+#define DEFAULT_ASYNC FALSE
+#define DEFAULT_QUEUE_SIZE 2
+#define DEFAULT_ROI_META_COMPAT FALSE
+#define DEFAULT_VIDEO_POLICY TENSORDECODE_VIDEO_POLICY_WAIT
+#define DEFAULT_SYNC_TOLERANCE GST_MSECOND
+#define DEFAULT_MAX_WAIT (200 * GST_MSECOND)
+#define TENSORDECODE_STREAM_PAD_TEMPLATE "src_%u"
+
+/* by mode */
+static const GstTensorDecodeBackend *const backends[TENSORDECODE_NUM_MODES] = {
+  &gst_tensordecode_ssd_backend,
+  &gst_tensordecode_bb_backend,
+  &gst_tensordecode_yolo_backend,
+};
+static guint backend_prop_base[TENSORDECODE_NUM_MODES];
+
+#define BACKEND(decoder) (backends[(decoder)->mode])
+
+/* the capabilities of the inputs and outputs.
+ *
+ * describe the real formats here.
+ */
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate stream_src_factory = GST_STATIC_PAD_TEMPLATE (TENSORDECODE_STREAM_PAD_TEMPLATE,
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (TENSOR_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate video_sink_factory = GST_STATIC_PAD_TEMPLATE ("video_sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate video_src_factory = GST_STATIC_PAD_TEMPLATE ("video_src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate detections_src_factory = GST_STATIC_PAD_TEMPLATE (GST_TENSOR_DETECTIONS_SRC_NAME,
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (GST_TENSOR_DETECTIONS_SRC_CAPS)
+    );
+
+#define gst_tensordecode_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstTensorDecode, gst_tensordecode, GST_TYPE_BASE_TRANSFORM,
+    GST_DEBUG_CATEGORY_INIT (gst_tensordecode_debug, "tensordecode", 0, TENSORDECODE_DESC));
+
+GType
+gst_tensordecode_mode_get_type (void)
+{
+  static gsize type = 0;
+  if (g_once_init_enter (&type)) {
+    static GEnumValue values[TENSORDECODE_NUM_MODES + 1];
+    guint m;
+    for (m = 0; m < TENSORDECODE_NUM_MODES; m++) {
+      values[m].value = m;
+      values[m].value_name = backends[m]->description;
+      values[m].value_nick = backends[m]->mode;
+    }
+    g_once_init_leave (&type, g_enum_register_static ("GstTensorDecodeMode", values));
+  }
+  return type;
+}
+
+GType
+gst_tensordecode_video_policy_get_type (void)
+{
+  static gsize type = 0;
+  if (g_once_init_enter (&type)) {
+    static const GEnumValue values[] = {
+      { TENSORDECODE_VIDEO_POLICY_WAIT, "Hold the frame until its result arrives, for up to max-wait", "wait" },
+      { TENSORDECODE_VIDEO_POLICY_REUSE, "Attach the latest earlier result", "reuse" },
+      { TENSORDECODE_VIDEO_POLICY_PASS, "Push the frame without detections", "pass" },
+      { 0, NULL, NULL }
+    };
+    g_once_init_leave (&type, g_enum_register_static ("GstTensorDecodeVideoPolicy", values));
+  }
+  return type;
+}
+
+static void gst_tensordecode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_tensordecode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_tensordecode_finalize (GObject * object);
+
+static GstStateChangeReturn gst_tensordecode_change_state (GstElement * element, GstStateChange transition);
+static GstPad *gst_tensordecode_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps);
+static void gst_tensordecode_release_pad (GstElement * element, GstPad * pad);
+static gboolean gst_tensordecode_sink_event (GstBaseTransform * trans, GstEvent * event);
+static gboolean gst_tensordecode_query (GstBaseTransform * trans, GstPadDirection direction, GstQuery * query);
+static gboolean gst_tensordecode_set_caps (GstBaseTransform * trans, GstCaps * incaps, GstCaps * outcaps);
+static GstFlowReturn gst_tensordecode_submit_input_buffer (GstBaseTransform * trans, gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_tensordecode_generate_output (GstBaseTransform * trans, GstBuffer ** outbuf);
+static GstFlowReturn gst_tensordecode_transform_ip (GstBaseTransform * trans, GstBuffer * buf);
+static void gst_tensordecode_loop (GstTensorDecode * decoder);
+static GstFlowReturn gst_tensordecode_video_chain (GstPad * pad, GstObject * parent, GstBuffer * frame);
+static gboolean gst_tensordecode_video_sink_event (GstPad * pad, GstObject * parent, GstEvent * event);
+static gboolean gst_tensordecode_video_src_query (GstPad * pad, GstObject * parent, GstQuery * query);
+static GstIterator *gst_tensordecode_video_iterate_internal_links (GstPad * pad, GstObject * parent);
+static GstFlowReturn gst_tensordecode_process (GstTensorDecode *decoder, GstBuffer *buf);
+
+/* GObject vmethod implementations */
+
+/* initialize the tensordecode's class */
+static void
+gst_tensordecode_class_init (GstTensorDecodeClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseTransformClass *trans_class;
+  guint m, prop_base = PROP_BACKENDS;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  trans_class = (GstBaseTransformClass *) klass;
+
+  gobject_class->set_property = gst_tensordecode_set_property;
+  gobject_class->get_property = gst_tensordecode_get_property;
+  gobject_class->finalize = gst_tensordecode_finalize;
+  gstelement_class->change_state = gst_tensordecode_change_state;
+  gstelement_class->request_new_pad = gst_tensordecode_request_new_pad;
+  gstelement_class->release_pad = gst_tensordecode_release_pad;
+  trans_class->sink_event = GST_DEBUG_FUNCPTR (gst_tensordecode_sink_event);
+  trans_class->query = GST_DEBUG_FUNCPTR (gst_tensordecode_query);
+  trans_class->set_caps = GST_DEBUG_FUNCPTR (gst_tensordecode_set_caps);
+  trans_class->submit_input_buffer = GST_DEBUG_FUNCPTR (gst_tensordecode_submit_input_buffer);
+  trans_class->generate_output = GST_DEBUG_FUNCPTR (gst_tensordecode_generate_output);
+  trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_tensordecode_transform_ip);
+
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode", "Model family the tensors are decoded as ?",
+          GST_TYPE_TENSORDECODE_MODE, DEFAULT_MODE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_LABELS,
+      g_param_spec_string ("labels", "Labels", "Path to labels list file ?",
+          "", G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DEQUANT,
+      g_param_spec_boolean ("dequant", "Dequant", "Decode input tensors as uint8-quantized even if the caps say otherwise (uint8 caps select this automatically) ?",
+          FALSE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Batch-Size", "Frames per batch ?",
+          1, TENSORDECODE_MAX_BATCH, 1, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "N-Threads", "Threads decoding a buffer, across batch entries and across anchor ranges of large models (0 = one per processor) ?",
+          0, 1024, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_DETECTIONS,
+      g_param_spec_uint ("max-detections", "Max-Detections", "Best-scoring candidates per frame passed to NMS (0 = unlimited) ?",
+          0, G_MAXUINT, DEFAULT_MAX_DETECTIONS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PER_CLASS,
+      g_param_spec_uint ("max-per-class", "Max-Per-Class", "Best-scoring candidates per class and frame passed to NMS (0 = unlimited) ?",
+          0, G_MAXUINT, DEFAULT_MAX_PER_CLASS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BOX_ZERO_POINT,
+      g_param_spec_int ("box-zero-point", "Box-Zero-Point", "Zero-point of quantized box tensors ?",
+          0, 255, BOX_ZERO_POINT, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BOX_QUANT_SCALE,
+      g_param_spec_double ("box-quant-scale", "Box-Quant-Scale", "Scale of quantized box tensors ?",
+          G_MINDOUBLE, G_MAXDOUBLE, BOX_QUANT_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SCORE_ZERO_POINT,
+      g_param_spec_int ("score-zero-point", "Score-Zero-Point", "Zero-point of quantized class predictions ?",
+          0, 255, SCORE_ZERO_POINT, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SCORE_QUANT_SCALE,
+      g_param_spec_double ("score-quant-scale", "Score-Quant-Scale", "Scale of quantized class predictions ?",
+          G_MINDOUBLE, G_MAXDOUBLE, SCORE_QUANT_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_ASYNC,
+      g_param_spec_boolean ("async", "Async", "Decode on a separate thread so upstream can process the next buffer meanwhile ?",
+          DEFAULT_ASYNC, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_SIZE,
+      g_param_spec_uint ("queue-size", "Queue-Size", "Buffers waiting to be decoded in async mode before upstream blocks ?",
+          1, 64, DEFAULT_QUEUE_SIZE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_ROI_META_COMPAT,
+      g_param_spec_boolean ("roi-meta-compat", "ROI-Meta-Compat", "Also attach a GstVideoRegionOfInterestMeta per detection ?",
+          DEFAULT_ROI_META_COMPAT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_VIDEO_POLICY,
+      g_param_spec_enum ("video-policy", "Video-Policy", "What video_sink does with a frame whose tensors have not been decoded yet ?",
+          GST_TYPE_TENSORDECODE_VIDEO_POLICY, DEFAULT_VIDEO_POLICY, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SYNC_TOLERANCE,
+      g_param_spec_uint64 ("sync-tolerance", "Sync-Tolerance", "Largest running-time difference (ns) between a frame and the tensors it takes detections from ?",
+          0, G_MAXUINT64, DEFAULT_SYNC_TOLERANCE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_WAIT,
+      g_param_spec_uint64 ("max-wait", "Max-Wait", "Longest time (ns) a frame waits for its detections with video-policy=wait ?",
+          0, G_MAXUINT64, DEFAULT_MAX_WAIT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SILENT,
+      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
+          FALSE, G_PARAM_READWRITE));
+
+  /* every backend's properties, so they can be set before mode */
+  for (m = 0; m < TENSORDECODE_NUM_MODES; m++) {
+    backend_prop_base[m] = prop_base;
+    if (backends[m]->install_properties)
+      backends[m]->install_properties (gobject_class, prop_base);
+    prop_base += backends[m]->num_properties;
+  }
+
+  gst_element_class_set_details_simple(gstelement_class,
+    "TensorDecode",
+    "Tensor Decoder",
+    "Tensor Decoder Element",
+    "Aaron Arthurs <aajarthurs@gmail.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&stream_src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&detections_src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&video_sink_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&video_src_factory));
+}
+
+/* only buffers take a place of queue-size; events are queued behind them regardless */
+static gboolean
+gst_tensordecode_is_buffer (gconstpointer item)
+{
+  return GST_IS_BUFFER (item);
+}
+
+/* initialize the new element
+ * the base class creates the tensor pads; ROIs are added to the tensor buffer in place
+ * video_sink/video_src pass frames through, each with the detections of its tensors
+ * initialize instance structure
+ */
+static void
+gst_tensordecode_init (GstTensorDecode * decoder)
+{
+  guint m;
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (decoder), TRUE);
+  gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (decoder), TRUE);
+
+  decoder->mode = DEFAULT_MODE;
+  for (m = 0; m < TENSORDECODE_NUM_MODES; m++)
+    decoder->states[m] = backends[m]->new (decoder);
+  memset (&decoder->entry, 0, sizeof (decoder->entry));
+  memset (decoder->entry_size, 0, sizeof (decoder->entry_size));
+  decoder->labels_path = NULL;
+  decoder->labels = NULL;
+  decoder->arenas = NULL;
+  decoder->num_arenas = 0;
+  decoder->box_quant.zero_point = BOX_ZERO_POINT;
+  decoder->box_quant.scale = BOX_QUANT_SCALE;
+  decoder->score_quant.zero_point = SCORE_ZERO_POINT;
+  decoder->score_quant.scale = SCORE_QUANT_SCALE;
+  decoder->need_dequant = FALSE;
+  decoder->quantized = FALSE;
+  decoder->batch_size = 1;
+  decoder->n_threads = 0;
+  decoder->max_detections = DEFAULT_MAX_DETECTIONS;
+  decoder->max_per_class = DEFAULT_MAX_PER_CLASS;
+  decoder->roi_meta_compat = DEFAULT_ROI_META_COMPAT;
+  decoder->silent = FALSE;
+  gst_tensor_detections_src_init (&decoder->detections, GST_ELEMENT (decoder),
+      GST_BASE_TRANSFORM_SINK_PAD (decoder), &GST_BASE_TRANSFORM (decoder)->segment);
+  decoder->stream_caps = NULL;
+  decoder->stream_pads = g_ptr_array_new_with_free_func (g_free);
+  decoder->async = DEFAULT_ASYNC;
+  decode_queue_init (&decoder->queue, DEFAULT_QUEUE_SIZE, gst_tensordecode_is_buffer,
+      (GDestroyNotify) gst_mini_object_unref);
+  decode_queue_stop (&decoder->queue, GST_FLOW_FLUSHING);
+  decoder->decode_latency = 0;
+  decoder->video_sinkpad = gst_pad_new_from_static_template (&video_sink_factory, "video_sink");
+  gst_pad_set_chain_function (decoder->video_sinkpad, GST_DEBUG_FUNCPTR (gst_tensordecode_video_chain));
+  gst_pad_set_event_function (decoder->video_sinkpad, GST_DEBUG_FUNCPTR (gst_tensordecode_video_sink_event));
+  gst_pad_set_iterate_internal_links_function (decoder->video_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_tensordecode_video_iterate_internal_links));
+  GST_PAD_SET_PROXY_CAPS (decoder->video_sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (decoder->video_sinkpad);
+  gst_element_add_pad (GST_ELEMENT (decoder), decoder->video_sinkpad);
+  decoder->video_srcpad = gst_pad_new_from_static_template (&video_src_factory, "video_src");
+  gst_pad_set_query_function (decoder->video_srcpad, GST_DEBUG_FUNCPTR (gst_tensordecode_video_src_query));
+  gst_pad_set_iterate_internal_links_function (decoder->video_srcpad,
+      GST_DEBUG_FUNCPTR (gst_tensordecode_video_iterate_internal_links));
+  GST_PAD_SET_PROXY_CAPS (decoder->video_srcpad);
+  GST_PAD_SET_PROXY_ALLOCATION (decoder->video_srcpad);
+  gst_element_add_pad (GST_ELEMENT (decoder), decoder->video_srcpad);
+  decoder->video_policy = DEFAULT_VIDEO_POLICY;
+  decoder->sync_tolerance = DEFAULT_SYNC_TOLERANCE;
+  decoder->max_wait = DEFAULT_MAX_WAIT;
+  gst_segment_init (&decoder->video_segment, GST_FORMAT_TIME);
+  sync_window_init (&decoder->sync_window, (GDestroyNotify) gst_buffer_unref);
+  decoder->tensor_eos = FALSE;
+  decoder->video_flushing = TRUE;
+  g_mutex_init (&decoder->sync_lock);
+  g_cond_init (&decoder->sync_cond);
+}
+
+/* rebuild the arenas' dequantization tables after a zero-point or scale change; only in READY, when nothing decodes */
+static void
+gst_tensordecode_update_quantization (GstTensorDecode * decoder)
+{
+  guint b;
+  for (b = 0; b < decoder->num_arenas; b++)
+    decode_arena_set_quantization (decoder->arenas[b], &decoder->box_quant, &decoder->score_quant);
+}
+
+static void
+gst_tensordecode_free_arenas (GstTensorDecode * decoder)
+{
+  guint b;
+  for (b = 0; b < decoder->num_arenas; b++)
+    decode_arena_free (decoder->arenas[b]);
+  g_free (decoder->arenas);
+  decoder->arenas = NULL;
+  decoder->num_arenas = 0;
+}
+
+/*
+ * make sure there is an arena of num_anchors x num_classes for each of batch-size entries,
+ * scoring the classes from first_class up; the arenas are sized for max-detections and max-per-class, so they are rebuilt when those change,
+ * and take n-threads here, on the streaming thread, rather than when the property is set
+ */
+gboolean
+gst_tensordecode_reserve_arenas (GstTensorDecode * decoder, guint num_anchors, guint num_classes, guint first_class)
+{
+  guint count = decoder->batch_size;
+  guint b;
+  if (decoder->num_arenas && (decoder->arenas[0]->num_anchors != num_anchors ||
+      decoder->arenas[0]->num_classes != num_classes ||
+      decoder->arenas[0]->first_class != first_class ||
+      decoder->arenas[0]->max_candidates != decoder->max_detections ||
+      decoder->arenas[0]->max_per_class != decoder->max_per_class))
+    gst_tensordecode_free_arenas (decoder);
+  for (b = 0; b < decoder->num_arenas; b++)
+    decode_arena_set_threads (decoder->arenas[b], decoder->n_threads);
+  if (count <= decoder->num_arenas)
+    return TRUE;
+  decoder->arenas = g_renew (DecodeArena *, decoder->arenas, count);
+  while (decoder->num_arenas < count) {
+    DecodeArena *arena = decode_arena_new (num_anchors, num_classes, first_class, decoder->max_detections, decoder->max_per_class);
+    if (!arena) {
+      GST_ERROR_OBJECT (decoder, "Failed to allocate decode arena for %u anchors x %u classes", num_anchors, num_classes);
+      return FALSE;
+    }
+    decode_arena_set_quantization (arena, &decoder->box_quant, &decoder->score_quant);
+    decode_arena_set_threads (arena, decoder->n_threads);
+    decoder->arenas[decoder->num_arenas++] = arena;
+  }
+  GST_DEBUG_OBJECT (decoder, "%u decode arenas sized for %u anchors x %u classes, %u candidates each",
+      count, num_anchors, num_classes, decoder->arenas[0]->max_detections);
+  return TRUE;
+}
+
+/* replace the labels with `labels`, taking over its asset cache reference */
+void
+gst_tensordecode_set_labels (GstTensorDecode * decoder, const LabelTable * labels)
+{
+  asset_cache_unref (decoder->labels);
+  decoder->labels = labels;
+}
+
+static void
+gst_tensordecode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (object);
+  guint m;
+
+  switch (prop_id) {
+    case PROP_MODE:
+      decoder->mode = g_value_get_enum (value);
+      /* the tensors are read differently from now on */
+      decoder->entry.num_tensors = 0;
+      break;
+    case PROP_LABELS:
+      g_free (decoder->labels_path);
+      decoder->labels_path = g_value_dup_string (value);
+      gst_tensordecode_set_labels (decoder, asset_cache_get_labels (decoder->labels_path));
+      if(!decoder->labels)
+        GST_ERROR_OBJECT(decoder, "Failed to load labels from %s", decoder->labels_path);
+      else if (!decoder->silent) {
+        guint irow;
+        GST_LOG_OBJECT(decoder, "Loaded labels from %s", decoder->labels_path);
+        for (irow = 0; irow < decoder->labels->num_labels; irow++)
+          GST_LOG_OBJECT(decoder, "             label %u:'%s'", irow, decoder->labels->labels[irow]);
+      }
+      break;
+    case PROP_DEQUANT:
+      decoder->need_dequant = g_value_get_boolean (value);
+      /* quantized derives from dequant and the caps: decode nothing until they are read again */
+      decoder->quantized = FALSE;
+      decoder->entry.num_tensors = 0;
+      break;
+    case PROP_BATCH_SIZE:
+      decoder->batch_size = g_value_get_uint (value);
+      break;
+    case PROP_N_THREADS:
+      decoder->n_threads = g_value_get_uint (value);
+      break;
+    case PROP_MAX_DETECTIONS:
+      decoder->max_detections = g_value_get_uint (value);
+      break;
+    case PROP_MAX_PER_CLASS:
+      decoder->max_per_class = g_value_get_uint (value);
+      break;
+    case PROP_BOX_ZERO_POINT:
+      decoder->box_quant.zero_point = g_value_get_int (value);
+      gst_tensordecode_update_quantization (decoder);
+      break;
+    case PROP_BOX_QUANT_SCALE:
+      decoder->box_quant.scale = g_value_get_double (value);
+      gst_tensordecode_update_quantization (decoder);
+      break;
+    case PROP_SCORE_ZERO_POINT:
+      decoder->score_quant.zero_point = g_value_get_int (value);
+      gst_tensordecode_update_quantization (decoder);
+      break;
+    case PROP_SCORE_QUANT_SCALE:
+      decoder->score_quant.scale = g_value_get_double (value);
+      gst_tensordecode_update_quantization (decoder);
+      break;
+    case PROP_ASYNC:
+      decoder->async = g_value_get_boolean (value);
+      break;
+    case PROP_QUEUE_SIZE:
+      decoder->queue.capacity = g_value_get_uint (value);
+      break;
+    case PROP_ROI_META_COMPAT:
+      decoder->roi_meta_compat = g_value_get_boolean (value);
+      break;
+    case PROP_VIDEO_POLICY:
+      decoder->video_policy = g_value_get_enum (value);
+      break;
+    case PROP_SYNC_TOLERANCE:
+      decoder->sync_tolerance = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_WAIT:
+      decoder->max_wait = g_value_get_uint64 (value);
+      break;
+    case PROP_SILENT:
+      decoder->silent = g_value_get_boolean (value);
+      break;
+    default:
+      for (m = 0; m < TENSORDECODE_NUM_MODES; m++) {
+        if (prop_id >= backend_prop_base[m] && prop_id < backend_prop_base[m] + backends[m]->num_properties) {
+          backends[m]->set_property (decoder, decoder->states[m], prop_id - backend_prop_base[m], value, pspec);
+          return;
+        }
+      }
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_tensordecode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (object);
+  guint m;
+
+  switch (prop_id) {
+    case PROP_MODE:
+      g_value_set_enum (value, decoder->mode);
+      break;
+    case PROP_LABELS:
+      g_value_set_string (value, decoder->labels_path);
+      break;
+    case PROP_DEQUANT:
+      g_value_set_boolean (value, decoder->need_dequant);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, decoder->batch_size);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, decoder->n_threads);
+      break;
+    case PROP_MAX_DETECTIONS:
+      g_value_set_uint (value, decoder->max_detections);
+      break;
+    case PROP_MAX_PER_CLASS:
+      g_value_set_uint (value, decoder->max_per_class);
+      break;
+    case PROP_BOX_ZERO_POINT:
+      g_value_set_int (value, decoder->box_quant.zero_point);
+      break;
+    case PROP_BOX_QUANT_SCALE:
+      g_value_set_double (value, decoder->box_quant.scale);
+      break;
+    case PROP_SCORE_ZERO_POINT:
+      g_value_set_int (value, decoder->score_quant.zero_point);
+      break;
+    case PROP_SCORE_QUANT_SCALE:
+      g_value_set_double (value, decoder->score_quant.scale);
+      break;
+    case PROP_ASYNC:
+      g_value_set_boolean (value, decoder->async);
+      break;
+    case PROP_QUEUE_SIZE:
+      g_value_set_uint (value, decoder->queue.capacity);
+      break;
+    case PROP_ROI_META_COMPAT:
+      g_value_set_boolean (value, decoder->roi_meta_compat);
+      break;
+    case PROP_VIDEO_POLICY:
+      g_value_set_enum (value, decoder->video_policy);
+      break;
+    case PROP_SYNC_TOLERANCE:
+      g_value_set_uint64 (value, decoder->sync_tolerance);
+      break;
+    case PROP_MAX_WAIT:
+      g_value_set_uint64 (value, decoder->max_wait);
+      break;
+    case PROP_SILENT:
+      g_value_set_boolean (value, decoder->silent);
+      break;
+    default:
+      for (m = 0; m < TENSORDECODE_NUM_MODES; m++) {
+        if (prop_id >= backend_prop_base[m] && prop_id < backend_prop_base[m] + backends[m]->num_properties) {
+          backends[m]->get_property (decoder, decoder->states[m], prop_id - backend_prop_base[m], value, pspec);
+          return;
+        }
+      }
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* keep the detections of a decoded tensor buffer for the video frame of the same running time */
+static void
+gst_tensordecode_sync_add_result (GstTensorDecode * decoder, GstBuffer * buf)
+{
+  GstTensorDetectionsMeta *meta = gst_buffer_get_tensor_detections_meta (buf);
+  GstClockTime running_time = gst_segment_to_running_time (&GST_BASE_TRANSFORM (decoder)->segment,
+      GST_FORMAT_TIME, GST_BUFFER_PTS (buf));
+  GstBuffer *detections;
+  if (!meta || !GST_CLOCK_TIME_IS_VALID (running_time))
+    return;
+  /* an empty buffer shares the detections array, so frames get it without a copy */
+  detections = gst_buffer_new ();
+  gst_buffer_add_tensor_detections_meta_shared (detections, meta);
+  g_mutex_lock (&decoder->sync_lock);
+  sync_window_add (&decoder->sync_window, running_time, detections);
+  g_cond_broadcast (&decoder->sync_cond);
+  g_mutex_unlock (&decoder->sync_lock);
+}
+
+static void
+gst_tensordecode_finalize (GObject * object)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (object);
+  guint m;
+
+  for (m = 0; m < TENSORDECODE_NUM_MODES; m++)
+    backends[m]->free (decoder->states[m]);
+  gst_tensordecode_set_labels (decoder, NULL);
+  g_free (decoder->labels_path);
+  gst_tensordecode_free_arenas (decoder);
+  gst_tensor_detections_src_clear (&decoder->detections);
+  g_ptr_array_unref (decoder->stream_pads);
+  decoder->stream_pads = NULL;
+  gst_caps_replace (&decoder->stream_caps, NULL);
+  decode_queue_clear (&decoder->queue);
+  sync_window_clear (&decoder->sync_window);
+  g_mutex_clear (&decoder->sync_lock);
+  g_cond_clear (&decoder->sync_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* GstElement vmethod implementations */
+
+/* hand a serialized event or a buffer to the src-pad task, waiting while
+ * queue-size buffers are queued; returns the flow to report upstream */
+static GstFlowReturn
+gst_tensordecode_enqueue (GstTensorDecode * decoder, GstMiniObject * item)
+{
+  return (GstFlowReturn) decode_queue_push (&decoder->queue, item);
+}
+
+static GstStateChangeReturn
+gst_tensordecode_change_state (GstElement * element, GstStateChange transition)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      g_mutex_lock (&decoder->sync_lock);
+      decoder->video_flushing = FALSE;
+      decoder->tensor_eos = FALSE;
+      gst_segment_init (&decoder->video_segment, GST_FORMAT_TIME);
+      g_mutex_unlock (&decoder->sync_lock);
+      decode_queue_restart (&decoder->queue);
+      if (decoder->async)
+        gst_pad_start_task (GST_BASE_TRANSFORM_SRC_PAD (decoder), (GstTaskFunction) gst_tensordecode_loop, decoder, NULL);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* unblock chain and the task before the pads are deactivated */
+      decode_queue_stop (&decoder->queue, GST_FLOW_FLUSHING);
+      gst_pad_stop_task (GST_BASE_TRANSFORM_SRC_PAD (decoder));
+      /* unblock a frame waiting for its detections */
+      g_mutex_lock (&decoder->sync_lock);
+      decoder->video_flushing = TRUE;
+      g_cond_broadcast (&decoder->sync_cond);
+      g_mutex_unlock (&decoder->sync_lock);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    GST_OBJECT_LOCK (decoder);
+    decoder->decode_latency = 0;
+    GST_OBJECT_UNLOCK (decoder);
+    g_mutex_lock (&decoder->sync_lock);
+    sync_window_clear (&decoder->sync_window);
+    g_mutex_unlock (&decoder->sync_lock);
+  }
+  return ret;
+}
+
+/* src_%u pads carry one stream of the batch each, the pad's number being the stream id;
+ * the detections pad follows the request pads protocol: there is at most one */
+static GstPad *
+gst_tensordecode_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (element);
+  GstTensorDecodeStreamPad *entry;
+  GstPad *pad;
+  gchar *pad_name;
+  gboolean taken;
+  guint id;
+  if (g_strcmp0 (GST_PAD_TEMPLATE_NAME_TEMPLATE (templ), TENSORDECODE_STREAM_PAD_TEMPLATE) != 0)
+    return gst_tensor_detections_src_request (&decoder->detections, templ);
+  GST_OBJECT_LOCK (decoder);
+  if (!name || sscanf (name, TENSORDECODE_STREAM_PAD_TEMPLATE, &id) != 1) {
+    /* the first stream without a pad */
+    for (id = 0; id < decoder->stream_pads->len && g_ptr_array_index (decoder->stream_pads, id); id++);
+  }
+  taken = id < decoder->stream_pads->len && g_ptr_array_index (decoder->stream_pads, id);
+  GST_OBJECT_UNLOCK (decoder);
+  if (id >= TENSORDECODE_MAX_BATCH) {
+    GST_WARNING_OBJECT (decoder, "No stream %u in a batch of at most %u", id, TENSORDECODE_MAX_BATCH);
+    return NULL;
+  }
+  /* checked up front, as gst_element_add_pad warns loudly about a duplicate name */
+  if (taken) {
+    GST_WARNING_OBJECT (decoder, "Stream %u already has a pad", id);
+    return NULL;
+  }
+  pad_name = g_strdup_printf (TENSORDECODE_STREAM_PAD_TEMPLATE, id);
+  pad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+  gst_pad_use_fixed_caps (pad);
+  /* still fails if a concurrent request took the stream meanwhile */
+  if (!gst_element_add_pad (element, pad))
+    return NULL;
+  entry = g_new0 (GstTensorDecodeStreamPad, 1);
+  entry->pad = pad;
+  entry->need_caps = TRUE;
+  GST_OBJECT_LOCK (decoder);
+  if (id >= decoder->stream_pads->len)
+    g_ptr_array_set_size (decoder->stream_pads, id + 1);
+  g_ptr_array_index (decoder->stream_pads, id) = entry;
+  GST_OBJECT_UNLOCK (decoder);
+  return pad;
+}
+
+static void
+gst_tensordecode_release_pad (GstElement * element, GstPad * pad)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (element);
+  gboolean found = FALSE;
+  guint id;
+  GST_OBJECT_LOCK (decoder);
+  for (id = 0; !found && id < decoder->stream_pads->len; id++) {
+    GstTensorDecodeStreamPad *entry = g_ptr_array_index (decoder->stream_pads, id);
+    if (entry && entry->pad == pad) {
+      g_free (entry);
+      g_ptr_array_index (decoder->stream_pads, id) = NULL;
+      found = TRUE;
+    }
+  }
+  GST_OBJECT_UNLOCK (decoder);
+  if (!found) {
+    gst_tensor_detections_src_release (&decoder->detections, pad);
+    return;
+  }
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
+/* this function returns a reference to the src_%u pad of stream `id`, or NULL if it was not requested */
+static GstPad *
+gst_tensordecode_get_stream_pad (GstTensorDecode * decoder, guint id, gboolean * need_caps)
+{
+  GstTensorDecodeStreamPad *entry;
+  GstPad *pad = NULL;
+  GST_OBJECT_LOCK (decoder);
+  entry = id < decoder->stream_pads->len ? g_ptr_array_index (decoder->stream_pads, id) : NULL;
+  if (entry) {
+    pad = gst_object_ref (entry->pad);
+    *need_caps = entry->need_caps;
+  }
+  GST_OBJECT_UNLOCK (decoder);
+  return pad;
+}
+
+/* this function sends stream-start (once), the caps of one stream, once negotiated, and the segment */
+static void
+gst_tensordecode_start_stream (GstTensorDecode * decoder, guint id, GstPad * pad)
+{
+  GstTensorDecodeStreamPad *entry;
+  GstEvent *event;
+  GST_OBJECT_LOCK (decoder);
+  entry = id < decoder->stream_pads->len ? g_ptr_array_index (decoder->stream_pads, id) : NULL;
+  if (entry && entry->pad == pad)
+    entry->need_caps = FALSE;
+  GST_OBJECT_UNLOCK (decoder);
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_STREAM_START, 0);
+  if (event) {
+    gst_event_unref (event);
+  } else {
+    gchar *stream_id = gst_pad_create_stream_id (pad, GST_ELEMENT (decoder), GST_PAD_NAME (pad));
+    GstEvent *upstream = gst_pad_get_sticky_event (GST_BASE_TRANSFORM_SINK_PAD (decoder), GST_EVENT_STREAM_START, 0);
+    guint group_id;
+    event = gst_event_new_stream_start (stream_id);
+    if (upstream && gst_event_parse_group_id (upstream, &group_id))
+      gst_event_set_group_id (event, group_id);
+    if (upstream)
+      gst_event_unref (upstream);
+    g_free (stream_id);
+    gst_pad_push_event (pad, event);
+  }
+  if (decoder->stream_caps)
+    gst_pad_push_event (pad, gst_event_new_caps (decoder->stream_caps));
+  gst_pad_push_event (pad, gst_event_new_segment (&GST_BASE_TRANSFORM (decoder)->segment));
+}
+
+/* this function forwards flushing, segment and EOS to the src_%u pads */
+static void
+gst_tensordecode_push_stream_event (GstTensorDecode * decoder, GstEvent * event)
+{
+  guint id, num_streams;
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_SEGMENT:
+    case GST_EVENT_EOS:
+      break;
+    default:
+      return;
+  }
+  GST_OBJECT_LOCK (decoder);
+  num_streams = decoder->stream_pads->len;
+  GST_OBJECT_UNLOCK (decoder);
+  for (id = 0; id < num_streams; id++) {
+    gboolean need_caps = FALSE;
+    GstPad *pad = gst_tensordecode_get_stream_pad (decoder, id, &need_caps);
+    if (!pad)
+      continue;
+    /* a pad yet to start gets the latest segment with its start sequence */
+    if (need_caps && GST_EVENT_TYPE (event) == GST_EVENT_EOS)
+      gst_tensordecode_start_stream (decoder, id, pad);
+    if (!need_caps || GST_EVENT_TYPE (event) == GST_EVENT_EOS)
+      gst_pad_push_event (pad, gst_event_ref (event));
+    gst_object_unref (pad);
+  }
+}
+
+/* hand a sink event to the base class, and its copies to the detections and stream pads */
+static gboolean
+gst_tensordecode_base_sink_event (GstTensorDecode * decoder, GstEvent * event)
+{
+  /* frames waiting for detections stop waiting once the tensors end */
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      g_mutex_lock (&decoder->sync_lock);
+      decoder->tensor_eos = TRUE;
+      g_cond_broadcast (&decoder->sync_cond);
+      g_mutex_unlock (&decoder->sync_lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_STREAM_START:
+      g_mutex_lock (&decoder->sync_lock);
+      if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+        sync_window_clear (&decoder->sync_window);
+      decoder->tensor_eos = FALSE;
+      g_mutex_unlock (&decoder->sync_lock);
+      break;
+    default:
+      break;
+  }
+  gst_tensor_detections_src_push_event (&decoder->detections, event);
+  gst_tensordecode_push_stream_event (decoder, event);
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (GST_BASE_TRANSFORM (decoder), event);
+}
+
+/* this function handles sink events */
+static gboolean
+gst_tensordecode_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (trans);
+  GstPad *srcpad = GST_BASE_TRANSFORM_SRC_PAD (trans);
+  gboolean ret;
+
+  GST_LOG_OBJECT (decoder, "Received %s event: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event);
+
+  if (!decoder->async)
+    return gst_tensordecode_base_sink_event (decoder, event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      ret = gst_tensordecode_base_sink_event (decoder, event);
+      /* wake up chain and the task, then wait for the task to pause */
+      decode_queue_stop (&decoder->queue, GST_FLOW_FLUSHING);
+      gst_pad_pause_task (srcpad);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      decode_queue_restart (&decoder->queue);
+      ret = gst_tensordecode_base_sink_event (decoder, event);
+      gst_pad_start_task (srcpad, (GstTaskFunction) gst_tensordecode_loop, decoder, NULL);
+      break;
+    default:
+      if (GST_EVENT_IS_SERIALIZED (event)) {
+        /* keep the event behind the buffers that were queued before it;
+         * the task hands it to the base class */
+        ret = gst_tensordecode_enqueue (decoder, GST_MINI_OBJECT_CAST (event)) == GST_FLOW_OK;
+      } else {
+        ret = gst_tensordecode_base_sink_event (decoder, event);
+      }
+      break;
+  }
+  return ret;
+}
+
+/* this function answers queries on either pad */
+static gboolean
+gst_tensordecode_query (GstBaseTransform * trans, GstPadDirection direction, GstQuery * query)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (trans);
+  gboolean live;
+  GstClockTime min, max, latency;
+
+  if (!decoder->async)
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->query (trans, direction, query);
+  /* serialized queries, e.g. ALLOCATION and DRAIN, must not overtake queued buffers */
+  if (direction == GST_PAD_SINK && GST_QUERY_IS_SERIALIZED (query))
+    decode_queue_drain (&decoder->queue);
+  if (!GST_BASE_TRANSFORM_CLASS (parent_class)->query (trans, direction, query))
+    return FALSE;
+  if (direction != GST_PAD_SRC || GST_QUERY_TYPE (query) != GST_QUERY_LATENCY)
+    return TRUE;
+  /* a buffer leaves after its own decode at best, and after those of a
+   * full queue ahead of it at worst */
+  gst_query_parse_latency (query, &live, &min, &max);
+  GST_OBJECT_LOCK (decoder);
+  latency = decoder->decode_latency;
+  GST_OBJECT_UNLOCK (decoder);
+  min += latency;
+  if (GST_CLOCK_TIME_IS_VALID (max))
+    max += latency * (decoder->queue.capacity + 1);
+  GST_DEBUG_OBJECT (decoder, "Latency: live %d, min %" GST_TIME_FORMAT ", max %" GST_TIME_FORMAT,
+      live, GST_TIME_ARGS (min), GST_TIME_ARGS (max));
+  gst_query_set_latency (query, live, min, max);
+  return TRUE;
+}
+
+/* keep the reported latency at or above the longest decode seen so far */
+static void
+gst_tensordecode_update_latency (GstTensorDecode * decoder, GstClockTime elapsed)
+{
+  gboolean changed = FALSE;
+  elapsed = gst_util_uint64_scale_ceil (elapsed, 1, GST_MSECOND) * GST_MSECOND;
+  GST_OBJECT_LOCK (decoder);
+  if (elapsed > decoder->decode_latency) {
+    decoder->decode_latency = elapsed;
+    changed = TRUE;
+  }
+  GST_OBJECT_UNLOCK (decoder);
+  if (changed) {
+    GST_DEBUG_OBJECT (decoder, "Decode latency is now %" GST_TIME_FORMAT, GST_TIME_ARGS (elapsed));
+    gst_element_post_message (GST_ELEMENT (decoder), gst_message_new_latency (GST_OBJECT (decoder)));
+  }
+}
+
+/* in async mode, queue buffers for the src-pad task instead of transforming them here */
+static GstFlowReturn
+gst_tensordecode_submit_input_buffer (GstBaseTransform * trans, gboolean is_discont, GstBuffer * input)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (trans);
+  if (decoder->async)
+    return gst_tensordecode_enqueue (decoder, GST_MINI_OBJECT_CAST (input));
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (trans, is_discont, input);
+}
+
+/* in async mode, the src-pad task pushes the output */
+static GstFlowReturn
+gst_tensordecode_generate_output (GstBaseTransform * trans, GstBuffer ** outbuf)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (trans);
+  if (decoder->async) {
+    *outbuf = NULL;
+    return GST_FLOW_OK;
+  }
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->generate_output (trans, outbuf);
+}
+
+/*
+ * this function builds the caps of one batch entry, as the src_%u pads carry them,
+ * from the layout the backend reads
+ */
+static GstCaps *
+gst_tensordecode_stream_caps (GstTensorDecode * decoder, GstCaps * incaps)
+{
+  GString *dims = g_string_new (NULL), *types = g_string_new (NULL);
+  GstCaps *caps;
+  gint fps_n, fps_d;
+  guint i, r;
+  for (i = 0; i < decoder->entry.num_tensors; i++) {
+    if (i) {
+      g_string_append_c (dims, ',');
+      g_string_append_c (types, ',');
+    }
+    for (r = 0; r < NNS_TENSOR_RANK_LIMIT; r++)
+      g_string_append_printf (dims, r ? ":%u" : "%u", decoder->entry.dims[i][r]);
+    g_string_append (types, tensor_type_to_string (decoder->entry.types[i]));
+  }
+  caps = gst_caps_new_simple ("other/tensors",
+      "num_tensors", G_TYPE_INT, decoder->entry.num_tensors,
+      "types", G_TYPE_STRING, types->str,
+      "dimensions", G_TYPE_STRING, dims->str,
+      NULL);
+  g_string_free (dims, TRUE);
+  g_string_free (types, TRUE);
+  if (gst_structure_get_fraction (gst_caps_get_structure (incaps, 0), "framerate", &fps_n, &fps_d))
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION, fps_n, fps_d, NULL);
+  return caps;
+}
+
+/* the tensor caps are set: the backend parses them into the layout of one batch entry */
+static gboolean
+gst_tensordecode_set_caps (GstBaseTransform * trans, GstCaps * incaps, GstCaps * outcaps)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (trans);
+  TensorsShape shape;
+  GstCaps *caps;
+  guint i, r;
+  decoder->entry.num_tensors = 0;
+  if (!tensors_shape_from_caps (incaps, &shape)) {
+    GST_ERROR_OBJECT (decoder, "Unsupported tensor caps: %" GST_PTR_FORMAT, incaps);
+    return FALSE;
+  }
+  if (!BACKEND (decoder)->set_caps (decoder, decoder->states[decoder->mode], &shape)) {
+    decoder->entry.num_tensors = 0;
+    return FALSE;
+  }
+  for (i = 0; i < decoder->entry.num_tensors; i++) {
+    decoder->entry_size[i] = tensor_type_size (decoder->entry.types[i]);
+    for (r = 0; r < NNS_TENSOR_RANK_LIMIT; r++)
+      decoder->entry_size[i] *= decoder->entry.dims[i][r];
+  }
+  gst_tensor_detections_src_set_framerate (&decoder->detections, incaps);
+
+  /* each src_%u pad carries the tensors of a batch of one */
+  caps = gst_tensordecode_stream_caps (decoder, incaps);
+  gst_caps_replace (&decoder->stream_caps, caps);
+  gst_caps_unref (caps);
+  GST_OBJECT_LOCK (decoder);
+  for (i = 0; i < decoder->stream_pads->len; i++) {
+    GstTensorDecodeStreamPad *entry = g_ptr_array_index (decoder->stream_pads, i);
+    if (entry)
+      entry->need_caps = TRUE;
+  }
+  GST_OBJECT_UNLOCK (decoder);
+  return TRUE;
+}
+
+/* decode a buffer and attach its ROIs */
+static GstFlowReturn
+gst_tensordecode_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (trans);
+  gpointer state = decoder->states[decoder->mode];
+  GstFlowReturn ret;
+  gint64 start;
+  if (!decoder->labels) {
+    GST_ERROR_OBJECT(decoder, "Required property 'labels' is missing");
+    return GST_FLOW_ERROR;
+  }
+  if (!decoder->entry.num_tensors) {
+    GST_ERROR_OBJECT(decoder, "Tensor caps have not been negotiated");
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  /* batch-size may have grown since the caps were negotiated */
+  if (!BACKEND (decoder)->prepare (decoder, state))
+    return GST_FLOW_ERROR;
+  start = g_get_monotonic_time ();
+  ret = gst_tensordecode_process (decoder, buf);
+  if (ret != GST_FLOW_OK)
+    return ret;
+  if (decoder->async)
+    gst_tensordecode_update_latency (decoder, (g_get_monotonic_time () - start) * GST_USECOND);
+  if (gst_pad_is_linked (decoder->video_sinkpad))
+    gst_tensordecode_sync_add_result (decoder, buf);
+  gst_tensor_detections_src_set_max_detections (&decoder->detections,
+      BACKEND (decoder)->max_objects (decoder, state) * decoder->batch_size);
+  return gst_tensor_detections_src_push (&decoder->detections, buf);
+}
+
+/* src-pad task of async mode: run queued buffers through the base class
+ * (QoS, writability, transform_ip) and push them, and hand queued events to it */
+static void
+gst_tensordecode_loop (GstTensorDecode * decoder)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (decoder);
+  GstPad *srcpad = GST_BASE_TRANSFORM_SRC_PAD (trans);
+  gpointer item;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (!decode_queue_pop (&decoder->queue, &item)) {
+    gst_pad_pause_task (srcpad);
+    return;
+  }
+
+  if (GST_IS_BUFFER (item)) {
+    GstBuffer *buf = GST_BUFFER_CAST (item);
+    GstBuffer *outbuf = NULL;
+    ret = GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (trans, GST_BUFFER_IS_DISCONT (buf), buf);
+    if (ret == GST_FLOW_OK)
+      ret = GST_BASE_TRANSFORM_CLASS (parent_class)->generate_output (trans, &outbuf);
+    if (outbuf)
+      ret = gst_pad_push (srcpad, outbuf);
+    else if (ret == GST_BASE_TRANSFORM_FLOW_DROPPED) /* late for QoS */
+      ret = GST_FLOW_OK;
+  } else {
+    GstEvent *event = GST_EVENT_CAST (item);
+    gboolean is_eos = GST_EVENT_TYPE (event) == GST_EVENT_EOS;
+    gboolean is_caps = GST_EVENT_TYPE (event) == GST_EVENT_CAPS;
+    if (!gst_tensordecode_base_sink_event (decoder, event) && is_caps)
+      ret = GST_FLOW_NOT_NEGOTIATED;
+    if (is_eos)
+      ret = GST_FLOW_EOS;
+  }
+
+  decode_queue_done (&decoder->queue, ret);
+
+  if (ret != GST_FLOW_OK) {
+    GST_LOG_OBJECT (decoder, "Pausing task, reason %s", gst_flow_get_name (ret));
+    gst_pad_pause_task (srcpad);
+    if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      /* chain cannot report this upstream anymore, so post it and end the stream */
+      GST_ELEMENT_FLOW_ERROR (decoder, ret);
+      gst_pad_push_event (srcpad, gst_event_new_eos ());
+    }
+  }
+}
+
+/* video_sink and video_src are linked to each other only */
+static GstIterator *
+gst_tensordecode_video_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (parent);
+  GstPad *other = (pad == decoder->video_sinkpad) ? decoder->video_srcpad : decoder->video_sinkpad;
+  GValue value = G_VALUE_INIT;
+  GstIterator *it;
+  g_value_init (&value, GST_TYPE_PAD);
+  g_value_set_object (&value, other);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &value);
+  g_value_unset (&value);
+  return it;
+}
+
+/* this function handles video_sink events; they all go on to video_src */
+static gboolean
+gst_tensordecode_video_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (parent);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&decoder->sync_lock);
+      decoder->video_flushing = TRUE;
+      g_cond_broadcast (&decoder->sync_cond);
+      g_mutex_unlock (&decoder->sync_lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&decoder->sync_lock);
+      decoder->video_flushing = FALSE;
+      g_mutex_unlock (&decoder->sync_lock);
+      gst_segment_init (&decoder->video_segment, GST_FORMAT_TIME);
+      break;
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &decoder->video_segment);
+      break;
+    default:
+      break;
+  }
+  return gst_pad_event_default (pad, parent, event);
+}
+
+/* with video-policy=wait, frames can be held back for up to max-wait */
+static gboolean
+gst_tensordecode_video_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (parent);
+  gboolean live;
+  GstClockTime min, max;
+  if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY)
+    return gst_pad_query_default (pad, parent, query);
+  if (!gst_pad_peer_query (decoder->video_sinkpad, query))
+    return FALSE;
+  if (decoder->video_policy == TENSORDECODE_VIDEO_POLICY_WAIT) {
+    gst_query_parse_latency (query, &live, &min, &max);
+    min += decoder->max_wait;
+    if (GST_CLOCK_TIME_IS_VALID (max))
+      max += decoder->max_wait;
+    gst_query_set_latency (query, live, min, max);
+  }
+  return TRUE;
+}
+
+/*
+ * this function attaches to a video frame the detections of the tensors with
+ * its running time, give or take sync-tolerance; the frame's memory is not copied
+ */
+static GstFlowReturn
+gst_tensordecode_video_chain (GstPad * pad, GstObject * parent, GstBuffer * frame)
+{
+  GstTensorDecode *decoder = GST_TENSORDECODE (parent);
+  GstBuffer *result = NULL;
+  GstClockTime running_time = gst_segment_to_running_time (&decoder->video_segment,
+      GST_FORMAT_TIME, GST_BUFFER_PTS (frame));
+  gint64 deadline = g_get_monotonic_time () + decoder->max_wait / GST_USECOND;
+  gboolean flushing;
+
+  g_mutex_lock (&decoder->sync_lock);
+  while (GST_CLOCK_TIME_IS_VALID (running_time) && !decoder->video_flushing) {
+    gpointer match;
+    /* either this frame's result, or one for a later frame: this frame has none */
+    if (sync_window_match (&decoder->sync_window, running_time, decoder->sync_tolerance, &match)) {
+      if (match)
+        result = gst_buffer_ref (match);
+      break;
+    }
+    if (decoder->video_policy != TENSORDECODE_VIDEO_POLICY_WAIT || decoder->tensor_eos)
+      break;
+    if (!g_cond_wait_until (&decoder->sync_cond, &decoder->sync_lock, deadline)) {
+      GST_DEBUG_OBJECT (decoder, "No detections for the frame at %" GST_TIME_FORMAT " within max-wait",
+          GST_TIME_ARGS (running_time));
+      break;
+    }
+  }
+  if (!result && decoder->video_policy == TENSORDECODE_VIDEO_POLICY_REUSE && decoder->sync_window.last)
+    result = gst_buffer_ref (decoder->sync_window.last);
+  flushing = decoder->video_flushing;
+  g_mutex_unlock (&decoder->sync_lock);
+
+  if (flushing) {
+    if (result)
+      gst_buffer_unref (result);
+    gst_buffer_unref (frame);
+    return GST_FLOW_FLUSHING;
+  }
+  if (result) {
+    GstTensorDetectionsMeta *meta = gst_buffer_get_tensor_detections_meta (result);
+    /* a new buffer header at most; the frame's memory is shared */
+    frame = gst_buffer_make_writable (frame);
+    gst_buffer_add_tensor_detections_meta_shared (frame, meta);
+    gst_buffer_unref (result);
+  }
+  return gst_pad_push (decoder->video_srcpad, frame);
+}
+
+/* the tensors of one buffer, decoded one batch entry per task */
+typedef struct
+{
+  GstTensorDecode *decoder;
+  const guint8 *tensors[NNS_TENSOR_SIZE_LIMIT];
+  const DetectedObject **objects; /* per batch entry */
+  guint *num_objects;
+  gboolean *sanity_check;
+} GstTensorDecodeBatch;
+
+/* decode batch entry `b` with the backend; runs on the shared decode pool */
+static void
+gst_tensordecode_decode_entry (gpointer data, guint b)
+{
+  GstTensorDecodeBatch *batch = data;
+  GstTensorDecode *decoder = batch->decoder;
+  const guint8 *tensors[NNS_TENSOR_SIZE_LIMIT];
+  guint i;
+  for (i = 0; i < decoder->entry.num_tensors; i++)
+    tensors[i] = batch->tensors[i] + b * decoder->entry_size[i];
+  batch->num_objects[b] = 0;
+  batch->sanity_check[b] = BACKEND (decoder)->decode (decoder, decoder->states[decoder->mode], b, tensors,
+      &batch->objects[b], &batch->num_objects[b]);
+}
+
+/*
+ * this function attaches the detections of streams `first` to `last` - 1 of the batch to the buffer
+ */
+static gboolean
+gst_tensordecode_attach (GstTensorDecode * decoder, GstBuffer * buf, const GstTensorDecodeBatch * batch,
+    guint first, guint last)
+{
+  GstTensorDetectionsMeta *meta;
+  const gfloat coord_scale = 1.f / UINT_MAX;
+  guint b, i, n = 0;
+  for (b = first; b < last; b++)
+    n += batch->num_objects[b];
+  /* All detections in one meta, in stream_id order */
+  meta = gst_buffer_add_tensor_detections_meta (buf, n);
+  if (!meta) {
+    GST_ERROR_OBJECT (decoder, "Failed to attach the detections meta");
+    return FALSE;
+  }
+  for (b = first, n = 0; b < last; b++) {
+    for (i = 0; i < batch->num_objects[b]; i++, n++) {
+      const DetectedObject *d = &batch->objects[b][i];
+      GstTensorDetection *o = &meta->detections[n];
+      o->x = d->x * coord_scale;
+      o->y = d->y * coord_scale;
+      o->width = d->width * coord_scale;
+      o->height = d->height * coord_scale;
+      o->label = (d->class_id < decoder->labels->num_labels) ? decoder->labels->quarks[d->class_id] : 0;
+      o->class_id = d->class_id;
+      o->score = d->score;
+      o->stream_id = b;
+      o->track_id = 0;
+    }
+  }
+  /* Legacy consumers read one ROI meta per detection, at several allocations each */
+  for (b = first; decoder->roi_meta_compat && b < last; b++) {
+    for (i = 0; i < batch->num_objects[b]; i++) {
+      const DetectedObject *d = &batch->objects[b][i];
+      GstStructure *s = gst_structure_new("detection",
+        "confidence", G_TYPE_DOUBLE, d->score,
+        "label_id", G_TYPE_UINT, d->class_id,
+        "label_name", G_TYPE_STRING, d->class_label,
+        "stream_id", G_TYPE_UINT, b,
+        NULL /* terminator: do not remove */
+        );
+      GstVideoRegionOfInterestMeta *roi = gst_buffer_add_video_region_of_interest_meta(
+          buf,
+          d->class_label,
+          d->x,
+          d->y,
+          d->width,
+          d->height
+          );
+      gst_video_region_of_interest_meta_add_param(roi, s);
+    }
+  }
+  return TRUE;
+}
+
+/*
+ * this function pushes each requested stream of the batch on its src_%u pad: the stream's slice of
+ * the tensors, shared rather than copied, with the stream's detections
+ */
+static GstFlowReturn
+gst_tensordecode_push_streams (GstTensorDecode * decoder, GstBuffer * buf, GstMemory ** in_mem,
+    const GstTensorDecodeBatch * batch)
+{
+  guint b, i;
+  for (b = 0; b < decoder->batch_size; b++) {
+    gboolean need_caps = FALSE;
+    GstPad *pad = gst_tensordecode_get_stream_pad (decoder, b, &need_caps);
+    GstFlowReturn ret;
+    GstBuffer *out;
+    if (!pad)
+      continue;
+    if (need_caps)
+      gst_tensordecode_start_stream (decoder, b, pad);
+    out = gst_buffer_new ();
+    for (i = 0; i < decoder->entry.num_tensors; i++)
+      gst_buffer_append_memory (out, gst_memory_share (in_mem[i], b * decoder->entry_size[i], decoder->entry_size[i]));
+    gst_buffer_copy_into (out, buf, GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    if (!gst_tensordecode_attach (decoder, out, batch, b, b + 1)) {
+      gst_buffer_unref (out);
+      gst_object_unref (pad);
+      return GST_FLOW_ERROR;
+    }
+    ret = gst_pad_push (pad, out);
+    gst_object_unref (pad);
+    /* an unlinked, flushing or finished stream does not stop the others */
+    if (ret < GST_FLOW_EOS)
+      return ret;
+  }
+  return GST_FLOW_OK;
+}
+
+/*
+ * this function decodes the objects of every batch entry with the backend, attaches them to the
+ * (writable) buffer, and pushes the requested streams
+ */
+static GstFlowReturn
+gst_tensordecode_process (GstTensorDecode *decoder, GstBuffer *buf)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMemory *in_mem[NNS_TENSOR_SIZE_LIMIT];
+  GstMapInfo in_info[NNS_TENSOR_SIZE_LIMIT];
+  GstTensorDecodeBatch batch;
+  guint b, i, num_mapped = 0;
+  if (gst_buffer_n_memory (buf) < decoder->entry.num_tensors) {
+    GST_ERROR_OBJECT (decoder, "Expected %u tensors, got %u", decoder->entry.num_tensors, gst_buffer_n_memory (buf));
+    return GST_FLOW_ERROR;
+  }
+  batch.decoder = decoder;
+  batch.objects = g_newa (const DetectedObject *, decoder->batch_size);
+  batch.num_objects = g_newa (guint, decoder->batch_size);
+  batch.sanity_check = g_newa (gboolean, decoder->batch_size);
+  /* Map the tensors the backend reads */
+  for (i = 0; ret == GST_FLOW_OK && i < decoder->entry.num_tensors; i++, num_mapped++) {
+    in_mem[i] = gst_buffer_peek_memory (buf, i);
+    if (!gst_memory_map (in_mem[i], &in_info[i], GST_MAP_READ)) {
+      GST_ERROR_OBJECT (decoder, "Failed to map tensor %u", i);
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+    batch.tensors[i] = in_info[i].data;
+    if (in_info[i].size < decoder->batch_size * decoder->entry_size[i]) {
+      GST_ERROR_OBJECT (decoder, "Tensors are too small for a batch of %u", decoder->batch_size);
+      ret = GST_FLOW_ERROR;
+    }
+  }
+  /* Decode each batch entry into an array of DetectedObjects */
+  if (ret == GST_FLOW_OK)
+    decode_pool_run (decoder->batch_size, decoder->n_threads, gst_tensordecode_decode_entry, &batch);
+  for (b = 0; ret == GST_FLOW_OK && b < decoder->batch_size; b++) {
+    if (!batch.sanity_check[b]) {
+      GST_ERROR_OBJECT (decoder, "Failed to decode stream %u of the batch", b);
+      ret = GST_FLOW_ERROR;
+    }
+  }
+  /* Attach all detections to the tensor buffer, then hand each stream its own */
+  if (ret == GST_FLOW_OK && !gst_tensordecode_attach (decoder, buf, &batch, 0, decoder->batch_size))
+    ret = GST_FLOW_ERROR;
+  if (ret == GST_FLOW_OK)
+    ret = gst_tensordecode_push_streams (decoder, buf, in_mem, &batch);
+  /* Teardown tensor mapping */
+  for (i = 0; i < num_mapped; i++) {
+    gst_memory_unmap (in_mem[i], &in_info[i]);
+  }
+  return ret;
+}
@@ -0,0 +1,164 @@
+/*
+ * No license installed
+ */
+
+#ifndef __GST_TENSORDECODE_H__
+#define __GST_TENSORDECODE_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include <gst/video/gstvideometa.h>
+#include "libtensordecode.h"
+#include "gsttensordetectionssrc.h"
+
+G_BEGIN_DECLS
+
+/* #defines don't like whitespacey bits */
+#define GST_TYPE_TENSORDECODE \
+  (gst_tensordecode_get_type())
+#define GST_TENSORDECODE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_TENSORDECODE,GstTensorDecode))
+#define GST_TENSORDECODE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_TENSORDECODE,GstTensorDecodeClass))
+#define GST_TENSORDECODE_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GST_TYPE_TENSORDECODE,GstTensorDecodeClass))
+#define GST_IS_TENSORDECODE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_TENSORDECODE))
+#define GST_IS_TENSORDECODE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_TENSORDECODE))
+
+#define GST_TYPE_TENSORDECODE_MODE \
+  (gst_tensordecode_mode_get_type())
+#define GST_TYPE_TENSORDECODE_VIDEO_POLICY \
+  (gst_tensordecode_video_policy_get_type())
+#define GST_TYPE_TENSORDECODE_YOLO_HEAD \
+  (gst_tensordecode_yolo_head_get_type())
+
+typedef struct _GstTensorDecode      GstTensorDecode;
+typedef struct _GstTensorDecodeClass GstTensorDecodeClass;
+
+/* the model family a buffer is decoded as; one backend each */
+typedef enum
+{
+  TENSORDECODE_MODE_SSD, /* SSD box encodings and class logits, decoded against anchors */
+  TENSORDECODE_MODE_BB,  /* boxes, classes, scores and counts of the TFLite detections postprocessor */
+  TENSORDECODE_MODE_YOLO, /* YOLOv5 or YOLOv8 head outputs, gated and decoded against the grid */
+  TENSORDECODE_NUM_MODES
+} GstTensorDecodeMode;
+
+/* what video_sink does with a frame whose decoded tensors have not arrived */
+typedef enum
+{
+  TENSORDECODE_VIDEO_POLICY_WAIT,  /* hold the frame until its result arrives, for up to max-wait */
+  TENSORDECODE_VIDEO_POLICY_REUSE, /* attach the latest earlier result */
+  TENSORDECODE_VIDEO_POLICY_PASS   /* push the frame without detections */
+} GstTensorDecodeVideoPolicy;
+
+/*
+ * a decoder backend: how the tensors of one model family turn into detections
+ *
+ * The element owns everything the backends share: the labels, the decode
+ * arenas, the thread pool, batching, async mode, the video pads and the
+ * emission of GstTensorDetectionsMeta. A backend parses the caps into the
+ * layout of one batch entry, decodes one entry at a time into DetectedObjects,
+ * and keeps whatever else it needs in its own state, with its own properties.
+ */
+typedef struct _GstTensorDecodeBackend
+{
+  const gchar *mode;          /* nick of the mode */
+  const gchar *description;
+  guint num_properties;
+  /* install the backend's properties, numbered from prop_base */
+  void (*install_properties) (GObjectClass *klass, guint prop_base);
+  gpointer (*new) (GstTensorDecode *decoder);
+  void (*free) (gpointer state);
+  /* prop counts from 0 */
+  void (*set_property) (GstTensorDecode *decoder, gpointer state, guint prop, const GValue *value, GParamSpec *pspec);
+  void (*get_property) (GstTensorDecode *decoder, gpointer state, guint prop, GValue *value, GParamSpec *pspec);
+  /* parse caps: check the negotiated tensors and write the layout of one batch entry to decoder->entry */
+  gboolean (*set_caps) (GstTensorDecode *decoder, gpointer state, const TensorsShape *shape);
+  /* check the configuration and size the scratch of batch-size entries, before each buffer */
+  gboolean (*prepare) (GstTensorDecode *decoder, gpointer state);
+  /* decode batch entry b from its tensors; runs on the decode pool, concurrently for different entries */
+  gboolean (*decode) (GstTensorDecode *decoder, gpointer state, guint b, const guint8 * const *tensors,
+      const DetectedObject **objects, guint *num_objects);
+  /* most objects `decode` returns for one entry */
+  guint (*max_objects) (GstTensorDecode *decoder, gpointer state);
+} GstTensorDecodeBackend;
+
+extern const GstTensorDecodeBackend gst_tensordecode_ssd_backend;
+extern const GstTensorDecodeBackend gst_tensordecode_bb_backend;
+extern const GstTensorDecodeBackend gst_tensordecode_yolo_backend;
+
+#define TENSORDECODE_MAX_BATCH 1024
+
+/* a src_%u request pad, carrying one stream of the batch */
+typedef struct
+{
+  GstPad *pad;
+  gboolean need_caps; /* stream-start, caps and segment go out before the next buffer */
+} GstTensorDecodeStreamPad;
+
+struct _GstTensorDecode
+{
+  GstBaseTransform element;
+
+  GstTensorDecodeMode mode; /* subclasses such as ssddecode set theirs at init */
+  gpointer states[TENSORDECODE_NUM_MODES]; /* every backend's, so properties can be set in any order */
+  TensorsShape entry; /* tensors of one batch entry, as the backend reads them; none until negotiated */
+  gsize entry_size[NNS_TENSOR_SIZE_LIMIT]; /* bytes */
+
+  gchar *labels_path;
+  const LabelTable *labels; /* shared through the asset cache */
+  DecodeArena **arenas; /* one per batch entry so entries can be decoded in parallel */
+  guint num_arenas;
+  QuantParams box_quant, score_quant;
+  gboolean need_dequant;
+  gboolean quantized; /* decode uint8 tensors, from 'dequant' or the negotiated types */
+  guint batch_size;
+  guint n_threads;
+  guint max_detections;
+  guint max_per_class;
+  gboolean roi_meta_compat; /* also attach one GstVideoRegionOfInterestMeta per detection */
+  gboolean silent;
+  GstTensorDetectionsSrc detections; /* optional detections_src pad */
+  GstCaps *stream_caps; /* one batch entry of the input, for the src_%u pads */
+  GPtrArray *stream_pads; /* GstTensorDecodeStreamPad by stream id, NULL if not requested; object lock */
+
+  /* async mode: buffers and serialized events wait here for the src-pad task */
+  gboolean async;
+  DecodeQueue queue; /* queue-size places, for buffers only; its status is the GstFlowReturn of the task */
+  GstClockTime decode_latency; /* longest decode seen in async mode, rounded up to ms; object lock */
+
+  /* video_sink/video_src: frames get the detections of the tensors with the same running time */
+  GstPad *video_sinkpad;
+  GstPad *video_srcpad;
+  GstTensorDecodeVideoPolicy video_policy;
+  GstClockTime sync_tolerance;
+  GstClockTime max_wait;
+  GstSegment video_segment;
+  SyncWindow sync_window; /* empty buffers, each holding a GstTensorDetectionsMeta shared with its tensor buffer */
+  gboolean tensor_eos; /* no more results will come */
+  gboolean video_flushing;
+  GMutex sync_lock;
+  GCond sync_cond;
+};
+
+struct _GstTensorDecodeClass
+{
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_tensordecode_get_type (void);
+GType gst_tensordecode_mode_get_type (void);
+GType gst_tensordecode_video_policy_get_type (void);
+GType gst_tensordecode_yolo_head_get_type (void);
+
+gboolean gst_tensordecode_reserve_arenas (GstTensorDecode *decoder, guint num_anchors, guint num_classes, guint first_class);
+void gst_tensordecode_set_labels (GstTensorDecode *decoder, const LabelTable *labels);
+
+GST_DEBUG_CATEGORY_EXTERN (gst_tensordecode_debug);
+
+G_END_DECLS
+
+#endif /* __GST_TENSORDECODE_H__ */
@@ -0,0 +1,174 @@
+/*
+ * No license installed
+ */
+
+/*
+ * tensordecode mode=bb: the boxes, classes, scores and counts of the TFLite
+ * detections postprocessor, already decoded and suppressed by the model
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <limits.h>
+#include <gst/gst.h>
+
+#include "gsttensordecode.h"
+
+#define GST_CAT_DEFAULT gst_tensordecode_debug
+
+typedef struct
+{
+  guint max_detections; /* per stream: N of the [B, N, 4] boxes tensor */
+  DetectedObject *objects; /* N per batch entry */
+  guint capacity; /* entries `objects` holds */
+} BBBackend;
+
+static gpointer
+bb_new (GstTensorDecode * decoder)
+{
+  return g_new0 (BBBackend, 1);
+}
+
+static void
+bb_free (gpointer state)
+{
+  BBBackend *bb = state;
+  g_free (bb->objects);
+  g_free (bb);
+}
+
+/*
+ * this function checks that the tensors are those of the TFLite detections postprocessor,
+ * batch-size entries of them
+ */
+static gboolean
+bb_set_caps (GstTensorDecode * decoder, gpointer state, const TensorsShape * shape)
+{
+  static const gchar *names[] = { "boxes", "classes", "scores", "count" };
+  BBBackend *bb = state;
+  guint i;
+  if (shape->num_tensors < 4) {
+    GST_ERROR_OBJECT (decoder, "Expected boxes, classes, scores and count tensors, got %u tensors", shape->num_tensors);
+    return FALSE;
+  }
+  /* the boxes tensor is 4:N:B, N being the most detections per stream the postprocessor outputs */
+  if (shape->dims[0][0] != 4 || shape->dims[0][2] * shape->dims[0][3] != decoder->batch_size) {
+    GST_ERROR_OBJECT (decoder, "Expected 4:N:%u boxes for batch-size %u, got %u:%u:%u:%u",
+        decoder->batch_size, decoder->batch_size,
+        shape->dims[0][0], shape->dims[0][1], shape->dims[0][2], shape->dims[0][3]);
+    return FALSE;
+  }
+  bb->max_detections = shape->dims[0][1];
+  /* classes and scores are N:B, and the count holds B values however its dimensions split them */
+  for (i = 1; i < 3; i++) {
+    if (shape->dims[i][0] != bb->max_detections ||
+        shape->dims[i][1] * shape->dims[i][2] * shape->dims[i][3] != decoder->batch_size) {
+      GST_ERROR_OBJECT (decoder, "Expected %u:%u %s for batch-size %u, got %u:%u:%u:%u",
+          bb->max_detections, decoder->batch_size, names[i], decoder->batch_size,
+          shape->dims[i][0], shape->dims[i][1], shape->dims[i][2], shape->dims[i][3]);
+      return FALSE;
+    }
+  }
+  if (shape->dims[3][0] * shape->dims[3][1] * shape->dims[3][2] * shape->dims[3][3] != decoder->batch_size) {
+    GST_ERROR_OBJECT (decoder, "Expected %u counts for batch-size %u, got %u:%u:%u:%u",
+        decoder->batch_size, decoder->batch_size,
+        shape->dims[3][0], shape->dims[3][1], shape->dims[3][2], shape->dims[3][3]);
+    return FALSE;
+  }
+  /* the postprocessor outputs float32 whatever the model's inference type */
+  for (i = 0; i < 4; i++) {
+    if (shape->types[i] != _NNS_FLOAT32) {
+      GST_ERROR_OBJECT (decoder, "Unsupported %s tensor type %s, expected float32",
+          names[i], tensor_type_to_string (shape->types[i]));
+      return FALSE;
+    }
+  }
+
+  /* one entry: 4:N boxes, N classes, N scores and a count */
+  decoder->entry.num_tensors = 4;
+  for (i = 0; i < 4; i++) {
+    decoder->entry.types[i] = _NNS_FLOAT32;
+    tensor_dim_from_string ("1", decoder->entry.dims[i]);
+  }
+  decoder->entry.dims[0][0] = 4;
+  decoder->entry.dims[0][1] = bb->max_detections;
+  decoder->entry.dims[1][0] = bb->max_detections;
+  decoder->entry.dims[2][0] = bb->max_detections;
+  return TRUE;
+}
+
+/* room for the objects of batch-size entries */
+static gboolean
+bb_prepare (GstTensorDecode * decoder, gpointer state)
+{
+  BBBackend *bb = state;
+  guint capacity = decoder->batch_size * bb->max_detections;
+  if (capacity > bb->capacity) {
+    g_free (bb->objects);
+    bb->objects = g_new (DetectedObject, capacity);
+    bb->capacity = capacity;
+  }
+  return TRUE;
+}
+
+/*
+ * this function reads the detections of batch entry `b` into its slice of the objects:
+ *    Boxes:             [num_detections, 4], ymin, xmin, ymax, xmax
+ *    Classes:           [num_detections]
+ *    Scores:            [num_detections]
+ *    Number detections: [1]
+ */
+static gboolean
+bb_decode (GstTensorDecode * decoder, gpointer state, guint b, const guint8 * const * tensors,
+    const DetectedObject ** objects, guint * num_objects)
+{
+  BBBackend *bb = state;
+  const gfloat *boxes = (const gfloat *) tensors[0];
+  const gfloat *classes = (const gfloat *) tensors[1];
+  const gfloat *scores = (const gfloat *) tensors[2];
+  const gfloat count = *(const gfloat *) tensors[3];
+  DetectedObject *o = bb->objects + b * bb->max_detections;
+  guint i, n = count > 0.f ? MIN ((guint) count, bb->max_detections) : 0;
+  for (i = 0; i < n; i++, o++) {
+    const gfloat *box = &boxes[4*i];
+    /* boxes may reach past the frame; coordinates are scaled by UINT_MAX like those decoded from anchors */
+    gdouble ymin = CLAMP (box[0], 0.f, 1.f), xmin = CLAMP (box[1], 0.f, 1.f);
+    gdouble ymax = CLAMP (box[2], 0.f, 1.f), xmax = CLAMP (box[3], 0.f, 1.f);
+    guint label_id = classes[i] > 0.f ? (guint)classes[i] + 1 : 1;
+    o->x = (guint) (xmin * UINT_MAX);
+    o->y = (guint) (ymin * UINT_MAX);
+    o->width = xmax > xmin ? (guint) ((xmax - xmin) * UINT_MAX) : 0;
+    o->height = ymax > ymin ? (guint) ((ymax - ymin) * UINT_MAX) : 0;
+    o->class_id = label_id;
+    o->class_label = (label_id < decoder->labels->num_labels) ? decoder->labels->labels[label_id] : NULL;
+    o->score = scores[i];
+  }
+  *objects = bb->objects + b * bb->max_detections;
+  *num_objects = n;
+  return TRUE;
+}
+
+/* the postprocessor outputs at most N per stream */
+static guint
+bb_max_objects (GstTensorDecode * decoder, gpointer state)
+{
+  BBBackend *bb = state;
+  return bb->max_detections;
+}
+
+const GstTensorDecodeBackend gst_tensordecode_bb_backend = {
+  "bb",
+  "Boxes, classes, scores and counts of the TFLite detections postprocessor",
+  0,
+  NULL,
+  bb_new,
+  bb_free,
+  NULL,
+  NULL,
+  bb_set_caps,
+  bb_prepare,
+  bb_decode,
+  bb_max_objects,
+};
@@ -0,0 +1,425 @@
+/*
+ * No license installed
+ */
+
+/*
+ * tensordecode mode=ssd: SSD box encodings and class logits, decoded against
+ * anchors from box-priors, an asset bundle or the anchor-* properties
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+
+#include "gsttensordecode.h"
+
+#define GST_CAT_DEFAULT gst_tensordecode_debug
+
+enum
+{
+  PROP_BOX_PRIORS,
+  PROP_BUNDLE,
+  PROP_ANCHOR_FEATURE_MAPS,
+  PROP_ANCHOR_MIN_SCALE,
+  PROP_ANCHOR_MAX_SCALE,
+  PROP_ANCHOR_ASPECT_RATIOS,
+  PROP_Y_SCALE,
+  PROP_X_SCALE,
+  PROP_H_SCALE,
+  PROP_W_SCALE,
+  NUM_PROPERTIES
+};
+
+/* where the anchors come from; boxpriors and bundle select themselves when set */
+typedef enum
+{
+  SSD_ANCHORS_GENERATED, /* from the anchor-* properties */
+  SSD_ANCHORS_BOX_PRIORS,
+  SSD_ANCHORS_BUNDLE
+} SsdAnchorSource;
+
+typedef struct
+{
+  gchar *box_priors_path;
+  gchar *bundle_path;
+  guint32 bundle_dims[2][ASSET_BUNDLE_RANK]; /* tensor dims recorded in the bundle; zero if none */
+  const AnchorTable *anchors; /* shared through the asset cache */
+  SsdAnchorSource anchor_source;
+  SsdAnchorParams anchor_params;
+  gchar *anchor_feature_maps;
+  gchar *anchor_aspect_ratios;
+  BoxScales scales;
+} SsdBackend;
+
+static void
+ssd_install_properties (GObjectClass * gobject_class, guint prop_base)
+{
+  g_object_class_install_property (gobject_class, prop_base + PROP_BOX_PRIORS,
+      g_param_spec_string ("boxpriors", "Box-Priors", "Path to box-priors file ?",
+          "", G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_BUNDLE,
+      g_param_spec_string ("bundle", "Bundle", "Path to asset bundle with box-priors, labels and scales (replaces labels and boxpriors) ?",
+          "", G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_ANCHOR_FEATURE_MAPS,
+      g_param_spec_string ("anchor-feature-maps", "Anchor-Feature-Maps", "Feature map sizes (N or HxW, comma-separated) of the generated anchors, used without boxpriors or bundle ?",
+          DEFAULT_ANCHOR_FEATURE_MAPS, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_ANCHOR_MIN_SCALE,
+      g_param_spec_float ("anchor-min-scale", "Anchor-Min-Scale", "Scale of the generated anchors on the first feature map ?",
+          0.f, 1.f, DEFAULT_ANCHOR_MIN_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_ANCHOR_MAX_SCALE,
+      g_param_spec_float ("anchor-max-scale", "Anchor-Max-Scale", "Scale of the generated anchors on the last feature map ?",
+          0.f, 1.f, DEFAULT_ANCHOR_MAX_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_ANCHOR_ASPECT_RATIOS,
+      g_param_spec_string ("anchor-aspect-ratios", "Anchor-Aspect-Ratios", "Aspect ratios (comma-separated) of the generated anchors ?",
+          DEFAULT_ANCHOR_ASPECT_RATIOS, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_Y_SCALE,
+      g_param_spec_float ("y-scale", "Y-Scale", "Box-coder scale of the y-centre offsets ?",
+          G_MINFLOAT, G_MAXFLOAT, Y_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_X_SCALE,
+      g_param_spec_float ("x-scale", "X-Scale", "Box-coder scale of the x-centre offsets ?",
+          G_MINFLOAT, G_MAXFLOAT, X_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_H_SCALE,
+      g_param_spec_float ("h-scale", "H-Scale", "Box-coder scale of the log-height offsets ?",
+          G_MINFLOAT, G_MAXFLOAT, H_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_W_SCALE,
+      g_param_spec_float ("w-scale", "W-Scale", "Box-coder scale of the log-width offsets ?",
+          G_MINFLOAT, G_MAXFLOAT, W_SCALE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+}
+
+static gpointer
+ssd_new (GstTensorDecode * decoder)
+{
+  SsdBackend *ssd = g_new0 (SsdBackend, 1);
+  ssd_anchor_params_init (&ssd->anchor_params);
+  ssd->anchor_feature_maps = g_strdup (DEFAULT_ANCHOR_FEATURE_MAPS);
+  ssd->anchor_aspect_ratios = g_strdup (DEFAULT_ANCHOR_ASPECT_RATIOS);
+  ssd->anchor_source = SSD_ANCHORS_GENERATED;
+  ssd->scales.y = Y_SCALE;
+  ssd->scales.x = X_SCALE;
+  ssd->scales.h = H_SCALE;
+  ssd->scales.w = W_SCALE;
+  return ssd;
+}
+
+static void
+ssd_free (gpointer state)
+{
+  SsdBackend *ssd = state;
+  asset_cache_unref (ssd->anchors);
+  g_free (ssd->box_priors_path);
+  g_free (ssd->bundle_path);
+  g_free (ssd->anchor_feature_maps);
+  g_free (ssd->anchor_aspect_ratios);
+  g_free (ssd);
+}
+
+/* (re)acquire the shared anchor table for the current anchor source and scales */
+static gboolean
+ssd_acquire_anchors (SsdBackend * ssd)
+{
+  const AnchorTable *anchors;
+  switch (ssd->anchor_source) {
+    case SSD_ANCHORS_BOX_PRIORS:
+      anchors = asset_cache_get_box_priors (ssd->box_priors_path, &ssd->scales);
+      break;
+    case SSD_ANCHORS_BUNDLE:
+      anchors = asset_cache_get_bundle_anchors (ssd->bundle_path, &ssd->scales);
+      break;
+    default:
+      anchors = asset_cache_get_ssd_anchors (&ssd->anchor_params, &ssd->scales);
+      break;
+  }
+  asset_cache_unref (ssd->anchors);
+  ssd->anchors = anchors;
+  return anchors != NULL;
+}
+
+/* switch to the anchors with the current box-coder scales folded in */
+static void
+ssd_update_scales (GstTensorDecode * decoder, SsdBackend * ssd)
+{
+  if (ssd->anchors && !ssd_acquire_anchors (ssd))
+    GST_ERROR_OBJECT(decoder, "Failed to rescale the box-priors");
+}
+
+/* regenerate anchors that came from the anchor-* properties after one of them changed */
+static void
+ssd_update_anchors (GstTensorDecode * decoder, SsdBackend * ssd)
+{
+  if (ssd->anchor_source == SSD_ANCHORS_GENERATED && ssd->anchors &&
+      !ssd_acquire_anchors (ssd))
+    GST_ERROR_OBJECT(decoder, "Failed to generate anchors");
+}
+
+/* take the anchors, labels, scales and tensor dims from an asset bundle */
+static gboolean
+ssd_load_bundle (GstTensorDecode * decoder, SsdBackend * ssd)
+{
+  AssetBundleHeader h;
+  if (!asset_bundle_read_header (ssd->bundle_path, &h))
+    return FALSE;
+  ssd->scales.y = h.y_scale;
+  ssd->scales.x = h.x_scale;
+  ssd->scales.h = h.h_scale;
+  ssd->scales.w = h.w_scale;
+  memcpy (ssd->bundle_dims[0], h.boxes_dim, sizeof (ssd->bundle_dims[0]));
+  memcpy (ssd->bundle_dims[1], h.predictions_dim, sizeof (ssd->bundle_dims[1]));
+  ssd->anchor_source = SSD_ANCHORS_BUNDLE;
+  gst_tensordecode_set_labels (decoder, asset_cache_get_bundle_labels (ssd->bundle_path));
+  return ssd_acquire_anchors (ssd) && decoder->labels;
+}
+
+static void
+ssd_set_property (GstTensorDecode * decoder, gpointer state, guint prop,
+    const GValue * value, GParamSpec * pspec)
+{
+  SsdBackend *ssd = state;
+
+  switch (prop) {
+    case PROP_BOX_PRIORS:
+      g_free (ssd->box_priors_path);
+      ssd->box_priors_path = g_value_dup_string (value);
+      ssd->anchor_source = SSD_ANCHORS_BOX_PRIORS;
+      if(!ssd_acquire_anchors (ssd))
+        GST_ERROR_OBJECT(decoder, "Failed to load box-priors from %s", ssd->box_priors_path);
+      else if (!decoder->silent)
+        GST_LOG_OBJECT(decoder, "Loaded %u box-priors from %s", ssd->anchors->num_anchors, ssd->box_priors_path);
+      break;
+    case PROP_BUNDLE:
+      g_free (ssd->bundle_path);
+      ssd->bundle_path = g_value_dup_string (value);
+      if (!ssd_load_bundle (decoder, ssd))
+        GST_ERROR_OBJECT(decoder, "Failed to load bundle from %s", ssd->bundle_path);
+      else if (!decoder->silent)
+        GST_LOG_OBJECT(decoder, "Loaded %u box-priors and %u labels from %s",
+            ssd->anchors->num_anchors, decoder->labels->num_labels, ssd->bundle_path);
+      break;
+    case PROP_ANCHOR_FEATURE_MAPS:
+      if (!ssd_anchor_params_set_feature_maps (&ssd->anchor_params, g_value_get_string (value))) {
+        GST_ERROR_OBJECT(decoder, "Invalid anchor feature maps '%s'", g_value_get_string (value));
+        break;
+      }
+      g_free (ssd->anchor_feature_maps);
+      ssd->anchor_feature_maps = g_value_dup_string (value);
+      ssd_update_anchors (decoder, ssd);
+      break;
+    case PROP_ANCHOR_MIN_SCALE:
+      ssd->anchor_params.min_scale = g_value_get_float (value);
+      ssd_update_anchors (decoder, ssd);
+      break;
+    case PROP_ANCHOR_MAX_SCALE:
+      ssd->anchor_params.max_scale = g_value_get_float (value);
+      ssd_update_anchors (decoder, ssd);
+      break;
+    case PROP_ANCHOR_ASPECT_RATIOS:
+      if (!ssd_anchor_params_set_aspect_ratios (&ssd->anchor_params, g_value_get_string (value))) {
+        GST_ERROR_OBJECT(decoder, "Invalid anchor aspect ratios '%s'", g_value_get_string (value));
+        break;
+      }
+      g_free (ssd->anchor_aspect_ratios);
+      ssd->anchor_aspect_ratios = g_value_dup_string (value);
+      ssd_update_anchors (decoder, ssd);
+      break;
+    case PROP_Y_SCALE:
+      ssd->scales.y = g_value_get_float (value);
+      ssd_update_scales (decoder, ssd);
+      break;
+    case PROP_X_SCALE:
+      ssd->scales.x = g_value_get_float (value);
+      ssd_update_scales (decoder, ssd);
+      break;
+    case PROP_H_SCALE:
+      ssd->scales.h = g_value_get_float (value);
+      ssd_update_scales (decoder, ssd);
+      break;
+    case PROP_W_SCALE:
+      ssd->scales.w = g_value_get_float (value);
+      ssd_update_scales (decoder, ssd);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (decoder, prop, pspec);
+      break;
+  }
+}
+
+static void
+ssd_get_property (GstTensorDecode * decoder, gpointer state, guint prop,
+    GValue * value, GParamSpec * pspec)
+{
+  SsdBackend *ssd = state;
+
+  switch (prop) {
+    case PROP_BOX_PRIORS:
+      g_value_set_string (value, ssd->box_priors_path);
+      break;
+    case PROP_BUNDLE:
+      g_value_set_string (value, ssd->bundle_path);
+      break;
+    case PROP_ANCHOR_FEATURE_MAPS:
+      g_value_set_string (value, ssd->anchor_feature_maps);
+      break;
+    case PROP_ANCHOR_MIN_SCALE:
+      g_value_set_float (value, ssd->anchor_params.min_scale);
+      break;
+    case PROP_ANCHOR_MAX_SCALE:
+      g_value_set_float (value, ssd->anchor_params.max_scale);
+      break;
+    case PROP_ANCHOR_ASPECT_RATIOS:
+      g_value_set_string (value, ssd->anchor_aspect_ratios);
+      break;
+    case PROP_Y_SCALE:
+      g_value_set_float (value, ssd->scales.y);
+      break;
+    case PROP_X_SCALE:
+      g_value_set_float (value, ssd->scales.x);
+      break;
+    case PROP_H_SCALE:
+      g_value_set_float (value, ssd->scales.h);
+      break;
+    case PROP_W_SCALE:
+      g_value_set_float (value, ssd->scales.w);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (decoder, prop, pspec);
+      break;
+  }
+}
+
+/*
+ * this function checks the negotiated tensors are SSD boxes and class predictions
+ * matching the anchors, and sizes the decode arenas for them
+ */
+static gboolean
+ssd_set_caps (GstTensorDecode * decoder, gpointer state, const TensorsShape * shape)
+{
+  SsdBackend *ssd = state;
+  guint num_anchors, num_classes, i;
+  tensor_type type;
+  if (shape->num_tensors < 2) {
+    GST_ERROR_OBJECT (decoder, "Expected boxes and predictions tensors, got %u tensors", shape->num_tensors);
+    return FALSE;
+  }
+  /* float32, or uint8 decoded with the box- and score- quantization; int8 would need its own tables */
+  for (i = 0; i < 2; i++) {
+    if (shape->types[i] != _NNS_UINT8 && shape->types[i] != _NNS_FLOAT32) {
+      GST_ERROR_OBJECT (decoder, "Unsupported %s tensor type %s, expected uint8 or float32",
+          i ? "predictions" : "boxes", tensor_type_to_string (shape->types[i]));
+      return FALSE;
+    }
+  }
+  if (shape->types[0] != shape->types[1] && !decoder->need_dequant) {
+    GST_ERROR_OBJECT (decoder, "Boxes are %s but predictions are %s; set dequant to decode both as uint8",
+        tensor_type_to_string (shape->types[0]), tensor_type_to_string (shape->types[1]));
+    return FALSE;
+  }
+  num_anchors = shape->dims[0][1];
+  num_classes = shape->dims[1][0];
+  if (shape->dims[0][0] != BOX_SIZE || shape->dims[1][1] != num_anchors || num_classes < 2) {
+    GST_ERROR_OBJECT (decoder, "Unsupported tensor dimensions %u:%u and %u:%u",
+        shape->dims[0][0], shape->dims[0][1], shape->dims[1][0], shape->dims[1][1]);
+    return FALSE;
+  }
+  if (!ssd->anchors && !ssd_acquire_anchors (ssd)) {
+    GST_ERROR_OBJECT (decoder, "Failed to load or generate anchors");
+    return FALSE;
+  }
+  if (ssd->anchors->num_anchors != num_anchors) {
+    GST_ERROR_OBJECT (decoder, "Model has %u anchors but there are %u box-priors%s",
+        num_anchors, ssd->anchors->num_anchors,
+        ssd->anchor_source == SSD_ANCHORS_GENERATED ? " (check the anchor-* properties)" : "");
+    return FALSE;
+  }
+  if (ssd->bundle_dims[0][0]) {
+    guint r;
+    for (r = 0; r < MIN (ASSET_BUNDLE_RANK, NNS_TENSOR_RANK_LIMIT); r++) {
+      if (ssd->bundle_dims[0][r] != shape->dims[0][r] || ssd->bundle_dims[1][r] != shape->dims[1][r]) {
+        GST_ERROR_OBJECT (decoder, "Tensor dimensions do not match those recorded in %s", ssd->bundle_path);
+        return FALSE;
+      }
+    }
+  }
+  if (decoder->labels && decoder->labels->num_labels < num_classes)
+    GST_WARNING_OBJECT (decoder, "Model has %u classes but there are only %u labels",
+        num_classes, decoder->labels->num_labels);
+  decoder->quantized = decoder->need_dequant ||
+      (shape->types[0] == _NNS_UINT8 && shape->types[1] == _NNS_UINT8);
+  /* one entry: BOX_SIZE:anchors boxes and classes:anchors predictions */
+  type = decoder->quantized ? _NNS_UINT8 : _NNS_FLOAT32;
+  decoder->entry.num_tensors = 2;
+  decoder->entry.types[0] = decoder->entry.types[1] = type;
+  tensor_dim_from_string ("4", decoder->entry.dims[0]);
+  tensor_dim_from_string ("1", decoder->entry.dims[1]);
+  decoder->entry.dims[0][1] = num_anchors;
+  decoder->entry.dims[1][0] = num_classes;
+  decoder->entry.dims[1][1] = num_anchors;
+  return gst_tensordecode_reserve_arenas (decoder, num_anchors, num_classes, SSD_FIRST_CLASS);
+}
+
+/* anchors may have failed to load since the caps; batch-size may have grown */
+static gboolean
+ssd_prepare (GstTensorDecode * decoder, gpointer state)
+{
+  SsdBackend *ssd = state;
+  if (!ssd->anchors) {
+    GST_ERROR_OBJECT(decoder, "No box-priors: set 'boxpriors' or 'bundle', or check the anchor-* properties");
+    return FALSE;
+  }
+  return gst_tensordecode_reserve_arenas (decoder, decoder->arenas[0]->num_anchors, decoder->arenas[0]->num_classes, SSD_FIRST_CLASS);
+}
+
+/* decode batch entry `b` into its own arena */
+static gboolean
+ssd_decode (GstTensorDecode * decoder, gpointer state, guint b, const guint8 * const * tensors,
+    const DetectedObject ** objects, guint * num_objects)
+{
+  SsdBackend *ssd = state;
+  DecodeArena *arena = decoder->arenas[b];
+  gboolean sanity_check;
+  if (decoder->quantized) // compare raw uint8 logits, dequantize survivors only
+    sanity_check = get_detected_objects_quant (ssd->anchors, decoder->labels->labels, decoder->labels->num_labels,
+        tensors[1], tensors[0], arena, num_objects);
+  else // no dequant, read as-is
+    sanity_check = get_detected_objects (ssd->anchors, decoder->labels->labels, decoder->labels->num_labels,
+        (const gfloat *) tensors[1], (const gfloat *) tensors[0], arena, num_objects);
+  if (!sanity_check)
+    GST_ERROR_OBJECT (decoder, "Box-priors do not match the model's %u anchors", arena->num_anchors);
+  *objects = arena->detections;
+  return sanity_check;
+}
+
+/* NMS keeps at most max-detections per frame */
+static guint
+ssd_max_objects (GstTensorDecode * decoder, gpointer state)
+{
+  guint rows = decoder->arenas[0]->max_detections;
+  if (decoder->max_detections)
+    rows = MIN (rows, decoder->max_detections);
+  return rows;
+}
+
+const GstTensorDecodeBackend gst_tensordecode_ssd_backend = {
+  "ssd",
+  "SSD box encodings and class logits, decoded against anchors",
+  NUM_PROPERTIES,
+  ssd_install_properties,
+  ssd_new,
+  ssd_free,
+  ssd_set_property,
+  ssd_get_property,
+  ssd_set_caps,
+  ssd_prepare,
+  ssd_decode,
+  ssd_max_objects,
+};
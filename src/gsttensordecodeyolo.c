@@ -0,0 +1,315 @@
+/*
+ * No license installed
+ */
+
+/*
+ * tensordecode mode=yolo: the output of a YOLOv5 (anchor-based) or YOLOv8
+ * (anchor-free) head, raw or decoded in-graph, without the model's own NMS
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+
+#include "gsttensordecode.h"
+
+#define GST_CAT_DEFAULT gst_tensordecode_debug
+
+#define DEFAULT_YOLO_HEAD YOLO_HEAD_ANCHORS
+
+enum
+{
+  PROP_HEAD,
+  PROP_DECODED,
+  PROP_INPUT_SIZE,
+  PROP_STRIDES,
+  PROP_ANCHORS,
+  PROP_SCORE_THRESHOLD,
+  NUM_PROPERTIES
+};
+
+typedef struct
+{
+  YoloParams params;
+  gchar *input_size;
+  gchar *strides;
+  gchar *anchors;
+  const AnchorTable *grid; /* shared through the asset cache; NULL for decoded outputs */
+  guint num_classes; /* of the negotiated head */
+} YoloBackend;
+
+GType
+gst_tensordecode_yolo_head_get_type (void)
+{
+  static gsize type = 0;
+  if (g_once_init_enter (&type)) {
+    static const GEnumValue values[] = {
+      { YOLO_HEAD_ANCHORS, "YOLOv5: rows of box, objectness and class scores per anchor", "v5" },
+      { YOLO_HEAD_ANCHOR_FREE, "YOLOv8: anchor-free planes of box and class scores", "v8" },
+      { 0, NULL, NULL }
+    };
+    g_once_init_leave (&type, g_enum_register_static ("GstTensorDecodeYoloHead", values));
+  }
+  return type;
+}
+
+static void
+yolo_install_properties (GObjectClass * gobject_class, guint prop_base)
+{
+  g_object_class_install_property (gobject_class, prop_base + PROP_HEAD,
+      g_param_spec_enum ("yolo-head", "YOLO-Head", "Output layout of the YOLO head ?",
+          GST_TYPE_TENSORDECODE_YOLO_HEAD, DEFAULT_YOLO_HEAD, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_DECODED,
+      g_param_spec_boolean ("yolo-decoded", "YOLO-Decoded", "Boxes are normalized and scores are probabilities, decoded in-graph, rather than raw head outputs decoded against the grid ?",
+          FALSE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_INPUT_SIZE,
+      g_param_spec_string ("yolo-input-size", "YOLO-Input-Size", "Model input size (N or HxW) the grid of raw outputs spans ?",
+          DEFAULT_YOLO_INPUT_SIZE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_STRIDES,
+      g_param_spec_string ("yolo-strides", "YOLO-Strides", "Strides (comma-separated) of the levels of raw outputs, in output order ?",
+          DEFAULT_YOLO_STRIDES, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_ANCHORS,
+      g_param_spec_string ("yolo-anchors", "YOLO-Anchors", "Anchor width,height pairs in input pixels, one semicolon-separated group per level, for raw v5 outputs ?",
+          DEFAULT_YOLO_ANCHORS, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, prop_base + PROP_SCORE_THRESHOLD,
+      g_param_spec_float ("yolo-score-threshold", "YOLO-Score-Threshold", "Lowest objectness x class score of a detection ?",
+          0.f, 1.f, DEFAULT_YOLO_SCORE_THRESHOLD, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+}
+
+static gpointer
+yolo_new (GstTensorDecode * decoder)
+{
+  YoloBackend *yolo = g_new0 (YoloBackend, 1);
+  yolo_params_init (&yolo->params);
+  yolo->input_size = g_strdup (DEFAULT_YOLO_INPUT_SIZE);
+  yolo->strides = g_strdup (DEFAULT_YOLO_STRIDES);
+  yolo->anchors = g_strdup (DEFAULT_YOLO_ANCHORS);
+  return yolo;
+}
+
+static void
+yolo_free (gpointer state)
+{
+  YoloBackend *yolo = state;
+  asset_cache_unref (yolo->grid);
+  g_free (yolo->input_size);
+  g_free (yolo->strides);
+  g_free (yolo->anchors);
+  g_free (yolo);
+}
+
+/* (re)acquire the shared grid for the current geometry; decoded outputs need none */
+static gboolean
+yolo_acquire_grid (YoloBackend * yolo)
+{
+  const AnchorTable *grid = NULL;
+  if (!yolo->params.decoded)
+    grid = asset_cache_get_yolo_grid (&yolo->params);
+  asset_cache_unref (yolo->grid);
+  yolo->grid = grid;
+  return grid != NULL || yolo->params.decoded;
+}
+
+/* regenerate a grid already in use after the geometry changed */
+static void
+yolo_update_grid (GstTensorDecode * decoder, YoloBackend * yolo)
+{
+  if (yolo->grid && !yolo_acquire_grid (yolo))
+    GST_ERROR_OBJECT(decoder, "Failed to generate the YOLO grid (check that yolo-anchors has one group per stride)");
+}
+
+static void
+yolo_set_property (GstTensorDecode * decoder, gpointer state, guint prop,
+    const GValue * value, GParamSpec * pspec)
+{
+  YoloBackend *yolo = state;
+
+  switch (prop) {
+    case PROP_HEAD:
+      yolo->params.head = g_value_get_enum (value);
+      yolo_update_grid (decoder, yolo);
+      break;
+    case PROP_DECODED:
+      yolo->params.decoded = g_value_get_boolean (value);
+      yolo_update_grid (decoder, yolo);
+      break;
+    case PROP_INPUT_SIZE:
+      if (!yolo_params_set_input_size (&yolo->params, g_value_get_string (value))) {
+        GST_ERROR_OBJECT(decoder, "Invalid YOLO input size '%s'", g_value_get_string (value));
+        break;
+      }
+      g_free (yolo->input_size);
+      yolo->input_size = g_value_dup_string (value);
+      yolo_update_grid (decoder, yolo);
+      break;
+    case PROP_STRIDES:
+      if (!yolo_params_set_strides (&yolo->params, g_value_get_string (value))) {
+        GST_ERROR_OBJECT(decoder, "Invalid YOLO strides '%s'", g_value_get_string (value));
+        break;
+      }
+      g_free (yolo->strides);
+      yolo->strides = g_value_dup_string (value);
+      yolo_update_grid (decoder, yolo);
+      break;
+    case PROP_ANCHORS:
+      if (!yolo_params_set_anchors (&yolo->params, g_value_get_string (value))) {
+        GST_ERROR_OBJECT(decoder, "Invalid YOLO anchors '%s'", g_value_get_string (value));
+        break;
+      }
+      g_free (yolo->anchors);
+      yolo->anchors = g_value_dup_string (value);
+      yolo_update_grid (decoder, yolo);
+      break;
+    case PROP_SCORE_THRESHOLD:
+      yolo->params.score_threshold = g_value_get_float (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (decoder, prop, pspec);
+      break;
+  }
+}
+
+static void
+yolo_get_property (GstTensorDecode * decoder, gpointer state, guint prop,
+    GValue * value, GParamSpec * pspec)
+{
+  YoloBackend *yolo = state;
+
+  switch (prop) {
+    case PROP_HEAD:
+      g_value_set_enum (value, yolo->params.head);
+      break;
+    case PROP_DECODED:
+      g_value_set_boolean (value, yolo->params.decoded);
+      break;
+    case PROP_INPUT_SIZE:
+      g_value_set_string (value, yolo->input_size);
+      break;
+    case PROP_STRIDES:
+      g_value_set_string (value, yolo->strides);
+      break;
+    case PROP_ANCHORS:
+      g_value_set_string (value, yolo->anchors);
+      break;
+    case PROP_SCORE_THRESHOLD:
+      g_value_set_float (value, yolo->params.score_threshold);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (decoder, prop, pspec);
+      break;
+  }
+}
+
+/*
+ * this function checks the negotiated tensor is the float32 output of the configured head,
+ * with as many rows as its grid, and sizes the decode arenas for it:
+ *    v5: (5 + classes):rows, each row x, y, w, h, objectness and class scores
+ *    v8: rows:(4 + classes), planes of x, y, w, h (or l, t, r, b) and class scores
+ */
+static gboolean
+yolo_set_caps (GstTensorDecode * decoder, gpointer state, const TensorsShape * shape)
+{
+  YoloBackend *yolo = state;
+  gboolean anchor_based = yolo->params.head == YOLO_HEAD_ANCHORS;
+  guint values, num_rows;
+  if (shape->num_tensors < 1) {
+    GST_ERROR_OBJECT (decoder, "Expected the output tensor of a YOLO head, got no tensors");
+    return FALSE;
+  }
+  if (shape->types[0] != _NNS_FLOAT32) {
+    GST_ERROR_OBJECT (decoder, "YOLO outputs must be float32, got %s", tensor_type_to_string (shape->types[0]));
+    return FALSE;
+  }
+  values = anchor_based ? shape->dims[0][0] : shape->dims[0][1];
+  num_rows = anchor_based ? shape->dims[0][1] : shape->dims[0][0];
+  if (values <= (anchor_based ? YOLO_ROW_CLASSES : YOLO_PLANE_CLASSES) || num_rows == 0) {
+    GST_ERROR_OBJECT (decoder, "Unsupported tensor dimensions %u:%u for a %s head",
+        shape->dims[0][0], shape->dims[0][1], anchor_based ? "v5" : "v8");
+    return FALSE;
+  }
+  yolo->num_classes = values - (anchor_based ? YOLO_ROW_CLASSES : YOLO_PLANE_CLASSES);
+  if (!yolo->params.decoded) {
+    if (!yolo->grid && !yolo_acquire_grid (yolo)) {
+      GST_ERROR_OBJECT (decoder, "Failed to generate the YOLO grid (check that yolo-anchors has one group per stride)");
+      return FALSE;
+    }
+    if (yolo->grid->num_anchors != num_rows) {
+      GST_ERROR_OBJECT (decoder, "Model has %u rows but the grid of yolo-input-size and yolo-strides has %u",
+          num_rows, yolo->grid->num_anchors);
+      return FALSE;
+    }
+  }
+  /* class c is labelled by line c: the labels file lists the model's classes, without a background line */
+  if (decoder->labels && decoder->labels->num_labels < yolo->num_classes)
+    GST_WARNING_OBJECT (decoder, "Model has %u classes but there are only %u labels",
+        yolo->num_classes, decoder->labels->num_labels);
+  if (decoder->need_dequant)
+    GST_WARNING_OBJECT (decoder, "dequant has no effect in mode=yolo");
+  decoder->quantized = FALSE;
+  /* one entry: the head's output as negotiated */
+  decoder->entry.num_tensors = 1;
+  decoder->entry.types[0] = _NNS_FLOAT32;
+  tensor_dim_from_string ("1", decoder->entry.dims[0]);
+  decoder->entry.dims[0][0] = shape->dims[0][0];
+  decoder->entry.dims[0][1] = shape->dims[0][1];
+  return gst_tensordecode_reserve_arenas (decoder, num_rows, yolo->num_classes, YOLO_FIRST_CLASS);
+}
+
+/* the grid may be due after yolo-decoded was cleared, or have failed to generate; batch-size may have grown */
+static gboolean
+yolo_prepare (GstTensorDecode * decoder, gpointer state)
+{
+  YoloBackend *yolo = state;
+  if (!yolo->params.decoded && !yolo->grid && !yolo_acquire_grid (yolo)) {
+    GST_ERROR_OBJECT(decoder, "No YOLO grid: check yolo-input-size, yolo-strides and yolo-anchors");
+    return FALSE;
+  }
+  return gst_tensordecode_reserve_arenas (decoder, decoder->arenas[0]->num_anchors, decoder->arenas[0]->num_classes, YOLO_FIRST_CLASS);
+}
+
+/* gate, decode and suppress batch entry `b` in its own arena */
+static gboolean
+yolo_decode (GstTensorDecode * decoder, gpointer state, guint b, const guint8 * const * tensors,
+    const DetectedObject ** objects, guint * num_objects)
+{
+  YoloBackend *yolo = state;
+  DecodeArena *arena = decoder->arenas[b];
+  gboolean sanity_check = get_detected_objects_yolo (&yolo->params, yolo->grid,
+      decoder->labels->labels, decoder->labels->num_labels, (const gfloat *) tensors[0], arena, num_objects);
+  if (!sanity_check)
+    GST_ERROR_OBJECT (decoder, "YOLO grid does not match the model's %u rows", arena->num_anchors);
+  *objects = arena->detections;
+  return sanity_check;
+}
+
+/* NMS keeps at most max-detections per frame */
+static guint
+yolo_max_objects (GstTensorDecode * decoder, gpointer state)
+{
+  guint rows = decoder->arenas[0]->max_detections;
+  if (decoder->max_detections)
+    rows = MIN (rows, decoder->max_detections);
+  return rows;
+}
+
+const GstTensorDecodeBackend gst_tensordecode_yolo_backend = {
+  "yolo",
+  "YOLOv5 or YOLOv8 head outputs, gated and decoded against the grid",
+  NUM_PROPERTIES,
+  yolo_install_properties,
+  yolo_new,
+  yolo_free,
+  yolo_set_property,
+  yolo_get_property,
+  yolo_set_caps,
+  yolo_prepare,
+  yolo_decode,
+  yolo_max_objects,
+};
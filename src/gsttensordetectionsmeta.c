@@ -0,0 +1,155 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:gsttensordetectionsmeta
+ *
+ * Compact per-buffer detections attached by the tensor decoders
+ *
+ */
+
+#include <gst/gst.h>
+#include "gsttensordetectionsmeta.h"
+
+#define GST_TENSOR_DETECTIONS_META_API_NAME "GstTensorDetectionsMetaAPI"
+#define GST_TENSOR_DETECTIONS_META_IMPL_NAME "GstTensorDetectionsMeta"
+
+/**
+ * @brief Header in front of a detections array, so that metas can share the array.
+ */
+typedef struct _GstTensorDetectionsBlock
+{
+  gint refcount;
+  gint reserved; /**< keeps the array 8-byte aligned */
+} GstTensorDetectionsBlock;
+
+#define DETECTIONS_BLOCK(d) ((GstTensorDetectionsBlock *) (d) - 1)
+
+static GstTensorDetection *
+gst_tensor_detections_alloc (guint num_detections)
+{
+  GstTensorDetectionsBlock *block;
+  if (!num_detections)
+    return NULL;
+  block = g_malloc (sizeof (GstTensorDetectionsBlock) + num_detections * sizeof (GstTensorDetection));
+  block->refcount = 1;
+  return (GstTensorDetection *) (block + 1);
+}
+
+static GstTensorDetection *
+gst_tensor_detections_ref (GstTensorDetection *detections)
+{
+  if (detections)
+    g_atomic_int_inc (&DETECTIONS_BLOCK (detections)->refcount);
+  return detections;
+}
+
+static void
+gst_tensor_detections_unref (GstTensorDetection *detections)
+{
+  if (detections && g_atomic_int_dec_and_test (&DETECTIONS_BLOCK (detections)->refcount))
+    g_free (DETECTIONS_BLOCK (detections));
+}
+
+/**
+ * @brief Register the meta API, or return the one already registered.
+ *
+ * The type is looked up first because this file may be linked into a process
+ * more than once, e.g. by the decoder library and by an application built
+ * against its sources; every copy must then share one API type.
+ */
+GType
+gst_tensor_detections_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  if (g_once_init_enter (&type)) {
+    static const gchar *tags[] = { NULL }; /* normalized coordinates survive any video transform */
+    GType api = g_type_from_name (GST_TENSOR_DETECTIONS_META_API_NAME);
+    if (!api)
+      api = gst_meta_api_type_register (GST_TENSOR_DETECTIONS_META_API_NAME, tags);
+    g_once_init_leave (&type, api);
+  }
+  return type;
+}
+
+static gboolean
+gst_tensor_detections_meta_init (GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+  GstTensorDetectionsMeta *dmeta = (GstTensorDetectionsMeta *) meta;
+  dmeta->num_detections = 0;
+  dmeta->detections = NULL;
+  return TRUE;
+}
+
+static void
+gst_tensor_detections_meta_free (GstMeta *meta, GstBuffer *buffer)
+{
+  GstTensorDetectionsMeta *dmeta = (GstTensorDetectionsMeta *) meta;
+  gst_tensor_detections_unref (dmeta->detections);
+  dmeta->detections = NULL;
+  dmeta->num_detections = 0;
+}
+
+static gboolean
+gst_tensor_detections_meta_transform (GstBuffer *dest, GstMeta *meta, GstBuffer *buffer, GQuark type, gpointer data)
+{
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+  return gst_buffer_add_tensor_detections_meta_shared (dest, (GstTensorDetectionsMeta *) meta) != NULL;
+}
+
+/**
+ * @brief Register the meta implementation, or return the one already registered.
+ */
+const GstMetaInfo *
+gst_tensor_detections_meta_get_info (void)
+{
+  static const GstMetaInfo *info = NULL;
+  if (g_once_init_enter (&info)) {
+    const GstMetaInfo *meta = gst_meta_get_info (GST_TENSOR_DETECTIONS_META_IMPL_NAME);
+    if (!meta)
+      meta = gst_meta_register (GST_TENSOR_DETECTIONS_META_API_TYPE, GST_TENSOR_DETECTIONS_META_IMPL_NAME,
+          sizeof (GstTensorDetectionsMeta), gst_tensor_detections_meta_init,
+          gst_tensor_detections_meta_free, gst_tensor_detections_meta_transform);
+    g_once_init_leave (&info, meta);
+  }
+  return info;
+}
+
+/**
+ * @brief Attach a detections meta with room for `num_detections` objects.
+ *
+ * The array is left for the caller to fill. Returns NULL on failure.
+ */
+GstTensorDetectionsMeta *
+gst_buffer_add_tensor_detections_meta (GstBuffer *buffer, guint num_detections)
+{
+  GstTensorDetectionsMeta *meta;
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  meta = (GstTensorDetectionsMeta *) gst_buffer_add_meta (buffer, GST_TENSOR_DETECTIONS_META_INFO, NULL);
+  if (!meta)
+    return NULL;
+  meta->num_detections = num_detections;
+  meta->detections = gst_tensor_detections_alloc (num_detections);
+  return meta;
+}
+
+/**
+ * @brief Attach a meta holding the detections of `source`, without copying them.
+ *
+ * Returns NULL on failure.
+ */
+GstTensorDetectionsMeta *
+gst_buffer_add_tensor_detections_meta_shared (GstBuffer *buffer, const GstTensorDetectionsMeta *source)
+{
+  GstTensorDetectionsMeta *meta;
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (source != NULL, NULL);
+  meta = (GstTensorDetectionsMeta *) gst_buffer_add_meta (buffer, GST_TENSOR_DETECTIONS_META_INFO, NULL);
+  if (!meta)
+    return NULL;
+  meta->num_detections = source->num_detections;
+  meta->detections = gst_tensor_detections_ref (source->detections);
+  return meta;
+}
@@ -0,0 +1,65 @@
+/*
+ * No license installed
+ */
+
+#ifndef __GST_TENSOR_DETECTIONS_META_H__
+#define __GST_TENSOR_DETECTIONS_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TENSOR_DETECTIONS_META_API_TYPE (gst_tensor_detections_meta_api_get_type())
+#define GST_TENSOR_DETECTIONS_META_INFO (gst_tensor_detections_meta_get_info())
+
+/**
+ * @brief One decoded object.
+ *
+ * Coordinates are normalized to the frame (0..1), so they stay valid when the
+ * video is scaled. `label` is the quark of the class label, 0 if the class has
+ * no label.
+ */
+typedef struct _GstTensorDetection
+{
+  gfloat x;
+  gfloat y;
+  gfloat width;
+  gfloat height;
+  GQuark label;
+  guint class_id;
+  gfloat score;
+  guint stream_id; /**< batch entry the object was decoded from */
+  guint track_id;  /**< set by a tracker, 0 if the object is not tracked */
+} GstTensorDetection;
+
+/**
+ * @brief All detections of a buffer in one array.
+ *
+ * The array is allocated once per buffer, sized by
+ * `gst_buffer_add_tensor_detections_meta`, and filled in place by the decoder;
+ * there is no allocation per object. Batched decoders put every stream's
+ * detections in the same array, in stream order.
+ *
+ * Copies of the meta, e.g. onto the video frame a result belongs to, share the
+ * array instead of copying it, so it is read-only once the decoder has pushed
+ * the buffer.
+ */
+typedef struct _GstTensorDetectionsMeta
+{
+  GstMeta meta;
+  guint num_detections;
+  GstTensorDetection *detections;
+} GstTensorDetectionsMeta;
+
+GType gst_tensor_detections_meta_api_get_type (void);
+const GstMetaInfo *gst_tensor_detections_meta_get_info (void);
+
+#define gst_buffer_get_tensor_detections_meta(b) \
+  ((GstTensorDetectionsMeta *) gst_buffer_get_meta ((b), GST_TENSOR_DETECTIONS_META_API_TYPE))
+
+GstTensorDetectionsMeta *gst_buffer_add_tensor_detections_meta (GstBuffer *buffer, guint num_detections);
+GstTensorDetectionsMeta *gst_buffer_add_tensor_detections_meta_shared (GstBuffer *buffer, const GstTensorDetectionsMeta *source);
+
+G_END_DECLS
+
+#endif /* __GST_TENSOR_DETECTIONS_META_H__ */
@@ -0,0 +1,358 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:gsttensordetectionssrc
+ *
+ * Dense detections tensors on an optional request pad of the tensor decoders
+ *
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include "gsttensordetectionssrc.h"
+
+G_DEFINE_TYPE (GstTensorDetectionsPool, gst_tensor_detections_pool, GST_TYPE_BUFFER_POOL);
+
+/**
+ * @brief Allocate a buffer of two memories: the detections table and its count.
+ */
+static GstFlowReturn
+gst_tensor_detections_pool_alloc_buffer (GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params)
+{
+  GstTensorDetectionsPool *self = (GstTensorDetectionsPool *) pool;
+  GstMemory *rows = gst_allocator_alloc (NULL, (gsize) self->max_detections * GST_TENSOR_DETECTION_FIELDS * sizeof (gfloat), NULL);
+  GstMemory *count = gst_allocator_alloc (NULL, sizeof (gfloat), NULL);
+  if (!rows || !count) {
+    if (rows)
+      gst_memory_unref (rows);
+    if (count)
+      gst_memory_unref (count);
+    return GST_FLOW_ERROR;
+  }
+  *buffer = gst_buffer_new ();
+  gst_buffer_append_memory (*buffer, rows);
+  gst_buffer_append_memory (*buffer, count);
+  return GST_FLOW_OK;
+}
+
+static void
+gst_tensor_detections_pool_class_init (GstTensorDetectionsPoolClass *klass)
+{
+  GstBufferPoolClass *pool_class = (GstBufferPoolClass *) klass;
+  pool_class->alloc_buffer = gst_tensor_detections_pool_alloc_buffer;
+}
+
+static void
+gst_tensor_detections_pool_init (GstTensorDetectionsPool *pool)
+{
+  pool->max_detections = 0;
+}
+
+/**
+ * @brief Create an active pool of detections tensors of `max_detections` rows.
+ *
+ * Returns NULL if the pool cannot be configured.
+ */
+GstBufferPool *
+gst_tensor_detections_pool_new (guint max_detections)
+{
+  GstTensorDetectionsPool *pool;
+  GstStructure *config;
+  guint size = (max_detections * GST_TENSOR_DETECTION_FIELDS + 1) * sizeof (gfloat);
+  g_return_val_if_fail (max_detections > 0, NULL);
+  pool = g_object_new (GST_TYPE_TENSOR_DETECTIONS_POOL, NULL);
+  gst_object_ref_sink (pool);
+  pool->max_detections = max_detections;
+  config = gst_buffer_pool_get_config (GST_BUFFER_POOL (pool));
+  /* the size is what the base class checks released buffers against: both memories */
+  gst_buffer_pool_config_set_params (config, NULL, size, 2, 0);
+  if (!gst_buffer_pool_set_config (GST_BUFFER_POOL (pool), config) ||
+      !gst_buffer_pool_set_active (GST_BUFFER_POOL (pool), TRUE)) {
+    gst_object_unref (pool);
+    return NULL;
+  }
+  return GST_BUFFER_POOL (pool);
+}
+
+/**
+ * @brief Initialize the helper of `element`; no pad exists until it is requested.
+ */
+void
+gst_tensor_detections_src_init (GstTensorDetectionsSrc *src, GstElement *element, GstPad *sinkpad, const GstSegment *segment)
+{
+  src->element = element;
+  src->sinkpad = sinkpad;
+  src->segment = segment;
+  src->pad = NULL;
+  src->need_caps = FALSE;
+  src->max_detections = 1;
+  src->fps_n = 0;
+  src->fps_d = 1;
+  src->pool = NULL;
+  src->pool_detections = 0;
+}
+
+/**
+ * @brief Release the pool; the pad itself goes with the element.
+ */
+void
+gst_tensor_detections_src_clear (GstTensorDetectionsSrc *src)
+{
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+  }
+  src->pool_detections = 0;
+}
+
+/**
+ * @brief Create and add the request pad; there is at most one.
+ */
+GstPad *
+gst_tensor_detections_src_request (GstTensorDetectionsSrc *src, GstPadTemplate *templ)
+{
+  GstPad *pad;
+  gboolean taken;
+  GST_OBJECT_LOCK (src->element);
+  taken = src->pad != NULL;
+  GST_OBJECT_UNLOCK (src->element);
+  if (taken) {
+    GST_WARNING_OBJECT (src->element, "Pad %s was already requested", GST_TENSOR_DETECTIONS_SRC_NAME);
+    return NULL;
+  }
+  pad = gst_pad_new_from_template (templ, GST_TENSOR_DETECTIONS_SRC_NAME);
+  gst_pad_use_fixed_caps (pad);
+  if (!gst_element_add_pad (src->element, pad))
+    return NULL;
+  GST_OBJECT_LOCK (src->element);
+  src->pad = pad;
+  src->need_caps = TRUE;
+  GST_OBJECT_UNLOCK (src->element);
+  return pad;
+}
+
+/**
+ * @brief Remove the request pad; a buffer being pushed on it meanwhile is dropped.
+ */
+void
+gst_tensor_detections_src_release (GstTensorDetectionsSrc *src, GstPad *pad)
+{
+  GST_OBJECT_LOCK (src->element);
+  if (pad == src->pad)
+    src->pad = NULL;
+  else
+    pad = NULL;
+  GST_OBJECT_UNLOCK (src->element);
+  if (pad) {
+    gst_pad_set_active (pad, FALSE);
+    gst_element_remove_pad (src->element, pad);
+  }
+}
+
+static void
+gst_tensor_detections_src_renegotiate (GstTensorDetectionsSrc *src)
+{
+  GST_OBJECT_LOCK (src->element);
+  src->need_caps = TRUE;
+  GST_OBJECT_UNLOCK (src->element);
+}
+
+/**
+ * @brief Take the framerate of the decoder's input caps.
+ */
+void
+gst_tensor_detections_src_set_framerate (GstTensorDetectionsSrc *src, const GstCaps *caps)
+{
+  gint fps_n = 0, fps_d = 1;
+  const GstStructure *s = gst_caps_get_structure (caps, 0);
+  if (!gst_structure_get_fraction (s, "framerate", &fps_n, &fps_d)) {
+    fps_n = 0;
+    fps_d = 1;
+  }
+  if (fps_n != src->fps_n || fps_d != src->fps_d) {
+    src->fps_n = fps_n;
+    src->fps_d = fps_d;
+    gst_tensor_detections_src_renegotiate (src);
+  }
+}
+
+/**
+ * @brief Set the rows of the detections tensor: the most detections a buffer can carry.
+ */
+void
+gst_tensor_detections_src_set_max_detections (GstTensorDetectionsSrc *src, guint max_detections)
+{
+  max_detections = MAX (max_detections, 1);
+  if (max_detections != src->max_detections) {
+    src->max_detections = max_detections;
+    gst_tensor_detections_src_renegotiate (src);
+  }
+}
+
+static GstPad *
+gst_tensor_detections_src_get_pad (GstTensorDetectionsSrc *src, gboolean *need_caps)
+{
+  GstPad *pad;
+  GST_OBJECT_LOCK (src->element);
+  pad = src->pad ? gst_object_ref (src->pad) : NULL;
+  *need_caps = src->need_caps;
+  GST_OBJECT_UNLOCK (src->element);
+  return pad;
+}
+
+/**
+ * @brief Send stream-start (once), the caps for the current layout and the segment.
+ */
+static void
+gst_tensor_detections_src_start (GstTensorDetectionsSrc *src, GstPad *pad)
+{
+  GstEvent *event;
+  GstCaps *caps;
+  gchar *dims;
+  GST_OBJECT_LOCK (src->element);
+  src->need_caps = FALSE;
+  GST_OBJECT_UNLOCK (src->element);
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_STREAM_START, 0);
+  if (event) {
+    gst_event_unref (event);
+  } else {
+    gchar *stream_id = gst_pad_create_stream_id (pad, src->element, GST_TENSOR_DETECTIONS_SRC_NAME);
+    GstEvent *upstream = gst_pad_get_sticky_event (src->sinkpad, GST_EVENT_STREAM_START, 0);
+    guint group_id;
+    event = gst_event_new_stream_start (stream_id);
+    if (upstream && gst_event_parse_group_id (upstream, &group_id))
+      gst_event_set_group_id (event, group_id);
+    if (upstream)
+      gst_event_unref (upstream);
+    g_free (stream_id);
+    gst_pad_push_event (pad, event);
+  }
+  dims = g_strdup_printf ("%u:%u:1:1,1:1:1:1", GST_TENSOR_DETECTION_FIELDS, src->max_detections);
+  caps = gst_caps_new_simple ("other/tensors",
+      "num_tensors", G_TYPE_INT, 2,
+      "types", G_TYPE_STRING, "float32,float32",
+      "dimensions", G_TYPE_STRING, dims,
+      "framerate", GST_TYPE_FRACTION, src->fps_n, src->fps_d,
+      NULL);
+  g_free (dims);
+  GST_DEBUG_OBJECT (src->element, "Detections caps %" GST_PTR_FORMAT, caps);
+  gst_pad_push_event (pad, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  gst_pad_push_event (pad, gst_event_new_segment (src->segment));
+}
+
+/**
+ * @brief Forward a sink event of the decoder, in stream order with the buffers.
+ *
+ * Only flushing, segment and EOS apply to the detections stream. The event is
+ * not taken.
+ */
+void
+gst_tensor_detections_src_push_event (GstTensorDetectionsSrc *src, GstEvent *event)
+{
+  GstPad *pad;
+  gboolean need_caps;
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_SEGMENT:
+    case GST_EVENT_EOS:
+      break;
+    default:
+      return;
+  }
+  pad = gst_tensor_detections_src_get_pad (src, &need_caps);
+  if (!pad)
+    return;
+  if (need_caps && GST_EVENT_TYPE (event) != GST_EVENT_EOS) {
+    /* the start sequence carries the latest segment anyway */
+    gst_object_unref (pad);
+    return;
+  }
+  if (need_caps)
+    gst_tensor_detections_src_start (src, pad);
+  gst_pad_push_event (pad, gst_event_ref (event));
+  gst_object_unref (pad);
+}
+
+/**
+ * @brief Write the rows of `meta` (may be NULL) into a pooled buffer, zeroing the unused ones.
+ */
+static gboolean
+gst_tensor_detections_src_fill (GstTensorDetectionsSrc *src, GstBuffer *out, const GstTensorDetectionsMeta *meta)
+{
+  GstMapInfo rows_info, count_info;
+  GstMemory *rows_mem = gst_buffer_peek_memory (out, 0);
+  GstMemory *count_mem = gst_buffer_peek_memory (out, 1);
+  guint n = meta ? MIN (meta->num_detections, src->max_detections) : 0, i;
+  gfloat *row;
+  if (!gst_memory_map (rows_mem, &rows_info, GST_MAP_WRITE))
+    return FALSE;
+  if (!gst_memory_map (count_mem, &count_info, GST_MAP_WRITE)) {
+    gst_memory_unmap (rows_mem, &rows_info);
+    return FALSE;
+  }
+  if (meta && meta->num_detections > n)
+    GST_DEBUG_OBJECT (src->element, "Dropping %u detections past the %u rows of the tensor",
+        meta->num_detections - n, src->max_detections);
+  row = (gfloat *) rows_info.data;
+  for (i = 0; i < n; i++, row += GST_TENSOR_DETECTION_FIELDS) {
+    const GstTensorDetection *d = &meta->detections[i];
+    row[0] = d->x;
+    row[1] = d->y;
+    row[2] = d->width;
+    row[3] = d->height;
+    row[4] = d->score;
+    row[5] = (gfloat) d->class_id;
+    row[6] = (gfloat) d->stream_id;
+  }
+  memset (row, 0, (gsize) (src->max_detections - n) * GST_TENSOR_DETECTION_FIELDS * sizeof (gfloat));
+  *(gfloat *) count_info.data = (gfloat) n;
+  gst_memory_unmap (count_mem, &count_info);
+  gst_memory_unmap (rows_mem, &rows_info);
+  return TRUE;
+}
+
+/**
+ * @brief Push the detections of a decoded buffer, if the pad was requested.
+ *
+ * The output takes the timestamps of `inbuf`. Only errors are returned: an
+ * unlinked, flushing or finished detections branch does not stop the decoder.
+ */
+GstFlowReturn
+gst_tensor_detections_src_push (GstTensorDetectionsSrc *src, GstBuffer *inbuf)
+{
+  GstPad *pad;
+  GstBuffer *out = NULL;
+  gboolean need_caps;
+  GstFlowReturn ret;
+  pad = gst_tensor_detections_src_get_pad (src, &need_caps);
+  if (!pad)
+    return GST_FLOW_OK;
+  if (!src->pool || src->pool_detections != src->max_detections) {
+    gst_tensor_detections_src_clear (src);
+    src->pool = gst_tensor_detections_pool_new (src->max_detections);
+    if (!src->pool) {
+      GST_ERROR_OBJECT (src->element, "Failed to create a pool of %u-row detections tensors", src->max_detections);
+      gst_object_unref (pad);
+      return GST_FLOW_ERROR;
+    }
+    src->pool_detections = src->max_detections;
+  }
+  if (need_caps)
+    gst_tensor_detections_src_start (src, pad);
+  ret = gst_buffer_pool_acquire_buffer (src->pool, &out, NULL);
+  if (ret == GST_FLOW_OK && !gst_tensor_detections_src_fill (src, out, gst_buffer_get_tensor_detections_meta (inbuf))) {
+    GST_ERROR_OBJECT (src->element, "Failed to map a detections tensor");
+    gst_buffer_unref (out);
+    ret = GST_FLOW_ERROR;
+  } else if (ret == GST_FLOW_OK) {
+    gst_buffer_copy_into (out, inbuf, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    ret = gst_pad_push (pad, out);
+  }
+  gst_object_unref (pad);
+  return ret < GST_FLOW_EOS ? ret : GST_FLOW_OK;
+}
@@ -0,0 +1,73 @@
+/*
+ * No license installed
+ */
+
+#ifndef __GST_TENSOR_DETECTIONS_SRC_H__
+#define __GST_TENSOR_DETECTIONS_SRC_H__
+
+#include <gst/gst.h>
+#include "gsttensordetectionsmeta.h"
+
+G_BEGIN_DECLS
+
+#define GST_TENSOR_DETECTIONS_SRC_NAME "detections_src"
+#define GST_TENSOR_DETECTIONS_SRC_CAPS "other/tensors"
+#define GST_TENSOR_DETECTION_FIELDS 7 /* x, y, width, height, score, class, stream */
+
+#define GST_TYPE_TENSOR_DETECTIONS_POOL (gst_tensor_detections_pool_get_type())
+
+/**
+ * @brief Buffer pool of dense detections tensors.
+ *
+ * Each buffer holds two memories, one per tensor as NNStreamer expects: a
+ * float32 table of `max_detections` rows of GST_TENSOR_DETECTION_FIELDS, and
+ * a float32 count of its valid rows.
+ */
+typedef struct _GstTensorDetectionsPool
+{
+  GstBufferPool pool;
+  guint max_detections;
+} GstTensorDetectionsPool;
+
+typedef struct _GstTensorDetectionsPoolClass
+{
+  GstBufferPoolClass parent_class;
+} GstTensorDetectionsPoolClass;
+
+/**
+ * @brief Optional `detections_src` request pad of a decoder.
+ *
+ * The decoder hands its serialized sink events and every decoded buffer to
+ * this helper, which turns the buffer's GstTensorDetectionsMeta into a pooled
+ * detections tensor. `pad` and `need_caps` are protected by the element's
+ * object lock; the rest belongs to the streaming thread.
+ */
+typedef struct _GstTensorDetectionsSrc
+{
+  GstElement *element;        /**< owner, not referenced */
+  GstPad *sinkpad;            /**< owner's sink pad, for the upstream group id */
+  const GstSegment *segment;  /**< owner's input segment */
+  GstPad *pad;                /**< NULL until requested */
+  gboolean need_caps;         /**< stream-start, caps and segment go out before the next buffer */
+  guint max_detections;       /**< rows of the detections tensor */
+  gint fps_n;
+  gint fps_d;
+  GstBufferPool *pool;        /**< sized for `pool_detections` rows */
+  guint pool_detections;
+} GstTensorDetectionsSrc;
+
+GType gst_tensor_detections_pool_get_type (void);
+GstBufferPool *gst_tensor_detections_pool_new (guint max_detections);
+
+void gst_tensor_detections_src_init (GstTensorDetectionsSrc *src, GstElement *element, GstPad *sinkpad, const GstSegment *segment);
+void gst_tensor_detections_src_clear (GstTensorDetectionsSrc *src);
+GstPad *gst_tensor_detections_src_request (GstTensorDetectionsSrc *src, GstPadTemplate *templ);
+void gst_tensor_detections_src_release (GstTensorDetectionsSrc *src, GstPad *pad);
+void gst_tensor_detections_src_set_framerate (GstTensorDetectionsSrc *src, const GstCaps *caps);
+void gst_tensor_detections_src_set_max_detections (GstTensorDetectionsSrc *src, guint max_detections);
+void gst_tensor_detections_src_push_event (GstTensorDetectionsSrc *src, GstEvent *event);
+GstFlowReturn gst_tensor_detections_src_push (GstTensorDetectionsSrc *src, GstBuffer *inbuf);
+
+G_END_DECLS
+
+#endif /* __GST_TENSOR_DETECTIONS_SRC_H__ */
@@ -0,0 +1,168 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:gsttensorsegmapmeta
+ *
+ * Per-buffer class-index maps attached by the segmentation decoder, and the pool they come from
+ *
+ */
+
+#include <gst/gst.h>
+#include "gsttensorsegmapmeta.h"
+
+#define GST_TENSOR_SEGMAP_META_API_NAME "GstTensorSegmapMetaAPI"
+#define GST_TENSOR_SEGMAP_META_IMPL_NAME "GstTensorSegmapMeta"
+
+G_DEFINE_TYPE (GstTensorSegmapPool, gst_tensor_segmap_pool, GST_TYPE_BUFFER_POOL);
+
+/**
+ * @brief Register the meta API, or return the one already registered.
+ *
+ * As for the detections meta, this file may be linked into a process more
+ * than once, and every copy must share one API type.
+ */
+GType
+gst_tensor_segmap_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  if (g_once_init_enter (&type)) {
+    static const gchar *tags[] = { NULL }; /* the map keeps the model's resolution whatever the video does */
+    GType api = g_type_from_name (GST_TENSOR_SEGMAP_META_API_NAME);
+    if (!api)
+      api = gst_meta_api_type_register (GST_TENSOR_SEGMAP_META_API_NAME, tags);
+    g_once_init_leave (&type, api);
+  }
+  return type;
+}
+
+static gboolean
+gst_tensor_segmap_meta_init (GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+  GstTensorSegmapMeta *smeta = (GstTensorSegmapMeta *) meta;
+  smeta->width = smeta->height = smeta->num_classes = 0;
+  smeta->map = NULL;
+  return TRUE;
+}
+
+static void
+gst_tensor_segmap_meta_free (GstMeta *meta, GstBuffer *buffer)
+{
+  GstTensorSegmapMeta *smeta = (GstTensorSegmapMeta *) meta;
+  gst_buffer_replace (&smeta->map, NULL);
+}
+
+static gboolean
+gst_tensor_segmap_meta_transform (GstBuffer *dest, GstMeta *meta, GstBuffer *buffer, GQuark type, gpointer data)
+{
+  GstTensorSegmapMeta *smeta = (GstTensorSegmapMeta *) meta;
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+  return gst_buffer_add_tensor_segmap_meta (dest, smeta->map, smeta->width, smeta->height, smeta->num_classes) != NULL;
+}
+
+/**
+ * @brief Register the meta implementation, or return the one already registered.
+ */
+const GstMetaInfo *
+gst_tensor_segmap_meta_get_info (void)
+{
+  static const GstMetaInfo *info = NULL;
+  if (g_once_init_enter (&info)) {
+    const GstMetaInfo *meta = gst_meta_get_info (GST_TENSOR_SEGMAP_META_IMPL_NAME);
+    if (!meta)
+      meta = gst_meta_register (GST_TENSOR_SEGMAP_META_API_TYPE, GST_TENSOR_SEGMAP_META_IMPL_NAME,
+          sizeof (GstTensorSegmapMeta), gst_tensor_segmap_meta_init,
+          gst_tensor_segmap_meta_free, gst_tensor_segmap_meta_transform);
+    g_once_init_leave (&info, meta);
+  }
+  return info;
+}
+
+/**
+ * @brief Attach a segmentation map of `width` x `height` pixels of `num_classes` classes.
+ *
+ * The meta takes a reference to `map`. Returns NULL on failure.
+ */
+GstTensorSegmapMeta *
+gst_buffer_add_tensor_segmap_meta (GstBuffer *buffer, GstBuffer *map, guint width, guint height, guint num_classes)
+{
+  GstTensorSegmapMeta *meta;
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (GST_IS_BUFFER (map), NULL);
+  meta = (GstTensorSegmapMeta *) gst_buffer_add_meta (buffer, GST_TENSOR_SEGMAP_META_INFO, NULL);
+  if (!meta)
+    return NULL;
+  meta->width = width;
+  meta->height = height;
+  meta->num_classes = num_classes;
+  meta->map = gst_buffer_ref (map);
+  return meta;
+}
+
+/**
+ * @brief Allocate a buffer of the class-index memory and, if asked for, the confidence memory.
+ */
+static GstFlowReturn
+gst_tensor_segmap_pool_alloc_buffer (GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params)
+{
+  GstTensorSegmapPool *self = (GstTensorSegmapPool *) pool;
+  GstMemory *classes = gst_allocator_alloc (NULL, self->num_pixels, NULL);
+  GstMemory *confidence = NULL;
+  if (self->confidence)
+    confidence = gst_allocator_alloc (NULL, (gsize) self->num_pixels * sizeof (gfloat), NULL);
+  if (!classes || (self->confidence && !confidence)) {
+    if (classes)
+      gst_memory_unref (classes);
+    if (confidence)
+      gst_memory_unref (confidence);
+    return GST_FLOW_ERROR;
+  }
+  *buffer = gst_buffer_new ();
+  gst_buffer_append_memory (*buffer, classes);
+  if (confidence)
+    gst_buffer_append_memory (*buffer, confidence);
+  return GST_FLOW_OK;
+}
+
+static void
+gst_tensor_segmap_pool_class_init (GstTensorSegmapPoolClass *klass)
+{
+  GstBufferPoolClass *pool_class = (GstBufferPoolClass *) klass;
+  pool_class->alloc_buffer = gst_tensor_segmap_pool_alloc_buffer;
+}
+
+static void
+gst_tensor_segmap_pool_init (GstTensorSegmapPool *pool)
+{
+  pool->num_pixels = 0;
+  pool->confidence = FALSE;
+}
+
+/**
+ * @brief Create an active pool of segmentation maps of `num_pixels` pixels, with confidence if `confidence`.
+ *
+ * Returns NULL if the pool cannot be configured.
+ */
+GstBufferPool *
+gst_tensor_segmap_pool_new (guint num_pixels, gboolean confidence)
+{
+  GstTensorSegmapPool *pool;
+  GstStructure *config;
+  guint size = num_pixels * (confidence ? 1 + sizeof (gfloat) : 1);
+  g_return_val_if_fail (num_pixels > 0, NULL);
+  pool = g_object_new (GST_TYPE_TENSOR_SEGMAP_POOL, NULL);
+  gst_object_ref_sink (pool);
+  pool->num_pixels = num_pixels;
+  pool->confidence = confidence;
+  config = gst_buffer_pool_get_config (GST_BUFFER_POOL (pool));
+  /* the size is what the base class checks released buffers against: every memory */
+  gst_buffer_pool_config_set_params (config, NULL, size, 2, 0);
+  if (!gst_buffer_pool_set_config (GST_BUFFER_POOL (pool), config) ||
+      !gst_buffer_pool_set_active (GST_BUFFER_POOL (pool), TRUE)) {
+    gst_object_unref (pool);
+    return NULL;
+  }
+  return GST_BUFFER_POOL (pool);
+}
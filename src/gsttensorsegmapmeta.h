@@ -0,0 +1,65 @@
+/*
+ * No license installed
+ */
+
+#ifndef __GST_TENSOR_SEGMAP_META_H__
+#define __GST_TENSOR_SEGMAP_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TENSOR_SEGMAP_META_API_TYPE (gst_tensor_segmap_meta_api_get_type())
+#define GST_TENSOR_SEGMAP_META_INFO (gst_tensor_segmap_meta_get_info())
+
+#define GST_TYPE_TENSOR_SEGMAP_POOL (gst_tensor_segmap_pool_get_type())
+
+/**
+ * @brief Decoded segmentation map of a buffer.
+ *
+ * `map` holds one memory of `width` x `height` uint8 class indices, row-major
+ * at the model's resolution, and, when the decoder was asked for confidence,
+ * a second memory of as many float32 scores of those classes. Copies of the
+ * meta share `map`, which is read-only once the decoder has pushed the buffer.
+ */
+typedef struct _GstTensorSegmapMeta
+{
+  GstMeta meta;
+  guint width;
+  guint height;
+  guint num_classes;
+  GstBuffer *map;
+} GstTensorSegmapMeta;
+
+/**
+ * @brief Buffer pool of segmentation maps of `num_pixels` pixels.
+ *
+ * Each buffer holds the class-index memory and, with `confidence`, the
+ * confidence memory, as NNStreamer expects one memory per tensor.
+ */
+typedef struct _GstTensorSegmapPool
+{
+  GstBufferPool pool;
+  guint num_pixels;
+  gboolean confidence;
+} GstTensorSegmapPool;
+
+typedef struct _GstTensorSegmapPoolClass
+{
+  GstBufferPoolClass parent_class;
+} GstTensorSegmapPoolClass;
+
+GType gst_tensor_segmap_meta_api_get_type (void);
+const GstMetaInfo *gst_tensor_segmap_meta_get_info (void);
+
+#define gst_buffer_get_tensor_segmap_meta(b) \
+  ((GstTensorSegmapMeta *) gst_buffer_get_meta ((b), GST_TENSOR_SEGMAP_META_API_TYPE))
+
+GstTensorSegmapMeta *gst_buffer_add_tensor_segmap_meta (GstBuffer *buffer, GstBuffer *map, guint width, guint height, guint num_classes);
+
+GType gst_tensor_segmap_pool_get_type (void);
+GstBufferPool *gst_tensor_segmap_pool_new (guint num_pixels, gboolean confidence);
+
+G_END_DECLS
+
+#endif /* __GST_TENSOR_SEGMAP_META_H__ */
@@ -9,148 +9,3281 @@
  *
  */
 
+#include <float.h>
 #include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include <gst/gst.h>
+#include <glib/gstdio.h>
 #include "libtensordecode.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief `qsort` callback: Compare score of detected objects in descending order.
+ */
+static gint
+compare_detection_scores (const void *A, const void *B)
+{
+  const DetectedObject *a = (DetectedObject *)A, *b = (DetectedObject *)B;
+  if (a->score > b->score)
+    return -1;
+  else if(a->score < b->score)
+    return 1;
+  else
+    return 0;
+}
+
+#define NMS_GRID 16 /* cells per axis of the spatial grid */
+#define NMS_NONE G_MAXUINT
+
+/**
+ * @brief A candidate as seen by the NMS engine, with its box in float corners.
+ */
+typedef struct _NmsEntry
+{
+  gfloat score;
+  guint index; /**< position in the caller's detections array */
+  gfloat x0, y0, x1, y1;
+} NmsEntry;
+
+struct _NmsEngine
+{
+  guint capacity;        /**< most candidates per run */
+  NmsEntry *entries;     /**< candidates grouped by class, best first within a class */
+  guint *next;           /**< per entry: next kept entry in the same grid cell */
+  guint8 *keep;          /**< per detection: survived NMS */
+  guint class_capacity;  /**< class ids are below class_capacity - 1 */
+  guint *class_start;    /**< first entry of each class bucket */
+  guint *class_end;      /**< one past the last selected entry of each class bucket */
+  guint max_detections;  /**< global top-K before NMS; 0 = unlimited */
+  guint max_per_class;   /**< per-class top-K before NMS; 0 = unlimited */
+  guint heap_capacity;
+  NmsEntry *heap;        /**< scratch for the global top-K selection */
+  guint cell_head[NMS_GRID * NMS_GRID]; /**< first kept entry of each grid cell */
+};
+
+/**
+ * @brief `qsort` callback: Compare score of NMS entries in descending order.
+ */
+static gint
+compare_entry_scores (const void *A, const void *B)
+{
+  const NmsEntry *a = (NmsEntry *)A, *b = (NmsEntry *)B;
+  if (a->score > b->score)
+    return -1;
+  else if(a->score < b->score)
+    return 1;
+  else
+    return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+/**
+ * @brief Order of the top-K heaps: `a` ranks below `b`.
+ */
+static inline gboolean
+entry_worse (const NmsEntry *a, const NmsEntry *b)
+{
+  return compare_entry_scores (a, b) > 0;
+}
+
+/**
+ * @brief Restore the heap property below `i` in a heap that keeps its worst entry at the root.
+ */
+static void
+heap_sift_down (NmsEntry *heap, guint n, guint i)
+{
+  for (;;) {
+    guint l = 2 * i + 1, r = l + 1, worst = i;
+    NmsEntry tmp;
+    if (l < n && entry_worse (&heap[l], &heap[worst]))
+      worst = l;
+    if (r < n && entry_worse (&heap[r], &heap[worst]))
+      worst = r;
+    if (worst == i)
+      return;
+    tmp = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = tmp;
+    i = worst;
+  }
+}
+
+/**
+ * @brief Turn the first `n` entries of `heap` into a heap with the worst entry at the root.
+ */
+static void
+heap_build (NmsEntry *heap, guint n)
+{
+  guint i = n / 2;
+  while (i-- > 0)
+    heap_sift_down (heap, n, i);
+}
+
+/**
+ * @brief Offer `e` to a full top-K heap; it replaces the root if it ranks above it.
+ */
+static inline void
+heap_offer (NmsEntry *heap, guint k, const NmsEntry *e)
+{
+  if (entry_worse (&heap[0], e)) {
+    heap[0] = *e;
+    heap_sift_down (heap, k, 0);
+  }
+}
+
+/**
+ * @brief Intersection of union
+ */
+static gfloat
+iou (const NmsEntry *a, const NmsEntry *b)
+{
+  gfloat w = MIN (a->x1, b->x1) - MAX (a->x0, b->x0);
+  gfloat h = MIN (a->y1, b->y1) - MAX (a->y0, b->y0);
+  gfloat inter, o;
+  if (w <= 0.f || h <= 0.f)
+    return 0.f;
+  inter = w * h;
+  o = inter / ((a->x1 - a->x0) * (a->y1 - a->y0) + (b->x1 - b->x0) * (b->y1 - b->y0) - inter);
+  GST_DEBUG("IOU = %e; %e x %e", o, w, h);
+  return o;
+}
+
+/**
+ * @brief Grid cell along one axis holding coordinate `v` (in 0..UINT_MAX units).
+ */
+static inline guint
+nms_cell (gfloat v)
+{
+  return (guint) CLAMP (v * ((gfloat) NMS_GRID / 4294967296.f), 0.f, NMS_GRID - 1.f);
+}
+
+/**
+ * @brief Create an NMS engine for up to `capacity` candidates with class ids below `num_classes`.
+ *
+ * All scratch memory is allocated here, so runs never allocate.
+ */
+NmsEngine *
+nms_engine_new (guint capacity, guint num_classes)
+{
+  NmsEngine *nms = g_new0 (NmsEngine, 1);
+  nms->capacity = MAX (capacity, 1);
+  nms->entries = g_new (NmsEntry, nms->capacity);
+  nms->next = g_new (guint, nms->capacity);
+  nms->keep = g_new (guint8, nms->capacity);
+  nms->class_capacity = num_classes + 1;
+  nms->class_start = g_new (guint, nms->class_capacity);
+  nms->class_end = g_new (guint, nms->class_capacity);
+  nms_engine_set_limits (nms, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+  return nms;
+}
+
+/**
+ * @brief Free an NMS engine.
+ */
+void
+nms_engine_free (NmsEngine *nms)
+{
+  if (!nms)
+    return;
+  g_free (nms->entries);
+  g_free (nms->next);
+  g_free (nms->keep);
+  g_free (nms->class_start);
+  g_free (nms->class_end);
+  g_free (nms->heap);
+  g_free (nms);
+}
+
+/**
+ * @brief Bound the candidates NMS looks at: the best `max_detections` overall
+ * and the best `max_per_class` within each class (0 disables a limit).
+ *
+ * Not to be called while the engine runs; this sizes the selection heap.
+ */
+void
+nms_engine_set_limits (NmsEngine *nms, guint max_detections, guint max_per_class)
+{
+  guint heap_capacity = MIN (max_detections, nms->capacity);
+  nms->max_detections = max_detections;
+  nms->max_per_class = max_per_class;
+  if (heap_capacity > nms->heap_capacity) {
+    nms->heap_capacity = heap_capacity;
+    nms->heap = g_renew (NmsEntry, nms->heap, nms->heap_capacity);
+  }
+}
+
+/**
+ * @brief Shrink the class buckets to their top `max_per_class` entries, then all of them to the global top `max_detections`.
+ *
+ * Both selections use bounded heaps, so this costs O(n log K) rather than a full sort.
+ * Ties are broken by position in the caller's detections, i.e. anchor order.
+ */
+static void
+nms_select_top_k (NmsEngine *nms, guint num_classes)
+{
+  guint c, i, k = 0, total = 0;
+  for (c = 0; c < num_classes; c++) {
+    guint first = nms->class_start[c], n = nms->class_end[c] - first;
+    if (nms->max_per_class && n > nms->max_per_class) {
+      NmsEntry *bucket = &nms->entries[first];
+      heap_build (bucket, nms->max_per_class);
+      for (i = nms->max_per_class; i < n; i++)
+        heap_offer (bucket, nms->max_per_class, &bucket[i]);
+      nms->class_end[c] = first + nms->max_per_class;
+    }
+    total += nms->class_end[c] - first;
+  }
+  if (!nms->max_detections || total <= nms->max_detections)
+    return;
+  /* The root of a full top-K heap is the K-th best entry. Equal scores rank in
+   * detection order, so a tie at the K-th score keeps exactly K entries */
+  for (c = 0; c < num_classes; c++) {
+    for (i = nms->class_start[c]; i < nms->class_end[c]; i++) {
+      if (k < nms->max_detections) {
+        nms->heap[k++] = nms->entries[i];
+        if (k == nms->max_detections)
+          heap_build (nms->heap, k);
+      } else {
+        heap_offer (nms->heap, k, &nms->entries[i]);
+      }
+    }
+  }
+  for (c = 0; c < num_classes; c++) {
+    guint end = nms->class_start[c];
+    for (i = nms->class_start[c]; i < nms->class_end[c]; i++)
+      if (!entry_worse (&nms->entries[i], &nms->heap[0]))
+        nms->entries[end++] = nms->entries[i];
+    nms->class_end[c] = end;
+  }
+}
+
+/**
+ * @brief Greedy NMS over one class bucket, best candidate first.
+ *
+ * Kept boxes are filed under the grid cell of their centre, so a candidate
+ * only has to be tested against the cells its box, grown by the largest kept
+ * half-extent, can reach.
+ */
+static void
+nms_bucket (NmsEngine *nms, guint first, guint last, gfloat iou_threshold)
+{
+  gfloat max_hw = 0.f, max_hh = 0.f;
+  guint k;
+  memset (nms->cell_head, 0xff, sizeof (nms->cell_head));
+  for (k = first; k < last; k++) {
+    const NmsEntry *q = &nms->entries[k];
+    gfloat hw = (q->x1 - q->x0) / 2.f, hh = (q->y1 - q->y0) / 2.f;
+    guint cx, cy, cx0 = 0, cy0 = 0, cx1 = NMS_GRID - 1, cy1 = NMS_GRID - 1, j, cell;
+    if (iou_threshold >= 0.f) {
+      cx0 = nms_cell (q->x0 - max_hw);
+      cx1 = nms_cell (q->x1 + max_hw);
+      cy0 = nms_cell (q->y0 - max_hh);
+      cy1 = nms_cell (q->y1 + max_hh);
+    }
+    for (cy = cy0; cy <= cy1; cy++)
+      for (cx = cx0; cx <= cx1; cx++)
+        for (j = nms->cell_head[cy * NMS_GRID + cx]; j != NMS_NONE; j = nms->next[j])
+          if (iou (q, &nms->entries[j]) > iou_threshold)
+            goto suppressed;
+    nms->keep[q->index] = TRUE;
+    cell = nms_cell (q->y0 + hh) * NMS_GRID + nms_cell (q->x0 + hw);
+    nms->next[k] = nms->cell_head[cell];
+    nms->cell_head[cell] = k;
+    max_hw = MAX (max_hw, hw);
+    max_hh = MAX (max_hh, hh);
+suppressed:
+    ;
+  }
+}
+
+/**
+ * @brief Bucket `detections` by class with a counting sort and cut the buckets down to the top-K limits.
+ * @return number of classes, or 0 if the candidates do not fit the engine.
+ */
+static guint
+nms_engine_select_buckets (NmsEngine *nms, const DetectedObject *detections, guint num_detections)
+{
+  guint i, c, num_classes = 0;
+  for (i = 0; i < num_detections; i++)
+    num_classes = MAX (num_classes, detections[i].class_id + 1);
+  g_return_val_if_fail (num_detections <= nms->capacity && num_classes < nms->class_capacity, 0);
+  /* Bucket by class */
+  memset (nms->class_start, 0, (num_classes + 1) * sizeof (guint));
+  for (i = 0; i < num_detections; i++)
+    nms->class_start[detections[i].class_id + 1]++;
+  for (c = 0; c < num_classes; c++)
+    nms->class_start[c + 1] += nms->class_start[c];
+  for (i = 0; i < num_detections; i++) {
+    const DetectedObject *d = &detections[i];
+    NmsEntry *e = &nms->entries[nms->class_start[d->class_id]++];
+    e->score = d->score;
+    e->index = i;
+    e->x0 = (gfloat) d->x;
+    e->y0 = (gfloat) d->y;
+    e->x1 = (gfloat) d->x + d->width;
+    e->y1 = (gfloat) d->y + d->height;
+  }
+  /* `class_start` now holds bucket ends; shift it back to bucket starts */
+  memcpy (nms->class_end, nms->class_start, num_classes * sizeof (guint));
+  memmove (nms->class_start + 1, nms->class_start, num_classes * sizeof (guint));
+  nms->class_start[0] = 0;
+  nms_select_top_k (nms, num_classes);
+  return num_classes;
+}
+
+/**
+ * @brief Compact `detections` to the front, in the order given, keeping the entries flagged in `keep`.
+ * @return number of entries kept.
+ */
+static guint
+nms_engine_compact (const NmsEngine *nms, DetectedObject *detections, guint num_detections)
+{
+  guint i, num_kept = 0;
+  for (i = 0; i < num_detections; i++) {
+    if (!nms->keep[i])
+      continue;
+    if (num_kept != i)
+      detections[num_kept] = detections[i];
+    num_kept++;
+  }
+  return num_kept;
+}
+
+/**
+ * @brief Drop the candidates that the top-K limits would never let reach NMS.
+ *
+ * The survivors stay in their original order. Selecting again after adding
+ * candidates gives the same result as selecting once from all of them, so a
+ * bounded buffer can be pruned each time it fills up.
+ * @return number of remaining detections.
+ */
+guint
+nms_engine_select (NmsEngine *nms, DetectedObject *detections, guint num_detections)
+{
+  guint i, c, num_classes = nms_engine_select_buckets (nms, detections, num_detections);
+  if (!num_classes)
+    return 0;
+  memset (nms->keep, 0, num_detections);
+  for (c = 0; c < num_classes; c++)
+    for (i = nms->class_start[c]; i < nms->class_end[c]; i++)
+      nms->keep[nms->entries[i].index] = TRUE;
+  return nms_engine_compact (nms, detections, num_detections);
+}
+
+/**
+ * @brief NMS (non-maximum suppression)
+ *
+ * Candidates are bucketed by class with a counting sort and cut down to the
+ * top-K limits set with `nms_engine_set_limits`. Each bucket is then sorted
+ * by score and suppressed against nearby kept boxes only. Survivors are then
+ * compacted to the front of `detections` in one pass and ordered by score.
+ * @return number of surviving detections.
+ */
+guint
+nms_engine_run (NmsEngine *nms, DetectedObject *detections, guint num_detections, gfloat iou_threshold)
+{
+  guint c, num_classes = nms_engine_select_buckets (nms, detections, num_detections), num_kept;
+  if (!num_classes)
+    return 0;
+  memset (nms->keep, 0, num_detections);
+  for (c = 0; c < num_classes; c++) {
+    guint first = nms->class_start[c], last = nms->class_end[c];
+    if (first == last)
+      continue;
+    qsort (&nms->entries[first], last - first, sizeof (NmsEntry), compare_entry_scores);
+    nms_bucket (nms, first, last, iou_threshold);
+  }
+  /* Single-pass compaction of survivors */
+  num_kept = nms_engine_compact (nms, detections, num_detections);
+  qsort (detections, num_kept, sizeof (DetectedObject), compare_detection_scores);
+  return num_kept;
+}
+
+/**
+ * @brief Allocate `size` bytes on a `DECODE_ALIGNMENT` boundary. Release with `free`.
+ */
+static gpointer
+aligned_alloc_bytes (gsize size)
+{
+  gpointer mem = NULL;
+  if (posix_memalign (&mem, DECODE_ALIGNMENT, size) != 0)
+    return NULL;
+  return mem;
+}
+
+/**
+ * @brief Size of the L2 cache of the processors, or DECODE_L2_CACHE_SIZE if unknown.
+ */
+static gsize
+l2_cache_size (void)
+{
+  static gsize size = 0;
+  if (g_once_init_enter (&size)) {
+    glong l2 = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2 = sysconf (_SC_LEVEL2_CACHE_SIZE);
+#endif
+    g_once_init_leave (&size, l2 > 0 ? (gsize) l2 : DECODE_L2_CACHE_SIZE);
+  }
+  return size;
+}
+
+/**
+ * @brief Prefetch the `size` bytes at `data` for reading.
+ */
+static inline void
+prefetch_range (gconstpointer data, gsize size)
+{
+#ifdef __GNUC__
+  const gchar *p = data, *end = p + size;
+  for (; p < end; p += DECODE_ALIGNMENT)
+    __builtin_prefetch (p, 0, 3);
+#endif
+}
+
+/**
+ * @brief Size in bytes of one element of `type`; 0 if unknown.
+ */
+gsize
+tensor_type_size (tensor_type type)
+{
+  switch (type) {
+    case _NNS_INT8:
+    case _NNS_UINT8:
+      return 1;
+    case _NNS_INT16:
+    case _NNS_UINT16:
+      return 2;
+    case _NNS_INT32:
+    case _NNS_UINT32:
+    case _NNS_FLOAT32:
+      return 4;
+    case _NNS_INT64:
+    case _NNS_UINT64:
+    case _NNS_FLOAT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief NNStreamer type names, as they appear in tensor caps.
+ */
+static const struct { const gchar *name; tensor_type type; } tensor_type_names[] = {
+  { "int32", _NNS_INT32 }, { "uint32", _NNS_UINT32 },
+  { "int16", _NNS_INT16 }, { "uint16", _NNS_UINT16 },
+  { "int8", _NNS_INT8 }, { "uint8", _NNS_UINT8 },
+  { "float64", _NNS_FLOAT64 }, { "float32", _NNS_FLOAT32 },
+  { "int64", _NNS_INT64 }, { "uint64", _NNS_UINT64 },
+};
+
+/**
+ * @brief Map an NNStreamer type name (e.g. "float32") to its `tensor_type`.
+ */
+static tensor_type
+tensor_type_from_string (const gchar *name)
+{
+  guint i;
+  for (i = 0; i < G_N_ELEMENTS (tensor_type_names); i++)
+    if (g_str_equal (name, tensor_type_names[i].name))
+      return tensor_type_names[i].type;
+  return _NNS_END;
+}
+
+/**
+ * @brief NNStreamer name of `type` (e.g. "float32"); NULL if unknown.
+ */
+const gchar *
+tensor_type_to_string (tensor_type type)
+{
+  guint i;
+  for (i = 0; i < G_N_ELEMENTS (tensor_type_names); i++)
+    if (tensor_type_names[i].type == type)
+      return tensor_type_names[i].name;
+  return NULL;
+}
+
+/**
+ * @brief Parse "d0:d1:d2:d3" into `dim`; missing trailing dimensions are 1.
+ */
+gboolean
+tensor_dim_from_string (const gchar *str, tensor_dim dim)
+{
+  guint r;
+  gchar *end;
+  for (r = 0; r < NNS_TENSOR_RANK_LIMIT; r++)
+    dim[r] = 1;
+  for (r = 0; r < NNS_TENSOR_RANK_LIMIT && *str; r++) {
+    dim[r] = (guint) g_ascii_strtoull (str, &end, 10);
+    if (end == str || dim[r] == 0)
+      return FALSE;
+    str = (*end == ':') ? end + 1 : end;
+  }
+  return *str == '\0';
+}
+
+/**
+ * @brief Read tensor types and dimensions from fixed other/tensor or other/tensors caps.
+ */
+gboolean
+tensors_shape_from_caps (const GstCaps *caps, TensorsShape *shape)
+{
+  const GstStructure *s;
+  const gchar *dims, *types;
+  gchar **dimv, **typev;
+  guint i;
+  gboolean ok = TRUE;
+  g_return_val_if_fail (caps != NULL && gst_caps_is_fixed (caps), FALSE);
+  s = gst_caps_get_structure (caps, 0);
+  if (gst_structure_has_name (s, "other/tensor")) {
+    dims = gst_structure_get_string (s, "dimension");
+    types = gst_structure_get_string (s, "type");
+  } else {
+    dims = gst_structure_get_string (s, "dimensions");
+    types = gst_structure_get_string (s, "types");
+  }
+  if (!dims || !types)
+    return FALSE;
+  dimv = g_strsplit (dims, ",", NNS_TENSOR_SIZE_LIMIT);
+  typev = g_strsplit (types, ",", NNS_TENSOR_SIZE_LIMIT);
+  shape->num_tensors = g_strv_length (dimv);
+  if (shape->num_tensors != g_strv_length (typev))
+    ok = FALSE;
+  for (i = 0; ok && i < shape->num_tensors; i++) {
+    shape->types[i] = tensor_type_from_string (g_strstrip (typev[i]));
+    ok = shape->types[i] != _NNS_END && tensor_dim_from_string (g_strstrip (dimv[i]), shape->dims[i]);
+  }
+  g_strfreev (dimv);
+  g_strfreev (typev);
+  return ok;
+}
+
+/**
+ * @brief Allocate the decode scratch for frames of `num_anchors` anchors and `num_classes` classes.
+ *
+ * Classes from `first_class` up are scored: SSD_FIRST_CLASS skips the SSD
+ * background class, and YOLO_FIRST_CLASS scores all of them. `max_candidates` and `max_per_class` are the NMS top-K limits (0 = unlimited).
+ * They also bound the candidates each partition keeps, and so the arena's size.
+ */
+DecodeArena *
+decode_arena_new (guint num_anchors, guint num_classes, guint first_class, guint max_candidates, guint max_per_class)
+{
+  DecodeArena *arena;
+  gsize limit;
+  guint num_scored, p;
+  g_return_val_if_fail (num_anchors > 0 && num_classes > first_class, NULL);
+  num_scored = num_classes - first_class;
+  arena = g_new0 (DecodeArena, 1);
+  arena->num_anchors = num_anchors;
+  arena->num_classes = num_classes;
+  arena->first_class = first_class;
+  arena->max_candidates = max_candidates;
+  arena->max_per_class = max_per_class;
+  arena->num_partitions = (num_anchors + DECODE_PARTITION_ANCHORS - 1) / DECODE_PARTITION_ANCHORS;
+  /* A slice holds every candidate of its partition, unless the limits keep
+   * fewer; then it holds twice that and is pruned whenever it fills */
+  arena->partition_capacity = MIN (num_anchors, DECODE_PARTITION_ANCHORS) * num_scored;
+  limit = max_candidates ? max_candidates : (gsize) max_per_class * num_scored;
+  if (limit && limit < arena->partition_capacity / 2) {
+    arena->partition_limit = limit;
+    arena->partition_capacity = 2 * limit;
+  }
+  arena->max_detections = MIN ((gsize) arena->num_partitions * arena->partition_capacity, (gsize) num_anchors * num_scored);
+  arena->detections = aligned_alloc_bytes ((gsize) arena->max_detections * sizeof (DetectedObject));
+  /* A chunk of logits and boxes takes at most half of L2, leaving room for the anchors and the output */
+  arena->chunk_anchors = CLAMP (l2_cache_size () / 2 / (((gsize) num_classes + BOX_SIZE) * sizeof (gfloat)),
+      1, DECODE_CHUNK_ANCHORS);
+  arena->partitions = g_new0 (DecodePartition, arena->num_partitions);
+  arena->num_threads = 1;
+  arena->score_kernel = score_kernel_select (num_anchors, num_classes);
+  arena->quant_kernel = quant_kernel_select (num_anchors, num_classes);
+  arena->nms = nms_engine_new (arena->max_detections, num_classes);
+  nms_engine_set_limits (arena->nms, max_candidates, max_per_class);
+  if (!arena->detections) {
+    decode_arena_free (arena);
+    return NULL;
+  }
+  for (p = 0; p < arena->num_partitions; p++) {
+    DecodePartition *part = &arena->partitions[p];
+    part->candidates = aligned_alloc_bytes ((gsize) arena->chunk_anchors * num_scored * sizeof (ScoredCandidate));
+    if (!part->candidates) {
+      decode_arena_free (arena);
+      return NULL;
+    }
+    if (arena->partition_limit) {
+      part->select = nms_engine_new (arena->partition_capacity, num_classes);
+      nms_engine_set_limits (part->select, max_candidates, max_per_class);
+    }
+  }
+  return arena;
+}
+
+/**
+ * @brief Decode the partitions of a frame on up to `num_threads` threads (0 = one per processor).
+ */
+void
+decode_arena_set_threads (DecodeArena *arena, guint num_threads)
+{
+  arena->num_threads = num_threads;
+}
+
+/**
+ * @brief Prepare `arena` for uint8 tensors quantized with `boxes` and `scores`.
+ *
+ * Every uint8 code is dequantized once here, so the per-frame work is a table
+ * lookup for the few codes that pass `score_cutoff`.
+ */
+void
+decode_arena_set_quantization (DecodeArena *arena, const QuantParams *boxes, const QuantParams *scores)
+{
+  guint q;
+  for (q = 0; q < 256; q++) {
+    gfloat logit = (gfloat) (((gdouble) q - scores->zero_point) * scores->scale);
+    arena->box_lut[q] = (gfloat) (((gdouble) q - boxes->zero_point) * boxes->scale);
+    arena->score_lut[q] = EXPIT (logit);
+  }
+  arena->score_cutoff = score_threshold_to_quant (arena->score_lut, THRESHOLD_SCORE);
+}
+
+/**
+ * @brief Free a decode arena.
+ */
+void
+decode_arena_free (DecodeArena *arena)
+{
+  guint p;
+  if (!arena)
+    return;
+  free (arena->detections);
+  for (p = 0; p < arena->num_partitions; p++) {
+    free (arena->partitions[p].candidates);
+    nms_engine_free (arena->partitions[p].select);
+  }
+  g_free (arena->partitions);
+  nms_engine_free (arena->nms);
+  g_free (arena);
+}
+
+/**
+ * @brief Allocate an anchor table for `num_anchors` anchors; priors are zeroed.
+ *
+ * Fill in the priors, then call `anchor_table_set_scales` to fold the gains.
+ */
+AnchorTable *
+anchor_table_new (guint num_anchors)
+{
+  AnchorTable *anchors;
+  gsize stride = (num_anchors + (DECODE_ALIGNMENT / sizeof (gfloat)) - 1) & ~(gsize) (DECODE_ALIGNMENT / sizeof (gfloat) - 1);
+  gfloat *planes = aligned_alloc_bytes (6 * stride * sizeof (gfloat));
+  g_return_val_if_fail (planes != NULL, NULL);
+  memset (planes, 0, 6 * stride * sizeof (gfloat));
+  anchors = g_new0 (AnchorTable, 1);
+  anchors->num_anchors = num_anchors;
+  anchors->ycenter = planes;
+  anchors->xcenter = planes + stride;
+  anchors->ygain = planes + 2 * stride;
+  anchors->xgain = planes + 3 * stride;
+  anchors->height = planes + 4 * stride;
+  anchors->width = planes + 5 * stride;
+  anchors->h_scale = H_SCALE;
+  anchors->w_scale = W_SCALE;
+  anchors->h_gain = 1.f / H_SCALE;
+  anchors->w_gain = 1.f / W_SCALE;
+  return anchors;
+}
+
+/**
+ * @brief Fold the box-coder scales into the table.
+ *
+ * The gain planes are only rewritten when the y or x scale changes, so a
+ * bundle opened with its own scales never dirties its mapped pages.
+ */
+void
+anchor_table_set_scales (AnchorTable *anchors, gfloat y_scale, gfloat x_scale, gfloat h_scale, gfloat w_scale)
+{
+  guint d;
+  for (d = 0; (anchors->y_scale != y_scale || anchors->x_scale != x_scale) && d < anchors->num_anchors; d++) {
+    anchors->ygain[d] = anchors->height[d] / y_scale;
+    anchors->xgain[d] = anchors->width[d] / x_scale;
+  }
+  anchors->y_scale = y_scale;
+  anchors->x_scale = x_scale;
+  anchors->h_scale = h_scale;
+  anchors->w_scale = w_scale;
+  anchors->h_gain = 1.f / h_scale;
+  anchors->w_gain = 1.f / w_scale;
+}
+
+/**
+ * @brief Parse whitespace-separated floats from `line` into `values` (if not NULL).
+ * @return number of values in `line`.
+ */
+static guint
+parse_floats (const gchar *line, gfloat *values)
+{
+  guint n = 0;
+  gchar *end;
+  for (;;) {
+    gdouble v = g_ascii_strtod (line, &end);
+    if (end == line)
+      return n;
+    if (values)
+      values[n] = (gfloat) v;
+    n++;
+    line = end;
+  }
+}
+
+/**
+ * @brief Load a box-priors file straight into an anchor table.
+ *
+ * The file holds four rows (y-centre, x-centre, height, width) of one value
+ * per anchor; the anchor count is taken from the file.
+ */
+AnchorTable *
+anchor_table_load_box_priors (const gchar *box_priors_path)
+{
+  AnchorTable *anchors = NULL;
+  GList *lines = NULL;
+  gfloat *rows[BOX_SIZE];
+  guint num_anchors, row;
+  if (!box_priors_path) {
+    GST_ERROR ("No box-priors file given");
+    return NULL;
+  }
+  if (!read_lines (box_priors_path, &lines))
+    return NULL;
+  num_anchors = (g_list_length (lines) >= BOX_SIZE) ? parse_floats (lines->data, NULL) : 0;
+  if (num_anchors == 0) {
+    GST_ERROR ("No box priors in %s", box_priors_path);
+    goto done;
+  }
+  anchors = anchor_table_new (num_anchors);
+  if (!anchors) {
+    GST_ERROR ("Failed to allocate %u box priors for %s", num_anchors, box_priors_path);
+    goto done;
+  }
+  rows[0] = anchors->ycenter;
+  rows[1] = anchors->xcenter;
+  rows[2] = anchors->height;
+  rows[3] = anchors->width;
+  for (row = 0; row < BOX_SIZE; row++) {
+    const gchar *line = g_list_nth_data (lines, row);
+    if (parse_floats (line, NULL) != num_anchors) {
+      GST_ERROR ("Row %u of %s does not have %u box priors", row, box_priors_path, num_anchors);
+      anchor_table_free (anchors);
+      anchors = NULL;
+      goto done;
+    }
+    parse_floats (line, rows[row]);
+  }
+  anchor_table_set_scales (anchors, Y_SCALE, X_SCALE, H_SCALE, W_SCALE);
+done:
+  g_list_free_full (lines, g_free);
+  return anchors;
+}
+
+/**
+ * @brief Free an anchor table.
+ */
+void
+anchor_table_free (AnchorTable *anchors)
+{
+  if (!anchors)
+    return;
+  if (anchors->mapping)
+    g_mapped_file_unref (anchors->mapping);
+  else
+    free (anchors->ycenter);
+  g_free (anchors);
+}
+
+/**
+ * @brief Fill `params` with the anchor grid of SSD MobileNet v1 at 300x300 (1917 anchors).
+ */
+void
+ssd_anchor_params_init (SsdAnchorParams *params)
+{
+  memset (params, 0, sizeof (*params));
+  ssd_anchor_params_set_feature_maps (params, DEFAULT_ANCHOR_FEATURE_MAPS);
+  ssd_anchor_params_set_aspect_ratios (params, DEFAULT_ANCHOR_ASPECT_RATIOS);
+  params->min_scale = DEFAULT_ANCHOR_MIN_SCALE;
+  params->max_scale = DEFAULT_ANCHOR_MAX_SCALE;
+  params->interpolated_scale_aspect_ratio = 1.f;
+  params->reduce_boxes_in_lowest_layer = TRUE;
+}
+
+/**
+ * @brief Set the feature maps from a comma-separated list of sizes, "19" or "19x19" (height x width).
+ */
+gboolean
+ssd_anchor_params_set_feature_maps (SsdAnchorParams *params, const gchar *feature_maps)
+{
+  gchar **sizes = g_strsplit (feature_maps, ",", -1);
+  guint n = g_strv_length (sizes), l;
+  gboolean ok = n > 0 && n <= SSD_MAX_LAYERS;
+  for (l = 0; ok && l < n; l++) {
+    gchar *end;
+    guint h = (guint) g_ascii_strtoull (g_strstrip (sizes[l]), &end, 10);
+    guint w = h;
+    if (*end == 'x')
+      w = (guint) g_ascii_strtoull (end + 1, &end, 10);
+    ok = h > 0 && w > 0 && *end == '\0';
+    params->feature_map_height[l] = h;
+    params->feature_map_width[l] = w;
+  }
+  if (ok)
+    params->num_layers = n;
+  g_strfreev (sizes);
+  return ok;
+}
+
+/**
+ * @brief Set the aspect ratios from a comma-separated list.
+ */
+gboolean
+ssd_anchor_params_set_aspect_ratios (SsdAnchorParams *params, const gchar *aspect_ratios)
+{
+  gchar **ratios = g_strsplit (aspect_ratios, ",", -1);
+  guint n = g_strv_length (ratios), i;
+  gfloat values[SSD_MAX_ASPECT_RATIOS];
+  gboolean ok = n > 0 && n <= SSD_MAX_ASPECT_RATIOS;
+  for (i = 0; ok && i < n; i++) {
+    gchar *end;
+    values[i] = (gfloat) g_ascii_strtod (g_strstrip (ratios[i]), &end);
+    ok = values[i] > 0.f && *end == '\0';
+  }
+  if (ok) {
+    params->num_aspect_ratios = n;
+    memcpy (params->aspect_ratios, values, n * sizeof (gfloat));
+  }
+  g_strfreev (ratios);
+  return ok;
+}
+
+/**
+ * @brief Scale of layer `l`; layer `num_layers` has scale 1.
+ */
+static gdouble
+ssd_layer_scale (const SsdAnchorParams *params, guint l)
+{
+  if (l >= params->num_layers)
+    return 1.0;
+  if (params->num_layers == 1)
+    return params->min_scale;
+  return params->min_scale + (gdouble) (params->max_scale - params->min_scale) * l / (params->num_layers - 1);
+}
+
+/**
+ * @brief Box (scale, aspect ratio) pairs placed at every cell of layer `l`.
+ * @return number of boxes per cell.
+ */
+static guint
+ssd_layer_box_specs (const SsdAnchorParams *params, guint l, gdouble *scales, gdouble *ratios)
+{
+  gdouble scale = ssd_layer_scale (params, l);
+  guint n = 0, i;
+  if (l == 0 && params->reduce_boxes_in_lowest_layer) {
+    static const gdouble lowest[3][2] = { { 0.1, 1.0 }, { -1.0, 2.0 }, { -1.0, 0.5 } };
+    for (n = 0; n < 3; n++) {
+      scales[n] = (lowest[n][0] > 0.0) ? lowest[n][0] : scale;
+      ratios[n] = lowest[n][1];
+    }
+    return n;
+  }
+  for (i = 0; i < params->num_aspect_ratios; i++, n++) {
+    scales[n] = scale;
+    ratios[n] = params->aspect_ratios[i];
+  }
+  if (params->interpolated_scale_aspect_ratio > 0.f) {
+    scales[n] = sqrt (scale * ssd_layer_scale (params, l + 1));
+    ratios[n] = params->interpolated_scale_aspect_ratio;
+    n++;
+  }
+  return n;
+}
+
+/**
+ * @brief Number of anchors in the grid described by `params`.
+ */
+guint
+ssd_anchor_count (const SsdAnchorParams *params)
+{
+  gdouble scales[SSD_MAX_ASPECT_RATIOS + 1], ratios[SSD_MAX_ASPECT_RATIOS + 1];
+  guint l, n = 0;
+  for (l = 0; l < params->num_layers; l++)
+    n += params->feature_map_height[l] * params->feature_map_width[l] * ssd_layer_box_specs (params, l, scales, ratios);
+  return n;
+}
+
+/**
+ * @brief Build the anchor table of an SSD model from its grid parameters.
+ *
+ * Produces the same priors as the box-priors files exported from the
+ * TensorFlow Object Detection API, without any file I/O. The default scales
+ * are folded in; see `anchor_table_set_scales`.
+ */
+AnchorTable *
+anchor_table_generate_ssd (const SsdAnchorParams *params)
+{
+  gdouble scales[SSD_MAX_ASPECT_RATIOS + 1], ratios[SSD_MAX_ASPECT_RATIOS + 1];
+  guint num_anchors = ssd_anchor_count (params);
+  AnchorTable *anchors;
+  guint l, y, x, b, d = 0;
+  g_return_val_if_fail (num_anchors > 0, NULL);
+  anchors = anchor_table_new (num_anchors);
+  g_return_val_if_fail (anchors != NULL, NULL);
+  for (l = 0; l < params->num_layers; l++) {
+    guint num_boxes = ssd_layer_box_specs (params, l, scales, ratios);
+    gdouble stride_y = 1.0 / params->feature_map_height[l];
+    gdouble stride_x = 1.0 / params->feature_map_width[l];
+    for (y = 0; y < params->feature_map_height[l]; y++) {
+      for (x = 0; x < params->feature_map_width[l]; x++) {
+        for (b = 0; b < num_boxes; b++, d++) {
+          gdouble ratio_sqrt = sqrt (ratios[b]);
+          anchors->ycenter[d] = (gfloat) ((y + 0.5) * stride_y);
+          anchors->xcenter[d] = (gfloat) ((x + 0.5) * stride_x);
+          anchors->height[d] = (gfloat) (scales[b] / ratio_sqrt);
+          anchors->width[d] = (gfloat) (scales[b] * ratio_sqrt);
+        }
+      }
+    }
+  }
+  anchor_table_set_scales (anchors, Y_SCALE, X_SCALE, H_SCALE, W_SCALE);
+  return anchors;
+}
+
+/**
+ * @brief Fill `params` with the head of YOLOv5 at 640x640: raw outputs, strides 8, 16 and 32, the COCO anchors and DEFAULT_YOLO_SCORE_THRESHOLD.
+ */
+void
+yolo_params_init (YoloParams *params)
+{
+  memset (params, 0, sizeof (*params));
+  params->head = YOLO_HEAD_ANCHORS;
+  params->score_threshold = DEFAULT_YOLO_SCORE_THRESHOLD;
+  yolo_params_set_input_size (params, DEFAULT_YOLO_INPUT_SIZE);
+  yolo_params_set_strides (params, DEFAULT_YOLO_STRIDES);
+  yolo_params_set_anchors (params, DEFAULT_YOLO_ANCHORS);
+}
+
+/**
+ * @brief Set the model's input size, "640" or "480x640" (height x width).
+ */
+gboolean
+yolo_params_set_input_size (YoloParams *params, const gchar *input_size)
+{
+  gchar *end;
+  guint h = (guint) g_ascii_strtoull (input_size, &end, 10);
+  guint w = h;
+  if (*end == 'x')
+    w = (guint) g_ascii_strtoull (end + 1, &end, 10);
+  if (h == 0 || w == 0 || *end != '\0')
+    return FALSE;
+  params->input_height = h;
+  params->input_width = w;
+  return TRUE;
+}
+
+/**
+ * @brief Set the strides of the levels from a comma-separated list, in output order.
+ */
+gboolean
+yolo_params_set_strides (YoloParams *params, const gchar *strides)
+{
+  gchar **values = g_strsplit (strides, ",", -1);
+  guint n = g_strv_length (values), l;
+  guint parsed[YOLO_MAX_LEVELS];
+  gboolean ok = n > 0 && n <= YOLO_MAX_LEVELS;
+  for (l = 0; ok && l < n; l++) {
+    gchar *end;
+    parsed[l] = (guint) g_ascii_strtoull (g_strstrip (values[l]), &end, 10);
+    ok = parsed[l] > 0 && *end == '\0';
+  }
+  if (ok) {
+    params->num_levels = n;
+    memcpy (params->strides, parsed, n * sizeof (guint));
+  }
+  g_strfreev (values);
+  return ok;
+}
+
+/**
+ * @brief Set the anchors from comma-separated width,height pairs in input
+ * pixels, one semicolon-separated group per level with the same count in each.
+ */
+gboolean
+yolo_params_set_anchors (YoloParams *params, const gchar *anchors)
+{
+  gchar **levels = g_strsplit (anchors, ";", -1);
+  guint num_levels = g_strv_length (levels), num_values = 0, l, i;
+  gfloat parsed[YOLO_MAX_LEVELS][2 * YOLO_MAX_ANCHORS];
+  gboolean ok = num_levels > 0 && num_levels <= YOLO_MAX_LEVELS;
+  for (l = 0; ok && l < num_levels; l++) {
+    gchar **values = g_strsplit (levels[l], ",", -1);
+    guint n = g_strv_length (values);
+    ok = n > 0 && n % 2 == 0 && n <= 2 * YOLO_MAX_ANCHORS && (l == 0 || n == num_values);
+    for (i = 0; ok && i < n; i++) {
+      gchar *end;
+      parsed[l][i] = (gfloat) g_ascii_strtod (g_strstrip (values[i]), &end);
+      ok = parsed[l][i] > 0.f && *end == '\0';
+    }
+    num_values = n;
+    g_strfreev (values);
+  }
+  if (ok) {
+    params->num_anchor_levels = num_levels;
+    params->num_anchors = num_values / 2;
+    for (l = 0; l < num_levels; l++)
+      memcpy (params->anchors[l], parsed[l], num_values * sizeof (gfloat));
+  }
+  g_strfreev (levels);
+  return ok;
+}
+
+/**
+ * @brief Number of output rows of the head described by `params`; 0 if its anchors do not cover its levels.
+ */
+guint
+yolo_grid_count (const YoloParams *params)
+{
+  guint l, n = 0;
+  guint boxes = params->head == YOLO_HEAD_ANCHORS ? params->num_anchors : 1;
+  if (params->head == YOLO_HEAD_ANCHORS && params->num_anchor_levels != params->num_levels)
+    return 0;
+  for (l = 0; l < params->num_levels; l++) {
+    guint s = params->strides[l];
+    n += boxes * ((params->input_height + s - 1) / s) * ((params->input_width + s - 1) / s);
+  }
+  return n;
+}
+
+/**
+ * @brief Build the grid of a raw YOLO head, one entry per output row.
+ *
+ * The grid reuses the anchor table's planes with the stride and input size
+ * folded in, so that a box decodes in normalized coordinates straight away:
+ * `xcenter` and `ycenter` hold the cell offset, `xgain` and `ygain` the
+ * stride, and, for YOLO_HEAD_ANCHORS, `width` and `height` the anchor size.
+ */
+AnchorTable *
+anchor_table_generate_yolo (const YoloParams *params)
+{
+  guint num_rows = yolo_grid_count (params);
+  gboolean anchor_based = params->head == YOLO_HEAD_ANCHORS;
+  gdouble in_w = params->input_width, in_h = params->input_height;
+  AnchorTable *grid;
+  guint l, a, y, x, d = 0;
+  g_return_val_if_fail (num_rows > 0, NULL);
+  grid = anchor_table_new (num_rows);
+  g_return_val_if_fail (grid != NULL, NULL);
+  for (l = 0; l < params->num_levels; l++) {
+    gdouble s = params->strides[l];
+    guint rows = (params->input_height + params->strides[l] - 1) / params->strides[l];
+    guint cols = (params->input_width + params->strides[l] - 1) / params->strides[l];
+    /* YOLOv5 centres are offset by -0.5 and scaled by 2 stride; YOLOv8 distances are from the cell centre */
+    gdouble offset = anchor_based ? -0.5 : 0.5, gain = anchor_based ? 2.0 : 1.0;
+    for (a = 0; a < (anchor_based ? params->num_anchors : 1); a++) {
+      for (y = 0; y < rows; y++) {
+        for (x = 0; x < cols; x++, d++) {
+          grid->ycenter[d] = (gfloat) ((y + offset) * s / in_h);
+          grid->xcenter[d] = (gfloat) ((x + offset) * s / in_w);
+          grid->ygain[d] = (gfloat) (gain * s / in_h);
+          grid->xgain[d] = (gfloat) (gain * s / in_w);
+          if (anchor_based) {
+            grid->height[d] = (gfloat) (4.0 * params->anchors[l][2 * a + 1] / in_h);
+            grid->width[d] = (gfloat) (4.0 * params->anchors[l][2 * a] / in_w);
+          }
+        }
+      }
+    }
+  }
+  return grid;
+}
+
+/**
+ * @brief Distance in bytes between the planes of a table of `num_anchors` anchors.
+ */
+static gsize
+anchor_plane_stride (guint num_anchors)
+{
+  gsize size = (gsize) num_anchors * sizeof (gfloat);
+  return (size + DECODE_ALIGNMENT - 1) & ~(gsize) (DECODE_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Check the magic, version and byte order of the `size` bytes at the start of a bundle.
+ */
+static gboolean
+asset_bundle_check_header (const gchar *bundle_path, const gchar *data, gsize size)
+{
+  const AssetBundleHeader *h = (const AssetBundleHeader *) data;
+  if (size < sizeof (AssetBundleHeader) || memcmp (h->magic, ASSET_BUNDLE_MAGIC, sizeof (h->magic)) != 0) {
+    GST_ERROR ("%s is not an asset bundle", bundle_path);
+    return FALSE;
+  }
+  if (h->byte_order != ASSET_BUNDLE_BYTE_ORDER || h->version != ASSET_BUNDLE_VERSION) {
+    GST_ERROR ("%s is an asset bundle of version %u for another byte order or version", bundle_path, h->version);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Read just the header of a bundle, e.g. for its scales and tensor dimensions.
+ */
+gboolean
+asset_bundle_read_header (const gchar *bundle_path, AssetBundleHeader *header)
+{
+  FILE *stream = g_fopen (bundle_path, "rb");
+  gsize size;
+  if (!stream) {
+    GST_ERROR ("Failed to open file %s", bundle_path);
+    return FALSE;
+  }
+  size = fread (header, 1, sizeof (*header), stream);
+  fclose (stream);
+  return asset_bundle_check_header (bundle_path, (const gchar *) header, size);
+}
+
+/**
+ * @brief Check that a mapped bundle's header describes sections that fit in `size` bytes.
+ */
+static gboolean
+asset_bundle_validate (const gchar *bundle_path, const gchar *data, gsize size)
+{
+  const AssetBundleHeader *h = (const AssetBundleHeader *) data;
+  const guint32 *offsets;
+  const gchar *strings;
+  guint64 strings_size;
+  guint i;
+  if (!asset_bundle_check_header (bundle_path, data, size))
+    return FALSE;
+  if (h->num_anchors == 0 || h->anchors_offset % DECODE_ALIGNMENT != 0 || h->anchor_stride % DECODE_ALIGNMENT != 0 ||
+      h->anchor_stride < (guint64) h->num_anchors * sizeof (gfloat) ||
+      h->anchors_offset > size || 6 * h->anchor_stride > size - h->anchors_offset) {
+    GST_ERROR ("Anchor section of %s is corrupt", bundle_path);
+    return FALSE;
+  }
+  if (h->labels_offset % sizeof (guint32) != 0 || h->labels_offset > size || h->labels_size > size - h->labels_offset ||
+      h->labels_size < (guint64) h->num_labels * sizeof (guint32)) {
+    GST_ERROR ("Label section of %s is corrupt", bundle_path);
+    return FALSE;
+  }
+  offsets = (const guint32 *) (data + h->labels_offset);
+  strings = (const gchar *) (offsets + h->num_labels);
+  strings_size = h->labels_size - (guint64) h->num_labels * sizeof (guint32);
+  if (h->num_labels > 0 && (strings_size == 0 || strings[strings_size - 1] != '\0')) {
+    GST_ERROR ("Label section of %s is corrupt", bundle_path);
+    return FALSE;
+  }
+  for (i = 0; i < h->num_labels; i++) {
+    if (offsets[i] >= strings_size) {
+      GST_ERROR ("Label %u of %s is out of bounds", i, bundle_path);
+      return FALSE;
+    }
+  }
+  if (h->y_scale == 0.f || h->x_scale == 0.f || h->h_scale == 0.f || h->w_scale == 0.f) {
+    GST_ERROR ("Box-coder scales of %s are zero", bundle_path);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Map an asset bundle written by `asset_bundle_write`. Release with `asset_bundle_close`.
+ *
+ * The file is mapped copy-on-write, so applying other scales to the anchor
+ * table only copies the gain pages it touches.
+ * @return NULL if the file cannot be mapped or is not a valid bundle.
+ */
+AssetBundle *
+asset_bundle_open (const gchar *bundle_path)
+{
+  AssetBundle *bundle;
+  AnchorTable *anchors;
+  const AssetBundleHeader *h;
+  const guint32 *offsets;
+  gchar *data;
+  GError *error = NULL;
+  GMappedFile *file = g_mapped_file_new (bundle_path, TRUE, &error);
+  guint i;
+  if (!file) {
+    GST_ERROR ("Failed to map %s: %s", bundle_path, error->message);
+    g_error_free (error);
+    return NULL;
+  }
+  data = g_mapped_file_get_contents (file);
+  if (!data || !asset_bundle_validate (bundle_path, data, g_mapped_file_get_length (file))) {
+    g_mapped_file_unref (file);
+    return NULL;
+  }
+  h = (const AssetBundleHeader *) data;
+  anchors = g_new0 (AnchorTable, 1);
+  anchors->num_anchors = h->num_anchors;
+  anchors->ycenter = (gfloat *) (data + h->anchors_offset);
+  anchors->xcenter = (gfloat *) (data + h->anchors_offset + h->anchor_stride);
+  anchors->ygain = (gfloat *) (data + h->anchors_offset + 2 * h->anchor_stride);
+  anchors->xgain = (gfloat *) (data + h->anchors_offset + 3 * h->anchor_stride);
+  anchors->height = (gfloat *) (data + h->anchors_offset + 4 * h->anchor_stride);
+  anchors->width = (gfloat *) (data + h->anchors_offset + 5 * h->anchor_stride);
+  anchors->y_scale = h->y_scale;
+  anchors->x_scale = h->x_scale;
+  anchors->h_scale = h->h_scale;
+  anchors->w_scale = h->w_scale;
+  anchors->h_gain = 1.f / h->h_scale;
+  anchors->w_gain = 1.f / h->w_scale;
+  anchors->mapping = g_mapped_file_ref (file);
+  bundle = g_new0 (AssetBundle, 1);
+  bundle->file = file;
+  bundle->header = h;
+  bundle->anchors = anchors;
+  bundle->num_labels = h->num_labels;
+  bundle->labels = g_new0 (const gchar *, h->num_labels + 1);
+  offsets = (const guint32 *) (data + h->labels_offset);
+  for (i = 0; i < h->num_labels; i++)
+    bundle->labels[i] = (const gchar *) (offsets + h->num_labels) + offsets[i];
+  return bundle;
+}
+
+/**
+ * @brief Unmap a bundle. An anchor table taken from it stays valid.
+ */
+void
+asset_bundle_close (AssetBundle *bundle)
+{
+  if (!bundle)
+    return;
+  anchor_table_free (bundle->anchors);
+  g_free (bundle->labels);
+  g_mapped_file_unref (bundle->file);
+  g_free (bundle);
+}
+
+/**
+ * @brief Write `anchors` (with its current scales), `labels` and the model's tensor dimensions as a bundle.
+ *
+ * The file is replaced atomically.
+ */
+gboolean
+asset_bundle_write (const gchar *bundle_path, const AnchorTable *anchors, const gchar * const *labels, guint num_labels,
+    const tensor_dim boxes_dim, const tensor_dim predictions_dim)
+{
+  AssetBundleHeader *h;
+  const gfloat *planes[6];
+  gsize stride = anchor_plane_stride (anchors->num_anchors);
+  gsize anchors_offset = (sizeof (AssetBundleHeader) + DECODE_ALIGNMENT - 1) & ~(gsize) (DECODE_ALIGNMENT - 1);
+  gsize labels_offset = anchors_offset + 6 * stride;
+  gsize strings_size = 0, size;
+  guint32 *offsets;
+  gchar *data, *strings;
+  GError *error = NULL;
+  gboolean ok;
+  guint i;
+  for (i = 0; i < num_labels; i++)
+    strings_size += strlen (labels[i]) + 1;
+  size = labels_offset + num_labels * sizeof (guint32) + strings_size;
+  data = g_malloc0 (size);
+  h = (AssetBundleHeader *) data;
+  memcpy (h->magic, ASSET_BUNDLE_MAGIC, sizeof (h->magic));
+  h->version = ASSET_BUNDLE_VERSION;
+  h->byte_order = ASSET_BUNDLE_BYTE_ORDER;
+  h->num_anchors = anchors->num_anchors;
+  h->num_labels = num_labels;
+  for (i = 0; i < ASSET_BUNDLE_RANK; i++) {
+    h->boxes_dim[i] = (i < NNS_TENSOR_RANK_LIMIT) ? boxes_dim[i] : 1;
+    h->predictions_dim[i] = (i < NNS_TENSOR_RANK_LIMIT) ? predictions_dim[i] : 1;
+  }
+  h->y_scale = anchors->y_scale;
+  h->x_scale = anchors->x_scale;
+  h->h_scale = anchors->h_scale;
+  h->w_scale = anchors->w_scale;
+  h->anchors_offset = anchors_offset;
+  h->anchor_stride = stride;
+  h->labels_offset = labels_offset;
+  h->labels_size = num_labels * sizeof (guint32) + strings_size;
+  planes[0] = anchors->ycenter;
+  planes[1] = anchors->xcenter;
+  planes[2] = anchors->ygain;
+  planes[3] = anchors->xgain;
+  planes[4] = anchors->height;
+  planes[5] = anchors->width;
+  for (i = 0; i < 6; i++)
+    memcpy (data + anchors_offset + i * stride, planes[i], anchors->num_anchors * sizeof (gfloat));
+  offsets = (guint32 *) (data + labels_offset);
+  strings = (gchar *) (offsets + num_labels);
+  for (i = 0, strings_size = 0; i < num_labels; i++) {
+    gsize len = strlen (labels[i]) + 1;
+    offsets[i] = strings_size;
+    memcpy (strings + strings_size, labels[i], len);
+    strings_size += len;
+  }
+  ok = g_file_set_contents (bundle_path, data, size, &error);
+  if (!ok) {
+    GST_ERROR ("Failed to write %s: %s", bundle_path, error->message);
+    g_error_free (error);
+  }
+  g_free (data);
+  return ok;
+}
+
+/*
+ * Process-wide asset cache.
+ *
+ * Assets are keyed by what they were built from, including the size and
+ * modification time of their file, so decoders on the same model share one
+ * read-only copy while a model updated on disk gets a fresh one. Entries are
+ * refcounted and dropped with their last user.
+ */
+
+/**
+ * @brief One shared asset.
+ */
+typedef struct _AssetCacheEntry
+{
+  gchar *key;
+  gint refcount;
+  gpointer asset;
+  GDestroyNotify destroy;
+} AssetCacheEntry;
+
+/**
+ * @brief Builds the asset for a cache miss from `data`; NULL on failure.
+ */
+typedef gpointer (*AssetLoadFunc) (gconstpointer data);
+
+static GMutex asset_cache_lock;
+static GHashTable *asset_cache_by_key;   /* key -> entry */
+static GHashTable *asset_cache_by_asset; /* asset -> entry */
+
+/**
+ * @brief Cache key of the file at `path`; NULL if it cannot be stat'ed.
+ */
+static gchar *
+asset_file_key (const gchar *kind, const gchar *path, const gchar *suffix)
+{
+  GStatBuf st;
+  if (!path || g_stat (path, &st) != 0) {
+    GST_ERROR ("Failed to stat file %s", path);
+    return NULL;
+  }
+  return g_strdup_printf ("%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%s%s", kind,
+      (gint64) st.st_mtime, (gint64) st.st_size, path, suffix ? suffix : "");
+}
+
+/**
+ * @brief Exact textual form of `scales` for cache keys.
+ */
+static gchar *
+box_scales_key (const BoxScales *scales)
+{
+  return g_strdup_printf ("|%a,%a,%a,%a", scales->y, scales->x, scales->h, scales->w);
+}
+
+/**
+ * @brief Look up `key`, loading the asset on a miss. Takes ownership of `key`.
+ */
+static gconstpointer
+asset_cache_get (gchar *key, AssetLoadFunc load, gconstpointer data, GDestroyNotify destroy)
+{
+  AssetCacheEntry *entry;
+  gpointer asset = NULL;
+  if (!key)
+    return NULL;
+  g_mutex_lock (&asset_cache_lock);
+  if (!asset_cache_by_key) {
+    asset_cache_by_key = g_hash_table_new (g_str_hash, g_str_equal);
+    asset_cache_by_asset = g_hash_table_new (g_direct_hash, g_direct_equal);
+  }
+  entry = g_hash_table_lookup (asset_cache_by_key, key);
+  if (entry) {
+    entry->refcount++;
+    asset = entry->asset;
+    g_free (key);
+  } else if ((asset = load (data)) != NULL) {
+    entry = g_new0 (AssetCacheEntry, 1);
+    entry->key = key;
+    entry->refcount = 1;
+    entry->asset = asset;
+    entry->destroy = destroy;
+    g_hash_table_insert (asset_cache_by_key, entry->key, entry);
+    g_hash_table_insert (asset_cache_by_asset, asset, entry);
+  } else {
+    g_free (key);
+  }
+  g_mutex_unlock (&asset_cache_lock);
+  return asset;
+}
+
+/**
+ * @brief Release an asset returned by one of the `asset_cache_get_*` functions. NULL is ignored.
+ */
+void
+asset_cache_unref (gconstpointer asset)
+{
+  AssetCacheEntry *entry = NULL;
+  if (!asset)
+    return;
+  g_mutex_lock (&asset_cache_lock);
+  if (asset_cache_by_asset)
+    entry = g_hash_table_lookup (asset_cache_by_asset, asset);
+  if (entry && --entry->refcount == 0) {
+    g_hash_table_remove (asset_cache_by_key, entry->key);
+    g_hash_table_remove (asset_cache_by_asset, asset);
+  } else {
+    entry = NULL;
+  }
+  g_mutex_unlock (&asset_cache_lock);
+  if (entry) {
+    entry->destroy (entry->asset);
+    g_free (entry->key);
+    g_free (entry);
+  }
+}
+
+/**
+ * @brief Intern `num_labels` strings into a new label table.
+ */
+static LabelTable *
+label_table_new (const gchar * const *labels, guint num_labels)
+{
+  LabelTable *table = g_new0 (LabelTable, 1);
+  guint i;
+  table->num_labels = num_labels;
+  table->labels = g_new0 (const gchar *, num_labels + 1);
+  table->quarks = g_new (GQuark, num_labels);
+  for (i = 0; i < num_labels; i++) {
+    table->labels[i] = g_intern_string (labels[i]);
+    table->quarks[i] = g_quark_from_static_string (table->labels[i]);
+  }
+  return table;
+}
+
+/**
+ * @brief Free a label table; interned strings stay with the process.
+ */
+static void
+label_table_free (gpointer data)
+{
+  LabelTable *table = data;
+  g_free (table->labels);
+  g_free (table->quarks);
+  g_free (table);
+}
+
+static gpointer
+load_labels (gconstpointer data)
+{
+  LabelTable *table;
+  guint num_labels;
+  gchar **labels = tflite_read_labels (data, &num_labels);
+  if (!labels)
+    return NULL;
+  table = label_table_new ((const gchar * const *) labels, num_labels);
+  g_strfreev (labels);
+  return table;
+}
+
+static gpointer
+load_bundle_labels (gconstpointer data)
+{
+  LabelTable *table;
+  AssetBundle *bundle = asset_bundle_open (data);
+  if (!bundle)
+    return NULL;
+  table = label_table_new (bundle->labels, bundle->num_labels);
+  asset_bundle_close (bundle);
+  return table;
+}
+
+/**
+ * @brief What an anchor table is built from on a cache miss.
+ */
+typedef struct _AnchorSource
+{
+  const gchar *path;
+  const SsdAnchorParams *params;
+  const BoxScales *scales;
+} AnchorSource;
+
+static void
+anchor_table_destroy (gpointer data)
+{
+  anchor_table_free (data);
+}
+
+static gpointer
+load_box_priors (gconstpointer data)
+{
+  const AnchorSource *source = data;
+  AnchorTable *anchors = anchor_table_load_box_priors (source->path);
+  if (anchors)
+    anchor_table_set_scales (anchors, source->scales->y, source->scales->x, source->scales->h, source->scales->w);
+  return anchors;
+}
+
+static gpointer
+load_bundle_anchors (gconstpointer data)
+{
+  const AnchorSource *source = data;
+  AnchorTable *anchors;
+  AssetBundle *bundle = asset_bundle_open (source->path);
+  if (!bundle)
+    return NULL;
+  anchors = bundle->anchors;
+  bundle->anchors = NULL;
+  asset_bundle_close (bundle);
+  if (source->scales)
+    anchor_table_set_scales (anchors, source->scales->y, source->scales->x, source->scales->h, source->scales->w);
+  return anchors;
+}
+
+static gpointer
+load_ssd_anchors (gconstpointer data)
+{
+  const AnchorSource *source = data;
+  AnchorTable *anchors = anchor_table_generate_ssd (source->params);
+  if (anchors)
+    anchor_table_set_scales (anchors, source->scales->y, source->scales->x, source->scales->h, source->scales->w);
+  return anchors;
+}
+
+/**
+ * @brief Shared labels of a labels file. Release with `asset_cache_unref`.
+ */
+const LabelTable *
+asset_cache_get_labels (const gchar *labels_path)
+{
+  return asset_cache_get (asset_file_key ("labels", labels_path, NULL),
+      load_labels, labels_path, label_table_free);
+}
+
+/**
+ * @brief Shared labels of an asset bundle. Release with `asset_cache_unref`.
+ */
+const LabelTable *
+asset_cache_get_bundle_labels (const gchar *bundle_path)
+{
+  return asset_cache_get (asset_file_key ("bundle-labels", bundle_path, NULL),
+      load_bundle_labels, bundle_path, label_table_free);
+}
+
+/**
+ * @brief Shared anchors of a box-priors file with `scales` folded in. Release with `asset_cache_unref`.
+ */
+const AnchorTable *
+asset_cache_get_box_priors (const gchar *box_priors_path, const BoxScales *scales)
+{
+  AnchorSource source = { box_priors_path, NULL, scales };
+  gchar *suffix = box_scales_key (scales);
+  gchar *key = asset_file_key ("box-priors", box_priors_path, suffix);
+  g_free (suffix);
+  return asset_cache_get (key, load_box_priors, &source, anchor_table_destroy);
+}
+
+/**
+ * @brief Shared anchors of an asset bundle. Release with `asset_cache_unref`.
+ *
+ * With `scales` NULL the bundle's own scales are kept.
+ */
+const AnchorTable *
+asset_cache_get_bundle_anchors (const gchar *bundle_path, const BoxScales *scales)
+{
+  AnchorSource source = { bundle_path, NULL, scales };
+  gchar *suffix = scales ? box_scales_key (scales) : NULL;
+  gchar *key = asset_file_key ("bundle-anchors", bundle_path, suffix);
+  g_free (suffix);
+  return asset_cache_get (key, load_bundle_anchors, &source, anchor_table_destroy);
+}
+
+/**
+ * @brief Shared anchors generated from `params` with `scales` folded in. Release with `asset_cache_unref`.
+ */
+const AnchorTable *
+asset_cache_get_ssd_anchors (const SsdAnchorParams *params, const BoxScales *scales)
+{
+  AnchorSource source = { NULL, params, scales };
+  GString *key = g_string_new ("ssd-anchors:");
+  guint i;
+  for (i = 0; i < params->num_layers; i++)
+    g_string_append_printf (key, "%ux%u,", params->feature_map_height[i], params->feature_map_width[i]);
+  g_string_append_printf (key, "%a,%a,", params->min_scale, params->max_scale);
+  for (i = 0; i < params->num_aspect_ratios; i++)
+    g_string_append_printf (key, "%a,", params->aspect_ratios[i]);
+  g_string_append_printf (key, "%a,%d|%a,%a,%a,%a", params->interpolated_scale_aspect_ratio,
+      params->reduce_boxes_in_lowest_layer, scales->y, scales->x, scales->h, scales->w);
+  return asset_cache_get (g_string_free (key, FALSE), load_ssd_anchors, &source, anchor_table_destroy);
+}
+
+static gpointer
+load_yolo_grid (gconstpointer data)
+{
+  return anchor_table_generate_yolo (data);
+}
+
+/**
+ * @brief Shared grid of the raw YOLO head described by `params`. Release with `asset_cache_unref`.
+ */
+const AnchorTable *
+asset_cache_get_yolo_grid (const YoloParams *params)
+{
+  GString *key = g_string_new ("yolo-grid:");
+  guint l, i;
+  g_string_append_printf (key, "%d,%ux%u,", params->head, params->input_height, params->input_width);
+  for (l = 0; l < params->num_levels; l++)
+    g_string_append_printf (key, "%u,", params->strides[l]);
+  if (params->head == YOLO_HEAD_ANCHORS) {
+    for (l = 0; l < params->num_anchor_levels; l++) {
+      g_string_append_c (key, ';');
+      for (i = 0; i < 2 * params->num_anchors; i++)
+        g_string_append_printf (key, "%a,", params->anchors[l][i]);
+    }
+  }
+  return asset_cache_get (g_string_free (key, FALSE), load_yolo_grid, params, anchor_table_destroy);
+}
+
+/**
+ * @brief One `decode_pool_run` call: tasks are claimed through `next` by the
+ * caller and by every helper thread until none are left.
+ *
+ * Helpers that start after all tasks are done only drop their reference, so
+ * the caller never waits for a helper to be scheduled. This keeps nested
+ * calls from pool threads, e.g. partitioned frames of a parallel batch, from
+ * deadlocking on a busy pool.
+ */
+typedef struct _DecodeJob
+{
+  DecodeTaskFunc func;
+  gpointer data;
+  gint num_tasks;
+  gint next;     /**< index of the next unclaimed task */
+  gint finished; /**< tasks that have returned */
+  gint refcount; /**< caller and helpers that have not let go of the job */
+  GMutex lock;
+  GCond done;
+} DecodeJob;
+
+static GMutex decode_pool_lock;
+static GThreadPool *decode_pool;
+
+static void
+decode_job_unref (DecodeJob *job)
+{
+  if (!g_atomic_int_dec_and_test (&job->refcount))
+    return;
+  g_cond_clear (&job->done);
+  g_mutex_clear (&job->lock);
+  g_free (job);
+}
+
+/**
+ * @brief Run tasks of `job` until all have been claimed.
+ */
+static void
+decode_job_drain (DecodeJob *job)
+{
+  gint i;
+  while ((i = g_atomic_int_add (&job->next, 1)) < job->num_tasks) {
+    job->func (job->data, i);
+    if (g_atomic_int_add (&job->finished, 1) + 1 == job->num_tasks) {
+      g_mutex_lock (&job->lock);
+      g_cond_signal (&job->done);
+      g_mutex_unlock (&job->lock);
+    }
+  }
+}
+
+/**
+ * @brief Pool thread: help with a job.
+ */
+static void
+decode_pool_worker (gpointer data, gpointer user_data)
+{
+  DecodeJob *job = data;
+  decode_job_drain (job);
+  decode_job_unref (job);
+}
+
+/**
+ * @brief The process-wide pool, grown to at least `num_helpers` threads; NULL on failure.
+ */
+static GThreadPool *
+decode_pool_get (guint num_helpers)
+{
+  GThreadPool *pool;
+  g_mutex_lock (&decode_pool_lock);
+  if (!decode_pool) {
+    GError *error = NULL;
+    decode_pool = g_thread_pool_new (decode_pool_worker, NULL,
+        MAX (num_helpers, g_get_num_processors () - 1), FALSE, &error);
+    if (!decode_pool) {
+      GST_ERROR ("Failed to create decode thread pool: %s", error->message);
+      g_error_free (error);
+    }
+  } else if ((gint) num_helpers > g_thread_pool_get_max_threads (decode_pool)) {
+    g_thread_pool_set_max_threads (decode_pool, num_helpers, NULL);
+  }
+  pool = decode_pool;
+  g_mutex_unlock (&decode_pool_lock);
+  return pool;
+}
+
+/**
+ * @brief Run `func` (`data`, i) for i in [0, `num_tasks`) on up to `num_threads` threads and wait for all of them.
+ *
+ * The calling thread takes part and helpers come from a pool shared by every
+ * decoder in the process. Tasks are handed out one at a time, so a thread that
+ * finishes early keeps taking work from the slower ones. `num_threads` of 0
+ * uses one thread per processor. Falls back to running the tasks in order on
+ * the calling thread if no helpers can be had.
+ */
+void
+decode_pool_run (guint num_tasks, guint num_threads, DecodeTaskFunc func, gpointer data)
+{
+  DecodeJob *job;
+  GThreadPool *pool;
+  guint num_helpers, i;
+  if (num_threads == 0)
+    num_threads = g_get_num_processors ();
+  num_helpers = MIN (num_threads, num_tasks);
+  num_helpers = num_helpers ? num_helpers - 1 : 0;
+  pool = num_helpers ? decode_pool_get (num_helpers) : NULL;
+  if (!pool) {
+    for (i = 0; i < num_tasks; i++)
+      func (data, i);
+    return;
+  }
+  job = g_new (DecodeJob, 1);
+  job->func = func;
+  job->data = data;
+  job->num_tasks = num_tasks;
+  job->next = 0;
+  job->finished = 0;
+  job->refcount = 1 + num_helpers;
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->done);
+  for (i = 0; i < num_helpers; i++)
+    g_thread_pool_push (pool, job, NULL);
+  decode_job_drain (job);
+  g_mutex_lock (&job->lock);
+  while (g_atomic_int_get (&job->finished) < job->num_tasks)
+    g_cond_wait (&job->done, &job->lock);
+  g_mutex_unlock (&job->lock);
+  decode_job_unref (job);
+}
+
+/**
+ * @brief Drop every queued item and wake the threads waiting for a place; call with the queue's lock held.
+ */
+static void
+decode_queue_free_items (DecodeQueue *queue)
+{
+  gpointer item;
+  while ((item = g_queue_pop_head (&queue->items)) != NULL)
+    queue->free_item (item);
+  queue->num_counted = 0;
+  g_cond_broadcast (&queue->cond);
+}
+
+/**
+ * @brief Set up an empty queue of `capacity` places that accepts items.
+ */
+void
+decode_queue_init (DecodeQueue *queue, guint capacity, gboolean (*counts) (gconstpointer item), GDestroyNotify free_item)
+{
+  g_queue_init (&queue->items);
+  queue->capacity = capacity;
+  queue->num_counted = 0;
+  queue->busy = FALSE;
+  queue->flushing = FALSE;
+  queue->status = 0;
+  queue->counts = counts;
+  queue->free_item = free_item;
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+}
+
+/**
+ * @brief Free the items still queued and the queue's lock. No thread may be using the queue.
+ */
+void
+decode_queue_clear (DecodeQueue *queue)
+{
+  decode_queue_free_items (queue);
+  g_mutex_clear (&queue->lock);
+  g_cond_clear (&queue->cond);
+}
+
+/**
+ * @brief Queue `item` behind those pushed before it, waiting while it counts and every place is taken.
+ *
+ * Returns the queue's status: 0 if `item` was queued. Otherwise the queue
+ * stopped or the task failed before `item` got in, and `item` is freed.
+ */
+gint
+decode_queue_push (DecodeQueue *queue, gpointer item)
+{
+  gboolean counts = queue->counts (item);
+  gint status;
+  g_mutex_lock (&queue->lock);
+  while (counts && queue->status == 0 && queue->num_counted >= queue->capacity)
+    g_cond_wait (&queue->cond, &queue->lock);
+  status = queue->status;
+  if (status == 0) {
+    g_queue_push_tail (&queue->items, item);
+    if (counts)
+      queue->num_counted++;
+    g_cond_broadcast (&queue->cond);
+  }
+  g_mutex_unlock (&queue->lock);
+  if (status != 0)
+    queue->free_item (item);
+  return status;
+}
+
+/**
+ * @brief Take the oldest item for the task, waiting for one. FALSE once the queue is stopped.
+ *
+ * The task owns `*item` and reports on it with `decode_queue_done`.
+ */
+gboolean
+decode_queue_pop (DecodeQueue *queue, gpointer *item)
+{
+  g_mutex_lock (&queue->lock);
+  while (!queue->flushing && g_queue_is_empty (&queue->items))
+    g_cond_wait (&queue->cond, &queue->lock);
+  if (queue->flushing) {
+    g_mutex_unlock (&queue->lock);
+    return FALSE;
+  }
+  *item = g_queue_pop_head (&queue->items);
+  if (queue->counts (*item))
+    queue->num_counted--;
+  queue->busy = TRUE;
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+  return TRUE;
+}
+
+/**
+ * @brief The task has handled its item with `status`. The first non-zero status is kept, and refuses later pushes.
+ */
+void
+decode_queue_done (DecodeQueue *queue, gint status)
+{
+  g_mutex_lock (&queue->lock);
+  queue->busy = FALSE;
+  if (status != 0 && queue->status == 0)
+    queue->status = status;
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * @brief Wait until the task has handled every item queued so far, or has failed.
+ */
+void
+decode_queue_drain (DecodeQueue *queue)
+{
+  g_mutex_lock (&queue->lock);
+  while (queue->status == 0 && (!g_queue_is_empty (&queue->items) || queue->busy))
+    g_cond_wait (&queue->cond, &queue->lock);
+  g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * @brief Drop the queued items and wake every waiting thread: pops return nothing and pushes return `status`, which must not be 0.
+ *
+ * An item the task has already popped is still its own to finish.
+ */
+void
+decode_queue_stop (DecodeQueue *queue, gint status)
+{
+  g_mutex_lock (&queue->lock);
+  queue->flushing = TRUE;
+  queue->status = status;
+  decode_queue_free_items (queue);
+  g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * @brief Accept items again after `decode_queue_stop`, with status 0.
+ */
+void
+decode_queue_restart (DecodeQueue *queue)
+{
+  g_mutex_lock (&queue->lock);
+  queue->flushing = FALSE;
+  queue->status = 0;
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * @brief Set up an empty window whose results are freed with `free_result`.
+ */
+void
+sync_window_init (SyncWindow *window, GDestroyNotify free_result)
+{
+  memset (window->results, 0, sizeof (window->results));
+  window->head = 0;
+  window->count = 0;
+  window->last = NULL;
+  window->free_result = free_result;
+}
+
+/**
+ * @brief Retire the oldest result; it replaces `last`.
+ */
+static void
+sync_window_retire (SyncWindow *window)
+{
+  SyncResult *r = &window->results[window->head];
+  if (window->last)
+    window->free_result (window->last);
+  window->last = r->result;
+  r->result = NULL;
+  window->head = (window->head + 1) % SYNC_WINDOW_SIZE;
+  window->count--;
+}
+
+/**
+ * @brief Free every result, `last` included.
+ */
+void
+sync_window_clear (SyncWindow *window)
+{
+  while (window->count)
+    sync_window_retire (window);
+  if (window->last)
+    window->free_result (window->last);
+  window->last = NULL;
+}
+
+/**
+ * @brief Keep `result` for the frame at `running_time`, no earlier than those kept before; the oldest is retired when the window is full.
+ */
+void
+sync_window_add (SyncWindow *window, guint64 running_time, gpointer result)
+{
+  SyncResult *r;
+  if (window->count == SYNC_WINDOW_SIZE)
+    sync_window_retire (window);
+  r = &window->results[(window->head + window->count) % SYNC_WINDOW_SIZE];
+  r->running_time = running_time;
+  r->result = result;
+  window->count++;
+}
+
+/**
+ * @brief Find the result of the frame at `running_time`, give or take `tolerance`.
+ *
+ * Results too old for this frame are too old for the next ones, and are
+ * retired. `*result` is the match, still owned by the window, or NULL.
+ * Returns FALSE if no result has reached this frame yet, so its own may
+ * still come; TRUE if the frame has its match, or a later frame's result
+ * shows it has none.
+ */
+gboolean
+sync_window_match (SyncWindow *window, guint64 running_time, guint64 tolerance, gpointer *result)
+{
+  SyncResult *head;
+  *result = NULL;
+  while (window->count && window->results[window->head].running_time + tolerance < running_time)
+    sync_window_retire (window);
+  if (!window->count)
+    return FALSE;
+  head = &window->results[window->head];
+  if (head->running_time <= running_time + tolerance)
+    *result = head->result;
+  return TRUE;
+}
+
+/**
+ * @brief Decode the box regressed against anchor `d` into `detection`.
+ */
+static inline void
+anchor_table_decode (const AnchorTable *anchors, guint d, const gfloat *box, DetectedObject *detection)
+{
+  gfloat ycenter = box[0] * anchors->ygain[d] + anchors->ycenter[d];
+  gfloat xcenter = box[1] * anchors->xgain[d] + anchors->xcenter[d];
+  gfloat h = expf (box[2] * anchors->h_gain) * anchors->height[d];
+  gfloat w = expf (box[3] * anchors->w_gain) * anchors->width[d];
+
+  gfloat ymin = ycenter - h / 2.f;
+  gfloat xmin = xcenter - w / 2.f;
+  gfloat ymax = ycenter + h / 2.f;
+  gfloat xmax = xcenter + w / 2.f;
+
+  detection->x = UINT_MAX * xmin;
+  detection->y = UINT_MAX * ymin;
+  detection->width = UINT_MAX * (xmax - xmin);
+  detection->height = UINT_MAX * (ymax - ymin);
+}
+
+/**
+ * @brief Lowest logit that can still produce a score of at least `threshold`.
+ *
+ * The cutoff is computed for a threshold a few ULPs below the requested one so
+ * that rounding in `EXPIT` can never reject a logit the float path would keep;
+ * survivors of the cutoff are re-checked against `threshold` after `EXPIT`.
+ */
+gfloat
+score_threshold_to_logit (gfloat threshold)
+{
+  gdouble t;
+  if (threshold <= 0.f)
+    return -INFINITY;
+  t = (gdouble) threshold * (1.0 - 4.0 * FLT_EPSILON);
+  if (t >= 1.0)
+    t = 1.0 - 4.0 * FLT_EPSILON;
+  return (gfloat) (log (t / (1.0 - t)) - 1e-6);
+}
+
+/**
+ * @brief Run the sigmoid on a logit that passed the cutoff and record it if its score still passes.
+ */
+static inline guint
+emit_candidate (gfloat logit, guint anchor, guint class_id, gfloat threshold, ScoredCandidate *candidates, guint n)
+{
+  gfloat score = EXPIT (logit);
+  /**
+   * This score cutoff is taken from Tensorflow's demo app.
+   * There are quite a lot of nodes to be run to convert it to the useful possibility
+   * scores. As a result of that, this cutoff will cause it to lose good detections in
+   * some scenarios and generate too much noise in other scenario.
+   */
+  if (score < threshold)
+    return n;
+  candidates[n].anchor = anchor;
+  candidates[n].class_id = class_id;
+  candidates[n].score = score;
+  return n + 1;
+}
+
+/**
+ * @brief Lowest uint8 logit whose entry in `score_lut` is at least `threshold`.
+ *
+ * Scanning the table rather than inverting the quantization keeps the cutoff
+ * exact; when no code passes, 255 is returned and the per-code re-check in the
+ * kernels rejects it.
+ */
+guint8
+score_threshold_to_quant (const gfloat score_lut[256], gfloat threshold)
+{
+  guint q;
+  for (q = 0; q < 256; q++) {
+    if (score_lut[q] >= threshold)
+      return q;
+  }
+  return 255;
+}
+
+/**
+ * @brief Look up the score of a uint8 logit that passed the cutoff and record it if it still passes.
+ */
+static inline guint
+emit_candidate_quant (guint8 logit, guint anchor, guint class_id, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates, guint n)
+{
+  gfloat score = score_lut[logit];
+  if (score < threshold)
+    return n;
+  candidates[n].anchor = anchor;
+  candidates[n].class_id = class_id;
+  candidates[n].score = score;
+  return n + 1;
+}
+
+/*
+ * The scoring loops below are written once per instruction set as always-inline
+ * bodies and stamped out per class count by `DEFINE_SCORE_KERNELS`, so the
+ * common SSD heads get loops with a constant trip count while other shapes
+ * run the same code with a runtime `num_classes`.
+ */
+static inline __attribute__ ((always_inline)) guint
+score_rows_scalar (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c < num_classes; c++) {
+      if (predictions[c] >= cutoff)
+        n = emit_candidate (predictions[c], a, c, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+
+static inline __attribute__ ((always_inline)) guint
+score_rows_quant_scalar (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates)
+{
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c < num_classes; c++) {
+      if (predictions[c] >= cutoff)
+        n = emit_candidate_quant (predictions[c], a, c, score_lut, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+
+#if defined(HAVE_X86_SIMD) && defined(__SSE2__)
+#define HAVE_SSE2_KERNELS 1
+static inline __attribute__ ((always_inline)) guint
+score_rows_sse2 (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  const __m128 vcutoff = _mm_set1_ps (cutoff);
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c + 4 <= num_classes; c += 4) {
+      guint mask = _mm_movemask_ps (_mm_cmpge_ps (_mm_loadu_ps (predictions + c), vcutoff));
+      while (mask) {
+        guint k = c + __builtin_ctz (mask);
+        n = emit_candidate (predictions[k], a, k, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; c < num_classes; c++) {
+      if (predictions[c] >= cutoff)
+        n = emit_candidate (predictions[c], a, c, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+/* SSE2 has no unsigned byte compare: q >= cutoff exactly when max (q, cutoff) == q */
+static inline __attribute__ ((always_inline)) guint
+score_rows_quant_sse2 (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates)
+{
+  const __m128i vcutoff = _mm_set1_epi8 ((gchar) cutoff);
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c + 16 <= num_classes; c += 16) {
+      __m128i q = _mm_loadu_si128 ((const __m128i *) (predictions + c));
+      guint mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_max_epu8 (q, vcutoff), q));
+      while (mask) {
+        guint k = c + __builtin_ctz (mask);
+        n = emit_candidate_quant (predictions[k], a, k, score_lut, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; c < num_classes; c++) {
+      if (predictions[c] >= cutoff)
+        n = emit_candidate_quant (predictions[c], a, c, score_lut, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+#define DEFINE_SSE2_SCORE_KERNEL(suffix, classes) \
+  static guint \
+  score_sse2_##suffix (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates) \
+  { \
+    return score_rows_sse2 (predictions, num_anchors, classes, threshold, cutoff, candidates); \
+  } \
+  static guint \
+  score_quant_sse2_##suffix (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates) \
+  { \
+    return score_rows_quant_sse2 (predictions, num_anchors, classes, cutoff, score_lut, threshold, candidates); \
+  }
+#else
+#define DEFINE_SSE2_SCORE_KERNEL(suffix, classes)
+#endif
+
+#ifdef HAVE_X86_SIMD
+#define HAVE_AVX2_KERNELS 1
+static inline __attribute__ ((always_inline, target ("avx2"))) guint
+score_rows_avx2 (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  const __m256 vcutoff = _mm256_set1_ps (cutoff);
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c + 8 <= num_classes; c += 8) {
+      guint mask = _mm256_movemask_ps (_mm256_cmp_ps (_mm256_loadu_ps (predictions + c), vcutoff, _CMP_GE_OQ));
+      while (mask) {
+        guint k = c + __builtin_ctz (mask);
+        n = emit_candidate (predictions[k], a, k, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; c < num_classes; c++) {
+      if (predictions[c] >= cutoff)
+        n = emit_candidate (predictions[c], a, c, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+static inline __attribute__ ((always_inline, target ("avx2"))) guint
+score_rows_quant_avx2 (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates)
+{
+  const __m256i vcutoff = _mm256_set1_epi8 ((gchar) cutoff);
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c + 32 <= num_classes; c += 32) {
+      __m256i q = _mm256_loadu_si256 ((const __m256i *) (predictions + c));
+      guint mask = (guint) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_max_epu8 (q, vcutoff), q));
+      while (mask) {
+        guint k = c + __builtin_ctz (mask);
+        n = emit_candidate_quant (predictions[k], a, k, score_lut, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; c < num_classes; c++) {
+      if (predictions[c] >= cutoff)
+        n = emit_candidate_quant (predictions[c], a, c, score_lut, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+#define DEFINE_AVX2_SCORE_KERNEL(suffix, classes) \
+  static __attribute__ ((target ("avx2"))) guint \
+  score_avx2_##suffix (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates) \
+  { \
+    return score_rows_avx2 (predictions, num_anchors, classes, threshold, cutoff, candidates); \
+  } \
+  static __attribute__ ((target ("avx2"))) guint \
+  score_quant_avx2_##suffix (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates) \
+  { \
+    return score_rows_quant_avx2 (predictions, num_anchors, classes, cutoff, score_lut, threshold, candidates); \
+  }
+#else
+#define DEFINE_AVX2_SCORE_KERNEL(suffix, classes)
+#endif
+
+#define DEFINE_SCORE_KERNELS(suffix, classes) \
+  static guint \
+  score_scalar_##suffix (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates) \
+  { \
+    return score_rows_scalar (predictions, num_anchors, classes, threshold, cutoff, candidates); \
+  } \
+  static guint \
+  score_quant_scalar_##suffix (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates) \
+  { \
+    return score_rows_quant_scalar (predictions, num_anchors, classes, cutoff, score_lut, threshold, candidates); \
+  } \
+  DEFINE_SSE2_SCORE_KERNEL (suffix, classes) \
+  DEFINE_AVX2_SCORE_KERNEL (suffix, classes)
+
+DEFINE_SCORE_KERNELS (generic, num_classes)
+DEFINE_SCORE_KERNELS (91, 91)   /* COCO heads: 1917 and 2034 anchors */
+DEFINE_SCORE_KERNELS (601, 601) /* Open Images heads: 1917 anchors */
+
+/**
+ * @brief Scoring kernels for one class count, one per instruction set.
+ */
+typedef struct _ScoreKernels
+{
+  guint num_anchors; /**< 0: any */
+  guint num_classes; /**< 0: any */
+  ScoreKernelFunc kernel[3]; /**< scalar, SSE2, AVX2; NULL when not built */
+  QuantScoreKernelFunc quant[3]; /**< same, for uint8 logits */
+} ScoreKernels;
+
+#ifdef HAVE_SSE2_KERNELS
+#define SSE2_KERNEL(prefix, suffix) prefix##_sse2_##suffix
+#else
+#define SSE2_KERNEL(prefix, suffix) NULL
+#endif
+#ifdef HAVE_AVX2_KERNELS
+#define AVX2_KERNEL(prefix, suffix) prefix##_avx2_##suffix
+#else
+#define AVX2_KERNEL(prefix, suffix) NULL
+#endif
+#define SCORE_KERNELS(anchors, classes, suffix) \
+  { anchors, classes, \
+    { score_scalar_##suffix, SSE2_KERNEL (score, suffix), AVX2_KERNEL (score, suffix) }, \
+    { score_quant_scalar_##suffix, SSE2_KERNEL (score_quant, suffix), AVX2_KERNEL (score_quant, suffix) } }
+
+static const ScoreKernels score_kernels[] = {
+  SCORE_KERNELS (1917, 91, 91),
+  SCORE_KERNELS (2034, 91, 91),
+  SCORE_KERNELS (1917, 601, 601),
+  SCORE_KERNELS (0, 0, generic),
+};
+
+/**
+ * @brief Widest instruction set usable for scoring: 0 scalar, 1 SSE2, 2 AVX2.
+ *
+ * Setting NNPLUGINS_SIMD to "none" or "sse2" caps the selection, which is
+ * handy for comparing the vector kernels against the scalar fallback.
+ */
+static guint
+simd_level (void)
+{
+  static gsize level = 0;
+  if (g_once_init_enter (&level)) {
+    const gchar *simd = g_getenv ("NNPLUGINS_SIMD");
+    gsize l = 1;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+      l = 3;
+    else if (__builtin_cpu_supports ("sse2"))
+      l = 2;
+#endif
+    if (simd && g_str_equal (simd, "none"))
+      l = 1;
+    else if (simd && g_str_equal (simd, "sse2"))
+      l = MIN (l, 2);
+    g_once_init_leave (&level, l);
+  }
+  return level - 1;
+}
+
+/**
+ * @brief Kernel set for an SSD head of `num_anchors` x `num_classes`; the generic set if not specialized.
+ */
+static const ScoreKernels *
+score_kernels_lookup (guint num_anchors, guint num_classes)
+{
+  const ScoreKernels *k = score_kernels;
+  while (k->num_classes && (k->num_anchors != num_anchors || k->num_classes != num_classes))
+    k++;
+  return k;
+}
+
+/**
+ * @brief Pick the scoring kernel for an SSD head of `num_anchors` x `num_classes`.
+ *
+ * Known shapes get a kernel with the class count folded in; any other shape
+ * gets the generic kernel. Either way the widest supported instruction set is used.
+ */
+ScoreKernelFunc
+score_kernel_select (guint num_anchors, guint num_classes)
+{
+  const ScoreKernels *k = score_kernels_lookup (num_anchors, num_classes);
+  guint level = simd_level ();
+  while (!k->kernel[level])
+    level--;
+  return k->kernel[level];
+}
+
+/**
+ * @brief uint8 counterpart of `score_kernel_select`.
+ */
+QuantScoreKernelFunc
+quant_kernel_select (guint num_anchors, guint num_classes)
+{
+  const ScoreKernels *k = score_kernels_lookup (num_anchors, num_classes);
+  guint level = simd_level ();
+  while (!k->quant[level])
+    level--;
+  return k->quant[level];
+}
+
 /**
- * @brief `qsort` callback: Compare score of detected objects in descending order.
+ * @brief Collect the (anchor, class) pairs of `predictions` that score at least `threshold`.
+ *
+ * `predictions` holds `num_anchors` rows of `num_classes` logits; class 0 is the
+ * background class and is never reported. The threshold is applied in logit
+ * space (`cutoff`, from `score_threshold_to_logit`) so that the sigmoid only
+ * runs on survivors, and results are identical to thresholding `EXPIT` of
+ * every logit. `candidates` must have room for `num_anchors * (num_classes - 1)`
+ * entries, which are emitted in row order.
+ * @return number of candidates written.
  */
-static gint
-compare_detection_scores (const void *A, const void *B)
+guint
+score_candidates (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
 {
-  const DetectedObject *a = (DetectedObject *)A, *b = (DetectedObject *)B;
-  if (a->score > b->score)
-    return -1;
-  else if(a->score < b->score)
-    return 1;
-  else
-    return 0;
+  return score_kernel_select (0, 0) (predictions, num_anchors, num_classes, threshold, cutoff, candidates);
 }
 
 /**
- * @brief Intersection of union
+ * @brief uint8 counterpart of `score_candidates`.
+ *
+ * `cutoff` comes from `score_threshold_to_quant` over `score_lut`, which maps
+ * every code to its score; results match dequantizing `predictions` and
+ * calling `score_candidates` with the same quantization.
  */
-static gfloat
-iou (const DetectedObject *a, const DetectedObject *b)
-{
-  guint x1 = (a->x > b->x)? a->x : b->x;
-  guint y1 = (a->y > b->y)? a->y : b->y;
-  guint ax2 = a->x + a->width;
-  guint bx2 = b->x + b->width;
-  guint ay2 = a->y + a->height;
-  guint by2 = b->y + b->height;
-  guint x2 = (ax2 < bx2)? ax2 : bx2;
-  guint y2 = (ay2 < by2)? ay2 : by2;
-  gfloat w  = (gfloat)x2 - x1;
-  gfloat h  = (gfloat)y2 - y1;
-  gfloat inter = w * h;
-  gfloat areaA = (gfloat)a->width * a->height;
-  gfloat areaB = (gfloat)b->width * b->height;
-  gfloat o = inter / (areaA + areaB - inter);
-  gfloat iou = fmax (0.0f, o);
-  GST_DEBUG("IOU = %e; o = %e; %e x %e", iou, o, w, h);
-  return iou;
+guint
+score_candidates_quant (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates)
+{
+  return quant_kernel_select (0, 0) (predictions, num_anchors, num_classes, cutoff, score_lut, threshold, candidates);
 }
 
 /**
- * @brief NMS (non-maximum suppression)
+ * @brief Class-score cutoff for a YOLO row whose objectness passed: a class
+ * can only give `objectness` x score >= `threshold` if its value is at least this.
+ *
+ * The division is done a few ULPs low so that rounding in the product never
+ * rejects a class the exact check would keep; survivors are re-checked by
+ * `emit_yolo_candidate`.
+ */
+static inline gfloat
+yolo_class_cutoff (gfloat objectness, gfloat threshold, gboolean logits)
+{
+  gfloat t;
+  if (threshold <= 0.f)
+    return -INFINITY;
+  t = (gfloat) ((gdouble) threshold / objectness * (1.0 - 4.0 * FLT_EPSILON));
+  return logits ? score_threshold_to_logit (t) : t;
+}
+
+/**
+ * @brief Score a YOLO class value that passed its cutoff and record it if objectness x score still passes.
+ *
+ * YOLO heads have no background class: class `c` is recorded as `c`, the
+ * model's own class id, and is labelled by line `c` of the labels file.
+ */
+static inline guint
+emit_yolo_candidate (gfloat objectness, gfloat value, guint row, guint class_id, gboolean logits, gfloat threshold, ScoredCandidate *candidates, guint n)
+{
+  gfloat score = objectness * (logits ? EXPIT (value) : value);
+  if (score < threshold)
+    return n;
+  candidates[n].anchor = row;
+  candidates[n].class_id = class_id;
+  candidates[n].score = score;
+  return n + 1;
+}
+
+/*
+ * The YOLO gating kernels come in two layouts. Rows (YOLOv5) are gated on
+ * objectness first: a row whose objectness cannot reach the threshold is
+ * skipped without touching its class scores, and the classes of the others
+ * are compared against a per-row cutoff a vector at a time. Planes (YOLOv8)
+ * have no objectness; each class plane is compared a vector of cells at a time.
+ * `cutoff` is the objectness cutoff of rows and the class cutoff of planes,
+ * in logits when `logits` is set and in probabilities otherwise.
  */
 static guint
-nms (DetectedObject *detections, guint num_detections)
+yolo_score_scalar_rows (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
 {
-  guint i, j, k, num_overlaps = 0, num_nonoverlaps, num_detections_capped;
-  gboolean del[DETECTION_MAX * LABEL_SIZE];
-  if (num_detections > 100)
-    num_detections_capped = 100;
-  else
-    num_detections_capped = num_detections;
-  qsort(detections, num_detections_capped, sizeof(DetectedObject), compare_detection_scores);
-  for (i = 0; i < num_detections_capped; i++) {
-    del[i] = FALSE;
+  guint r, c, n = 0;
+  for (r = 0; r < num_rows; r++, output += stride) {
+    const gfloat *classes = output + YOLO_ROW_CLASSES;
+    gfloat objectness, class_cutoff;
+    if (!(output[YOLO_ROW_CLASSES - 1] >= cutoff))
+      continue;
+    objectness = logits ? EXPIT (output[YOLO_ROW_CLASSES - 1]) : output[YOLO_ROW_CLASSES - 1];
+    class_cutoff = yolo_class_cutoff (objectness, threshold, logits);
+    for (c = 0; c < num_classes; c++) {
+      if (classes[c] >= class_cutoff)
+        n = emit_yolo_candidate (objectness, classes[c], r, c, logits, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+
+static guint
+yolo_score_scalar_planes (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  guint r, c, n = 0;
+  for (c = 0; c < num_classes; c++) {
+    const gfloat *plane = output + (YOLO_PLANE_CLASSES + c) * stride;
+    for (r = 0; r < num_rows; r++) {
+      if (plane[r] >= cutoff)
+        n = emit_yolo_candidate (1.f, plane[r], r, c, logits, threshold, candidates, n);
+    }
   }
-  for (i = 0; i < num_detections_capped; i++) {
-    if (del[i])
+  return n;
+}
+
+#ifdef HAVE_SSE2_KERNELS
+static guint
+yolo_score_sse2_rows (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  guint r, c, n = 0;
+  for (r = 0; r < num_rows; r++, output += stride) {
+    const gfloat *classes = output + YOLO_ROW_CLASSES;
+    gfloat objectness, class_cutoff;
+    __m128 vcutoff;
+    if (!(output[YOLO_ROW_CLASSES - 1] >= cutoff))
       continue;
+    objectness = logits ? EXPIT (output[YOLO_ROW_CLASSES - 1]) : output[YOLO_ROW_CLASSES - 1];
+    class_cutoff = yolo_class_cutoff (objectness, threshold, logits);
+    vcutoff = _mm_set1_ps (class_cutoff);
+    for (c = 0; c + 4 <= num_classes; c += 4) {
+      guint mask = _mm_movemask_ps (_mm_cmpge_ps (_mm_loadu_ps (classes + c), vcutoff));
+      while (mask) {
+        guint k = c + __builtin_ctz (mask);
+        n = emit_yolo_candidate (objectness, classes[k], r, k, logits, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; c < num_classes; c++) {
+      if (classes[c] >= class_cutoff)
+        n = emit_yolo_candidate (objectness, classes[c], r, c, logits, threshold, candidates, n);
+    }
+  }
+  return n;
+}
 
-    for (j = (i + 1); j < num_detections_capped; j++) {
-      if (!del[j] &&
-        detections[i].class_id == detections[j].class_id &&
-        iou (&detections[i], &detections[j]) > THRESHOLD_IOU
-        ) {
-        del[j] = TRUE;
-        num_overlaps++;
+static guint
+yolo_score_sse2_planes (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  const __m128 vcutoff = _mm_set1_ps (cutoff);
+  guint r, c, n = 0;
+  for (c = 0; c < num_classes; c++) {
+    const gfloat *plane = output + (YOLO_PLANE_CLASSES + c) * stride;
+    for (r = 0; r + 4 <= num_rows; r += 4) {
+      guint mask = _mm_movemask_ps (_mm_cmpge_ps (_mm_loadu_ps (plane + r), vcutoff));
+      while (mask) {
+        guint k = r + __builtin_ctz (mask);
+        n = emit_yolo_candidate (1.f, plane[k], k, c, logits, threshold, candidates, n);
+        mask &= mask - 1;
       }
     }
+    for (; r < num_rows; r++) {
+      if (plane[r] >= cutoff)
+        n = emit_yolo_candidate (1.f, plane[r], r, c, logits, threshold, candidates, n);
+    }
   }
-  num_nonoverlaps = num_detections_capped - num_overlaps;
-  for (i = 0; i < num_nonoverlaps; i++) {
-    if (!del[i])
+  return n;
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+static __attribute__ ((target ("avx2"))) guint
+yolo_score_avx2_rows (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  guint r, c, n = 0;
+  for (r = 0; r < num_rows; r++, output += stride) {
+    const gfloat *classes = output + YOLO_ROW_CLASSES;
+    gfloat objectness, class_cutoff;
+    __m256 vcutoff;
+    if (!(output[YOLO_ROW_CLASSES - 1] >= cutoff))
       continue;
+    objectness = logits ? EXPIT (output[YOLO_ROW_CLASSES - 1]) : output[YOLO_ROW_CLASSES - 1];
+    class_cutoff = yolo_class_cutoff (objectness, threshold, logits);
+    vcutoff = _mm256_set1_ps (class_cutoff);
+    for (c = 0; c + 8 <= num_classes; c += 8) {
+      guint mask = _mm256_movemask_ps (_mm256_cmp_ps (_mm256_loadu_ps (classes + c), vcutoff, _CMP_GE_OQ));
+      while (mask) {
+        guint k = c + __builtin_ctz (mask);
+        n = emit_yolo_candidate (objectness, classes[k], r, k, logits, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; c < num_classes; c++) {
+      if (classes[c] >= class_cutoff)
+        n = emit_yolo_candidate (objectness, classes[c], r, c, logits, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+
+static __attribute__ ((target ("avx2"))) guint
+yolo_score_avx2_planes (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates)
+{
+  const __m256 vcutoff = _mm256_set1_ps (cutoff);
+  guint r, c, n = 0;
+  for (c = 0; c < num_classes; c++) {
+    const gfloat *plane = output + (YOLO_PLANE_CLASSES + c) * stride;
+    for (r = 0; r + 8 <= num_rows; r += 8) {
+      guint mask = _mm256_movemask_ps (_mm256_cmp_ps (_mm256_loadu_ps (plane + r), vcutoff, _CMP_GE_OQ));
+      while (mask) {
+        guint k = r + __builtin_ctz (mask);
+        n = emit_yolo_candidate (1.f, plane[k], k, c, logits, threshold, candidates, n);
+        mask &= mask - 1;
+      }
+    }
+    for (; r < num_rows; r++) {
+      if (plane[r] >= cutoff)
+        n = emit_yolo_candidate (1.f, plane[r], r, c, logits, threshold, candidates, n);
+    }
+  }
+  return n;
+}
+#endif
+
+/**
+ * @brief YOLO gating kernels per head, one per instruction set; NULL when not built.
+ */
+static const YoloScoreKernelFunc yolo_kernels[2][3] = {
+  { yolo_score_scalar_rows, SSE2_KERNEL (yolo_score, rows), AVX2_KERNEL (yolo_score, rows) },
+  { yolo_score_scalar_planes, SSE2_KERNEL (yolo_score, planes), AVX2_KERNEL (yolo_score, planes) },
+};
+
+/**
+ * @brief Pick the gating kernel of `head` for the widest supported instruction set.
+ */
+static YoloScoreKernelFunc
+yolo_kernel_select (YoloHead head)
+{
+  guint level = simd_level ();
+  while (!yolo_kernels[head][level])
+    level--;
+  return yolo_kernels[head][level];
+}
+
+/**
+ * @brief Objectness cutoff of rows, class cutoff of planes; see `yolo_score_candidates`.
+ */
+static gfloat
+yolo_score_cutoff (gboolean logits, gfloat threshold)
+{
+  return logits ? score_threshold_to_logit (threshold) : threshold;
+}
+
+/**
+ * @brief Collect the (row, class) pairs of a YOLO output whose objectness x class score is at least `threshold`.
+ *
+ * For YOLO_HEAD_ANCHORS, `output` holds `num_rows` rows of `stride` values;
+ * for YOLO_HEAD_ANCHOR_FREE, it points at the first of `num_rows` columns of
+ * planes `stride` values apart. Scores are sigmoids of logits when `logits`
+ * is set and probabilities otherwise, and results are identical to computing
+ * and thresholding every product. `candidates` must have room for
+ * `num_rows * num_classes` entries; rows come first for YOLO_HEAD_ANCHORS,
+ * classes for YOLO_HEAD_ANCHOR_FREE. Class ids start at 1.
+ * @return number of candidates written.
+ */
+guint
+yolo_score_candidates (YoloHead head, const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, ScoredCandidate *candidates)
+{
+  return yolo_kernel_select (head) (output, num_rows, stride, num_classes, logits, threshold,
+      yolo_score_cutoff (logits, threshold), candidates);
+}
+
+/**
+ * @brief Make room for one more detection in the slice of `part`.
+ *
+ * A full slice is pruned to the candidates that can pass the top-K limits.
+ * @return TRUE if entries were dropped, so the last one may have changed.
+ */
+static inline gboolean
+decode_partition_reserve (const DecodeArena *arena, DecodePartition *part, DetectedObject *detections)
+{
+  if (G_LIKELY (part->num_detections < arena->partition_capacity))
+    return FALSE;
+  part->num_detections = nms_engine_select (part->select, detections, part->num_detections);
+  return TRUE;
+}
+
+/**
+ * @brief Prune the slice of `part` to the top-K limits once the partition is decoded.
+ */
+static inline void
+decode_partition_finish (const DecodeArena *arena, DecodePartition *part, DetectedObject *detections)
+{
+  if (arena->partition_limit && part->num_detections > arena->partition_limit)
+    part->num_detections = nms_engine_select (part->select, detections, part->num_detections);
+}
 
-    j = i;
-    while(del[i] && j < (num_detections_capped-1)) {
-      for(k = i; k < (num_detections_capped-1); k++) {
-        del[k] = del[k+1];
-        memcpy(&detections[k], &detections[k+1], sizeof(DetectedObject));
+/**
+ * @brief Turn the `n` candidates scored for the chunk starting at `first` into the detections of `part`.
+ *
+ * Exactly one of `boxes` and `qboxes` is set; quantized boxes are dequantized
+ * through `box_lut` only for anchors that have a candidate.
+ */
+static inline void
+emit_detections (const AnchorTable *anchors, const gchar * const *labels, guint num_labels,
+    const gfloat *boxes, const guint8 *qboxes, const gfloat *box_lut, const ScoredCandidate *candidates,
+    guint first, guint n, const DecodeArena *arena, DecodePartition *part, DetectedObject *detections)
+{
+  guint i, decoded = G_MAXUINT;
+  for (i = 0; i < n; i++) {
+    const ScoredCandidate *c = &candidates[i];
+    DetectedObject *o;
+    guint d = first + c->anchor;
+    if (decode_partition_reserve (arena, part, detections))
+      decoded = G_MAXUINT;
+    o = &detections[part->num_detections];
+    /* Only anchors with a surviving class pay for the box decode */
+    if (d != decoded) {
+      if (qboxes) {
+        const guint8 *q = qboxes + (gsize) d * BOX_SIZE;
+        gfloat box[BOX_SIZE];
+        box[0] = box_lut[q[0]];
+        box[1] = box_lut[q[1]];
+        box[2] = box_lut[q[2]];
+        box[3] = box_lut[q[3]];
+        anchor_table_decode (anchors, d, box, o);
+      } else {
+        anchor_table_decode (anchors, d, boxes + (gsize) d * BOX_SIZE, o);
       }
-      j++;
+    } else {
+      *o = detections[part->num_detections - 1];
     }
-    num_detections_capped -= (j-i);
+    decoded = d;
+    o->class_id = c->class_id;
+    o->class_label = (c->class_id < num_labels) ? labels[c->class_id] : NULL;
+    o->score = c->score;
+    part->num_detections++;
+  }
+}
+
+/**
+ * @brief The tensors of one frame, shared by the tasks decoding its partitions.
+ *
+ * Either the float or the uint8 pair of tensors is set.
+ */
+typedef struct _DecodeFrame
+{
+  const AnchorTable *anchors;
+  const gchar * const *labels;
+  guint num_labels;
+  const gfloat *predictions, *boxes;
+  const guint8 *qpredictions, *qboxes;
+  gfloat cutoff;
+  DecodeArena *arena;
+} DecodeFrame;
+
+/**
+ * @brief Score and decode the anchors of partition `p` into its slice of the detections.
+ */
+static void
+decode_partition (gpointer data, guint p)
+{
+  const DecodeFrame *f = data;
+  DecodeArena *arena = f->arena;
+  DecodePartition *part = &arena->partitions[p];
+  guint num_classes = arena->num_classes;
+  guint first = p * DECODE_PARTITION_ANCHORS;
+  guint last = MIN (first + DECODE_PARTITION_ANCHORS, arena->num_anchors);
+  DetectedObject *detections = arena->detections + (gsize) p * arena->partition_capacity;
+  const guint8 *predictions = f->qpredictions ? f->qpredictions : (const guint8 *) f->predictions;
+  gsize row_size = num_classes * (f->qpredictions ? 1 : sizeof (gfloat));
+  guint a, n;
+  part->num_detections = 0;
+  for (a = first; a < last; a += arena->chunk_anchors) {
+    guint chunk = MIN (arena->chunk_anchors, last - a);
+    /* Start on the next chunk's logits while this one is scored; the
+     * hardware prefetcher picks up the stream from there */
+    prefetch_range (predictions + (gsize) (a + chunk) * row_size,
+        MIN ((gsize) (last - a - chunk) * row_size, DECODE_PREFETCH_BYTES));
+    if (f->qpredictions)
+      n = arena->quant_kernel (f->qpredictions + (gsize) a * num_classes, chunk, num_classes,
+          arena->score_cutoff, arena->score_lut, THRESHOLD_SCORE, part->candidates);
+    else
+      n = arena->score_kernel (f->predictions + (gsize) a * num_classes, chunk, num_classes,
+          THRESHOLD_SCORE, f->cutoff, part->candidates);
+    emit_detections (f->anchors, f->labels, f->num_labels, f->boxes, f->qboxes, arena->box_lut,
+        part->candidates, a, n, arena, part, detections);
   }
-  return num_nonoverlaps;
+  decode_partition_finish (arena, part, detections);
 }
 
+/**
+ * @brief Decode all partitions of a frame, merge them in anchor order and run NMS.
+ * @return number of surviving detections.
+ */
+static guint
+decode_frame (DecodeArena *arena, DecodeTaskFunc decode, gconstpointer frame)
+{
+  gsize stride = arena->partition_capacity;
+  guint p, num_detections;
+  decode_pool_run (arena->num_partitions, arena->num_threads, decode, (gpointer) frame);
+  /* Merge: close the gaps between the partitions' slices */
+  num_detections = arena->partitions[0].num_detections;
+  for (p = 1; p < arena->num_partitions; p++) {
+    guint n = arena->partitions[p].num_detections;
+    if (n)
+      memmove (arena->detections + num_detections, arena->detections + p * stride, n * sizeof (DetectedObject));
+    num_detections += n;
+  }
+  return nms_engine_run (arena->nms, arena->detections, num_detections, THRESHOLD_IOU);
+}
 
 /**
  * @brief Get detected objects.
+ *
+ * Survivors are left, best first, in `arena->detections`.
+ */
+gboolean
+get_detected_objects (const AnchorTable *anchors, const gchar * const *labels, guint num_labels, const gfloat *predictions, const gfloat *boxes, DecodeArena *arena, guint *num_detections)
+{
+  DecodeFrame f = { anchors, labels, num_labels, predictions, boxes, NULL, NULL, 0.f, arena };
+  g_return_val_if_fail (anchors->num_anchors == arena->num_anchors && arena->first_class == SSD_FIRST_CLASS, FALSE);
+  f.cutoff = score_threshold_to_logit (THRESHOLD_SCORE);
+  *num_detections = decode_frame (arena, decode_partition, &f);
+  return TRUE;
+}
+
+/**
+ * @brief Get detected objects from uint8-quantized tensors.
+ *
+ * The quantization must have been set with `decode_arena_set_quantization`.
+ * Logits are compared as raw bytes and only surviving scores and boxes are
+ * dequantized. Survivors are left, best first, in `arena->detections`.
+ */
+gboolean
+get_detected_objects_quant (const AnchorTable *anchors, const gchar * const *labels, guint num_labels, const guint8 *predictions, const guint8 *boxes, DecodeArena *arena, guint *num_detections)
+{
+  DecodeFrame f = { anchors, labels, num_labels, NULL, NULL, predictions, boxes, 0.f, arena };
+  g_return_val_if_fail (anchors->num_anchors == arena->num_anchors && arena->first_class == SSD_FIRST_CLASS, FALSE);
+  *num_detections = decode_frame (arena, decode_partition, &f);
+  return TRUE;
+}
+
+/**
+ * @brief The output of one YOLO frame, shared by the tasks decoding its partitions.
+ */
+typedef struct _YoloFrame
+{
+  const YoloParams *params;
+  const AnchorTable *grid; /**< NULL for decoded outputs */
+  const gchar * const *labels;
+  guint num_labels;
+  const gfloat *output;
+  YoloScoreKernelFunc kernel;
+  gfloat cutoff;
+  DecodeArena *arena;
+} YoloFrame;
+
+/**
+ * @brief Decode the box of YOLO output row `r` into `detection`, clamped to the frame.
+ */
+static inline void
+yolo_decode_box (const YoloFrame *f, guint r, DetectedObject *detection)
+{
+  const AnchorTable *grid = f->grid;
+  guint num_rows = f->arena->num_anchors;
+  gboolean planes = f->params->head == YOLO_HEAD_ANCHOR_FREE;
+  gfloat b[BOX_SIZE];
+  gdouble xmin, ymin, xmax, ymax;
+  guint k;
+  for (k = 0; k < BOX_SIZE; k++)
+    b[k] = planes ? f->output[(gsize) k * num_rows + r] : f->output[(gsize) r * (f->arena->num_classes + YOLO_ROW_CLASSES) + k];
+  if (f->params->decoded) {
+    xmin = b[0] - b[2] / 2.f;
+    ymin = b[1] - b[3] / 2.f;
+    xmax = b[0] + b[2] / 2.f;
+    ymax = b[1] + b[3] / 2.f;
+  } else if (planes) {
+    xmin = grid->xcenter[r] - b[0] * grid->xgain[r];
+    ymin = grid->ycenter[r] - b[1] * grid->ygain[r];
+    xmax = grid->xcenter[r] + b[2] * grid->xgain[r];
+    ymax = grid->ycenter[r] + b[3] * grid->ygain[r];
+  } else {
+    gfloat xcenter = EXPIT (b[0]) * grid->xgain[r] + grid->xcenter[r];
+    gfloat ycenter = EXPIT (b[1]) * grid->ygain[r] + grid->ycenter[r];
+    gfloat w = EXPIT (b[2]), h = EXPIT (b[3]);
+    w = w * w * grid->width[r];
+    h = h * h * grid->height[r];
+    xmin = xcenter - w / 2.f;
+    ymin = ycenter - h / 2.f;
+    xmax = xcenter + w / 2.f;
+    ymax = ycenter + h / 2.f;
+  }
+  xmin = CLAMP (xmin, 0.0, 1.0);
+  ymin = CLAMP (ymin, 0.0, 1.0);
+  xmax = CLAMP (xmax, 0.0, 1.0);
+  ymax = CLAMP (ymax, 0.0, 1.0);
+  detection->x = (guint) (xmin * UINT_MAX);
+  detection->y = (guint) (ymin * UINT_MAX);
+  detection->width = xmax > xmin ? (guint) ((xmax - xmin) * UINT_MAX) : 0;
+  detection->height = ymax > ymin ? (guint) ((ymax - ymin) * UINT_MAX) : 0;
+}
+
+/**
+ * @brief Gate and decode the rows of partition `p` into its slice of the detections.
+ */
+static void
+decode_partition_yolo (gpointer data, guint p)
+{
+  const YoloFrame *f = data;
+  DecodeArena *arena = f->arena;
+  DecodePartition *part = &arena->partitions[p];
+  guint num_classes = arena->num_classes;
+  guint first = p * DECODE_PARTITION_ANCHORS;
+  guint last = MIN (first + DECODE_PARTITION_ANCHORS, arena->num_anchors);
+  DetectedObject *detections = arena->detections + (gsize) p * arena->partition_capacity;
+  gboolean planes = f->params->head == YOLO_HEAD_ANCHOR_FREE;
+  gsize stride = planes ? arena->num_anchors : num_classes + YOLO_ROW_CLASSES;
+  guint r, i, n;
+  part->num_detections = 0;
+  for (r = first; r < last; r += arena->chunk_anchors) {
+    guint chunk = MIN (arena->chunk_anchors, last - r);
+    guint decoded = G_MAXUINT;
+    if (!planes)
+      prefetch_range (f->output + (gsize) (r + chunk) * stride,
+          MIN ((gsize) (last - r - chunk) * stride * sizeof (gfloat), DECODE_PREFETCH_BYTES));
+    n = f->kernel (planes ? f->output + r : f->output + (gsize) r * stride, chunk, stride, num_classes,
+        !f->params->decoded, f->params->score_threshold, f->cutoff, part->candidates);
+    for (i = 0; i < n; i++) {
+      const ScoredCandidate *c = &part->candidates[i];
+      DetectedObject *o;
+      guint d = r + c->anchor;
+      if (decode_partition_reserve (arena, part, detections))
+        decoded = G_MAXUINT;
+      o = &detections[part->num_detections];
+      /* Rows come out with all their classes together; decode each box once */
+      if (d != decoded)
+        yolo_decode_box (f, d, o);
+      else
+        *o = detections[part->num_detections - 1];
+      decoded = d;
+      o->class_id = c->class_id;
+      o->class_label = (c->class_id < f->num_labels) ? f->labels[c->class_id] : NULL;
+      o->score = c->score;
+      part->num_detections++;
+    }
+  }
+  decode_partition_finish (arena, part, detections);
+}
+
+/**
+ * @brief Get detected objects from the output of a YOLO head.
+ *
+ * `arena` is sized for the head's rows and classes, with class ids from 0 as
+ * the model numbers them; `grid` comes from `anchor_table_generate_yolo` and may
+ * be NULL for decoded outputs. Candidates go through the same NMS as SSD's,
+ * and survivors are left, best first, in `arena->detections`.
  */
 gboolean
-get_detected_objects (gfloat box_priors[BOX_SIZE][DETECTION_MAX], const gchar *labels[LABEL_SIZE], const gfloat *predictions, const gfloat *boxes, DetectedObject *detections, guint *num_detections)
-{
-  *num_detections = 0;
-  guint d, l;
-  for (d = 0; d < DETECTION_MAX; d++) {
-    gfloat ycenter = ((boxes[0] / Y_SCALE) * box_priors[2][d]) + box_priors[0][d];
-    gfloat xcenter = ((boxes[1] / X_SCALE) * box_priors[3][d]) + box_priors[1][d];
-    gfloat h = (gfloat) expf (boxes[2] / H_SCALE) * box_priors[2][d];
-    gfloat w = (gfloat) expf (boxes[3] / W_SCALE) * box_priors[3][d];
-
-    gfloat ymin = ycenter - h / 2.f;
-    gfloat xmin = xcenter - w / 2.f;
-    gfloat ymax = ycenter + h / 2.f;
-    gfloat xmax = xcenter + w / 2.f;
-
-    for (l = 1; l < LABEL_SIZE; l++) {
-      gfloat score = EXPIT (predictions[l]);
-      /**
-       * This score cutoff is taken from Tensorflow's demo app.
-       * There are quite a lot of nodes to be run to convert it to the useful possibility
-       * scores. As a result of that, this cutoff will cause it to lose good detections in
-       * some scenarios and generate too much noise in other scenario.
-       */
-      if (score < THRESHOLD_SCORE)
-        continue;
-
-      detections[*num_detections].class_id = l;
-      detections[*num_detections].class_label = labels[l];
-      detections[*num_detections].x = UINT_MAX * xmin;
-      detections[*num_detections].y = UINT_MAX * ymin;
-      detections[*num_detections].width = UINT_MAX * (xmax - xmin);
-      detections[*num_detections].height = UINT_MAX * (ymax - ymin);
-      detections[*num_detections].score = score;
-      (*num_detections)++;
-    }
-    predictions += LABEL_SIZE;
-    boxes += BOX_SIZE;
-  }
-  *num_detections = nms (detections, *num_detections);
+get_detected_objects_yolo (const YoloParams *params, const AnchorTable *grid, const gchar * const *labels, guint num_labels, const gfloat *output, DecodeArena *arena, guint *num_detections)
+{
+  YoloFrame f = { params, grid, labels, num_labels, output, NULL, 0.f, arena };
+  g_return_val_if_fail (arena->first_class == YOLO_FIRST_CLASS, FALSE);
+  g_return_val_if_fail (params->decoded || (grid && grid->num_anchors == arena->num_anchors), FALSE);
+  f.kernel = yolo_kernel_select (params->head);
+  f.cutoff = yolo_score_cutoff (!params->decoded, params->score_threshold);
+  *num_detections = decode_frame (arena, decode_partition_yolo, &f);
   return TRUE;
 }
 
+/**
+ * @brief Index of the first highest of `num_classes` scores.
+ */
+static inline __attribute__ ((always_inline)) guint
+argmax_scalar (const gfloat *scores, guint num_classes)
+{
+  guint c, best = 0;
+  for (c = 1; c < num_classes; c++) {
+    if (scores[c] > scores[best])
+      best = c;
+  }
+  return best;
+}
+
+/*
+ * The vector argmax runs in two passes over a pixel's scores, which stay in
+ * L1: a vertical max across vectors of classes reduced to the highest score,
+ * then a compare against it to find the first class holding it. Ties thus go
+ * to the lowest class, as in the scalar scan; scores must not be NaN.
+ */
+#ifdef HAVE_SSE2_KERNELS
+static inline __attribute__ ((always_inline)) guint
+argmax_sse2 (const gfloat *scores, guint num_classes)
+{
+  __m128 vmax;
+  gfloat best;
+  guint c;
+  if (num_classes < 4)
+    return argmax_scalar (scores, num_classes);
+  vmax = _mm_loadu_ps (scores);
+  for (c = 4; c + 4 <= num_classes; c += 4)
+    vmax = _mm_max_ps (vmax, _mm_loadu_ps (scores + c));
+  vmax = _mm_max_ps (vmax, _mm_shuffle_ps (vmax, vmax, _MM_SHUFFLE (1, 0, 3, 2)));
+  vmax = _mm_max_ps (vmax, _mm_shuffle_ps (vmax, vmax, _MM_SHUFFLE (2, 3, 0, 1)));
+  best = _mm_cvtss_f32 (vmax);
+  for (; c < num_classes; c++)
+    best = MAX (best, scores[c]);
+  vmax = _mm_set1_ps (best);
+  for (c = 0; c + 4 <= num_classes; c += 4) {
+    guint mask = _mm_movemask_ps (_mm_cmpeq_ps (_mm_loadu_ps (scores + c), vmax));
+    if (mask)
+      return c + __builtin_ctz (mask);
+  }
+  for (; c < num_classes; c++) {
+    if (scores[c] == best)
+      return c;
+  }
+  return 0;
+}
+
+static void
+segmap_argmax_sse2_float (const gfloat *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence)
+{
+  guint p;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint c = argmax_sse2 (scores, num_classes);
+    classes[p] = c;
+    if (confidence)
+      confidence[p] = scores[c];
+  }
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+static inline __attribute__ ((always_inline, target ("avx2"))) guint
+argmax_avx2 (const gfloat *scores, guint num_classes)
+{
+  __m256 vmax;
+  __m128 vmax4;
+  gfloat best;
+  guint c;
+  if (num_classes < 8)
+    return argmax_scalar (scores, num_classes);
+  vmax = _mm256_loadu_ps (scores);
+  for (c = 8; c + 8 <= num_classes; c += 8)
+    vmax = _mm256_max_ps (vmax, _mm256_loadu_ps (scores + c));
+  vmax4 = _mm_max_ps (_mm256_castps256_ps128 (vmax), _mm256_extractf128_ps (vmax, 1));
+  vmax4 = _mm_max_ps (vmax4, _mm_shuffle_ps (vmax4, vmax4, _MM_SHUFFLE (1, 0, 3, 2)));
+  vmax4 = _mm_max_ps (vmax4, _mm_shuffle_ps (vmax4, vmax4, _MM_SHUFFLE (2, 3, 0, 1)));
+  best = _mm_cvtss_f32 (vmax4);
+  for (; c < num_classes; c++)
+    best = MAX (best, scores[c]);
+  vmax = _mm256_set1_ps (best);
+  for (c = 0; c + 8 <= num_classes; c += 8) {
+    guint mask = _mm256_movemask_ps (_mm256_cmp_ps (_mm256_loadu_ps (scores + c), vmax, _CMP_EQ_OQ));
+    if (mask)
+      return c + __builtin_ctz (mask);
+  }
+  for (; c < num_classes; c++) {
+    if (scores[c] == best)
+      return c;
+  }
+  return 0;
+}
+
+static __attribute__ ((target ("avx2"))) void
+segmap_argmax_avx2_float (const gfloat *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence)
+{
+  guint p;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint c = argmax_avx2 (scores, num_classes);
+    classes[p] = c;
+    if (confidence)
+      confidence[p] = scores[c];
+  }
+}
+#endif
+
+static void
+segmap_argmax_scalar_float (const gfloat *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence)
+{
+  guint p;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint c = argmax_scalar (scores, num_classes);
+    classes[p] = c;
+    if (confidence)
+      confidence[p] = scores[c];
+  }
+}
+
+/**
+ * @brief Argmax kernels, one per instruction set; NULL when not built.
+ */
+static const SegmapArgmaxFunc segmap_kernels[3] = {
+  segmap_argmax_scalar_float, SSE2_KERNEL (segmap_argmax, float), AVX2_KERNEL (segmap_argmax, float),
+};
+
+/**
+ * @brief Class index of each of `num_pixels` pixels of `num_classes` float32 scores.
+ *
+ * Scores are pixel-major, classes innermost, as in a C:W:H tensor. Each pixel
+ * gets the lowest class with the highest score, as with a scalar scan. With
+ * `confidence` set, it also gets that score. At most SEGMAP_MAX_CLASSES classes.
+ */
+void
+segmap_argmax (const gfloat *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence)
+{
+  guint level = simd_level ();
+  while (!segmap_kernels[level])
+    level--;
+  segmap_kernels[level] (scores, num_pixels, num_classes, classes, confidence);
+}
+
+/**
+ * @brief Index of the first highest of `num_classes` uint8 scores.
+ */
+static inline __attribute__ ((always_inline)) guint
+argmax_quant_scalar (const guint8 *scores, guint num_classes)
+{
+  guint c, best = 0;
+  for (c = 1; c < num_classes; c++) {
+    if (scores[c] > scores[best])
+      best = c;
+  }
+  return best;
+}
+
+/*
+ * Quantized scores are compared as they are: with a positive scale,
+ * dequantizing is monotonic and cannot move the argmax. The byte-wide kernels
+ * thus take 16 or 32 classes per compare, and only the winning code of a pixel
+ * is dequantized, and only for confidence.
+ */
+#ifdef HAVE_SSE2_KERNELS
+static inline __attribute__ ((always_inline)) guint
+argmax_quant_sse2 (const guint8 *scores, guint num_classes)
+{
+  __m128i vmax;
+  guint best, c;
+  if (num_classes < 16)
+    return argmax_quant_scalar (scores, num_classes);
+  vmax = _mm_loadu_si128 ((const __m128i *) scores);
+  for (c = 16; c + 16 <= num_classes; c += 16)
+    vmax = _mm_max_epu8 (vmax, _mm_loadu_si128 ((const __m128i *) (scores + c)));
+  vmax = _mm_max_epu8 (vmax, _mm_srli_si128 (vmax, 8));
+  vmax = _mm_max_epu8 (vmax, _mm_srli_si128 (vmax, 4));
+  vmax = _mm_max_epu8 (vmax, _mm_srli_si128 (vmax, 2));
+  vmax = _mm_max_epu8 (vmax, _mm_srli_si128 (vmax, 1));
+  best = _mm_cvtsi128_si32 (vmax) & 0xff;
+  for (; c < num_classes; c++)
+    best = MAX (best, scores[c]);
+  vmax = _mm_set1_epi8 ((gchar) best);
+  for (c = 0; c + 16 <= num_classes; c += 16) {
+    guint mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) (scores + c)), vmax));
+    if (mask)
+      return c + __builtin_ctz (mask);
+  }
+  for (; c < num_classes; c++) {
+    if (scores[c] == best)
+      return c;
+  }
+  return 0;
+}
+
+static void
+segmap_argmax_sse2_quant (const guint8 *scores, guint num_pixels, guint num_classes, const QuantParams *quant,
+    guint8 *classes, gfloat *confidence)
+{
+  const gfloat zero_point = quant->zero_point, scale = quant->scale;
+  guint p;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint c = argmax_quant_sse2 (scores, num_classes);
+    classes[p] = c;
+    if (confidence)
+      confidence[p] = (scores[c] - zero_point) * scale;
+  }
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+static inline __attribute__ ((always_inline, target ("avx2"))) guint
+argmax_quant_avx2 (const guint8 *scores, guint num_classes)
+{
+  __m256i vmax;
+  __m128i vmax16;
+  guint best, c;
+  /* DeepLab's 21 classes fit the SSE2 compare */
+  if (num_classes < 32)
+#ifdef HAVE_SSE2_KERNELS
+    return argmax_quant_sse2 (scores, num_classes);
+#else
+    return argmax_quant_scalar (scores, num_classes);
+#endif
+  vmax = _mm256_loadu_si256 ((const __m256i *) scores);
+  for (c = 32; c + 32 <= num_classes; c += 32)
+    vmax = _mm256_max_epu8 (vmax, _mm256_loadu_si256 ((const __m256i *) (scores + c)));
+  vmax16 = _mm_max_epu8 (_mm256_castsi256_si128 (vmax), _mm256_extracti128_si256 (vmax, 1));
+  vmax16 = _mm_max_epu8 (vmax16, _mm_srli_si128 (vmax16, 8));
+  vmax16 = _mm_max_epu8 (vmax16, _mm_srli_si128 (vmax16, 4));
+  vmax16 = _mm_max_epu8 (vmax16, _mm_srli_si128 (vmax16, 2));
+  vmax16 = _mm_max_epu8 (vmax16, _mm_srli_si128 (vmax16, 1));
+  best = _mm_cvtsi128_si32 (vmax16) & 0xff;
+  for (; c < num_classes; c++)
+    best = MAX (best, scores[c]);
+  vmax = _mm256_set1_epi8 ((gchar) best);
+  for (c = 0; c + 32 <= num_classes; c += 32) {
+    guint mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i *) (scores + c)), vmax));
+    if (mask)
+      return c + __builtin_ctz (mask);
+  }
+  for (; c < num_classes; c++) {
+    if (scores[c] == best)
+      return c;
+  }
+  return 0;
+}
+
+static __attribute__ ((target ("avx2"))) void
+segmap_argmax_avx2_quant (const guint8 *scores, guint num_pixels, guint num_classes, const QuantParams *quant,
+    guint8 *classes, gfloat *confidence)
+{
+  const gfloat zero_point = quant->zero_point, scale = quant->scale;
+  guint p;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint c = argmax_quant_avx2 (scores, num_classes);
+    classes[p] = c;
+    if (confidence)
+      confidence[p] = (scores[c] - zero_point) * scale;
+  }
+}
+#endif
+
+static void
+segmap_argmax_scalar_quant (const guint8 *scores, guint num_pixels, guint num_classes, const QuantParams *quant,
+    guint8 *classes, gfloat *confidence)
+{
+  const gfloat zero_point = quant->zero_point, scale = quant->scale;
+  guint p;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint c = argmax_quant_scalar (scores, num_classes);
+    classes[p] = c;
+    if (confidence)
+      confidence[p] = (scores[c] - zero_point) * scale;
+  }
+}
+
+/**
+ * @brief Quantized argmax kernels, one per instruction set; NULL when not built.
+ */
+static const SegmapArgmaxQuantFunc segmap_quant_kernels[3] = {
+  segmap_argmax_scalar_quant, SSE2_KERNEL (segmap_argmax, quant), AVX2_KERNEL (segmap_argmax, quant),
+};
+
+/**
+ * @brief Class index of each pixel of uint8 scores quantized by `quant`, which must have a positive scale.
+ *
+ * The argmax runs on the codes without dequantizing them, with the tie rule
+ * of `segmap_argmax`. With `confidence` set, each pixel also gets its winning
+ * score, dequantized.
+ */
+void
+segmap_argmax_quant (const guint8 *scores, guint num_pixels, guint num_classes, const QuantParams *quant,
+    guint8 *classes, gfloat *confidence)
+{
+  guint level = simd_level ();
+  while (!segmap_quant_kernels[level])
+    level--;
+  segmap_quant_kernels[level] (scores, num_pixels, num_classes, quant, classes, confidence);
+}
+
+/**
+ * @brief int64 counterpart of `segmap_argmax`.
+ */
+void
+segmap_argmax_int64 (const gint64 *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence)
+{
+  guint p, c;
+  for (p = 0; p < num_pixels; p++, scores += num_classes) {
+    guint best = 0;
+    for (c = 1; c < num_classes; c++) {
+      if (scores[c] > scores[best])
+        best = c;
+    }
+    classes[p] = best;
+    if (confidence)
+      confidence[p] = (gfloat) scores[best];
+  }
+}
+
+/**
+ * @brief Narrow the class indices of a model that argmaxes in-graph to uint8.
+ *
+ * `indices` holds one int64, int32 or uint8 index per pixel; indices outside
+ * 0..255 are clamped. Returns FALSE for other types.
+ */
+gboolean
+segmap_from_indices (gconstpointer indices, tensor_type type, guint num_pixels, guint8 *classes)
+{
+  guint p;
+  switch (type) {
+    case _NNS_INT64:
+      for (p = 0; p < num_pixels; p++)
+        classes[p] = CLAMP (((const gint64 *) indices)[p], 0, 255);
+      return TRUE;
+    case _NNS_INT32:
+      for (p = 0; p < num_pixels; p++)
+        classes[p] = CLAMP (((const gint32 *) indices)[p], 0, 255);
+      return TRUE;
+    case _NNS_UINT8:
+      memcpy (classes, indices, num_pixels);
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
 /**
  * @brief Read strings from file.
  */
@@ -167,14 +3300,33 @@ read_lines (const gchar *file_name, GList **lines)
   }
   while ((nread = getline (&line, &len, stream)) != -1) {
     line[nread-1] = '\0'; /* remove extraneous newline character */
-    *lines = g_list_append (*lines, g_strdup (line));
+    *lines = g_list_prepend (*lines, g_strdup (line));
   }
+  *lines = g_list_reverse (*lines);
   free (line);
   fclose(stream);
 
   return TRUE;
 }
 
+/**
+ * @brief Read one label per line into a NULL-terminated array. Free with `g_strfreev`.
+ */
+gchar **
+tflite_read_labels (const gchar *labels_path, guint *num_labels)
+{
+  GList *lines = NULL, *l;
+  gchar **labels;
+  guint i = 0;
+  g_return_val_if_fail (read_lines (labels_path, &lines), NULL);
+  labels = g_new0 (gchar *, g_list_length (lines) + 1);
+  for (l = lines; l; l = l->next)
+    labels[i++] = l->data;
+  g_list_free (lines);
+  *num_labels = i;
+  return labels;
+}
+
 /**
  * @brief Load labels.
  */
@@ -182,11 +3334,12 @@ gboolean
 tflite_load_labels (const gchar *labels_path, const gchar *labels[LABEL_SIZE])
 {
   guint i;
-  GList *lines = NULL;
+  GList *lines = NULL, *l;
   g_return_val_if_fail(read_lines (labels_path, &lines), FALSE);
-  for (i = 0; i < LABEL_SIZE; i++) {
-    labels[i] = (gchar *) g_list_nth_data (lines, i);
+  for (i = 0, l = lines; i < LABEL_SIZE; i++, l = l ? l->next : NULL) {
+    labels[i] = l ? (gchar *) l->data : NULL;
   }
+  g_list_free (lines);
   return TRUE;
 }
 
@@ -7,6 +7,7 @@
 
 #include <gst/gst.h>
 #include <nnstreamer/tensor_typedef.h>
+#include "gsttensordetectionsmeta.h"
 
 G_BEGIN_DECLS
 
@@ -14,7 +15,7 @@ G_BEGIN_DECLS
 #define TENSOR_CAPS_STRING GST_TENSOR_CAP_DEFAULT "; " GST_TENSORS_CAP_DEFAULT
 #define VIDEO_CAPS_STRING GST_VIDEO_CAPS_MAKE(GST_VIDEO_FORMATS_ALL)
 
-/* FIXME: Consider making these properties with default values */
+/* Defaults; the model geometry is negotiated from caps and the scales are element properties */
 #define Y_SCALE         10.0f
 #define X_SCALE         10.0f
 #define H_SCALE         5.0f
@@ -24,7 +25,30 @@ G_BEGIN_DECLS
 #define LABEL_SIZE      91
 #define THRESHOLD_SCORE 0.5f
 #define THRESHOLD_IOU   0.0f
+#define DEFAULT_MAX_DETECTIONS 100
+#define DEFAULT_MAX_PER_CLASS  0
+#define DEFAULT_ANCHOR_FEATURE_MAPS  "19,10,5,3,2,1" /* SSD MobileNet v1, 300x300 */
+#define DEFAULT_ANCHOR_ASPECT_RATIOS "1,2,0.5,3,0.3333"
+#define DEFAULT_ANCHOR_MIN_SCALE     0.2f
+#define DEFAULT_ANCHOR_MAX_SCALE     0.95f
+#define BOX_ZERO_POINT   180 /* SSD MobileNet v1 quantized box-encodings */
+#define BOX_QUANT_SCALE  0.0448576174609375
+#define SCORE_ZERO_POINT 128 /* SSD MobileNet v1 quantized class logits */
+#define SCORE_QUANT_SCALE 0.0078125
 #define EXPIT(x) (1.f / (1.f + expf (-x)))
+#define DECODE_ALIGNMENT 64 /* bytes; one cache line */
+#define DECODE_CHUNK_ANCHORS 64 /* most anchors scored per kernel call */
+#define DECODE_L2_CACHE_SIZE (256 * 1024) /* bytes; assumed if the L2 size cannot be queried */
+#define DECODE_PREFETCH_BYTES 4096 /* logits prefetched ahead of each chunk; one page */
+#define DECODE_PARTITION_ANCHORS 4096 /* anchors per parallel task within a frame; a multiple of DECODE_CHUNK_ANCHORS */
+#define DEFAULT_YOLO_INPUT_SIZE "640"
+#define DEFAULT_YOLO_STRIDES    "8,16,32"
+#define DEFAULT_YOLO_ANCHORS    "10,13,16,30,33,23;30,61,62,45,59,119;116,90,156,198,373,326" /* YOLOv5 COCO, input pixels */
+#define DEFAULT_YOLO_SCORE_THRESHOLD 0.25f /* as YOLOv5 and YOLOv8 exports are usually run */
+#define SSD_FIRST_CLASS  1 /* SSD logits start with the background class, which is never scored */
+#define YOLO_FIRST_CLASS 0 /* YOLO heads have no background class */
+#define SEGMAP_MAX_CLASSES 256 /* class indices are uint8 */
+#define SYNC_WINDOW_SIZE 16 /* decoded results kept for frames still to come */
 
 typedef struct _DetectedObject
 {
@@ -37,10 +61,410 @@ typedef struct _DetectedObject
   gfloat score;
 } DetectedObject;
 
+/**
+ * @brief An (anchor, class) pair whose score passed the score threshold.
+ */
+typedef struct _ScoredCandidate
+{
+  guint anchor;
+  guint class_id;
+  gfloat score;
+} ScoredCandidate;
+
 gboolean read_lines (const gchar *file_name, GList **lines);
+gchar **tflite_read_labels (const gchar *labels_path, guint *num_labels);
 gboolean tflite_load_labels (const gchar *labels_path, const gchar *labels[LABEL_SIZE]);
 gboolean tflite_load_box_priors (const gchar *box_priors_path, gfloat box_priors[BOX_SIZE][DETECTION_MAX]);
-gboolean get_detected_objects (gfloat box_priors[BOX_SIZE][DETECTION_MAX], const gchar *labels[LABEL_SIZE], const gfloat *predictions, const gfloat *boxes, DetectedObject *detections, guint *num_detections);
+/**
+ * @brief Decode-ready anchor priors in structure-of-arrays layout.
+ *
+ * Each plane holds `num_anchors` floats and starts on a `DECODE_ALIGNMENT`
+ * boundary. The box-coder scales are folded in when the table is built so
+ * that decoding an anchor is two multiply-adds and two `expf` calls; the
+ * scales below are the BoxScales in effect then, from the y-scale to w-scale
+ * properties or the bundle.
+ */
+typedef struct _AnchorTable
+{
+  guint num_anchors;
+  gfloat *ycenter;  /**< prior y-centre */
+  gfloat *xcenter;  /**< prior x-centre */
+  gfloat *ygain;    /**< prior height / y_scale */
+  gfloat *xgain;    /**< prior width / x_scale */
+  gfloat *height;   /**< prior height */
+  gfloat *width;    /**< prior width */
+  gfloat y_scale;  /**< BoxScales.y the table was built with */
+  gfloat x_scale;  /**< BoxScales.x the table was built with */
+  gfloat h_scale;  /**< BoxScales.h the table was built with */
+  gfloat w_scale;  /**< BoxScales.w the table was built with */
+  gfloat h_gain;    /**< 1 / h_scale */
+  gfloat w_gain;    /**< 1 / w_scale */
+  GMappedFile *mapping; /**< asset bundle backing the planes, NULL if they were allocated */
+} AnchorTable;
+
+#define SSD_MAX_LAYERS        8
+#define SSD_MAX_ASPECT_RATIOS 8
+
+/**
+ * @brief Parameters of an SSD anchor grid, following the TensorFlow Object
+ * Detection API's `ssd_anchor_generator` (MultipleGridAnchorGenerator).
+ *
+ * Layer `l` has a scale interpolated linearly from `min_scale` to `max_scale`
+ * and one box per aspect ratio, plus one of aspect ratio
+ * `interpolated_scale_aspect_ratio` (if > 0) whose scale is the geometric mean
+ * of this layer's and the next one's. With `reduce_boxes_in_lowest_layer`, the
+ * first layer instead gets (0.1, 1), (scale, 2) and (scale, 0.5). Anchors are
+ * centred on the cells of each feature map and ordered by layer, row, column
+ * and box.
+ */
+typedef struct _SsdAnchorParams
+{
+  guint num_layers;
+  guint feature_map_height[SSD_MAX_LAYERS];
+  guint feature_map_width[SSD_MAX_LAYERS];
+  gfloat min_scale;
+  gfloat max_scale;
+  guint num_aspect_ratios;
+  gfloat aspect_ratios[SSD_MAX_ASPECT_RATIOS];
+  gfloat interpolated_scale_aspect_ratio;
+  gboolean reduce_boxes_in_lowest_layer;
+} SsdAnchorParams;
+
+#define YOLO_MAX_LEVELS   8
+#define YOLO_MAX_ANCHORS  8 /* per cell and level */
+#define YOLO_ROW_CLASSES  5 /* x, y, w, h and objectness precede the class scores of a YOLO_HEAD_ANCHORS row */
+#define YOLO_PLANE_CLASSES 4 /* x, y, w, h precede the class scores of a YOLO_HEAD_ANCHOR_FREE output */
+
+/**
+ * @brief Output layout of a YOLO detection head.
+ */
+typedef enum _YoloHead
+{
+  YOLO_HEAD_ANCHORS,     /**< YOLOv5: one row of x, y, w, h, objectness and class scores per anchor of each cell */
+  YOLO_HEAD_ANCHOR_FREE  /**< YOLOv8: planes of box coordinates and class scores, one column per cell */
+} YoloHead;
+
+/**
+ * @brief Geometry of a YOLO model's output.
+ *
+ * Rows are ordered by level, anchor, row and column for YOLO_HEAD_ANCHORS and
+ * by level, row and column for YOLO_HEAD_ANCHOR_FREE, as the heads concatenate
+ * them. Raw outputs are decoded against the grid of each level: YOLOv5 boxes
+ * as `(2 sigmoid (t) - 0.5 + cell) * stride` and `(2 sigmoid (t))^2 * anchor`,
+ * YOLOv8 boxes as left, top, right and bottom distances from the cell centre in
+ * strides, and scores are logits. With `decoded`, the model has done that
+ * itself: boxes are normalized centre and size, scores are probabilities.
+ * Detections score `score_threshold` or more.
+ */
+typedef struct _YoloParams
+{
+  YoloHead head;
+  gboolean decoded;
+  guint input_height;
+  guint input_width;
+  guint num_levels;
+  guint strides[YOLO_MAX_LEVELS];
+  guint num_anchor_levels;
+  guint num_anchors; /**< per cell on every level; YOLO_HEAD_ANCHORS only */
+  gfloat anchors[YOLO_MAX_LEVELS][2 * YOLO_MAX_ANCHORS]; /**< width, height pairs in input pixels */
+  gfloat score_threshold;
+} YoloParams;
+
+#define ASSET_BUNDLE_MAGIC      "NNPBNDL"
+#define ASSET_BUNDLE_VERSION    1
+#define ASSET_BUNDLE_BYTE_ORDER 0x01020304
+#define ASSET_BUNDLE_RANK       4
+
+/**
+ * @brief On-disk header of an asset bundle; see `asset_bundle_open`.
+ *
+ * Fields are in the byte order of the host that wrote the bundle, recorded in
+ * `byte_order`. The six anchor planes follow `AnchorTable` order (ycenter,
+ * xcenter, ygain, xgain, height, width) with the gains already folded for the
+ * stored scales; they start at `anchors_offset` and are `anchor_stride` bytes
+ * apart, both multiples of DECODE_ALIGNMENT. The label section holds
+ * `num_labels` guint32 offsets followed by the NUL-terminated strings they
+ * point to, relative to the end of the offset table.
+ */
+typedef struct _AssetBundleHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 num_anchors;
+  guint32 num_labels;
+  guint32 boxes_dim[ASSET_BUNDLE_RANK];       /**< innermost first, as in caps */
+  guint32 predictions_dim[ASSET_BUNDLE_RANK];
+  gfloat y_scale;
+  gfloat x_scale;
+  gfloat h_scale;
+  gfloat w_scale;
+  guint64 anchors_offset;
+  guint64 anchor_stride;
+  guint64 labels_offset;
+  guint64 labels_size;
+} AssetBundleHeader;
+
+/**
+ * @brief A memory-mapped asset bundle.
+ *
+ * Nothing is parsed or copied on open: `anchors` and `labels` point into the
+ * mapping, which `anchors` keeps alive on its own so it may outlive the bundle.
+ */
+typedef struct _AssetBundle
+{
+  GMappedFile *file;
+  const AssetBundleHeader *header;
+  AnchorTable *anchors;
+  const gchar **labels; /**< NULL-terminated */
+  guint num_labels;
+} AssetBundle;
+
+/**
+ * @brief Box-coder scales of an SSD model.
+ */
+typedef struct _BoxScales
+{
+  gfloat y;
+  gfloat x;
+  gfloat h;
+  gfloat w;
+} BoxScales;
+
+/**
+ * @brief Class labels shared through the asset cache.
+ *
+ * The strings are interned with `g_intern_string`, so every decoder in the
+ * process that uses the same label shares one copy of it, and `quarks` holds
+ * their quarks for GstTensorDetectionsMeta.
+ */
+typedef struct _LabelTable
+{
+  guint num_labels;
+  const gchar **labels; /**< NULL-terminated */
+  GQuark *quarks;
+} LabelTable;
+
+/**
+ * @brief Per-class NMS with reusable scratch memory; see `nms_engine_run`.
+ */
+typedef struct _NmsEngine NmsEngine;
+
+/**
+ * @brief Signature of the scoring kernels; see `score_candidates`.
+ */
+typedef guint (*ScoreKernelFunc) (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates);
+
+/**
+ * @brief Signature of the uint8 scoring kernels; see `score_candidates_quant`.
+ */
+typedef guint (*QuantScoreKernelFunc) (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates);
+
+/**
+ * @brief Signature of the YOLO gating kernels; see `yolo_score_candidates`.
+ */
+typedef guint (*YoloScoreKernelFunc) (const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates);
+
+/**
+ * @brief Affine quantization of a uint8 tensor: real = (q - zero_point) * scale.
+ */
+typedef struct _QuantParams
+{
+  gint zero_point;
+  gdouble scale;
+} QuantParams;
+
+/**
+ * @brief Signature of the segmentation argmax kernels; see `segmap_argmax`.
+ */
+typedef void (*SegmapArgmaxFunc) (const gfloat *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence);
+
+/**
+ * @brief Signature of the quantized segmentation argmax kernels; see `segmap_argmax_quant`.
+ */
+typedef void (*SegmapArgmaxQuantFunc) (const guint8 *scores, guint num_pixels, guint num_classes, const QuantParams *quant, guint8 *classes, gfloat *confidence);
+
+/**
+ * @brief Shapes and types of the tensors negotiated on a pad.
+ *
+ * Dimensions follow NNStreamer's innermost-first order, e.g. the SSD box
+ * tensor is BOX_SIZE:DETECTION_MAX:1:1.
+ */
+typedef struct _TensorsShape
+{
+  guint num_tensors;
+  tensor_type types[NNS_TENSOR_SIZE_LIMIT];
+  tensor_dim dims[NNS_TENSOR_SIZE_LIMIT];
+} TensorsShape;
+
+/**
+ * @brief Scratch of one DECODE_PARTITION_ANCHORS range of anchors, decoded by one thread.
+ *
+ * The partition's detections go to its own slice of `DecodeArena.detections`,
+ * `DecodeArena.partition_capacity` entries starting at its index times that.
+ */
+typedef struct _DecodePartition
+{
+  ScoredCandidate *candidates; /**< scoring output for `chunk_anchors` anchors */
+  guint num_detections;
+  NmsEngine *select;           /**< prunes the slice to the top-K limits when it fills; NULL if it holds every candidate */
+} DecodePartition;
+
+/**
+ * @brief Per-element scratch memory for decoding one frame, sized once at caps time.
+ *
+ * All arrays are `DECODE_ALIGNMENT` aligned and reused for every frame, which
+ * keeps multi-megabyte work arrays off the streaming thread's stack. Frames
+ * with more than DECODE_PARTITION_ANCHORS anchors are scored and decoded in
+ * partitions on up to `num_threads` threads, then merged for NMS.
+ *
+ * Only candidates that can pass the NMS top-K limits are kept, so with a
+ * max-detections of K each partition holds at most 2K of them rather than
+ * one per anchor and class.
+ */
+typedef struct _DecodeArena
+{
+  guint num_anchors;
+  guint num_classes;          /**< class ids are below this */
+  guint first_class;          /**< lowest class id that is scored: SSD_FIRST_CLASS or YOLO_FIRST_CLASS */
+  guint max_candidates;       /**< global top-K before NMS; 0 = unlimited */
+  guint max_per_class;        /**< per-class top-K before NMS; 0 = unlimited */
+  guint max_detections;       /**< capacity of `detections`: num_partitions * partition_capacity */
+  guint partition_capacity;   /**< detections a partition's slice holds */
+  guint partition_limit;      /**< most detections a pruned slice keeps; 0 if slices are never pruned */
+  DetectedObject *detections; /**< candidates, then NMS survivors */
+  guint chunk_anchors;        /**< anchors per kernel call, so a chunk of logits and boxes takes at most half of L2 */
+  guint num_partitions;
+  DecodePartition *partitions;
+  guint num_threads;          /**< threads per frame; 0 = one per processor */
+  ScoreKernelFunc score_kernel; /**< picked for this geometry at negotiation time */
+  QuantScoreKernelFunc quant_kernel; /**< uint8 counterpart of `score_kernel` */
+  gfloat box_lut[256];        /**< dequantized box offset for each uint8 code */
+  gfloat score_lut[256];      /**< EXPIT of the dequantized logit for each uint8 code */
+  guint8 score_cutoff;        /**< lowest uint8 logit whose score can pass THRESHOLD_SCORE */
+  NmsEngine *nms;
+} DecodeArena;
+
+/**
+ * @brief One unit of work for `decode_pool_run`, e.g. one batch entry.
+ */
+typedef void (*DecodeTaskFunc) (gpointer data, guint task);
+
+/**
+ * @brief Items waiting, in arrival order, for the task that decodes them on another thread.
+ *
+ * Only items `counts` accepts, e.g. buffers but not events, take one of the
+ * `capacity` places, so a pushed event never waits for a full queue. `status`
+ * is 0 while the task accepts items; anything else, e.g. a flow return, is
+ * what a push gets back instead of queuing its item.
+ */
+typedef struct _DecodeQueue
+{
+  GQueue items;
+  guint capacity;
+  guint num_counted;          /**< items in `items` that take a place */
+  gboolean busy;              /**< the task is handling an item it popped */
+  gboolean flushing;          /**< stopped: pop returns nothing until `decode_queue_restart` */
+  gint status;
+  gboolean (*counts) (gconstpointer item);
+  GDestroyNotify free_item;
+  GMutex lock;
+  GCond cond;
+} DecodeQueue;
+
+/**
+ * @brief A decoded result, e.g. the detections of one tensor buffer, and the running time of the frame it belongs to.
+ */
+typedef struct _SyncResult
+{
+  guint64 running_time;
+  gpointer result;
+} SyncResult;
+
+/**
+ * @brief Decoded results waiting for the video frames of the same running time, oldest first.
+ *
+ * Results arrive in running-time order and the window keeps the newest
+ * SYNC_WINDOW_SIZE of them. Those too old for a frame are retired, and the
+ * newest retired one stays as `last` for frames whose own result never
+ * comes. The window does not lock; its owner serializes access.
+ */
+typedef struct _SyncWindow
+{
+  SyncResult results[SYNC_WINDOW_SIZE]; /**< ring of `count` results from `head` */
+  guint head;
+  guint count;
+  gpointer last;
+  GDestroyNotify free_result;
+} SyncWindow;
+
+void decode_arena_set_quantization (DecodeArena *arena, const QuantParams *boxes, const QuantParams *scores);
+gboolean tensor_dim_from_string (const gchar *str, tensor_dim dim);
+gboolean tensors_shape_from_caps (const GstCaps *caps, TensorsShape *shape);
+gsize tensor_type_size (tensor_type type);
+const gchar *tensor_type_to_string (tensor_type type);
+DecodeArena *decode_arena_new (guint num_anchors, guint num_classes, guint first_class, guint max_candidates, guint max_per_class);
+void decode_arena_set_threads (DecodeArena *arena, guint num_threads);
+void decode_arena_free (DecodeArena *arena);
+AnchorTable *anchor_table_new (guint num_anchors);
+AnchorTable *anchor_table_load_box_priors (const gchar *box_priors_path);
+void anchor_table_set_scales (AnchorTable *anchors, gfloat y_scale, gfloat x_scale, gfloat h_scale, gfloat w_scale);
+void anchor_table_free (AnchorTable *anchors);
+void ssd_anchor_params_init (SsdAnchorParams *params);
+gboolean ssd_anchor_params_set_feature_maps (SsdAnchorParams *params, const gchar *feature_maps);
+gboolean ssd_anchor_params_set_aspect_ratios (SsdAnchorParams *params, const gchar *aspect_ratios);
+guint ssd_anchor_count (const SsdAnchorParams *params);
+AnchorTable *anchor_table_generate_ssd (const SsdAnchorParams *params);
+void yolo_params_init (YoloParams *params);
+gboolean yolo_params_set_input_size (YoloParams *params, const gchar *input_size);
+gboolean yolo_params_set_strides (YoloParams *params, const gchar *strides);
+gboolean yolo_params_set_anchors (YoloParams *params, const gchar *anchors);
+guint yolo_grid_count (const YoloParams *params);
+AnchorTable *anchor_table_generate_yolo (const YoloParams *params);
+AssetBundle *asset_bundle_open (const gchar *bundle_path);
+void asset_bundle_close (AssetBundle *bundle);
+gboolean asset_bundle_write (const gchar *bundle_path, const AnchorTable *anchors, const gchar * const *labels, guint num_labels,
+    const tensor_dim boxes_dim, const tensor_dim predictions_dim);
+gboolean asset_bundle_read_header (const gchar *bundle_path, AssetBundleHeader *header);
+const LabelTable *asset_cache_get_labels (const gchar *labels_path);
+const LabelTable *asset_cache_get_bundle_labels (const gchar *bundle_path);
+const AnchorTable *asset_cache_get_box_priors (const gchar *box_priors_path, const BoxScales *scales);
+const AnchorTable *asset_cache_get_bundle_anchors (const gchar *bundle_path, const BoxScales *scales);
+const AnchorTable *asset_cache_get_ssd_anchors (const SsdAnchorParams *params, const BoxScales *scales);
+const AnchorTable *asset_cache_get_yolo_grid (const YoloParams *params);
+void asset_cache_unref (gconstpointer asset);
+void decode_pool_run (guint num_tasks, guint num_threads, DecodeTaskFunc func, gpointer data);
+void decode_queue_init (DecodeQueue *queue, guint capacity, gboolean (*counts) (gconstpointer item), GDestroyNotify free_item);
+void decode_queue_clear (DecodeQueue *queue);
+gint decode_queue_push (DecodeQueue *queue, gpointer item);
+gboolean decode_queue_pop (DecodeQueue *queue, gpointer *item);
+void decode_queue_done (DecodeQueue *queue, gint status);
+void decode_queue_drain (DecodeQueue *queue);
+void decode_queue_stop (DecodeQueue *queue, gint status);
+void decode_queue_restart (DecodeQueue *queue);
+void sync_window_init (SyncWindow *window, GDestroyNotify free_result);
+void sync_window_clear (SyncWindow *window);
+void sync_window_add (SyncWindow *window, guint64 running_time, gpointer result);
+gboolean sync_window_match (SyncWindow *window, guint64 running_time, guint64 tolerance, gpointer *result);
+NmsEngine *nms_engine_new (guint capacity, guint num_classes);
+void nms_engine_free (NmsEngine *nms);
+void nms_engine_set_limits (NmsEngine *nms, guint max_detections, guint max_per_class);
+guint nms_engine_select (NmsEngine *nms, DetectedObject *detections, guint num_detections);
+guint nms_engine_run (NmsEngine *nms, DetectedObject *detections, guint num_detections, gfloat iou_threshold);
+gfloat score_threshold_to_logit (gfloat threshold);
+ScoreKernelFunc score_kernel_select (guint num_anchors, guint num_classes);
+QuantScoreKernelFunc quant_kernel_select (guint num_anchors, guint num_classes);
+guint score_candidates (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, gfloat cutoff, ScoredCandidate *candidates);
+guint8 score_threshold_to_quant (const gfloat score_lut[256], gfloat threshold);
+guint score_candidates_quant (const guint8 *predictions, guint num_anchors, guint num_classes, guint8 cutoff, const gfloat *score_lut, gfloat threshold, ScoredCandidate *candidates);
+guint yolo_score_candidates (YoloHead head, const gfloat *output, guint num_rows, gsize stride, guint num_classes, gboolean logits, gfloat threshold, ScoredCandidate *candidates);
+gboolean get_detected_objects (const AnchorTable *anchors, const gchar * const *labels, guint num_labels, const gfloat *predictions, const gfloat *boxes, DecodeArena *arena, guint *num_detections);
+gboolean get_detected_objects_quant (const AnchorTable *anchors, const gchar * const *labels, guint num_labels, const guint8 *predictions, const guint8 *boxes, DecodeArena *arena, guint *num_detections);
+gboolean get_detected_objects_yolo (const YoloParams *params, const AnchorTable *grid, const gchar * const *labels, guint num_labels, const gfloat *output, DecodeArena *arena, guint *num_detections);
+void segmap_argmax (const gfloat *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence);
+void segmap_argmax_quant (const guint8 *scores, guint num_pixels, guint num_classes, const QuantParams *quant, guint8 *classes, gfloat *confidence);
+void segmap_argmax_int64 (const gint64 *scores, guint num_pixels, guint num_classes, guint8 *classes, gfloat *confidence);
+gboolean segmap_from_indices (gconstpointer indices, tensor_type type, guint num_pixels, guint8 *classes);
 
 G_END_DECLS
 
@@ -0,0 +1,351 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:library-roitracker
+ *
+ * Multi-object tracking of decoded detections
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include "roitracker.h"
+
+#define ROI_TRACK_MIN_SIZE 1e-4f /* keeps boxes and noise scales positive */
+
+/**
+ * @brief Create a tracker of up to `max_tracks` tracks per stream.
+ */
+RoiTracker *
+roi_tracker_new (guint max_tracks)
+{
+  RoiTracker *tracker = g_new0 (RoiTracker, 1);
+  tracker->max_tracks = MAX (max_tracks, 1);
+  tracker->max_age = DEFAULT_MAX_AGE;
+  tracker->min_hits = DEFAULT_MIN_HITS;
+  tracker->iou_threshold = DEFAULT_TRACK_IOU;
+  tracker->next_id = 1;
+  tracker->track_matched = g_new (gboolean, tracker->max_tracks);
+  return tracker;
+}
+
+/**
+ * @brief Free a tracker.
+ */
+void
+roi_tracker_free (RoiTracker *tracker)
+{
+  guint s;
+  if (!tracker)
+    return;
+  for (s = 0; s < tracker->num_streams; s++)
+    g_free (tracker->streams[s].tracks);
+  g_free (tracker->streams);
+  g_free (tracker->detections);
+  g_free (tracker->detection_matched);
+  g_free (tracker->track_matched);
+  g_free (tracker->matches);
+  g_free (tracker);
+}
+
+/**
+ * @brief Drop all tracks, e.g. on a flush or a new stream. Memory is kept.
+ */
+void
+roi_tracker_reset (RoiTracker *tracker)
+{
+  guint s;
+  for (s = 0; s < tracker->num_streams; s++)
+    tracker->streams[s].num_tracks = 0;
+  tracker->next_id = 1;
+}
+
+/**
+ * @brief Make room for streams below `num_streams` and `num_detections` detections.
+ *
+ * Only allocates when a frame brings more streams or detections than any before it.
+ */
+static void
+roi_tracker_reserve (RoiTracker *tracker, guint num_streams, guint num_detections)
+{
+  guint s;
+  if (num_streams > tracker->num_streams) {
+    tracker->streams = g_renew (RoiTrackerStream, tracker->streams, num_streams);
+    for (s = tracker->num_streams; s < num_streams; s++) {
+      tracker->streams[s].num_tracks = 0;
+      tracker->streams[s].tracks = g_new (RoiTrack, tracker->max_tracks);
+    }
+    tracker->num_streams = num_streams;
+  }
+  if (num_detections > tracker->capacity) {
+    tracker->capacity = MAX (num_detections, 2 * tracker->capacity);
+    tracker->detections = g_renew (guint, tracker->detections, tracker->capacity);
+    tracker->detection_matched = g_renew (gboolean, tracker->detection_matched, tracker->capacity);
+    tracker->matches = g_renew (RoiTrackMatch, tracker->matches, (gsize) tracker->max_tracks * tracker->capacity);
+  }
+}
+
+/**
+ * @brief Noise scale of `axis`: the box width for x and width, its height for y and height.
+ */
+static inline gfloat
+track_scale (const RoiTrack *track, guint axis)
+{
+  return MAX (track->position[2 + (axis & 1)], ROI_TRACK_MIN_SIZE);
+}
+
+/**
+ * @brief Start a track at detection `d`.
+ */
+static void
+track_init (RoiTrack *track, guint id, const GstTensorDetection *d)
+{
+  guint a;
+  track->id = id;
+  track->label = d->label;
+  track->class_id = d->class_id;
+  track->score = d->score;
+  track->hits = 1;
+  track->frames_since_update = 0;
+  track->position[0] = d->x + d->width / 2;
+  track->position[1] = d->y + d->height / 2;
+  track->position[2] = MAX (d->width, ROI_TRACK_MIN_SIZE);
+  track->position[3] = MAX (d->height, ROI_TRACK_MIN_SIZE);
+  for (a = 0; a < ROI_TRACK_AXES; a++) {
+    gfloat std_p = 2 * ROI_TRACK_STD_POSITION * track_scale (track, a);
+    gfloat std_v = 10 * ROI_TRACK_STD_VELOCITY * track_scale (track, a);
+    track->velocity[a] = 0.f;
+    track->cov[a][0] = std_p * std_p;
+    track->cov[a][1] = 0.f;
+    track->cov[a][2] = std_v * std_v;
+  }
+}
+
+/**
+ * @brief Kalman predict: advance the track by one frame at constant velocity.
+ */
+static void
+track_predict (RoiTrack *track)
+{
+  guint a;
+  for (a = 0; a < ROI_TRACK_AXES; a++) {
+    gfloat std_p = ROI_TRACK_STD_POSITION * track_scale (track, a);
+    gfloat std_v = ROI_TRACK_STD_VELOCITY * track_scale (track, a);
+    gfloat *p = track->cov[a];
+    track->position[a] += track->velocity[a];
+    p[0] += 2 * p[1] + p[2] + std_p * std_p;
+    p[1] += p[2];
+    p[2] += std_v * std_v;
+  }
+  track->position[2] = MAX (track->position[2], ROI_TRACK_MIN_SIZE);
+  track->position[3] = MAX (track->position[3], ROI_TRACK_MIN_SIZE);
+  track->frames_since_update++;
+}
+
+/**
+ * @brief Kalman update: correct the track with its associated detection `d`.
+ */
+static void
+track_update (RoiTrack *track, const GstTensorDetection *d)
+{
+  gfloat z[ROI_TRACK_AXES];
+  guint a;
+  z[0] = d->x + d->width / 2;
+  z[1] = d->y + d->height / 2;
+  z[2] = d->width;
+  z[3] = d->height;
+  for (a = 0; a < ROI_TRACK_AXES; a++) {
+    gfloat std_m = ROI_TRACK_STD_POSITION * track_scale (track, a);
+    gfloat *p = track->cov[a];
+    gfloat s = p[0] + std_m * std_m;
+    gfloat k0 = p[0] / s, k1 = p[1] / s;
+    gfloat y = z[a] - track->position[a];
+    track->position[a] += k0 * y;
+    track->velocity[a] += k1 * y;
+    p[2] -= k1 * p[1];
+    p[1] -= k0 * p[1];
+    p[0] -= k0 * p[0];
+  }
+  track->position[2] = MAX (track->position[2], ROI_TRACK_MIN_SIZE);
+  track->position[3] = MAX (track->position[3], ROI_TRACK_MIN_SIZE);
+  track->label = d->label;
+  track->score = d->score;
+  track->hits++;
+  track->frames_since_update = 0;
+}
+
+/**
+ * @brief Intersection over union of a track's predicted box and a detection.
+ */
+static gfloat
+track_iou (const RoiTrack *track, const GstTensorDetection *d)
+{
+  gfloat x0 = track->position[0] - track->position[2] / 2, x1 = x0 + track->position[2];
+  gfloat y0 = track->position[1] - track->position[3] / 2, y1 = y0 + track->position[3];
+  gfloat w = MIN (x1, d->x + d->width) - MAX (x0, d->x);
+  gfloat h = MIN (y1, d->y + d->height) - MAX (y0, d->y);
+  gfloat inter;
+  if (w <= 0.f || h <= 0.f)
+    return 0.f;
+  inter = w * h;
+  return inter / (track->position[2] * track->position[3] + d->width * d->height - inter);
+}
+
+/**
+ * @brief `qsort` callback: best IoU first; ties go to the older track, then the earlier detection.
+ */
+static gint
+compare_matches (const void *A, const void *B)
+{
+  const RoiTrackMatch *a = (const RoiTrackMatch *) A, *b = (const RoiTrackMatch *) B;
+  if (a->iou != b->iou)
+    return a->iou > b->iou ? -1 : 1;
+  if (a->track != b->track)
+    return a->track < b->track ? -1 : 1;
+  return a->detection < b->detection ? -1 : (a->detection > b->detection);
+}
+
+/**
+ * @brief Advance every track to the next frame and drop those unseen for more than `max_age` frames.
+ *
+ * Call once per frame, before `roi_tracker_update` on frames with detections.
+ */
+void
+roi_tracker_predict (RoiTracker *tracker)
+{
+  guint s, i, n;
+  for (s = 0; s < tracker->num_streams; s++) {
+    RoiTrackerStream *stream = &tracker->streams[s];
+    for (i = 0, n = 0; i < stream->num_tracks; i++) {
+      RoiTrack *track = &stream->tracks[i];
+      track_predict (track);
+      if (track->frames_since_update > tracker->max_age)
+        continue;
+      if (n != i)
+        stream->tracks[n] = *track;
+      n++;
+    }
+    stream->num_tracks = n;
+  }
+}
+
+/**
+ * @brief Associate the detections of stream `s`, gathered in `tracker->detections`, with its tracks.
+ */
+static void
+roi_tracker_update_stream (RoiTracker *tracker, guint s, const GstTensorDetection *detections, guint num_detections)
+{
+  RoiTrackerStream *stream = &tracker->streams[s];
+  guint num_tracks = stream->num_tracks, num_matches = 0, i, j;
+
+  for (i = 0; i < num_tracks; i++) {
+    const RoiTrack *track = &stream->tracks[i];
+    for (j = 0; j < num_detections; j++) {
+      const GstTensorDetection *d = &detections[tracker->detections[j]];
+      gfloat o;
+      if (d->class_id != track->class_id)
+        continue;
+      o = track_iou (track, d);
+      if (o < tracker->iou_threshold)
+        continue;
+      tracker->matches[num_matches].track = i;
+      tracker->matches[num_matches].detection = j;
+      tracker->matches[num_matches].iou = o;
+      num_matches++;
+    }
+  }
+  qsort (tracker->matches, num_matches, sizeof (RoiTrackMatch), compare_matches);
+
+  /* Greedy assignment, best overlap first */
+  memset (tracker->track_matched, 0, num_tracks * sizeof (gboolean));
+  memset (tracker->detection_matched, 0, num_detections * sizeof (gboolean));
+  for (i = 0; i < num_matches; i++) {
+    const RoiTrackMatch *m = &tracker->matches[i];
+    if (tracker->track_matched[m->track] || tracker->detection_matched[m->detection])
+      continue;
+    tracker->track_matched[m->track] = TRUE;
+    tracker->detection_matched[m->detection] = TRUE;
+    track_update (&stream->tracks[m->track], &detections[tracker->detections[m->detection]]);
+  }
+
+  /* Unmatched detections start tracks while the stream has room */
+  for (j = 0; j < num_detections && stream->num_tracks < tracker->max_tracks; j++) {
+    if (tracker->detection_matched[j])
+      continue;
+    track_init (&stream->tracks[stream->num_tracks++], tracker->next_id,
+        &detections[tracker->detections[j]]);
+    if (++tracker->next_id == 0)
+      tracker->next_id = 1;
+  }
+}
+
+/**
+ * @brief Correct the tracks with the detections of an inferred frame.
+ *
+ * Detections only associate with tracks of the same stream and class.
+ */
+void
+roi_tracker_update (RoiTracker *tracker, const GstTensorDetection *detections, guint num_detections)
+{
+  guint num_streams = 0, s, i, n;
+  for (i = 0; i < num_detections; i++)
+    num_streams = MAX (num_streams, detections[i].stream_id + 1);
+  roi_tracker_reserve (tracker, num_streams, num_detections);
+  for (s = 0; s < num_streams; s++) {
+    for (i = 0, n = 0; i < num_detections; i++) {
+      if (detections[i].stream_id == s)
+        tracker->detections[n++] = i;
+    }
+    if (n)
+      roi_tracker_update_stream (tracker, s, detections, n);
+  }
+}
+
+/**
+ * @brief Number of tracks `roi_tracker_write` reports: those with at least `min_hits` detections.
+ */
+guint
+roi_tracker_count (const RoiTracker *tracker)
+{
+  guint s, i, n = 0;
+  for (s = 0; s < tracker->num_streams; s++) {
+    const RoiTrackerStream *stream = &tracker->streams[s];
+    for (i = 0; i < stream->num_tracks; i++)
+      n += stream->tracks[i].hits >= tracker->min_hits;
+  }
+  return n;
+}
+
+/**
+ * @brief Write the current box of each reported track to `out`, sized by `roi_tracker_count`.
+ *
+ * Entries are in stream order. Returns the number written.
+ */
+guint
+roi_tracker_write (const RoiTracker *tracker, GstTensorDetection *out)
+{
+  guint s, i, n = 0;
+  for (s = 0; s < tracker->num_streams; s++) {
+    const RoiTrackerStream *stream = &tracker->streams[s];
+    for (i = 0; i < stream->num_tracks; i++) {
+      const RoiTrack *track = &stream->tracks[i];
+      GstTensorDetection *o;
+      if (track->hits < tracker->min_hits)
+        continue;
+      o = &out[n++];
+      o->x = track->position[0] - track->position[2] / 2;
+      o->y = track->position[1] - track->position[3] / 2;
+      o->width = track->position[2];
+      o->height = track->position[3];
+      o->label = track->label;
+      o->class_id = track->class_id;
+      o->score = track->score;
+      o->stream_id = s;
+      o->track_id = track->id;
+    }
+  }
+  return n;
+}
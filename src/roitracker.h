@@ -0,0 +1,93 @@
+/*
+ * No license installed
+ */
+
+#ifndef __ROI_TRACKER_H__
+#define __ROI_TRACKER_H__
+
+#include <gst/gst.h>
+#include "gsttensordetectionsmeta.h"
+
+G_BEGIN_DECLS
+
+#define ROI_TRACK_AXES 4 /* centre x, centre y, width, height */
+#define DEFAULT_MAX_TRACKS 256
+#define DEFAULT_MAX_AGE 30
+#define DEFAULT_MIN_HITS 1
+#define DEFAULT_TRACK_IOU 0.3f
+#define ROI_TRACK_STD_POSITION (1.f / 20)  /* process and measurement noise, relative to the box size */
+#define ROI_TRACK_STD_VELOCITY (1.f / 160)
+
+/**
+ * @brief A tracked object: a constant-velocity Kalman filter on its box.
+ *
+ * The filter runs per frame. Each axis has its own two-state filter (position,
+ * velocity). With axis-aligned noise the 8-state filter has a block-diagonal
+ * covariance, so the axes never interact and the state fits in a few floats.
+ */
+typedef struct _RoiTrack
+{
+  guint id;
+  GQuark label;
+  guint class_id;
+  gfloat score;               /**< of the last detection */
+  guint hits;                 /**< detections associated so far */
+  guint frames_since_update;
+  gfloat position[ROI_TRACK_AXES];
+  gfloat velocity[ROI_TRACK_AXES];  /**< per frame */
+  gfloat cov[ROI_TRACK_AXES][3];    /**< covariance of each axis: position, cross term, velocity */
+} RoiTrack;
+
+/**
+ * @brief Tracks of one stream of a batch, with room for `max_tracks`.
+ */
+typedef struct _RoiTrackerStream
+{
+  guint num_tracks;
+  RoiTrack *tracks;
+} RoiTrackerStream;
+
+/**
+ * @brief A candidate association of a track with a detection.
+ */
+typedef struct _RoiTrackMatch
+{
+  guint track;
+  guint detection;
+  gfloat iou;
+} RoiTrackMatch;
+
+/**
+ * @brief Multi-object tracker: IoU association and constant-velocity Kalman filters.
+ *
+ * All memory is sized up front or grown to the largest frame seen, so a
+ * tracker in steady state does not allocate.
+ */
+typedef struct _RoiTracker
+{
+  guint max_tracks;           /**< per stream; further detections do not start tracks */
+  guint max_age;              /**< frames a track survives without a detection */
+  guint min_hits;             /**< detections before a track is reported */
+  gfloat iou_threshold;       /**< least IoU of an association */
+  guint next_id;
+  guint num_streams;
+  RoiTrackerStream *streams;
+  /* association scratch */
+  guint capacity;             /**< detections the scratch below holds */
+  guint *detections;          /**< indices of the current stream's detections */
+  gboolean *detection_matched;
+  gboolean *track_matched;    /**< `max_tracks` */
+  RoiTrackMatch *matches;     /**< `max_tracks` * `capacity` */
+} RoiTracker;
+
+RoiTracker *roi_tracker_new (guint max_tracks);
+void roi_tracker_free (RoiTracker *tracker);
+void roi_tracker_reset (RoiTracker *tracker);
+void roi_tracker_predict (RoiTracker *tracker);
+void roi_tracker_update (RoiTracker *tracker, const GstTensorDetection *detections, guint num_detections);
+guint roi_tracker_count (const RoiTracker *tracker);
+guint roi_tracker_write (const RoiTracker *tracker, GstTensorDetection *out);
+
+G_END_DECLS
+
+#endif /* __ROI_TRACKER_H__ */
@@ -0,0 +1,180 @@
+/*
+ * No license installed
+ */
+
+/**
+ * SECTION:library-segmapregions
+ *
+ * Connected regions of decoded segmentation maps
+ *
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include "segmapregions.h"
+
+/**
+ * @brief Create a labeller of `width` x `height` maps.
+ */
+SegmapRegions *
+segmap_regions_new (guint width, guint height)
+{
+  SegmapRegions *labeller;
+  gsize num_pixels = (gsize) width * height;
+  g_return_val_if_fail (width > 0 && height > 0 && num_pixels <= G_MAXUINT, NULL);
+  labeller = g_new0 (SegmapRegions, 1);
+  labeller->width = width;
+  labeller->height = height;
+  labeller->prev_labels = g_new (guint, width);
+  labeller->cur_labels = g_new (guint, width);
+  labeller->parent = g_new (guint, num_pixels);
+  labeller->regions = g_new (SegmapRegion, num_pixels);
+  return labeller;
+}
+
+/**
+ * @brief Free a labeller.
+ */
+void
+segmap_regions_free (SegmapRegions *labeller)
+{
+  if (!labeller)
+    return;
+  g_free (labeller->prev_labels);
+  g_free (labeller->cur_labels);
+  g_free (labeller->parent);
+  g_free (labeller->regions);
+  g_free (labeller);
+}
+
+/**
+ * @brief Root of `label`, halving the path on the way.
+ */
+static inline guint
+segmap_regions_find (guint *parent, guint label)
+{
+  while (parent[label] != label) {
+    parent[label] = parent[parent[label]];
+    label = parent[label];
+  }
+  return label;
+}
+
+/**
+ * @brief Merge the regions of roots `a` and `b` under the older one, and return it.
+ *
+ * Keeping the lower label as the root keeps the regions in raster order of
+ * their first pixel.
+ */
+static inline guint
+segmap_regions_unite (guint *parent, SegmapRegion *regions, guint a, guint b)
+{
+  SegmapRegion *root, *child;
+  if (a == b)
+    return a;
+  if (b < a) {
+    guint t = a;
+    a = b;
+    b = t;
+  }
+  parent[b] = a;
+  root = &regions[a];
+  child = &regions[b];
+  root->area += child->area;
+  root->x0 = MIN (root->x0, child->x0);
+  root->y0 = MIN (root->y0, child->y0);
+  root->x1 = MAX (root->x1, child->x1);
+  root->y1 = MAX (root->y1, child->y1);
+  return a;
+}
+
+/**
+ * @brief Find the 4-connected regions of each class of `classes` of at least `min_area` pixels.
+ *
+ * `classes` holds `width` x `height` class indices, row-major. Pixels of
+ * class `background` belong to no region; -1 labels every class. Returns the
+ * number of regions, which are left in `regions`, in raster order of their
+ * first pixel.
+ */
+guint
+segmap_regions_label (SegmapRegions *labeller, const guint8 *classes, gint background, guint min_area)
+{
+  const guint width = labeller->width;
+  guint *parent = labeller->parent;
+  SegmapRegion *regions = labeller->regions;
+  guint num_labels = 0, l, n, x, y;
+
+  for (y = 0; y < labeller->height; y++) {
+    const guint8 *row = classes + (gsize) y * width;
+    const guint8 *above = y ? row - width : NULL;
+    guint *prev = labeller->prev_labels, *cur = labeller->cur_labels;
+    for (x = 0; x < width;) {
+      const guint c = row[x], x0 = x;
+      guint root = G_MAXUINT, last = G_MAXUINT, i;
+      while (++x < width && row[x] == c);
+      if ((gint) c == background)
+        continue;
+      /* join the regions of the runs of the same class above; a run above has one label */
+      for (i = x0; above && i < x; i++) {
+        if (above[i] != c || prev[i] == last)
+          continue;
+        last = prev[i];
+        l = segmap_regions_find (parent, last);
+        root = (root == G_MAXUINT) ? l : segmap_regions_unite (parent, regions, root, l);
+      }
+      if (root == G_MAXUINT) {
+        root = num_labels++;
+        parent[root] = root;
+        regions[root].class_id = c;
+        regions[root].area = 0;
+        regions[root].x0 = x0;
+        regions[root].y0 = y;
+        regions[root].x1 = x - 1;
+        regions[root].y1 = y;
+      }
+      regions[root].area += x - x0;
+      regions[root].x0 = MIN (regions[root].x0, x0);
+      regions[root].x1 = MAX (regions[root].x1, x - 1);
+      regions[root].y1 = y;
+      for (i = x0; i < x; i++)
+        cur[i] = root;
+    }
+    labeller->prev_labels = cur;
+    labeller->cur_labels = prev;
+  }
+
+  /* roots are at or after the slot they move to, so the regions compact in place */
+  for (l = 0, n = 0; l < num_labels; l++) {
+    if (parent[l] == l && regions[l].area >= MAX (min_area, 1))
+      regions[n++] = regions[l];
+  }
+  labeller->num_regions = n;
+  return n;
+}
+
+/**
+ * @brief Write the labelled regions as detections with normalized boxes, and return their count.
+ *
+ * Class `c` takes label quark `quarks[c]`, 0 past `num_labels`. The score of
+ * a region is 1: the map holds no uncertainty about which pixels it covers.
+ */
+guint
+segmap_regions_write (const SegmapRegions *labeller, const GQuark *quarks, guint num_labels, GstTensorDetection *out)
+{
+  const gfloat x_scale = 1.f / labeller->width, y_scale = 1.f / labeller->height;
+  guint r;
+  for (r = 0; r < labeller->num_regions; r++) {
+    const SegmapRegion *region = &labeller->regions[r];
+    GstTensorDetection *o = &out[r];
+    o->x = region->x0 * x_scale;
+    o->y = region->y0 * y_scale;
+    o->width = (region->x1 - region->x0 + 1) * x_scale;
+    o->height = (region->y1 - region->y0 + 1) * y_scale;
+    o->label = (quarks && region->class_id < num_labels) ? quarks[region->class_id] : 0;
+    o->class_id = region->class_id;
+    o->score = 1.f;
+    o->stream_id = 0;
+    o->track_id = 0;
+  }
+  return labeller->num_regions;
+}
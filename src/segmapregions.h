@@ -0,0 +1,58 @@
+/*
+ * No license installed
+ */
+
+#ifndef __SEGMAP_REGIONS_H__
+#define __SEGMAP_REGIONS_H__
+
+#include <gst/gst.h>
+#include "gsttensordetectionsmeta.h"
+
+G_BEGIN_DECLS
+
+#define DEFAULT_SEGMAP_MIN_AREA 64   /* pixels of the map */
+#define DEFAULT_SEGMAP_BACKGROUND 0  /* class without regions, as in DeepLab; -1 for none */
+
+/**
+ * @brief A connected region of one class: its pixel count and inclusive bounding box.
+ */
+typedef struct _SegmapRegion
+{
+  guint class_id;
+  guint area;
+  guint x0;
+  guint y0;
+  guint x1;
+  guint y1;
+} SegmapRegion;
+
+/**
+ * @brief Connected-components labelling of `width` x `height` class-index maps.
+ *
+ * One raster pass over the map: each horizontal run of a class either joins
+ * the regions of the runs of that class it touches in the row above, merging
+ * them through a union-find forest, or starts a region. Region statistics are
+ * kept at the roots and merged with them, so no second pass over the pixels
+ * resolves the labels; only the labels of the previous row are kept. Every
+ * array is sized for the worst case, one region per pixel, when the labeller
+ * is created, so labelling does not allocate.
+ */
+typedef struct _SegmapRegions
+{
+  guint width;
+  guint height;
+  guint *prev_labels;     /**< `width`: label of each pixel of the previous row */
+  guint *cur_labels;      /**< `width`: same, for the current row */
+  guint *parent;          /**< `width` * `height`: union-find forest of labels */
+  SegmapRegion *regions;  /**< `width` * `height`: statistics, valid at roots; the regions found, once labelled */
+  guint num_regions;
+} SegmapRegions;
+
+SegmapRegions *segmap_regions_new (guint width, guint height);
+void segmap_regions_free (SegmapRegions *labeller);
+guint segmap_regions_label (SegmapRegions *labeller, const guint8 *classes, gint background, guint min_area);
+guint segmap_regions_write (const SegmapRegions *labeller, const GQuark *quarks, guint num_labels, GstTensorDetection *out);
+
+G_END_DECLS
+
+#endif /* __SEGMAP_REGIONS_H__ */
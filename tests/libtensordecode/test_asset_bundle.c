@@ -0,0 +1,304 @@
+/**
+ * @brief	Unit test: asset bundles round-trip through write and open, and corrupt or truncated bundles are refused
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define NUM_ANCHORS 1917
+#define NUM_LABELS  4
+
+static const gchar *labels[NUM_LABELS] = { "???", "person", "bicycle", "traffic light" };
+
+/**
+ * @brief Check that `actual` holds the anchors, scales and labels that were written.
+ */
+static gboolean
+check_bundle (const gchar *name, const AssetBundle *bundle, const AnchorTable *expected)
+{
+  const AnchorTable *a = bundle->anchors;
+  const gfloat *planes[6], *expected_planes[6];
+  guint i;
+  planes[0] = a->ycenter;
+  planes[1] = a->xcenter;
+  planes[2] = a->ygain;
+  planes[3] = a->xgain;
+  planes[4] = a->height;
+  planes[5] = a->width;
+  expected_planes[0] = expected->ycenter;
+  expected_planes[1] = expected->xcenter;
+  expected_planes[2] = expected->ygain;
+  expected_planes[3] = expected->xgain;
+  expected_planes[4] = expected->height;
+  expected_planes[5] = expected->width;
+  if (a->num_anchors != expected->num_anchors || a->y_scale != expected->y_scale || a->x_scale != expected->x_scale ||
+      a->h_scale != expected->h_scale || a->w_scale != expected->w_scale || a->h_gain != expected->h_gain ||
+      a->w_gain != expected->w_gain) {
+    g_printerr ("%s: %u anchors with scales %g %g %g %g, expected %u with %g %g %g %g\n", name,
+        a->num_anchors, a->y_scale, a->x_scale, a->h_scale, a->w_scale,
+        expected->num_anchors, expected->y_scale, expected->x_scale, expected->h_scale, expected->w_scale);
+    return FALSE;
+  }
+  for (i = 0; i < 6; i++) {
+    if ((guintptr) planes[i] % DECODE_ALIGNMENT != 0 ||
+        memcmp (planes[i], expected_planes[i], a->num_anchors * sizeof (gfloat)) != 0) {
+      g_printerr ("%s: anchor plane %u is misaligned or differs\n", name, i);
+      return FALSE;
+    }
+  }
+  if (bundle->num_labels != NUM_LABELS || bundle->labels[NUM_LABELS] != NULL) {
+    g_printerr ("%s: %u labels, expected %u\n", name, bundle->num_labels, NUM_LABELS);
+    return FALSE;
+  }
+  for (i = 0; i < NUM_LABELS; i++) {
+    if (strcmp (bundle->labels[i], labels[i]) != 0) {
+      g_printerr ("%s: label %u is '%s', expected '%s'\n", name, i, bundle->labels[i], labels[i]);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Write a bundle, read its header, open it, and keep its anchors past closing it.
+ */
+static gboolean
+check_round_trip (const gchar *path, const AnchorTable *anchors)
+{
+  const tensor_dim boxes_dim = { BOX_SIZE, NUM_ANCHORS, 1, 1 };
+  const tensor_dim predictions_dim = { NUM_LABELS, NUM_ANCHORS, 1, 1 };
+  AssetBundleHeader header;
+  AssetBundle *bundle;
+  AnchorTable *kept;
+  gboolean ok = TRUE;
+  guint i;
+  if (!asset_bundle_write (path, anchors, labels, NUM_LABELS, boxes_dim, predictions_dim) ||
+      !asset_bundle_read_header (path, &header)) {
+    g_printerr ("round trip: failed to write or read back %s\n", path);
+    return FALSE;
+  }
+  for (i = 0; i < ASSET_BUNDLE_RANK; i++) {
+    if (header.boxes_dim[i] != boxes_dim[i] || header.predictions_dim[i] != predictions_dim[i]) {
+      g_printerr ("round trip: dimension %u is %u:%u, expected %u:%u\n", i,
+          header.boxes_dim[i], header.predictions_dim[i], boxes_dim[i], predictions_dim[i]);
+      ok = FALSE;
+    }
+  }
+  if (header.num_anchors != NUM_ANCHORS || header.num_labels != NUM_LABELS || header.y_scale != anchors->y_scale) {
+    g_printerr ("round trip: header has %u anchors, %u labels and y-scale %g\n",
+        header.num_anchors, header.num_labels, header.y_scale);
+    ok = FALSE;
+  }
+  bundle = asset_bundle_open (path);
+  if (!bundle) {
+    g_printerr ("round trip: failed to open %s\n", path);
+    return FALSE;
+  }
+  ok = check_bundle ("round trip", bundle, anchors) && ok;
+  /* The table keeps the mapping alive on its own */
+  kept = bundle->anchors;
+  bundle->anchors = NULL;
+  asset_bundle_close (bundle);
+  if (memcmp (kept->width, anchors->width, NUM_ANCHORS * sizeof (gfloat)) != 0) {
+    g_printerr ("round trip: anchors changed after closing the bundle\n");
+    ok = FALSE;
+  }
+  /* Other scales only touch the private copy of the mapping, never the file */
+  anchor_table_set_scales (kept, 8.f, 9.f, 4.f, 6.f);
+  if (kept->ygain[7] != kept->height[7] / 8.f || kept->xgain[7] != kept->width[7] / 9.f) {
+    g_printerr ("round trip: scales were not folded into the mapped table\n");
+    ok = FALSE;
+  }
+  bundle = asset_bundle_open (path);
+  ok = bundle && check_bundle ("reopened", bundle, anchors) && ok;
+  asset_bundle_close (bundle);
+  anchor_table_free (kept);
+  return ok;
+}
+
+/**
+ * @brief Check that a bundle altered by `corrupt` (or cut to `size` bytes) is refused.
+ */
+static gboolean
+check_refused (const gchar *name, const gchar *path, const gchar *data, gsize size,
+    void (*corrupt) (AssetBundleHeader *h, gchar *data, gsize size), gboolean header_ok)
+{
+  gchar *copy = g_malloc (size + 1);
+  AssetBundleHeader header;
+  AssetBundle *bundle;
+  gboolean ok = TRUE;
+  memcpy (copy, data, size);
+  if (corrupt)
+    corrupt ((AssetBundleHeader *) copy, copy, size);
+  if (!g_file_set_contents (path, copy, size, NULL)) {
+    g_printerr ("%s: failed to write %s\n", name, path);
+    g_free (copy);
+    return FALSE;
+  }
+  g_free (copy);
+  bundle = asset_bundle_open (path);
+  if (bundle) {
+    g_printerr ("%s: corrupt bundle was opened\n", name);
+    asset_bundle_close (bundle);
+    ok = FALSE;
+  }
+  if (asset_bundle_read_header (path, &header) != header_ok) {
+    g_printerr ("%s: header was %s\n", name, header_ok ? "refused" : "accepted");
+    ok = FALSE;
+  }
+  return ok;
+}
+
+static void
+corrupt_magic (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->magic[0] = 'X';
+}
+
+static void
+corrupt_version (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->version = ASSET_BUNDLE_VERSION + 1;
+}
+
+static void
+corrupt_byte_order (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->byte_order = GUINT32_SWAP_LE_BE (ASSET_BUNDLE_BYTE_ORDER);
+}
+
+static void
+corrupt_no_anchors (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->num_anchors = 0;
+}
+
+static void
+corrupt_anchors_offset (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->anchors_offset += sizeof (gfloat);
+}
+
+static void
+corrupt_anchor_stride (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->anchor_stride -= DECODE_ALIGNMENT;
+}
+
+static void
+corrupt_num_anchors (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->num_anchors = G_MAXUINT32;
+}
+
+static void
+corrupt_labels_offset (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->labels_offset = size;
+  h->labels_size = 0;
+  h->num_labels = 1;
+}
+
+static void
+corrupt_num_labels (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->num_labels = G_MAXUINT32;
+}
+
+static void
+corrupt_label_offset (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  guint32 *offsets = (guint32 *) (data + h->labels_offset);
+  offsets[NUM_LABELS - 1] = h->labels_size;
+}
+
+static void
+corrupt_label_string (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  data[size - 1] = 'x';
+}
+
+static void
+corrupt_scale (AssetBundleHeader *h, gchar *data, gsize size)
+{
+  h->w_scale = 0.f;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  gchar *dir, *path, *data = NULL;
+  AnchorTable *anchors;
+  AssetBundleHeader header;
+  guint32 seed = 0x2545f491;
+  gsize size = 0, cuts[6];
+  guint d, i;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  dir = g_dir_make_tmp ("test_asset_bundle-XXXXXX", NULL);
+  path = g_build_filename (dir, "model.bundle", NULL);
+  anchors = anchor_table_new (NUM_ANCHORS);
+  for (d = 0; d < NUM_ANCHORS; d++) {
+    seed = seed * 1664525u + 1013904223u;
+    anchors->ycenter[d] = (gfloat) (seed >> 8) / (1 << 24);
+    seed = seed * 1664525u + 1013904223u;
+    anchors->xcenter[d] = (gfloat) (seed >> 8) / (1 << 24);
+    seed = seed * 1664525u + 1013904223u;
+    anchors->height[d] = (gfloat) (seed >> 8) / (1 << 24);
+    seed = seed * 1664525u + 1013904223u;
+    anchors->width[d] = (gfloat) (seed >> 8) / (1 << 24);
+  }
+  anchor_table_set_scales (anchors, Y_SCALE, X_SCALE, H_SCALE, W_SCALE);
+  ok = check_round_trip (path, anchors) && ok;
+
+  if (!g_file_get_contents (path, &data, &size, NULL) || !asset_bundle_read_header (path, &header)) {
+    g_printerr ("failed to read back %s\n", path);
+    return 1;
+  }
+  ok = check_refused ("bad magic", path, data, size, corrupt_magic, FALSE) && ok;
+  ok = check_refused ("other version", path, data, size, corrupt_version, FALSE) && ok;
+  ok = check_refused ("other byte order", path, data, size, corrupt_byte_order, FALSE) && ok;
+  ok = check_refused ("no anchors", path, data, size, corrupt_no_anchors, TRUE) && ok;
+  ok = check_refused ("misaligned anchors", path, data, size, corrupt_anchors_offset, TRUE) && ok;
+  ok = check_refused ("short anchor stride", path, data, size, corrupt_anchor_stride, TRUE) && ok;
+  ok = check_refused ("too many anchors", path, data, size, corrupt_num_anchors, TRUE) && ok;
+  ok = check_refused ("labels past the end", path, data, size, corrupt_labels_offset, TRUE) && ok;
+  ok = check_refused ("too many labels", path, data, size, corrupt_num_labels, TRUE) && ok;
+  ok = check_refused ("label out of bounds", path, data, size, corrupt_label_offset, TRUE) && ok;
+  ok = check_refused ("unterminated label", path, data, size, corrupt_label_string, TRUE) && ok;
+  ok = check_refused ("zero scale", path, data, size, corrupt_scale, TRUE) && ok;
+  /* Cut inside the header, the anchors, the label offsets and the last label */
+  cuts[0] = 0;
+  cuts[1] = sizeof (AssetBundleHeader) - 1;
+  cuts[2] = header.anchors_offset;
+  cuts[3] = header.anchors_offset + 5 * header.anchor_stride;
+  cuts[4] = header.labels_offset + sizeof (guint32);
+  cuts[5] = size - 1;
+  for (i = 0; i < G_N_ELEMENTS (cuts); i++) {
+    gchar name[32];
+    g_snprintf (name, sizeof (name), "cut at %u bytes", (guint) cuts[i]);
+    ok = check_refused (name, path, data, cuts[i], NULL, cuts[i] >= sizeof (AssetBundleHeader)) && ok;
+  }
+  g_remove (path);
+  if (asset_bundle_open (path) || asset_bundle_read_header (path, &header)) {
+    g_printerr ("a missing bundle was opened\n");
+    ok = FALSE;
+  }
+
+  g_free (data);
+  anchor_table_free (anchors);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+  if (!ok)
+    return 1;
+  g_print ("asset bundles round-trip through write and open, and corrupt or truncated bundles are refused\n");
+  return 0;
+}
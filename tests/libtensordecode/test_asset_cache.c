@@ -0,0 +1,190 @@
+/**
+ * @brief	Unit test: asset cache sharing by key, refcounts, and distinct tables for distinct scales
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <utime.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define NUM_USERS 5
+
+/**
+ * @brief Rewrite `path` with `contents` of the same length, keeping its modification time, so its cache key does not change.
+ */
+static gboolean
+rewrite_in_place (const gchar *path, const gchar *contents)
+{
+  GStatBuf st;
+  struct utimbuf times;
+  if (g_stat (path, &st) != 0 || !g_file_set_contents (path, contents, strlen (contents), NULL))
+    return FALSE;
+  times.actime = st.st_atime;
+  times.modtime = st.st_mtime;
+  return g_utime (path, &times) == 0;
+}
+
+/**
+ * @brief Users of one labels file share a table until the last one releases it.
+ */
+static gboolean
+check_labels (const gchar *path, const gchar *other_path)
+{
+  const LabelTable *tables[NUM_USERS], *other, *reloaded;
+  gboolean ok = TRUE;
+  guint i;
+  g_file_set_contents (path, "???\nperson\ncar\n", -1, NULL);
+  g_file_set_contents (other_path, "???\ncar\n", -1, NULL);
+  for (i = 0; i < NUM_USERS; i++) {
+    tables[i] = asset_cache_get_labels (path);
+    if (!tables[i] || tables[i] != tables[0]) {
+      g_printerr ("labels: user %u got another table\n", i);
+      ok = FALSE;
+    }
+  }
+  other = asset_cache_get_labels (other_path);
+  if (!other || other == tables[0] || other->num_labels != 2 || other->labels[1] != tables[0]->labels[2]) {
+    g_printerr ("labels: another file did not get its own table of interned labels\n");
+    ok = FALSE;
+  }
+  asset_cache_unref (other);
+  /* Same size and time: the cached table stays while anyone holds it */
+  ok = rewrite_in_place (path, "???\nperson\ndog\n") && ok;
+  for (i = 1; i < NUM_USERS; i++)
+    asset_cache_unref (tables[i]);
+  reloaded = asset_cache_get_labels (path);
+  if (reloaded != tables[0] || strcmp (reloaded->labels[2], "car") != 0) {
+    g_printerr ("labels: the table was reloaded while still in use\n");
+    ok = FALSE;
+  }
+  asset_cache_unref (reloaded);
+  asset_cache_unref (tables[0]);
+  /* The last release drops the entry, so the next user reads the file again */
+  reloaded = asset_cache_get_labels (path);
+  if (!reloaded || strcmp (reloaded->labels[2], "dog") != 0) {
+    g_printerr ("labels: the table outlived its last user\n");
+    ok = FALSE;
+  }
+  asset_cache_unref (reloaded);
+  return ok;
+}
+
+/**
+ * @brief One box-priors file with different scales gives distinct tables, each shared by its own users.
+ */
+static gboolean
+check_box_priors (const gchar *path)
+{
+  const BoxScales scales = { Y_SCALE, X_SCALE, H_SCALE, W_SCALE };
+  const BoxScales other_scales = { 8.f, X_SCALE, H_SCALE, 4.f };
+  const AnchorTable *a, *b, *c, *d;
+  gboolean ok = TRUE;
+  g_file_set_contents (path, "0.1 0.5\n0.2 0.5\n0.3 0.4\n0.4 0.3\n", -1, NULL);
+  a = asset_cache_get_box_priors (path, &scales);
+  b = asset_cache_get_box_priors (path, &other_scales);
+  c = asset_cache_get_box_priors (path, &scales);
+  if (!a || !b || a != c || a == b) {
+    g_printerr ("box priors: tables are not shared by scales\n");
+    ok = FALSE;
+  } else if (a->ygain[0] != 0.3f / Y_SCALE || b->ygain[0] != 0.3f / 8.f || a->w_scale != W_SCALE || b->w_scale != 4.f ||
+      a->ycenter[1] != b->ycenter[1]) {
+    g_printerr ("box priors: the scales of one table leaked into the other\n");
+    ok = FALSE;
+  }
+  /* Releasing one set of scales leaves the other intact */
+  asset_cache_unref (b);
+  d = asset_cache_get_box_priors (path, &scales);
+  if (d != a || d->ygain[0] != 0.3f / Y_SCALE) {
+    g_printerr ("box priors: releasing other scales changed the shared table\n");
+    ok = FALSE;
+  }
+  asset_cache_unref (a);
+  asset_cache_unref (c);
+  asset_cache_unref (d);
+  if (asset_cache_get_box_priors (NULL, &scales) != NULL) {
+    g_printerr ("box priors: loaded without a file\n");
+    ok = FALSE;
+  }
+  return ok;
+}
+
+/**
+ * @brief Generated anchors and YOLO grids are keyed by every parameter that shapes them.
+ */
+static gboolean
+check_generated (void)
+{
+  const BoxScales scales = { Y_SCALE, X_SCALE, H_SCALE, W_SCALE };
+  const BoxScales other_scales = { Y_SCALE, X_SCALE, 4.f, W_SCALE };
+  SsdAnchorParams params, other_params;
+  YoloParams yolo, other_yolo;
+  const AnchorTable *a, *b, *c, *d, *grid, *other_grid, *same_grid;
+  gboolean ok = TRUE;
+  ssd_anchor_params_init (&params);
+  ssd_anchor_params_init (&other_params);
+  other_params.max_scale = 0.9f;
+  a = asset_cache_get_ssd_anchors (&params, &scales);
+  b = asset_cache_get_ssd_anchors (&params, &scales);
+  c = asset_cache_get_ssd_anchors (&params, &other_scales);
+  d = asset_cache_get_ssd_anchors (&other_params, &scales);
+  if (!a || a != b || c == a || d == a || d == c || a->h_scale != H_SCALE || c->h_scale != 4.f) {
+    g_printerr ("SSD anchors: tables are not keyed by grid and scales\n");
+    ok = FALSE;
+  }
+  asset_cache_unref (a);
+  asset_cache_unref (b);
+  asset_cache_unref (c);
+  asset_cache_unref (d);
+  yolo_params_init (&yolo);
+  yolo_params_init (&other_yolo);
+  yolo_params_set_input_size (&other_yolo, "320");
+  grid = asset_cache_get_yolo_grid (&yolo);
+  other_grid = asset_cache_get_yolo_grid (&other_yolo);
+  same_grid = asset_cache_get_yolo_grid (&yolo);
+  if (!grid || grid != same_grid || other_grid == grid || other_grid->num_anchors * 4 != grid->num_anchors) {
+    g_printerr ("YOLO grids: tables are not keyed by input size\n");
+    ok = FALSE;
+  }
+  asset_cache_unref (grid);
+  asset_cache_unref (other_grid);
+  asset_cache_unref (same_grid);
+  /* NULL and assets the cache does not know are ignored */
+  asset_cache_unref (NULL);
+  asset_cache_unref (&yolo);
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  gchar *dir, *labels_path, *other_labels_path, *box_priors_path;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  dir = g_dir_make_tmp ("test_asset_cache-XXXXXX", NULL);
+  labels_path = g_build_filename (dir, "labels.txt", NULL);
+  other_labels_path = g_build_filename (dir, "other_labels.txt", NULL);
+  box_priors_path = g_build_filename (dir, "box_priors.txt", NULL);
+
+  ok = check_labels (labels_path, other_labels_path) && ok;
+  ok = check_box_priors (box_priors_path) && ok;
+  ok = check_generated () && ok;
+
+  g_remove (labels_path);
+  g_remove (other_labels_path);
+  g_remove (box_priors_path);
+  g_rmdir (dir);
+  g_free (labels_path);
+  g_free (other_labels_path);
+  g_free (box_priors_path);
+  g_free (dir);
+  if (!ok)
+    return 1;
+  g_print ("asset_cache shares assets by key until their last user, with distinct tables for distinct scales\n");
+  return 0;
+}
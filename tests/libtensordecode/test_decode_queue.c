@@ -0,0 +1,262 @@
+/**
+ * @brief	Unit test: the async decode queue's order, bound, drain and stop
+ */
+
+#include <stdio.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define CAPACITY 2
+#define NUM_ITEMS 60
+#define STATUS_FLUSHING -2 /* as GST_FLOW_FLUSHING */
+#define STATUS_EOS -3
+#define STATUS_ERROR -5
+
+/**
+ * @brief A buffer or an event, numbered in push order.
+ */
+typedef struct
+{
+  guint seq;
+  gboolean counts;
+} Item;
+
+static gint num_freed;
+
+static gboolean
+item_counts (gconstpointer item)
+{
+  return ((const Item *) item)->counts;
+}
+
+static void
+item_free (gpointer item)
+{
+  g_atomic_int_inc (&num_freed);
+  g_free (item);
+}
+
+static Item *
+item_new (guint seq, gboolean counts)
+{
+  Item *item = g_new (Item, 1);
+  item->seq = seq;
+  item->counts = counts;
+  return item;
+}
+
+/**
+ * @brief The task thread and the items it handled, in pop order.
+ */
+typedef struct
+{
+  DecodeQueue *queue;
+  guint num_handled;
+  guint seqs[NUM_ITEMS];
+  guint fail_at;   /**< item after which the task fails with STATUS_ERROR; NUM_ITEMS never */
+  gulong delay_us; /**< time spent on each item, so pushes catch up with the task */
+} Task;
+
+/**
+ * @brief Task thread: handle items until the queue stops, the last item, or `fail_at`.
+ */
+static gpointer
+task_run (gpointer data)
+{
+  Task *task = data;
+  gpointer item;
+  while (decode_queue_pop (task->queue, &item)) {
+    guint seq = ((Item *) item)->seq;
+    gint status = 0;
+    g_usleep (task->delay_us);
+    task->seqs[task->num_handled++] = seq;
+    item_free (item);
+    if (seq == task->fail_at)
+      status = STATUS_ERROR;
+    else if (seq == NUM_ITEMS - 1)
+      status = STATUS_EOS;
+    decode_queue_done (task->queue, status);
+    if (status != 0)
+      break;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Items come out in push order, with at most CAPACITY buffers waiting; after EOS pushes are refused.
+ */
+static gboolean
+check_order (void)
+{
+  DecodeQueue queue;
+  Task task = { &queue, 0, { 0 }, NUM_ITEMS, 200 };
+  GThread *thread;
+  gboolean ok = TRUE;
+  guint i, max_counted = 0;
+  gint status;
+  num_freed = 0;
+  decode_queue_init (&queue, CAPACITY, item_counts, item_free);
+  thread = g_thread_new ("task", task_run, &task);
+  /* every fourth item is an event, which takes no place */
+  for (i = 0; i < NUM_ITEMS; i++) {
+    status = decode_queue_push (&queue, item_new (i, i % 4 != 3));
+    if (status != 0) {
+      g_printerr ("order: push %u returned %d\n", i, status);
+      ok = FALSE;
+    }
+    g_mutex_lock (&queue.lock);
+    max_counted = MAX (max_counted, queue.num_counted);
+    g_mutex_unlock (&queue.lock);
+  }
+  g_thread_join (thread);
+  for (i = 0; i < task.num_handled; i++) {
+    if (task.seqs[i] != i) {
+      g_printerr ("order: item %u came out at %u\n", task.seqs[i], i);
+      ok = FALSE;
+      break;
+    }
+  }
+  if (task.num_handled != NUM_ITEMS) {
+    g_printerr ("order: %u items handled, expected %u\n", task.num_handled, NUM_ITEMS);
+    ok = FALSE;
+  }
+  /* the task is slower than the pushes, so the queue fills */
+  if (max_counted != CAPACITY) {
+    g_printerr ("order: at most %u buffers were waiting, capacity %u\n", max_counted, CAPACITY);
+    ok = FALSE;
+  }
+  status = decode_queue_push (&queue, item_new (NUM_ITEMS, TRUE));
+  if (status != STATUS_EOS || num_freed != NUM_ITEMS + 1) {
+    g_printerr ("order: a push after EOS returned %d, %d items freed\n", status, num_freed);
+    ok = FALSE;
+  }
+  decode_queue_clear (&queue);
+  return ok;
+}
+
+/**
+ * @brief A push that waits for a place, on a thread of its own.
+ */
+typedef struct
+{
+  DecodeQueue *queue;
+  gint status;
+  gint returned;
+} Push;
+
+static gpointer
+push_run (gpointer data)
+{
+  Push *push = data;
+  push->status = decode_queue_push (push->queue, item_new (NUM_ITEMS, TRUE));
+  g_atomic_int_set (&push->returned, 1);
+  return NULL;
+}
+
+/**
+ * @brief Events get in past a full queue; stopping drops what waits and wakes the blocked push and pop.
+ */
+static gboolean
+check_stop (void)
+{
+  DecodeQueue queue;
+  Push push = { &queue, 0, 0 };
+  GThread *thread;
+  gpointer item = NULL;
+  gboolean ok = TRUE;
+  num_freed = 0;
+  decode_queue_init (&queue, CAPACITY, item_counts, item_free);
+  decode_queue_push (&queue, item_new (0, TRUE));
+  decode_queue_push (&queue, item_new (1, TRUE));
+  if (decode_queue_push (&queue, item_new (2, FALSE)) != 0 || g_queue_get_length (&queue.items) != 3) {
+    g_printerr ("stop: an event was not queued behind a full queue\n");
+    ok = FALSE;
+  }
+  thread = g_thread_new ("push", push_run, &push);
+  g_usleep (20000);
+  if (g_atomic_int_get (&push.returned)) {
+    g_printerr ("stop: a buffer got past a full queue\n");
+    ok = FALSE;
+  }
+  decode_queue_stop (&queue, STATUS_FLUSHING);
+  g_thread_join (thread);
+  if (push.status != STATUS_FLUSHING || num_freed != 4 || !g_queue_is_empty (&queue.items) || queue.num_counted) {
+    g_printerr ("stop: the blocked push returned %d and %d items were freed\n", push.status, num_freed);
+    ok = FALSE;
+  }
+  if (decode_queue_pop (&queue, &item)) {
+    g_printerr ("stop: an item was popped from a stopped queue\n");
+    ok = FALSE;
+  }
+  /* a restarted queue accepts items again */
+  decode_queue_restart (&queue);
+  if (decode_queue_push (&queue, item_new (5, TRUE)) != 0 || !decode_queue_pop (&queue, &item) ||
+      ((Item *) item)->seq != 5) {
+    g_printerr ("stop: a restarted queue did not pass an item\n");
+    ok = FALSE;
+  } else {
+    item_free (item);
+    decode_queue_done (&queue, 0);
+  }
+  decode_queue_clear (&queue);
+  return ok;
+}
+
+/**
+ * @brief Drain waits for the task to finish every queued item, and gives up when the task fails.
+ */
+static gboolean
+check_drain (void)
+{
+  DecodeQueue queue;
+  Task task = { &queue, 0, { 0 }, NUM_ITEMS, 2000 };
+  GThread *thread;
+  gboolean ok = TRUE;
+  guint i;
+  num_freed = 0;
+  decode_queue_init (&queue, 8, item_counts, item_free);
+  thread = g_thread_new ("task", task_run, &task);
+  for (i = 0; i < 5; i++)
+    decode_queue_push (&queue, item_new (i, TRUE));
+  decode_queue_drain (&queue);
+  if (task.num_handled != 5 || queue.busy) {
+    g_printerr ("drain: returned after %u of 5 items\n", task.num_handled);
+    ok = FALSE;
+  }
+  /* the task fails on the next item and handles no more */
+  task.fail_at = 6;
+  for (i = 5; i < 10; i++)
+    decode_queue_push (&queue, item_new (i, TRUE));
+  decode_queue_drain (&queue);
+  g_thread_join (thread);
+  if (task.num_handled != 7 || queue.status != STATUS_ERROR) {
+    g_printerr ("drain: %u items handled before the failure, status %d\n", task.num_handled, queue.status);
+    ok = FALSE;
+  }
+  decode_queue_clear (&queue);
+  if (num_freed != 10) {
+    g_printerr ("drain: %d of 10 items freed\n", num_freed);
+    ok = FALSE;
+  }
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+
+  ok = check_order () && ok;
+  ok = check_stop () && ok;
+  ok = check_drain () && ok;
+
+  if (!ok)
+    return 1;
+  g_print ("decode_queue keeps push order within its bound, drains and stops\n");
+  return 0;
+}
@@ -0,0 +1,388 @@
+/**
+ * @brief	Unit test: grid-bucketed NMS against the quadratic greedy reference, and its top-K selection and pruning
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define NUM_BOXES   3000
+#define NUM_CLASSES 4
+#define GRID_CELLS  16 /* cells per axis of the engine's grid */
+
+static guint32 seed = 0x9e3779b9;
+static gchar tags[NUM_BOXES]; /* the class_label of detection i points to tags[i] */
+
+/**
+ * @brief Uniform random number in [0, 1).
+ */
+static gdouble
+next_random (void)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return (gdouble) (seed >> 8) / (1 << 24);
+}
+
+/**
+ * @brief Make `o` detection `i` of class `class_id` with the normalized box (x, y, w, h), clipped to the frame.
+ */
+static void
+set_box (DetectedObject *o, guint i, guint class_id, gdouble x, gdouble y, gdouble w, gdouble h, gfloat score)
+{
+  gdouble x0 = CLAMP (x, 0.0, 1.0), y0 = CLAMP (y, 0.0, 1.0);
+  gdouble x1 = CLAMP (x + w, 0.0, 1.0), y1 = CLAMP (y + h, 0.0, 1.0);
+  o->x = (guint) (x0 * UINT_MAX);
+  o->y = (guint) (y0 * UINT_MAX);
+  o->width = (guint) ((x1 - x0) * UINT_MAX);
+  o->height = (guint) ((y1 - y0) * UINT_MAX);
+  o->class_id = class_id;
+  o->class_label = &tags[i];
+  o->score = score;
+}
+
+/**
+ * @brief Reference IoU, on the same float corners as the engine.
+ */
+static gfloat
+reference_iou (const DetectedObject *a, const DetectedObject *b)
+{
+  gfloat ax0 = (gfloat) a->x, ay0 = (gfloat) a->y, ax1 = (gfloat) a->x + a->width, ay1 = (gfloat) a->y + a->height;
+  gfloat bx0 = (gfloat) b->x, by0 = (gfloat) b->y, bx1 = (gfloat) b->x + b->width, by1 = (gfloat) b->y + b->height;
+  gfloat w = MIN (ax1, bx1) - MAX (ax0, bx0), h = MIN (ay1, by1) - MAX (ay0, by0);
+  gfloat inter;
+  if (w <= 0.f || h <= 0.f)
+    return 0.f;
+  inter = w * h;
+  return inter / ((ax1 - ax0) * (ay1 - ay0) + (bx1 - bx0) * (by1 - by0) - inter);
+}
+
+static const DetectedObject *sort_detections;
+
+/**
+ * @brief `qsort` callback: order detection indices by descending score, then by index.
+ */
+static gint
+compare_indices (const void *A, const void *B)
+{
+  guint a = *(const guint *) A, b = *(const guint *) B;
+  if (sort_detections[a].score != sort_detections[b].score)
+    return sort_detections[a].score > sort_detections[b].score ? -1 : 1;
+  return a < b ? -1 : (a > b);
+}
+
+/**
+ * @brief Reference: the quadratic greedy NMS, best first, each candidate against every kept box of its class.
+ */
+static void
+reference_nms (const DetectedObject *detections, guint n, gfloat iou_threshold, guint8 *keep)
+{
+  guint *order = g_new (guint, n), *kept = g_new (guint, n);
+  guint i, j, num_kept = 0;
+  for (i = 0; i < n; i++)
+    order[i] = i;
+  sort_detections = detections;
+  qsort (order, n, sizeof (guint), compare_indices);
+  memset (keep, 0, n);
+  for (i = 0; i < n; i++) {
+    const DetectedObject *q = &detections[order[i]];
+    for (j = 0; j < num_kept; j++)
+      if (detections[kept[j]].class_id == q->class_id && reference_iou (q, &detections[kept[j]]) > iou_threshold)
+        break;
+    if (j < num_kept)
+      continue;
+    keep[order[i]] = TRUE;
+    kept[num_kept++] = order[i];
+  }
+  g_free (order);
+  g_free (kept);
+}
+
+/**
+ * @brief Run the engine on a copy of `detections` and compare its survivors with the reference.
+ */
+static gboolean
+check_nms (const gchar *name, const DetectedObject *detections, guint n, gfloat iou_threshold)
+{
+  DetectedObject *actual = g_new (DetectedObject, n);
+  guint8 *expected = g_new (guint8, n), *seen = g_new0 (guint8, n);
+  NmsEngine *nms = nms_engine_new (n, NUM_CLASSES + 1);
+  guint i, n_expected = 0, n_actual;
+  gboolean ok = TRUE;
+  reference_nms (detections, n, iou_threshold, expected);
+  for (i = 0; i < n; i++)
+    n_expected += expected[i];
+  memcpy (actual, detections, n * sizeof (DetectedObject));
+  nms_engine_set_limits (nms, 0, 0);
+  n_actual = nms_engine_run (nms, actual, n, iou_threshold);
+  for (i = 0; ok && i < n_actual; i++) {
+    guint tag = actual[i].class_label - tags;
+    if (!expected[tag] || seen[tag]) {
+      g_printerr ("%s, IoU threshold %g: detection %u should have been suppressed\n", name, iou_threshold, tag);
+      ok = FALSE;
+    } else if (i > 0 && actual[i].score > actual[i - 1].score) {
+      g_printerr ("%s, IoU threshold %g: survivors are not ordered by score\n", name, iou_threshold);
+      ok = FALSE;
+    }
+    seen[tag] = TRUE;
+  }
+  if (ok && n_actual != n_expected) {
+    g_printerr ("%s, IoU threshold %g: expected %u survivors, got %u\n", name, iou_threshold, n_expected, n_actual);
+    ok = FALSE;
+  }
+  nms_engine_free (nms);
+  g_free (actual);
+  g_free (expected);
+  g_free (seen);
+  return ok;
+}
+
+/**
+ * @brief Reference: the best `max_per_class` of each class, then the best `max_detections` of those (0 = unlimited).
+ *
+ * Equal scores rank in detection order.
+ */
+static void
+reference_top_k (const DetectedObject *detections, guint n, guint max_detections, guint max_per_class, guint8 *keep)
+{
+  guint *order = g_new (guint, n), per_class[NUM_CLASSES + 1] = { 0 };
+  guint i, total = 0;
+  for (i = 0; i < n; i++)
+    order[i] = i;
+  sort_detections = detections;
+  qsort (order, n, sizeof (guint), compare_indices);
+  memset (keep, 0, n);
+  for (i = 0; i < n; i++) {
+    guint class_id = detections[order[i]].class_id;
+    if (max_per_class && per_class[class_id] == max_per_class)
+      continue;
+    if (max_detections && total == max_detections)
+      break;
+    per_class[class_id]++;
+    total++;
+    keep[order[i]] = TRUE;
+  }
+  g_free (order);
+}
+
+/**
+ * @brief Select with the engine's limits, suppressing nothing, and compare the survivors with the reference.
+ */
+static gboolean
+check_top_k (const gchar *name, const DetectedObject *detections, guint n, guint max_detections, guint max_per_class)
+{
+  DetectedObject *actual = g_new (DetectedObject, n);
+  guint8 *expected = g_new (guint8, n), *seen = g_new0 (guint8, n);
+  NmsEngine *nms = nms_engine_new (n, NUM_CLASSES + 1);
+  guint i, n_expected = 0, n_actual;
+  gboolean ok = TRUE;
+  reference_top_k (detections, n, max_detections, max_per_class, expected);
+  for (i = 0; i < n; i++)
+    n_expected += expected[i];
+  memcpy (actual, detections, n * sizeof (DetectedObject));
+  nms_engine_set_limits (nms, max_detections, max_per_class);
+  /* No IoU exceeds 1, so every selected candidate survives */
+  n_actual = nms_engine_run (nms, actual, n, 1.f);
+  for (i = 0; ok && i < n_actual; i++) {
+    guint tag = actual[i].class_label - tags;
+    if (!expected[tag] || seen[tag]) {
+      g_printerr ("%s, max-detections %u, max-per-class %u: detection %u should not have been selected\n",
+          name, max_detections, max_per_class, tag);
+      ok = FALSE;
+    }
+    seen[tag] = TRUE;
+  }
+  if (ok && n_actual != n_expected) {
+    g_printerr ("%s, max-detections %u, max-per-class %u: expected %u survivors, got %u\n",
+        name, max_detections, max_per_class, n_expected, n_actual);
+    ok = FALSE;
+  }
+  nms_engine_free (nms);
+  g_free (actual);
+  g_free (expected);
+  g_free (seen);
+  return ok;
+}
+
+/**
+ * @brief Ties at the K-th score: exactly K survive, earliest detections first.
+ */
+static gboolean
+check_top_k_ties (void)
+{
+  static const gfloat scores[] = { 0.2f, 0.9f, 0.5f, 0.5f, 0.5f, 0.1f, 0.5f };
+  DetectedObject detections[G_N_ELEMENTS (scores)];
+  guint i, n, max_detections;
+  gboolean ok = TRUE;
+  for (max_detections = 2; max_detections <= 4; max_detections++) {
+    NmsEngine *nms = nms_engine_new (G_N_ELEMENTS (scores), 2);
+    /* One class, disjoint boxes */
+    for (i = 0; i < G_N_ELEMENTS (scores); i++)
+      set_box (&detections[i], i, 1, 0.1 * i, 0.0, 0.05, 0.05, scores[i]);
+    nms_engine_set_limits (nms, max_detections, 0);
+    n = nms_engine_run (nms, detections, G_N_ELEMENTS (scores), THRESHOLD_IOU);
+    /* 0.9 at 1, then the first of the 0.5 ties at 2, 3, 4 and 6 */
+    for (i = 0; i < n; i++)
+      if (detections[i].class_label - tags < 1 || detections[i].class_label - tags > max_detections)
+        break;
+    if (n != max_detections || i != n) {
+      g_printerr ("ties at max-detections %u: expected detections 1..%u, got %u survivors\n",
+          max_detections, max_detections, n);
+      ok = FALSE;
+    }
+    /* The same tie within a class */
+    for (i = 0; i < G_N_ELEMENTS (scores); i++)
+      set_box (&detections[i], i, 1, 0.1 * i, 0.0, 0.05, 0.05, scores[i]);
+    nms_engine_set_limits (nms, 0, max_detections);
+    n = nms_engine_run (nms, detections, G_N_ELEMENTS (scores), THRESHOLD_IOU);
+    for (i = 0; i < n; i++)
+      if (detections[i].class_label - tags < 1 || detections[i].class_label - tags > max_detections)
+        break;
+    if (n != max_detections || i != n) {
+      g_printerr ("ties at max-per-class %u: expected detections 1..%u, got %u survivors\n",
+          max_detections, max_detections, n);
+      ok = FALSE;
+    }
+    nms_engine_free (nms);
+  }
+  return ok;
+}
+
+/**
+ * @brief Stream `detections` through a buffer of twice the limit that is pruned
+ * whenever it fills, as a decode partition does, and check that NMS then keeps
+ * the same detections as from all of them.
+ */
+static gboolean
+check_select (const DetectedObject *detections, guint n, guint max_detections, guint max_per_class)
+{
+  guint limit = max_detections ? max_detections : max_per_class * NUM_CLASSES;
+  DetectedObject *all = g_new (DetectedObject, n), *pruned = g_new (DetectedObject, 2 * limit);
+  guint8 *expected = g_new0 (guint8, n);
+  NmsEngine *nms = nms_engine_new (n, NUM_CLASSES + 1), *select = nms_engine_new (2 * limit, NUM_CLASSES + 1);
+  guint i, n_all, n_pruned = 0;
+  gboolean ok = TRUE;
+  nms_engine_set_limits (nms, max_detections, max_per_class);
+  nms_engine_set_limits (select, max_detections, max_per_class);
+  memcpy (all, detections, n * sizeof (DetectedObject));
+  n_all = nms_engine_run (nms, all, n, THRESHOLD_IOU);
+  for (i = 0; i < n; i++) {
+    if (n_pruned == 2 * limit) {
+      n_pruned = nms_engine_select (select, pruned, n_pruned);
+      if (n_pruned > limit) {
+        g_printerr ("select, max-detections %u, max-per-class %u: %u candidates left, more than %u\n",
+            max_detections, max_per_class, n_pruned, limit);
+        ok = FALSE;
+        break;
+      }
+    }
+    pruned[n_pruned++] = detections[i];
+  }
+  n_pruned = nms_engine_run (nms, pruned, n_pruned, THRESHOLD_IOU);
+  for (i = 0; i < n_all; i++)
+    expected[all[i].class_label - tags] = TRUE;
+  for (i = 0; ok && i < n_pruned; i++) {
+    guint tag = pruned[i].class_label - tags;
+    if (!expected[tag]) {
+      g_printerr ("select, max-detections %u, max-per-class %u: detection %u should not have survived\n",
+          max_detections, max_per_class, tag);
+      ok = FALSE;
+    }
+    expected[tag] = FALSE;
+  }
+  if (ok && n_pruned != n_all) {
+    g_printerr ("select, max-detections %u, max-per-class %u: expected %u survivors, got %u\n",
+        max_detections, max_per_class, n_all, n_pruned);
+    ok = FALSE;
+  }
+  nms_engine_free (nms);
+  nms_engine_free (select);
+  g_free (all);
+  g_free (pruned);
+  g_free (expected);
+  return ok;
+}
+
+/**
+ * @brief An arena keeps at most twice max-detections candidates per partition.
+ */
+static gboolean
+check_arena_size (void)
+{
+  /* YOLOv5 at 640x640 with COCO: 25200 rows of 80 classes in 7 partitions */
+  DecodeArena *arena = decode_arena_new (25200, 80, YOLO_FIRST_CLASS, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+  gboolean ok = arena->max_detections == 7 * 2 * DEFAULT_MAX_DETECTIONS;
+  decode_arena_free (arena);
+  /* Unlimited, every anchor and class */
+  arena = decode_arena_new (1917, 91, SSD_FIRST_CLASS, 0, 0);
+  ok = arena->max_detections == 1917 * 90 && ok;
+  decode_arena_free (arena);
+  if (!ok)
+    g_printerr ("decode arenas are not sized by the top-K limits\n");
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  static const gfloat thresholds[] = { THRESHOLD_IOU, -0.5f, 0.f, 0.1f, 0.3f, 0.9f, 1.f, 1.5f };
+  /* max-detections, max-per-class */
+  static const guint limits[][2] = {
+    { 0, 0 }, { DEFAULT_MAX_DETECTIONS, 0 }, { 1, 0 }, { 0, 7 }, { 0, 1 },
+    { 50, 7 }, { 7, 50 }, { 50, 50 }, { 1, 1 }, { NUM_BOXES, 0 }, { 0, NUM_BOXES }, { NUM_BOXES + 1, NUM_BOXES + 1 },
+  };
+  DetectedObject *detections = g_new (DetectedObject, NUM_BOXES);
+  guint i, t;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  for (t = 0; t < G_N_ELEMENTS (thresholds); t++) {
+    /* Small boxes spread over the frame */
+    for (i = 0; i < NUM_BOXES; i++)
+      set_box (&detections[i], i, 1 + i % NUM_CLASSES, next_random (), next_random (),
+          0.01 + 0.1 * next_random (), 0.01 + 0.1 * next_random (), next_random ());
+    ok = check_nms ("random", detections, NUM_BOXES, thresholds[t]) && ok;
+    /* Boxes centred on cell edges and corners, so kept boxes and candidates sit in neighbouring cells */
+    for (i = 0; i < NUM_BOXES; i++) {
+      gdouble cx = (gdouble) (1 + (guint) (next_random () * (GRID_CELLS - 1))) / GRID_CELLS + (next_random () - 0.5) * 0.01;
+      gdouble cy = (gdouble) (1 + (guint) (next_random () * (GRID_CELLS - 1))) / GRID_CELLS + (next_random () - 0.5) * 0.01;
+      gdouble w = 0.02 + 0.08 * next_random (), h = 0.02 + 0.08 * next_random ();
+      set_box (&detections[i], i, 1 + i % NUM_CLASSES, cx - w / 2, cy - h / 2, w, h, next_random ());
+    }
+    ok = check_nms ("cell edges", detections, NUM_BOXES, thresholds[t]) && ok;
+    /* Mostly small boxes with a few that span most of the frame, scored in coarse steps for ties */
+    for (i = 0; i < NUM_BOXES; i++) {
+      gdouble size = (i % 17 == 0) ? 0.5 + 0.5 * next_random () : 0.01 + 0.05 * next_random ();
+      set_box (&detections[i], i, 1 + i % NUM_CLASSES, next_random () * (1.0 - size), next_random () * (1.0 - size),
+          size, size * (0.5 + next_random ()), floorf ((gfloat) next_random () * 8.f) / 8.f);
+    }
+    ok = check_nms ("large boxes", detections, NUM_BOXES, thresholds[t]) && ok;
+  }
+  for (t = 0; t < G_N_ELEMENTS (limits); t++) {
+    /* Disjoint boxes with scores in coarse steps, so the limits often fall inside a tie */
+    for (i = 0; i < NUM_BOXES; i++)
+      set_box (&detections[i], i, 1 + (guint) (next_random () * NUM_CLASSES), (gdouble) (i % 60) / 60, (gdouble) (i / 60) / 60,
+          0.01, 0.01, floorf ((gfloat) next_random () * 32.f) / 32.f);
+    ok = check_top_k ("top-K", detections, NUM_BOXES, limits[t][0], limits[t][1]) && ok;
+  }
+  ok = check_top_k_ties () && ok;
+  /* Overlapping boxes, so the pruned buffer also has to leave NMS the same candidates to suppress */
+  for (i = 0; i < NUM_BOXES; i++)
+    set_box (&detections[i], i, 1 + (guint) (next_random () * NUM_CLASSES), next_random () * 0.9, next_random () * 0.9,
+        0.05 + 0.05 * next_random (), 0.05 + 0.05 * next_random (), floorf ((gfloat) next_random () * 64.f) / 64.f);
+  for (t = 0; t < G_N_ELEMENTS (limits); t++)
+    if (limits[t][0] || limits[t][1])
+      ok = check_select (detections, NUM_BOXES, limits[t][0], limits[t][1]) && ok;
+  ok = check_arena_size () && ok;
+  g_free (detections);
+  if (!ok)
+    return 1;
+  g_print ("nms_engine_run matches the quadratic greedy NMS and the top-K limits, also after pruning\n");
+  return 0;
+}
@@ -0,0 +1,325 @@
+/**
+ * @brief	Unit test: frames split into anchor partitions, and batches of frames, decode the same on several threads as on one
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define NUM_ANCHORS 9000 /* three partitions, the last one partial */
+#define NUM_CLASSES 91
+
+/**
+ * @brief Which decode path a model goes through.
+ */
+typedef enum _ModelKind
+{
+  MODEL_SSD,
+  MODEL_SSD_QUANT,
+  MODEL_YOLO
+} ModelKind;
+
+/**
+ * @brief Inputs of one frame of a model.
+ */
+typedef struct _Model
+{
+  ModelKind kind;
+  guint num_anchors;
+  guint num_classes;
+  guint first_class;
+  AnchorTable *anchors;  /**< SSD priors or YOLO grid */
+  YoloParams params;
+  gfloat *predictions;   /**< SSD logits, or the whole YOLO output */
+  gfloat *boxes;
+  guint8 *qpredictions;
+  guint8 *qboxes;
+} Model;
+
+static guint32 seed = 0x2545f491;
+
+/**
+ * @brief Uniform random float in [0, 1).
+ */
+static gfloat
+random_float (void)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return (gfloat) (seed >> 8) / (1 << 24);
+}
+
+/**
+ * @brief Fill a model with random priors and outputs, about one logit in twenty above the score threshold.
+ */
+static void
+model_init (Model *m, ModelKind kind)
+{
+  gsize size, i;
+  guint d;
+  memset (m, 0, sizeof (*m));
+  m->kind = kind;
+  if (kind == MODEL_YOLO) {
+    yolo_params_init (&m->params);
+    m->num_anchors = yolo_grid_count (&m->params);
+    m->num_classes = 80;
+    m->first_class = YOLO_FIRST_CLASS;
+    m->anchors = anchor_table_generate_yolo (&m->params);
+    size = (gsize) m->num_anchors * (YOLO_ROW_CLASSES + 80);
+    m->predictions = g_new (gfloat, size);
+    for (i = 0; i < size; i++)
+      m->predictions[i] = (i % (YOLO_ROW_CLASSES + 80) < YOLO_ROW_CLASSES - 1) ?
+          random_float () * 2.f - 1.f : random_float () * 20.f - 17.f;
+    return;
+  }
+  m->num_anchors = NUM_ANCHORS;
+  m->num_classes = NUM_CLASSES;
+  m->first_class = SSD_FIRST_CLASS;
+  m->anchors = anchor_table_new (NUM_ANCHORS);
+  for (d = 0; d < NUM_ANCHORS; d++) {
+    m->anchors->ycenter[d] = random_float ();
+    m->anchors->xcenter[d] = random_float ();
+    m->anchors->height[d] = 0.05f + 0.45f * random_float ();
+    m->anchors->width[d] = 0.05f + 0.45f * random_float ();
+  }
+  anchor_table_set_scales (m->anchors, Y_SCALE, X_SCALE, H_SCALE, W_SCALE);
+  size = (gsize) NUM_ANCHORS * NUM_CLASSES;
+  if (kind == MODEL_SSD_QUANT) {
+    m->qpredictions = g_new (guint8, size);
+    m->qboxes = g_new (guint8, (gsize) NUM_ANCHORS * BOX_SIZE);
+    for (i = 0; i < size; i++)
+      m->qpredictions[i] = (guint8) (random_float () * 140.f);
+    for (i = 0; i < (gsize) NUM_ANCHORS * BOX_SIZE; i++)
+      m->qboxes[i] = (guint8) (BOX_ZERO_POINT - 20 + random_float () * 40.f);
+    return;
+  }
+  m->predictions = g_new (gfloat, size);
+  m->boxes = g_new (gfloat, (gsize) NUM_ANCHORS * BOX_SIZE);
+  for (i = 0; i < size; i++)
+    m->predictions[i] = random_float () * 20.f - 19.f;
+  for (i = 0; i < (gsize) NUM_ANCHORS * BOX_SIZE; i++)
+    m->boxes[i] = random_float () * 2.f - 1.f;
+}
+
+static void
+model_clear (Model *m)
+{
+  anchor_table_free (m->anchors);
+  g_free (m->predictions);
+  g_free (m->boxes);
+  g_free (m->qpredictions);
+  g_free (m->qboxes);
+}
+
+/**
+ * @brief Decode one frame of `m` in `arena`.
+ */
+static guint
+model_decode (const Model *m, DecodeArena *arena)
+{
+  static const QuantParams boxes = { BOX_ZERO_POINT, BOX_QUANT_SCALE };
+  static const QuantParams scores = { SCORE_ZERO_POINT, SCORE_QUANT_SCALE };
+  guint n = 0;
+  switch (m->kind) {
+    case MODEL_SSD:
+      get_detected_objects (m->anchors, NULL, 0, m->predictions, m->boxes, arena, &n);
+      break;
+    case MODEL_SSD_QUANT:
+      decode_arena_set_quantization (arena, &boxes, &scores);
+      get_detected_objects_quant (m->anchors, NULL, 0, m->qpredictions, m->qboxes, arena, &n);
+      break;
+    case MODEL_YOLO:
+      get_detected_objects_yolo (&m->params, m->anchors, NULL, 0, m->predictions, arena, &n);
+      break;
+  }
+  return n;
+}
+
+/**
+ * @brief Check that two lists of detections are equal, in order.
+ */
+static gboolean
+check_same (const gchar *name, const DetectedObject *expected, guint n_expected,
+    const DetectedObject *actual, guint n_actual)
+{
+  guint i;
+  if (n_actual != n_expected) {
+    g_printerr ("%s: %u detections, expected %u\n", name, n_actual, n_expected);
+    return FALSE;
+  }
+  for (i = 0; i < n_expected; i++) {
+    const DetectedObject *e = &expected[i], *a = &actual[i];
+    if (a->x != e->x || a->y != e->y || a->width != e->width || a->height != e->height ||
+        a->class_id != e->class_id || a->score != e->score) {
+      g_printerr ("%s: detection %u is (%u: %u, %u, %u, %u, %g), expected (%u: %u, %u, %u, %u, %g)\n", name, i,
+          a->class_id, a->x, a->y, a->width, a->height, a->score,
+          e->class_id, e->x, e->y, e->width, e->height, e->score);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Reference: every candidate of a float SSD frame in anchor order, without partitions, then NMS.
+ */
+static guint
+reference_decode (const Model *m, guint max_candidates, guint max_per_class, DetectedObject *detections)
+{
+  const AnchorTable *a = m->anchors;
+  NmsEngine *nms;
+  guint d, c, n = 0;
+  for (d = 0; d < m->num_anchors; d++) {
+    const gfloat *box = m->boxes + (gsize) d * BOX_SIZE;
+    gfloat ycenter = box[0] * a->ygain[d] + a->ycenter[d];
+    gfloat xcenter = box[1] * a->xgain[d] + a->xcenter[d];
+    gfloat h = expf (box[2] * a->h_gain) * a->height[d];
+    gfloat w = expf (box[3] * a->w_gain) * a->width[d];
+    for (c = 1; c < m->num_classes; c++) {
+      gfloat score = EXPIT (m->predictions[(gsize) d * m->num_classes + c]);
+      if (score < THRESHOLD_SCORE)
+        continue;
+      detections[n].x = UINT_MAX * (xcenter - w / 2.f);
+      detections[n].y = UINT_MAX * (ycenter - h / 2.f);
+      detections[n].width = UINT_MAX * ((xcenter + w / 2.f) - (xcenter - w / 2.f));
+      detections[n].height = UINT_MAX * ((ycenter + h / 2.f) - (ycenter - h / 2.f));
+      detections[n].class_id = c;
+      detections[n].class_label = NULL;
+      detections[n].score = score;
+      n++;
+    }
+  }
+  nms = nms_engine_new (n, m->num_classes);
+  nms_engine_set_limits (nms, max_candidates, max_per_class);
+  n = nms_engine_run (nms, detections, n, THRESHOLD_IOU);
+  nms_engine_free (nms);
+  return n;
+}
+
+/**
+ * @brief Decode `m` with the top-K limits on 1 thread, then on several, and compare.
+ */
+static gboolean
+check_threads (const gchar *name, const Model *m, guint max_candidates, guint max_per_class)
+{
+  static const guint threads[] = { 2, 3, 4, 0 };
+  DecodeArena *reference = decode_arena_new (m->num_anchors, m->num_classes, m->first_class, max_candidates, max_per_class);
+  DecodeArena *arena = decode_arena_new (m->num_anchors, m->num_classes, m->first_class, max_candidates, max_per_class);
+  gboolean ok = TRUE;
+  guint n_expected, n, t;
+  if (reference->num_partitions < 2) {
+    g_printerr ("%s: %u anchors are not split\n", name, m->num_anchors);
+    ok = FALSE;
+  }
+  decode_arena_set_threads (reference, 1);
+  n_expected = model_decode (m, reference);
+  if (n_expected == 0) {
+    g_printerr ("%s: nothing was detected\n", name);
+    ok = FALSE;
+  }
+  /* Partitions merged in anchor order give what one pass over the frame gives */
+  if (m->kind == MODEL_SSD) {
+    DetectedObject *expected = g_new (DetectedObject, (gsize) m->num_anchors * (m->num_classes - 1));
+    gchar label[96];
+    guint n = reference_decode (m, max_candidates, max_per_class, expected);
+    g_snprintf (label, sizeof (label), "%s, top-K %u/%u, one pass", name, max_candidates, max_per_class);
+    ok = check_same (label, expected, n, reference->detections, n_expected) && ok;
+    g_free (expected);
+  }
+  for (t = 0; t < G_N_ELEMENTS (threads); t++) {
+    gchar label[96];
+    g_snprintf (label, sizeof (label), "%s, top-K %u/%u, %u threads", name, max_candidates, max_per_class, threads[t]);
+    decode_arena_set_threads (arena, threads[t]);
+    n = model_decode (m, arena);
+    ok = check_same (label, reference->detections, n_expected, arena->detections, n) && ok;
+    /* Reusing the arena must not carry anything over */
+    n = model_decode (m, arena);
+    ok = check_same (label, reference->detections, n_expected, arena->detections, n) && ok;
+  }
+  decode_arena_free (reference);
+  decode_arena_free (arena);
+  return ok;
+}
+
+/**
+ * @brief A batch of frames, one arena each, as the element decodes a batched buffer.
+ */
+typedef struct _Batch
+{
+  const Model *models;
+  DecodeArena **arenas;
+  guint *num_detections;
+} Batch;
+
+static void
+decode_batch_entry (gpointer data, guint b)
+{
+  Batch *batch = data;
+  batch->num_detections[b] = model_decode (&batch->models[b], batch->arenas[b]);
+}
+
+/**
+ * @brief Decode a batch on the shared pool, each entry partitioned on the same pool, and compare with one entry at a time.
+ */
+static gboolean
+check_batch (void)
+{
+  static const ModelKind kinds[] = { MODEL_SSD, MODEL_YOLO, MODEL_SSD_QUANT, MODEL_SSD, MODEL_YOLO };
+  Model models[G_N_ELEMENTS (kinds)];
+  DecodeArena *arenas[G_N_ELEMENTS (kinds)], *reference;
+  guint num_detections[G_N_ELEMENTS (kinds)], t, b, n;
+  Batch batch = { models, arenas, num_detections };
+  gboolean ok = TRUE;
+  for (b = 0; b < G_N_ELEMENTS (kinds); b++) {
+    model_init (&models[b], kinds[b]);
+    arenas[b] = decode_arena_new (models[b].num_anchors, models[b].num_classes, models[b].first_class, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+  }
+  for (t = 1; t <= 4; t++) {
+    for (b = 0; b < G_N_ELEMENTS (kinds); b++)
+      decode_arena_set_threads (arenas[b], t);
+    decode_pool_run (G_N_ELEMENTS (kinds), t, decode_batch_entry, &batch);
+    for (b = 0; b < G_N_ELEMENTS (kinds); b++) {
+      gchar label[64];
+      g_snprintf (label, sizeof (label), "batch entry %u, %u threads", b, t);
+      reference = decode_arena_new (models[b].num_anchors, models[b].num_classes, models[b].first_class, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+      decode_arena_set_threads (reference, 1);
+      n = model_decode (&models[b], reference);
+      ok = check_same (label, reference->detections, n, arenas[b]->detections, num_detections[b]) && ok;
+      decode_arena_free (reference);
+    }
+  }
+  for (b = 0; b < G_N_ELEMENTS (kinds); b++) {
+    decode_arena_free (arenas[b]);
+    model_clear (&models[b]);
+  }
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  /* unlimited, the element's defaults, and limits tight enough to prune every partition */
+  static const guint limits[][2] = { { 0, 0 }, { DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS }, { 10, 3 } };
+  static const gchar *names[] = { "SSD", "SSD uint8", "YOLOv5" };
+  Model m;
+  guint k, l;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  for (k = MODEL_SSD; k <= MODEL_YOLO; k++) {
+    model_init (&m, k);
+    for (l = 0; l < G_N_ELEMENTS (limits); l++)
+      ok = check_threads (names[k], &m, limits[l][0], limits[l][1]) && ok;
+    model_clear (&m);
+  }
+  ok = check_batch () && ok;
+  if (!ok)
+    return 1;
+  g_print ("partitioned frames and batches decode the same on several threads as on one, with and without top-K limits\n");
+  return 0;
+}
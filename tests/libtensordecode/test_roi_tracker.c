@@ -0,0 +1,150 @@
+/**
+ * @brief	Unit test: roi_tracker keeps ids and predicts boxes between inferred frames
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/roitracker.h"
+
+#define NUM_FRAMES 60         /* the objects do not meet */
+#define INFERENCE_INTERVAL 6 /* detections on one frame in six */
+#define NUM_OBJECTS 2
+#define VELOCITY 0.004f      /* per frame */
+#define MAX_ERROR 0.01f      /* of a predicted coordinate, in frame units */
+
+/**
+ * @brief Ground truth: object `o` moving at constant velocity, in opposite directions.
+ */
+static void
+truth (guint o, guint frame, GstTensorDetection *d)
+{
+  gfloat v = o ? -VELOCITY : VELOCITY;
+  memset (d, 0, sizeof (*d));
+  d->x = (o ? 0.7f : 0.1f) + v * frame;
+  d->y = (o ? 0.6f : 0.2f) + v * frame / 2;
+  d->width = 0.1f;
+  d->height = 0.2f;
+  d->class_id = 1;
+  d->score = 0.9f;
+}
+
+/**
+ * @brief Track both objects and compare every reported box with the ground truth.
+ */
+static gboolean
+check_tracks (guint min_hits)
+{
+  RoiTracker *tracker = roi_tracker_new (DEFAULT_MAX_TRACKS);
+  GstTensorDetection detections[NUM_OBJECTS], out[NUM_OBJECTS], expected;
+  guint ids[NUM_OBJECTS] = { 0 };
+  guint frame, o, i, n;
+  gboolean ok = TRUE;
+
+  tracker->min_hits = min_hits;
+  for (frame = 0; frame < NUM_FRAMES && ok; frame++) {
+    roi_tracker_predict (tracker);
+    if (frame % INFERENCE_INTERVAL == 0) {
+      for (o = 0; o < NUM_OBJECTS; o++)
+        truth (o, frame, &detections[o]);
+      roi_tracker_update (tracker, detections, NUM_OBJECTS);
+    }
+    n = roi_tracker_count (tracker);
+    if (n != (frame >= (min_hits - 1) * INFERENCE_INTERVAL ? NUM_OBJECTS : 0) ||
+        roi_tracker_write (tracker, out) != n) {
+      g_printerr ("min_hits %u, frame %u: %u tracks reported\n", min_hits, frame, n);
+      ok = FALSE;
+      break;
+    }
+    for (i = 0; i < n; i++) {
+      truth (0, frame, &detections[0]);
+      truth (1, frame, &detections[1]);
+      o = fabsf (out[i].x - detections[0].x) < fabsf (out[i].x - detections[1].x) ? 0 : 1; /* the nearer object */
+      expected = detections[o];
+      if (!ids[o])
+        ids[o] = out[i].track_id;
+      if (out[i].track_id != ids[o] ||
+          /* the filter needs a few detections to learn the velocity */
+          (frame >= 4 * INFERENCE_INTERVAL &&
+           (fabsf (out[i].x - expected.x) > MAX_ERROR || fabsf (out[i].y - expected.y) > MAX_ERROR ||
+            fabsf (out[i].width - expected.width) > MAX_ERROR || fabsf (out[i].height - expected.height) > MAX_ERROR))) {
+        g_printerr ("min_hits %u, frame %u: track %u at (%g, %g, %g, %g), expected track %u at (%g, %g, %g, %g)\n",
+            min_hits, frame, out[i].track_id, out[i].x, out[i].y, out[i].width, out[i].height,
+            ids[o], expected.x, expected.y, expected.width, expected.height);
+        ok = FALSE;
+      }
+    }
+  }
+  if (ok && ids[0] == ids[1]) {
+    g_printerr ("min_hits %u: both objects share track %u\n", min_hits, ids[0]);
+    ok = FALSE;
+  }
+  roi_tracker_free (tracker);
+  return ok;
+}
+
+/**
+ * @brief Tracks without detections are predicted for `max_age` frames, then dropped.
+ */
+static gboolean
+check_aging (void)
+{
+  RoiTracker *tracker = roi_tracker_new (DEFAULT_MAX_TRACKS);
+  GstTensorDetection detection;
+  guint frame, n;
+  gboolean ok = TRUE;
+
+  roi_tracker_predict (tracker);
+  truth (0, 0, &detection);
+  roi_tracker_update (tracker, &detection, 1);
+  for (frame = 1; frame <= tracker->max_age + 1 && ok; frame++) {
+    roi_tracker_predict (tracker);
+    n = roi_tracker_count (tracker);
+    if (n != (frame <= tracker->max_age)) {
+      g_printerr ("frame %u without detections: %u tracks\n", frame, n);
+      ok = FALSE;
+    }
+  }
+  roi_tracker_free (tracker);
+  return ok;
+}
+
+/**
+ * @brief Detections beyond `max_tracks` in a stream do not start tracks; other streams are unaffected.
+ */
+static gboolean
+check_capacity (void)
+{
+  RoiTracker *tracker = roi_tracker_new (4);
+  GstTensorDetection detections[10];
+  guint i, n;
+
+  for (i = 0; i < 10; i++) {
+    truth (0, 0, &detections[i]);
+    detections[i].x = 0.09f * i;
+    detections[i].stream_id = i < 8 ? 0 : 1;
+  }
+  roi_tracker_predict (tracker);
+  roi_tracker_update (tracker, detections, 10);
+  n = roi_tracker_count (tracker);
+  roi_tracker_free (tracker);
+  if (n != 6) {
+    g_printerr ("capacity: expected 6 tracks, got %u\n", n);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Main
+ */
+int
+main (int argc, char ** argv)
+{
+  if (!check_tracks (1) || !check_tracks (3) || !check_aging () || !check_capacity ())
+    return 1;
+  g_print ("roi_tracker keeps ids and predicts boxes between inferred frames\n");
+  return 0;
+}
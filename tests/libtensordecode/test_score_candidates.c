@@ -0,0 +1,165 @@
+/**
+ * @brief	Unit test: logit-space and uint8 score kernels against the per-logit EXPIT path, for every specialized shape
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define MAX_VALUES (2034 * 601)
+
+/**
+ * @brief The shapes with specialized kernels, then one that gets the generic kernels.
+ */
+static const struct { guint num_anchors, num_classes; gboolean specialized; } shapes[] = {
+  { 1917, 91, TRUE }, { 2034, 91, TRUE }, { 1917, 601, TRUE }, { 1000, 37, FALSE },
+};
+
+/**
+ * @brief Reference: threshold `EXPIT` of every logit, as `get_detected_objects` used to.
+ */
+static guint
+reference_candidates (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold, ScoredCandidate *candidates)
+{
+  guint a, c, n = 0;
+  for (a = 0; a < num_anchors; a++, predictions += num_classes) {
+    for (c = 1; c < num_classes; c++) {
+      gfloat score = EXPIT (predictions[c]);
+      if (score < threshold)
+        continue;
+      candidates[n].anchor = a;
+      candidates[n].class_id = c;
+      candidates[n].score = score;
+      n++;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief Compare the kernel picked for `num_anchors` x `num_classes` against the reference for one threshold.
+ */
+static gboolean
+check_threshold (const gfloat *predictions, guint num_anchors, guint num_classes, gfloat threshold,
+    ScoredCandidate *expected, ScoredCandidate *actual)
+{
+  ScoreKernelFunc kernel = score_kernel_select (num_anchors, num_classes);
+  guint n_expected, n_actual, i;
+  n_expected = reference_candidates (predictions, num_anchors, num_classes, threshold, expected);
+  n_actual = kernel (predictions, num_anchors, num_classes, threshold, score_threshold_to_logit (threshold), actual);
+  if (n_actual != n_expected) {
+    g_printerr ("%ux%u, threshold %g: expected %u candidates, got %u\n", num_anchors, num_classes,
+        threshold, n_expected, n_actual);
+    return FALSE;
+  }
+  for (i = 0; i < n_expected; i++) {
+    if (actual[i].anchor != expected[i].anchor ||
+        actual[i].class_id != expected[i].class_id ||
+        memcmp (&actual[i].score, &expected[i].score, sizeof (gfloat)) != 0) {
+      g_printerr ("%ux%u, threshold %g: candidate %u differs: (%u, %u, %.9g) != (%u, %u, %.9g)\n",
+          num_anchors, num_classes, threshold, i,
+          actual[i].anchor, actual[i].class_id, actual[i].score,
+          expected[i].anchor, expected[i].class_id, expected[i].score);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Compare the uint8 kernel picked for `num_anchors` x `num_classes` against the reference on the dequantized logits for one threshold.
+ */
+static gboolean
+check_threshold_quant (const guint8 *qpredictions, const gfloat *predictions, guint num_anchors, guint num_classes,
+    const gfloat *score_lut, gfloat threshold, ScoredCandidate *expected, ScoredCandidate *actual)
+{
+  QuantScoreKernelFunc kernel = quant_kernel_select (num_anchors, num_classes);
+  guint n_expected, n_actual;
+  n_expected = reference_candidates (predictions, num_anchors, num_classes, threshold, expected);
+  n_actual = kernel (qpredictions, num_anchors, num_classes,
+      score_threshold_to_quant (score_lut, threshold), score_lut, threshold, actual);
+  if (n_actual != n_expected ||
+      memcmp (actual, expected, n_expected * sizeof (ScoredCandidate)) != 0) {
+    g_printerr ("%ux%u, uint8 threshold %g: expected %u candidates, got %u\n", num_anchors, num_classes,
+        threshold, n_expected, n_actual);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Run both kernels of one shape over random frames and values packed around each cutoff.
+ */
+static gboolean
+check_shape (guint num_anchors, guint num_classes, gboolean specialized, gfloat *predictions, guint8 *qpredictions,
+    ScoredCandidate *expected, ScoredCandidate *actual)
+{
+  static const gfloat thresholds[] = { THRESHOLD_SCORE, 0.f, 0.05f, 0.3f, 0.7f, 0.99f, 0.99999f, 1.f };
+  guint num_values = num_anchors * num_classes;
+  gfloat score_lut[256];
+  guint32 seed = 0x2545f491;
+  guint i, t;
+  gboolean ok = TRUE;
+  /* Make sure the specialized kernels, not the generic ones, are under test */
+  if (specialized != (score_kernel_select (num_anchors, num_classes) != score_kernel_select (0, 0)) ||
+      specialized != (quant_kernel_select (num_anchors, num_classes) != quant_kernel_select (0, 0))) {
+    g_printerr ("%ux%u: expected %s kernels\n", num_anchors, num_classes, specialized ? "specialized" : "generic");
+    ok = FALSE;
+  }
+  /* Mostly negative logits like a real SSD frame, plus values packed around each cutoff */
+  for (i = 0; i < num_values; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    predictions[i] = ((gfloat) (seed >> 8) / (1 << 24)) * 24.f - 16.f;
+  }
+  for (t = 0; t < G_N_ELEMENTS (thresholds); t++) {
+    gfloat cutoff = score_threshold_to_logit (thresholds[t]);
+    gfloat x = isinf (cutoff) ? 0.f : cutoff;
+    for (i = 0; i < 64; i++) {
+      predictions[(t * 64 + i) * 7 + 1] = x;
+      x = nextafterf (x, INFINITY);
+    }
+  }
+  for (t = 0; t < G_N_ELEMENTS (thresholds); t++)
+    ok = check_threshold (predictions, num_anchors, num_classes, thresholds[t], expected, actual) && ok;
+  /* Same frame quantized with the default score zero-point and scale */
+  for (i = 0; i < 256; i++)
+    score_lut[i] = EXPIT ((gfloat) (((gdouble) i - SCORE_ZERO_POINT) * SCORE_QUANT_SCALE));
+  for (i = 0; i < num_values; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    qpredictions[i] = seed >> 24;
+    predictions[i] = (gfloat) (((gdouble) qpredictions[i] - SCORE_ZERO_POINT) * SCORE_QUANT_SCALE);
+  }
+  for (t = 0; t < G_N_ELEMENTS (thresholds); t++)
+    ok = check_threshold_quant (qpredictions, predictions, num_anchors, num_classes, score_lut, thresholds[t],
+        expected, actual) && ok;
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  gfloat *predictions = g_new (gfloat, MAX_VALUES);
+  guint8 *qpredictions = g_new (guint8, MAX_VALUES);
+  ScoredCandidate *expected = g_new (ScoredCandidate, MAX_VALUES);
+  ScoredCandidate *actual = g_new (ScoredCandidate, MAX_VALUES);
+  guint s;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  for (s = 0; s < G_N_ELEMENTS (shapes); s++)
+    ok = check_shape (shapes[s].num_anchors, shapes[s].num_classes, shapes[s].specialized,
+        predictions, qpredictions, expected, actual) && ok;
+  g_free (qpredictions);
+  g_free (predictions);
+  g_free (expected);
+  g_free (actual);
+  if (!ok)
+    return 1;
+  g_print ("specialized and generic score kernels match the EXPIT path, in float and uint8\n");
+  return 0;
+}
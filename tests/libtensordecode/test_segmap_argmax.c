@@ -0,0 +1,162 @@
+/**
+ * @brief	Unit test: float and quantized segmentation argmax kernels against a scalar scan, ties included
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define NUM_PIXELS 3001
+
+/**
+ * @brief Reference: first highest score of each pixel.
+ */
+static void
+reference_argmax (const gfloat *scores, guint num_classes, guint8 *classes, gfloat *confidence)
+{
+  guint p, c;
+  for (p = 0; p < NUM_PIXELS; p++) {
+    const gfloat *s = scores + (gsize) p * num_classes;
+    guint best = 0;
+    for (c = 1; c < num_classes; c++) {
+      if (s[c] > s[best])
+        best = c;
+    }
+    classes[p] = best;
+    confidence[p] = s[best];
+  }
+}
+
+/**
+ * @brief Compare `segmap_argmax` with the reference for one class count.
+ *
+ * Scores are drawn from a few levels so that most pixels have ties, some of
+ * them across vector lanes and the scalar tail.
+ */
+static gboolean
+check_classes (guint num_classes, gfloat *scores, guint8 *expected, guint8 *actual,
+    gfloat *expected_confidence, gfloat *actual_confidence)
+{
+  static guint32 seed = 0x9e3779b9;
+  guint i;
+  for (i = 0; i < NUM_PIXELS * num_classes; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    scores[i] = (gfloat) ((seed >> 24) % 6) - 3.f;
+  }
+  reference_argmax (scores, num_classes, expected, expected_confidence);
+  segmap_argmax (scores, NUM_PIXELS, num_classes, actual, actual_confidence);
+  if (memcmp (actual, expected, NUM_PIXELS) != 0 ||
+      memcmp (actual_confidence, expected_confidence, NUM_PIXELS * sizeof (gfloat)) != 0) {
+    g_printerr ("%u classes: argmax differs from the scalar scan\n", num_classes);
+    return FALSE;
+  }
+  /* without confidence, only the classes are written */
+  memset (actual, 0xff, NUM_PIXELS);
+  segmap_argmax (scores, NUM_PIXELS, num_classes, actual, NULL);
+  if (memcmp (actual, expected, NUM_PIXELS) != 0) {
+    g_printerr ("%u classes: argmax without confidence differs from the scalar scan\n", num_classes);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Compare `segmap_argmax_quant` with a scan of the dequantized scores for one class count.
+ *
+ * Codes are drawn from a few levels near the top of the range, so that most
+ * pixels tie and the unsigned compare is exercised above 127.
+ */
+static gboolean
+check_quant_classes (guint num_classes, guint8 *scores, guint8 *expected, guint8 *actual,
+    gfloat *expected_confidence, gfloat *actual_confidence)
+{
+  static const QuantParams quant = { 128, 0.0625 };
+  static guint32 seed = 0x7f4a7c15;
+  const gfloat zero_point = quant.zero_point, scale = quant.scale;
+  guint i, p, c;
+  for (i = 0; i < NUM_PIXELS * num_classes; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    scores[i] = 250 - (seed >> 24) % 5 * 60;
+  }
+  for (p = 0; p < NUM_PIXELS; p++) {
+    const guint8 *s = scores + (gsize) p * num_classes;
+    guint best = 0;
+    for (c = 1; c < num_classes; c++) {
+      if ((s[c] - zero_point) * scale > (s[best] - zero_point) * scale)
+        best = c;
+    }
+    expected[p] = best;
+    expected_confidence[p] = (s[best] - zero_point) * scale;
+  }
+  segmap_argmax_quant (scores, NUM_PIXELS, num_classes, &quant, actual, actual_confidence);
+  if (memcmp (actual, expected, NUM_PIXELS) != 0 ||
+      memcmp (actual_confidence, expected_confidence, NUM_PIXELS * sizeof (gfloat)) != 0) {
+    g_printerr ("%u classes: quantized argmax differs from the dequantized scan\n", num_classes);
+    return FALSE;
+  }
+  memset (actual, 0xff, NUM_PIXELS);
+  segmap_argmax_quant (scores, NUM_PIXELS, num_classes, &quant, actual, NULL);
+  if (memcmp (actual, expected, NUM_PIXELS) != 0) {
+    g_printerr ("%u classes: quantized argmax without confidence differs from the dequantized scan\n", num_classes);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Check the int64 scan and the narrowing of in-graph indices.
+ */
+static gboolean
+check_integer (void)
+{
+  static const gint64 scores64[] = { 3, 7, 7, -1, /**/ -5, -6, -2, -2 };
+  static const gint64 indices64[] = { 0, 20, 300, -4 };
+  static const guint8 indices8[] = { 0, 20, 255, 4 };
+  guint8 classes[4];
+  gfloat confidence[2];
+  gboolean ok = TRUE;
+  segmap_argmax_int64 (scores64, 2, 4, classes, confidence);
+  ok = classes[0] == 1 && classes[1] == 2 && confidence[0] == 7.f && confidence[1] == -2.f && ok;
+  ok = segmap_from_indices (indices64, _NNS_INT64, 4, classes) && ok;
+  ok = classes[0] == 0 && classes[1] == 20 && classes[2] == 255 && classes[3] == 0 && ok;
+  ok = segmap_from_indices (indices8, _NNS_UINT8, 4, classes) && ok;
+  ok = memcmp (classes, indices8, 4) == 0 && ok;
+  ok = !segmap_from_indices (indices8, _NNS_FLOAT32, 4, classes) && ok;
+  if (!ok)
+    g_printerr ("integer argmax or index narrowing failed\n");
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  /* below, at and across the SSE2 and AVX2 widths of either kernel, DeepLab's 21, and the most a map holds */
+  static const guint class_counts[] = { 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 21, 31, 32, 33, 48, 91, 256 };
+  gfloat *scores = g_new (gfloat, NUM_PIXELS * SEGMAP_MAX_CLASSES);
+  guint8 *qscores = g_new (guint8, NUM_PIXELS * SEGMAP_MAX_CLASSES);
+  guint8 *expected = g_new (guint8, NUM_PIXELS), *actual = g_new (guint8, NUM_PIXELS);
+  gfloat *expected_confidence = g_new (gfloat, NUM_PIXELS), *actual_confidence = g_new (gfloat, NUM_PIXELS);
+  guint i;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  for (i = 0; i < G_N_ELEMENTS (class_counts); i++)
+    ok = check_classes (class_counts[i], scores, expected, actual, expected_confidence, actual_confidence) && ok;
+  for (i = 0; i < G_N_ELEMENTS (class_counts); i++)
+    ok = check_quant_classes (class_counts[i], qscores, expected, actual, expected_confidence, actual_confidence) && ok;
+  ok = check_integer () && ok;
+  g_free (scores);
+  g_free (qscores);
+  g_free (expected);
+  g_free (actual);
+  g_free (expected_confidence);
+  g_free (actual_confidence);
+  if (!ok)
+    return 1;
+  g_print ("segmap_argmax and segmap_argmax_quant match the scalar scan, ties included\n");
+  return 0;
+}
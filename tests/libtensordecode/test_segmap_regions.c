@@ -0,0 +1,169 @@
+/**
+ * @brief	Unit test: single-pass connected regions of class-index maps against a flood fill
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/segmapregions.h"
+
+#define WIDTH  97
+#define HEIGHT 61
+
+/**
+ * @brief Reference: flood-fill the 4-connected regions in raster order of their first pixel.
+ */
+static guint
+reference_regions (const guint8 *classes, gint background, guint min_area, SegmapRegion *regions)
+{
+  gboolean *seen = g_new0 (gboolean, WIDTH * HEIGHT);
+  guint *stack = g_new (guint, WIDTH * HEIGHT);
+  guint p, n = 0;
+  for (p = 0; p < WIDTH * HEIGHT; p++) {
+    SegmapRegion r;
+    guint top = 0;
+    if (seen[p] || (gint) classes[p] == background)
+      continue;
+    r.class_id = classes[p];
+    r.area = 0;
+    r.x0 = r.x1 = p % WIDTH;
+    r.y0 = r.y1 = p / WIDTH;
+    seen[p] = TRUE;
+    stack[top++] = p;
+    while (top) {
+      guint q = stack[--top], x = q % WIDTH, y = q / WIDTH;
+      guint neighbours[4], k, m = 0;
+      r.area++;
+      r.x0 = MIN (r.x0, x);
+      r.x1 = MAX (r.x1, x);
+      r.y0 = MIN (r.y0, y);
+      r.y1 = MAX (r.y1, y);
+      if (x > 0)
+        neighbours[m++] = q - 1;
+      if (x + 1 < WIDTH)
+        neighbours[m++] = q + 1;
+      if (y > 0)
+        neighbours[m++] = q - WIDTH;
+      if (y + 1 < HEIGHT)
+        neighbours[m++] = q + WIDTH;
+      for (k = 0; k < m; k++) {
+        if (!seen[neighbours[k]] && classes[neighbours[k]] == r.class_id) {
+          seen[neighbours[k]] = TRUE;
+          stack[top++] = neighbours[k];
+        }
+      }
+    }
+    if (r.area >= MAX (min_area, 1))
+      regions[n++] = r;
+  }
+  g_free (seen);
+  g_free (stack);
+  return n;
+}
+
+/**
+ * @brief Label one map and compare with the reference.
+ */
+static gboolean
+check_map (SegmapRegions *labeller, const guint8 *classes, gint background, guint min_area, SegmapRegion *expected)
+{
+  guint n_expected = reference_regions (classes, background, min_area, expected);
+  guint n_actual = segmap_regions_label (labeller, classes, background, min_area);
+  if (n_actual != n_expected || memcmp (labeller->regions, expected, n_expected * sizeof (SegmapRegion)) != 0) {
+    g_printerr ("background %d, min-area %u: expected %u regions, got %u\n", background, min_area,
+        n_expected, n_actual);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief A U, whose arms only meet on its last row, and a speck below min-area, written as detections.
+ */
+static gboolean
+check_write (SegmapRegions *labeller, guint8 *classes)
+{
+  static const GQuark quarks[] = { 0, 11, 22 };
+  GstTensorDetection out[WIDTH * HEIGHT];
+  const gfloat tolerance = 1e-6f;
+  guint x, y, n;
+  memset (classes, 0, WIDTH * HEIGHT);
+  for (y = 10; y < 30; y++) {
+    for (x = 20; x < 40; x++) {
+      if (y == 29 || x < 24 || x >= 36)
+        classes[y * WIDTH + x] = 2;
+    }
+  }
+  classes[50 * WIDTH + 50] = 1;
+  n = segmap_regions_label (labeller, classes, 0, 2);
+  if (n != 1 || segmap_regions_write (labeller, quarks, G_N_ELEMENTS (quarks), out) != 1) {
+    g_printerr ("U: expected one region, got %u\n", n);
+    return FALSE;
+  }
+  if (out[0].class_id != 2 || out[0].label != 22 || out[0].score != 1.f ||
+      fabsf (out[0].x - 20.f / WIDTH) > tolerance || fabsf (out[0].y - 10.f / HEIGHT) > tolerance ||
+      fabsf (out[0].width - 20.f / WIDTH) > tolerance || fabsf (out[0].height - 20.f / HEIGHT) > tolerance ||
+      labeller->regions[0].area != 20 * 20 - 12 * 19) {
+    g_printerr ("U: wrong detection (%u: %g, %g, %g, %g)\n", out[0].class_id, out[0].x, out[0].y,
+        out[0].width, out[0].height);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  static const guint num_classes[] = { 2, 3, 5 };
+  guint8 *classes = g_new (guint8, WIDTH * HEIGHT);
+  SegmapRegion *expected = g_new (SegmapRegion, WIDTH * HEIGHT);
+  SegmapRegions *labeller;
+  guint32 seed = 0x1b873593;
+  guint t, k, i, x, y;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  labeller = segmap_regions_new (WIDTH, HEIGHT);
+  for (t = 0; t < 8; t++) {
+    for (k = 0; k < G_N_ELEMENTS (num_classes); k++) {
+      /* blobs: random rectangles painted over each other, plus single-pixel noise */
+      memset (classes, 0, WIDTH * HEIGHT);
+      for (i = 0; i < 40; i++) {
+        guint x0, y0, w, h, c;
+        seed = seed * 1664525u + 1013904223u;
+        x0 = (seed >> 8) % WIDTH;
+        y0 = (seed >> 16) % HEIGHT;
+        seed = seed * 1664525u + 1013904223u;
+        w = 1 + (seed >> 8) % 30;
+        h = 1 + (seed >> 16) % 20;
+        c = (seed >> 24) % num_classes[k];
+        for (y = y0; y < MIN (y0 + h, HEIGHT); y++)
+          for (x = x0; x < MIN (x0 + w, WIDTH); x++)
+            classes[y * WIDTH + x] = c;
+      }
+      for (i = 0; i < 200; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        classes[(seed >> 8) % (WIDTH * HEIGHT)] = (seed >> 24) % num_classes[k];
+      }
+      ok = check_map (labeller, classes, 0, 0, expected) && ok;
+      ok = check_map (labeller, classes, -1, 0, expected) && ok;
+      ok = check_map (labeller, classes, 0, 25, expected) && ok;
+    }
+  }
+  /* a checkerboard: every pixel is a region of its own */
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    classes[i] = 1 + ((i % WIDTH) + (i / WIDTH)) % 2;
+  ok = check_map (labeller, classes, -1, 0, expected) && ok;
+  ok = check_write (labeller, classes) && ok;
+  segmap_regions_free (labeller);
+  g_free (classes);
+  g_free (expected);
+  if (!ok)
+    return 1;
+  g_print ("segmap_regions_label matches a flood fill\n");
+  return 0;
+}
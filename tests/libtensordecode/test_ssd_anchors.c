@@ -0,0 +1,257 @@
+/**
+ * @brief	Unit test: generated SSD anchors against the box-priors files they replace
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define MAX_ANCHORS 8192
+
+/**
+ * @brief Box priors as the TensorFlow Object Detection API exports them: rows of y-centre, x-centre, height and width.
+ *
+ * Follows `multiple_grid_anchor_generator.create_ssd_anchors` in float, with
+ * scales linear in the layer and an extra scale of 1 past the last layer.
+ */
+static guint
+reference_box_priors (const SsdAnchorParams *params, gfloat priors[BOX_SIZE][MAX_ANCHORS])
+{
+  guint l, y, x, b, n = 0;
+  for (l = 0; l < params->num_layers; l++) {
+    gfloat scales[SSD_MAX_ASPECT_RATIOS + 1], ratios[SSD_MAX_ASPECT_RATIOS + 1];
+    gfloat scale = params->min_scale + (params->max_scale - params->min_scale) * l / (params->num_layers - 1);
+    gfloat next = (l + 1 < params->num_layers) ?
+        params->min_scale + (params->max_scale - params->min_scale) * (l + 1) / (params->num_layers - 1) : 1.f;
+    guint num_boxes = 0;
+    if (l == 0 && params->reduce_boxes_in_lowest_layer) {
+      scales[0] = 0.1f;
+      ratios[0] = 1.f;
+      scales[1] = scale;
+      ratios[1] = 2.f;
+      scales[2] = scale;
+      ratios[2] = 0.5f;
+      num_boxes = 3;
+    } else {
+      for (b = 0; b < params->num_aspect_ratios; b++, num_boxes++) {
+        scales[num_boxes] = scale;
+        ratios[num_boxes] = params->aspect_ratios[b];
+      }
+      if (params->interpolated_scale_aspect_ratio > 0.f) {
+        scales[num_boxes] = sqrtf (scale * next);
+        ratios[num_boxes++] = params->interpolated_scale_aspect_ratio;
+      }
+    }
+    for (y = 0; y < params->feature_map_height[l]; y++) {
+      for (x = 0; x < params->feature_map_width[l]; x++) {
+        for (b = 0; b < num_boxes; b++, n++) {
+          priors[0][n] = (y + 0.5f) / params->feature_map_height[l];
+          priors[1][n] = (x + 0.5f) / params->feature_map_width[l];
+          priors[2][n] = scales[b] / sqrtf (ratios[b]);
+          priors[3][n] = scales[b] * sqrtf (ratios[b]);
+        }
+      }
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief Write `priors` as a box-priors file, four lines of `num_anchors` values.
+ */
+static gboolean
+write_box_priors (const gchar *path, gfloat priors[BOX_SIZE][MAX_ANCHORS], guint num_anchors)
+{
+  GString *text = g_string_new (NULL);
+  guint row, d;
+  gboolean ok;
+  for (row = 0; row < BOX_SIZE; row++) {
+    for (d = 0; d < num_anchors; d++)
+      g_string_append_printf (text, "%s%.9g", d ? " " : "", priors[row][d]);
+    g_string_append_c (text, '\n');
+  }
+  ok = g_file_set_contents (path, text->str, text->len, NULL);
+  g_string_free (text, TRUE);
+  return ok;
+}
+
+/**
+ * @brief Check that two anchor tables hold the same priors and gains, within float rounding.
+ */
+static gboolean
+check_tables (const gchar *name, const AnchorTable *expected, const AnchorTable *actual)
+{
+  const gdouble tolerance = 1e-6;
+  guint d;
+  if (actual->num_anchors != expected->num_anchors) {
+    g_printerr ("%s: %u anchors, expected %u\n", name, actual->num_anchors, expected->num_anchors);
+    return FALSE;
+  }
+  for (d = 0; d < expected->num_anchors; d++) {
+    if (fabs (actual->ycenter[d] - expected->ycenter[d]) > tolerance ||
+        fabs (actual->xcenter[d] - expected->xcenter[d]) > tolerance ||
+        fabs (actual->height[d] - expected->height[d]) > tolerance ||
+        fabs (actual->width[d] - expected->width[d]) > tolerance ||
+        fabs (actual->ygain[d] - expected->ygain[d]) > tolerance ||
+        fabs (actual->xgain[d] - expected->xgain[d]) > tolerance) {
+      g_printerr ("%s: anchor %u is (%g, %g, %g, %g), expected (%g, %g, %g, %g)\n", name, d,
+          actual->ycenter[d], actual->xcenter[d], actual->height[d], actual->width[d],
+          expected->ycenter[d], expected->xcenter[d], expected->height[d], expected->width[d]);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Generate the anchors of `params` and compare them with the box-priors file of the same grid.
+ */
+static gboolean
+check_grid (const gchar *name, const gchar *path, const SsdAnchorParams *params, gfloat priors[BOX_SIZE][MAX_ANCHORS])
+{
+  const BoxScales scales = { 8.f, 9.f, 4.f, 6.f };
+  guint num_anchors = reference_box_priors (params, priors);
+  AnchorTable *generated = anchor_table_generate_ssd (params);
+  AnchorTable *loaded;
+  const AnchorTable *cached_generated, *cached_loaded;
+  gboolean ok;
+  guint d;
+  if (!generated || ssd_anchor_count (params) != num_anchors || !write_box_priors (path, priors, num_anchors)) {
+    g_printerr ("%s: failed to generate %u anchors\n", name, num_anchors);
+    anchor_table_free (generated);
+    return FALSE;
+  }
+  loaded = anchor_table_load_box_priors (path);
+  ok = loaded && check_tables (name, loaded, generated);
+  /* Both sources fold the decoder's scales in the same way */
+  cached_generated = asset_cache_get_ssd_anchors (params, &scales);
+  cached_loaded = asset_cache_get_box_priors (path, &scales);
+  ok = ok && cached_generated && cached_loaded && check_tables (name, cached_loaded, cached_generated);
+  for (d = 0; ok && d < num_anchors; d++) {
+    if (fabsf (cached_generated->ygain[d] - cached_generated->height[d] / scales.y) > 1e-6f ||
+        fabsf (cached_generated->xgain[d] - cached_generated->width[d] / scales.x) > 1e-6f) {
+      g_printerr ("%s: gains of anchor %u do not fold in the y and x scales\n", name, d);
+      ok = FALSE;
+    }
+  }
+  asset_cache_unref (cached_generated);
+  asset_cache_unref (cached_loaded);
+  anchor_table_free (loaded);
+  anchor_table_free (generated);
+  return ok;
+}
+
+/**
+ * @brief Pin a few anchors of the default grid to the published box_priors-ssd_mobilenet.txt.
+ */
+static gboolean
+check_published (void)
+{
+  /* anchor, y-centre, x-centre, height, width */
+  static const gfloat published[][5] = {
+    { 0, 0.0263157895f, 0.0263157895f, 0.1f, 0.1f },
+    { 1, 0.0263157895f, 0.0263157895f, 0.141421356f, 0.282842712f },
+    { 2, 0.0263157895f, 0.0263157895f, 0.282842712f, 0.141421356f },
+    { 1083, 0.05f, 0.05f, 0.35f, 0.35f },
+    { 1916, 0.5f, 0.5f, 0.974679434f, 0.974679434f },
+  };
+  SsdAnchorParams params;
+  AnchorTable *anchors;
+  gboolean ok = TRUE;
+  guint i;
+  ssd_anchor_params_init (&params);
+  anchors = anchor_table_generate_ssd (&params);
+  if (!anchors || anchors->num_anchors != 1917) {
+    g_printerr ("default grid: %u anchors, expected 1917\n", anchors ? anchors->num_anchors : 0);
+    anchor_table_free (anchors);
+    return FALSE;
+  }
+  for (i = 0; i < G_N_ELEMENTS (published); i++) {
+    guint d = (guint) published[i][0];
+    if (fabsf (anchors->ycenter[d] - published[i][1]) > 1e-6f || fabsf (anchors->xcenter[d] - published[i][2]) > 1e-6f ||
+        fabsf (anchors->height[d] - published[i][3]) > 1e-6f || fabsf (anchors->width[d] - published[i][4]) > 1e-6f) {
+      g_printerr ("default grid: anchor %u is (%g, %g, %g, %g), expected (%g, %g, %g, %g)\n", d,
+          anchors->ycenter[d], anchors->xcenter[d], anchors->height[d], anchors->width[d],
+          published[i][1], published[i][2], published[i][3], published[i][4]);
+      ok = FALSE;
+    }
+  }
+  anchor_table_free (anchors);
+  return ok;
+}
+
+/**
+ * @brief Check that box-priors files without a full grid of anchors are refused.
+ */
+static gboolean
+check_bad_box_priors (const gchar *path)
+{
+  static const gchar *bad[] = {
+    "",
+    "0.1 0.2\n0.1 0.2\n0.1 0.2\n",
+    "0.1 0.2\n0.1 0.2\n0.1\n0.1 0.2\n",
+    "x\ny\nz\nw\n",
+  };
+  AnchorTable *anchors;
+  gboolean ok = TRUE;
+  guint i;
+  if (anchor_table_load_box_priors (NULL) != NULL) {
+    g_printerr ("box priors were loaded without a file\n");
+    ok = FALSE;
+  }
+  for (i = 0; i < G_N_ELEMENTS (bad); i++) {
+    g_file_set_contents (path, bad[i], strlen (bad[i]), NULL);
+    anchors = anchor_table_load_box_priors (path);
+    if (anchors) {
+      g_printerr ("bad box-priors file %u was loaded\n", i);
+      anchor_table_free (anchors);
+      ok = FALSE;
+    }
+  }
+  g_remove (path);
+  if (anchor_table_load_box_priors (path) != NULL) {
+    g_printerr ("box priors were loaded from a missing file\n");
+    ok = FALSE;
+  }
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  static gfloat priors[BOX_SIZE][MAX_ANCHORS];
+  SsdAnchorParams params;
+  gchar *dir, *path;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  dir = g_dir_make_tmp ("test_ssd_anchors-XXXXXX", NULL);
+  path = g_build_filename (dir, "box_priors.txt", NULL);
+
+  ok = check_published () && ok;
+  ssd_anchor_params_init (&params);
+  ok = check_grid ("SSD MobileNet v1 300x300", path, &params, priors) && ok;
+  /* A non-square input without the reduced lowest layer */
+  ssd_anchor_params_init (&params);
+  ssd_anchor_params_set_feature_maps (&params, "24x18,12x9,6x5,3x3");
+  ssd_anchor_params_set_aspect_ratios (&params, "1,2,0.5");
+  params.min_scale = 0.1f;
+  params.max_scale = 0.9f;
+  params.reduce_boxes_in_lowest_layer = FALSE;
+  ok = check_grid ("non-square 4 layers", path, &params, priors) && ok;
+  ok = check_bad_box_priors (path) && ok;
+
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+  if (!ok)
+    return 1;
+  g_print ("anchor_table_generate_ssd matches the box-priors files it replaces\n");
+  return 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * @brief	Unit test: matching decoded results to video frames by running time
+ */
+
+#include <stdio.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define MSECOND G_GUINT64_CONSTANT (1000000) /* as GST_MSECOND */
+#define NUM_RESULTS (SYNC_WINDOW_SIZE + 4)
+
+static gint num_freed;
+static gboolean freed[NUM_RESULTS];
+static guint ids[NUM_RESULTS];
+
+static void
+result_free (gpointer result)
+{
+  guint id = *(guint *) result;
+  if (freed[id])
+    g_printerr ("result %u freed twice\n", id);
+  freed[id] = TRUE;
+  num_freed++;
+}
+
+/**
+ * @brief Start from an empty window and no result freed.
+ */
+static void
+reset (SyncWindow *window)
+{
+  guint i;
+  for (i = 0; i < NUM_RESULTS; i++) {
+    ids[i] = i;
+    freed[i] = FALSE;
+  }
+  num_freed = 0;
+  sync_window_init (window, result_free);
+}
+
+/**
+ * @brief Match the frame at `running_time` and check the outcome: `found`, and the result `expected` or none if negative.
+ */
+static gboolean
+check_frame (SyncWindow *window, guint64 running_time, guint64 tolerance, gboolean found, gint expected)
+{
+  gpointer result;
+  gboolean ret = sync_window_match (window, running_time, tolerance, &result);
+  gint id = result ? (gint) *(guint *) result : -1;
+  if (ret != found || id != expected) {
+    g_printerr ("frame at %" G_GUINT64_FORMAT " ns: got %d (%s), expected %d (%s)\n", running_time,
+        id, ret ? "decided" : "pending", expected, found ? "decided" : "pending");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Frames get the result within tolerance on either side, and results too old for a frame are retired to `last`.
+ */
+static gboolean
+check_match (void)
+{
+  SyncWindow window;
+  gboolean ok = TRUE;
+  guint i;
+  reset (&window);
+  /* nothing decoded yet: the frame's result may still come */
+  ok = check_frame (&window, 0, MSECOND, FALSE, -1) && ok;
+  for (i = 0; i < 4; i++)
+    sync_window_add (&window, i * 40 * MSECOND, &ids[i]);
+  ok = check_frame (&window, 0, MSECOND, TRUE, 0) && ok;
+  /* a frame with the same running time gets the same result */
+  ok = check_frame (&window, 0, MSECOND, TRUE, 0) && ok;
+  ok = check_frame (&window, 40 * MSECOND + MSECOND / 2, MSECOND, TRUE, 1) && ok;
+  ok = check_frame (&window, 80 * MSECOND - MSECOND / 2, MSECOND, TRUE, 2) && ok;
+  if (window.last != &ids[1] || num_freed != 1 || !freed[0]) {
+    g_printerr ("match: the newest retired result is not the one kept\n");
+    ok = FALSE;
+  }
+  /* between two results: the later one shows this frame has none */
+  ok = check_frame (&window, 100 * MSECOND, MSECOND, TRUE, -1) && ok;
+  if (window.last != &ids[2] || window.count != 1) {
+    g_printerr ("match: a frame without a result did not retire the earlier one\n");
+    ok = FALSE;
+  }
+  /* a frame before the window's oldest result leaves it for later frames */
+  ok = check_frame (&window, 110 * MSECOND, MSECOND, TRUE, -1) && ok;
+  ok = check_frame (&window, 120 * MSECOND, 0, TRUE, 3) && ok;
+  ok = check_frame (&window, 120 * MSECOND + 1, 0, FALSE, -1) && ok;
+  if (window.last != &ids[3] || window.count != 0 || num_freed != 3) {
+    g_printerr ("match: %u results left and %d freed after the last frame\n", window.count, num_freed);
+    ok = FALSE;
+  }
+  sync_window_clear (&window);
+  if (window.last || num_freed != 4) {
+    g_printerr ("match: %d of 4 results freed by clear\n", num_freed);
+    ok = FALSE;
+  }
+  return ok;
+}
+
+/**
+ * @brief A full window retires its oldest result for each new one, and clear frees all of them.
+ */
+static gboolean
+check_full (void)
+{
+  SyncWindow window;
+  gboolean ok = TRUE;
+  guint i;
+  reset (&window);
+  for (i = 0; i < NUM_RESULTS; i++)
+    sync_window_add (&window, i * 10 * MSECOND, &ids[i]);
+  if (window.count != SYNC_WINDOW_SIZE || window.last != &ids[NUM_RESULTS - SYNC_WINDOW_SIZE - 1] ||
+      num_freed != NUM_RESULTS - SYNC_WINDOW_SIZE - 1) {
+    g_printerr ("full: %u results kept and %d freed\n", window.count, num_freed);
+    ok = FALSE;
+  }
+  /* the ring wraps around and still matches in running-time order */
+  for (i = NUM_RESULTS - SYNC_WINDOW_SIZE; i < NUM_RESULTS; i++)
+    ok = check_frame (&window, i * 10 * MSECOND, MSECOND, TRUE, i) && ok;
+  sync_window_clear (&window);
+  if (window.count || window.last || num_freed != NUM_RESULTS) {
+    g_printerr ("full: %d of %d results freed by clear\n", num_freed, NUM_RESULTS);
+    ok = FALSE;
+  }
+  /* a cleared window takes new results */
+  sync_window_add (&window, 0, &ids[0]);
+  freed[0] = FALSE;
+  ok = check_frame (&window, 0, 0, TRUE, 0) && ok;
+  sync_window_clear (&window);
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+
+  ok = check_match () && ok;
+  ok = check_full () && ok;
+
+  if (!ok)
+    return 1;
+  g_print ("sync_window matches results to frames by running time and keeps the newest retired one\n");
+  return 0;
+}
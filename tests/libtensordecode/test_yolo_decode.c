@@ -0,0 +1,277 @@
+/**
+ * @brief	Unit test: YOLO gating kernels against the per-score product, and grid decode of both heads
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../../src/libtensordecode.h"
+
+#define NUM_ROWS    2000
+#define NUM_CLASSES 80
+
+/**
+ * @brief Reference: objectness x class score of every pair, thresholded, in the kernels' output order.
+ */
+static guint
+reference_candidates (YoloHead head, const gfloat *output, gboolean logits, gfloat threshold, ScoredCandidate *candidates)
+{
+  guint r, c, n = 0;
+  for (r = 0; r < NUM_ROWS * NUM_CLASSES; r++) {
+    guint row = (head == YOLO_HEAD_ANCHORS) ? r / NUM_CLASSES : r % NUM_ROWS;
+    guint class_id = (head == YOLO_HEAD_ANCHORS) ? r % NUM_CLASSES : r / NUM_ROWS;
+    gfloat objectness = 1.f, value, score;
+    if (head == YOLO_HEAD_ANCHORS) {
+      const gfloat *o = output + (gsize) row * (YOLO_ROW_CLASSES + NUM_CLASSES);
+      objectness = logits ? EXPIT (o[YOLO_ROW_CLASSES - 1]) : o[YOLO_ROW_CLASSES - 1];
+      value = o[YOLO_ROW_CLASSES + class_id];
+    } else {
+      value = output[(gsize) (YOLO_PLANE_CLASSES + class_id) * NUM_ROWS + row];
+    }
+    score = objectness * (logits ? EXPIT (value) : value);
+    if (score < threshold)
+      continue;
+    c = n++;
+    candidates[c].anchor = row;
+    candidates[c].class_id = class_id;
+    candidates[c].score = score;
+  }
+  return n;
+}
+
+/**
+ * @brief Compare the kernel of `head` against the reference for one threshold.
+ */
+static gboolean
+check_threshold (YoloHead head, const gfloat *output, gboolean logits, gfloat threshold,
+    ScoredCandidate *expected, ScoredCandidate *actual)
+{
+  gsize stride = (head == YOLO_HEAD_ANCHORS) ? YOLO_ROW_CLASSES + NUM_CLASSES : NUM_ROWS;
+  guint n_expected, n_actual;
+  n_expected = reference_candidates (head, output, logits, threshold, expected);
+  n_actual = yolo_score_candidates (head, output, NUM_ROWS, stride, NUM_CLASSES, logits, threshold, actual);
+  if (n_actual != n_expected ||
+      memcmp (actual, expected, n_expected * sizeof (ScoredCandidate)) != 0) {
+    g_printerr ("head %d, %s, threshold %g: expected %u candidates, got %u\n", head,
+        logits ? "logits" : "probabilities", threshold, n_expected, n_actual);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Check that a detection has class `class_id` and the normalized box (x, y, w, h).
+ */
+static gboolean
+check_box (const DetectedObject *o, guint class_id, gdouble x, gdouble y, gdouble w, gdouble h)
+{
+  const gdouble tolerance = 1e-5;
+  if (o->class_id != class_id ||
+      fabs ((gdouble) o->x / G_MAXUINT - x) > tolerance || fabs ((gdouble) o->y / G_MAXUINT - y) > tolerance ||
+      fabs ((gdouble) o->width / G_MAXUINT - w) > tolerance || fabs ((gdouble) o->height / G_MAXUINT - h) > tolerance) {
+    g_printerr ("detection (%u: %g, %g, %g, %g) != (%u: %g, %g, %g, %g)\n", o->class_id,
+        (gdouble) o->x / G_MAXUINT, (gdouble) o->y / G_MAXUINT,
+        (gdouble) o->width / G_MAXUINT, (gdouble) o->height / G_MAXUINT, class_id, x, y, w, h);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Decode one strong YOLOv5 row and one strong YOLOv8 column of a 64x64 model.
+ */
+static gboolean
+check_grid_decode (void)
+{
+  YoloParams params;
+  AnchorTable *grid;
+  DecodeArena *arena;
+  gfloat *output;
+  guint num_rows, n = 0, i;
+  gboolean ok = TRUE;
+
+  /* YOLOv5: level 0 (stride 8, 8x8), anchor 1 (16x30), cell (y 2, x 3) */
+  yolo_params_init (&params);
+  yolo_params_set_input_size (&params, "64");
+  num_rows = yolo_grid_count (&params);
+  ok = num_rows == 3 * (8 * 8 + 4 * 4 + 2 * 2) && ok;
+  grid = anchor_table_generate_yolo (&params);
+  arena = decode_arena_new (num_rows, 3, YOLO_FIRST_CLASS, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+  output = g_new (gfloat, num_rows * (YOLO_ROW_CLASSES + 3));
+  for (i = 0; i < num_rows * (YOLO_ROW_CLASSES + 3); i++)
+    output[i] = -20.f;
+  i = (1 * 8 * 8 + 2 * 8 + 3) * (YOLO_ROW_CLASSES + 3);
+  output[i] = output[i + 1] = output[i + 2] = output[i + 3] = 0.f;
+  output[i + 4] = 10.f;
+  output[i + YOLO_ROW_CLASSES + 2] = 10.f;
+  ok = get_detected_objects_yolo (&params, grid, NULL, 0, output, arena, &n) && ok;
+  if (n != 1) {
+    g_printerr ("YOLOv5: expected 1 detection, got %u\n", n);
+    ok = FALSE;
+  } else {
+    /* centre (2 * 0.5 - 0.5 + cell) * 8, size (2 * 0.5)^2 * anchor */
+    ok = check_box (&arena->detections[0], 2, (28. - 8.) / 64., (20. - 15.) / 64., 16. / 64., 30. / 64.) && ok;
+  }
+  g_free (output);
+  decode_arena_free (arena);
+  anchor_table_free (grid);
+
+  /* YOLOv8: level 1 (stride 16, 4x4), cell (y 1, x 2), one stride from the centre on every side */
+  params.head = YOLO_HEAD_ANCHOR_FREE;
+  num_rows = yolo_grid_count (&params);
+  ok = num_rows == 8 * 8 + 4 * 4 + 2 * 2 && ok;
+  grid = anchor_table_generate_yolo (&params);
+  arena = decode_arena_new (num_rows, 3, YOLO_FIRST_CLASS, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+  output = g_new (gfloat, num_rows * (YOLO_PLANE_CLASSES + 3));
+  for (i = 0; i < num_rows * (YOLO_PLANE_CLASSES + 3); i++)
+    output[i] = (i < num_rows * YOLO_PLANE_CLASSES) ? 1.f : -20.f;
+  output[YOLO_PLANE_CLASSES * num_rows + 8 * 8 + 1 * 4 + 2] = 5.f;
+  ok = get_detected_objects_yolo (&params, grid, NULL, 0, output, arena, &n) && ok;
+  if (n != 1) {
+    g_printerr ("YOLOv8: expected 1 detection, got %u\n", n);
+    ok = FALSE;
+  } else {
+    ok = check_box (&arena->detections[0], 0, 24. / 64., 8. / 64., 32. / 64., 32. / 64.) && ok;
+  }
+  g_free (output);
+  decode_arena_free (arena);
+  anchor_table_free (grid);
+  return ok;
+}
+
+/**
+ * @brief Check that class `c` of both heads keeps the model's id and takes label line `c`, with no background line.
+ */
+static gboolean
+check_labels (void)
+{
+  static const gchar *labels[] = { "person", "bicycle", "car" };
+  YoloParams params;
+  AnchorTable *grid;
+  DecodeArena *arena;
+  gfloat *output;
+  guint num_rows, values, n = 0, c, i;
+  gboolean ok = TRUE;
+  yolo_params_init (&params);
+  yolo_params_set_input_size (&params, "64");
+  for (params.head = YOLO_HEAD_ANCHORS; params.head <= YOLO_HEAD_ANCHOR_FREE; params.head++) {
+    gboolean planes = params.head == YOLO_HEAD_ANCHOR_FREE;
+    num_rows = yolo_grid_count (&params);
+    values = (planes ? YOLO_PLANE_CLASSES : YOLO_ROW_CLASSES) + 3;
+    grid = anchor_table_generate_yolo (&params);
+    arena = decode_arena_new (num_rows, 3, YOLO_FIRST_CLASS, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+    output = g_new (gfloat, num_rows * values);
+    for (c = 0; c < 3; c++) {
+      for (i = 0; i < num_rows * values; i++)
+        output[i] = -20.f;
+      /* row 7 is certain of class c */
+      if (planes) {
+        output[(YOLO_PLANE_CLASSES + c) * num_rows + 7] = 10.f;
+      } else {
+        output[7 * values + YOLO_ROW_CLASSES - 1] = 10.f;
+        output[7 * values + YOLO_ROW_CLASSES + c] = 10.f;
+      }
+      /* every label, then one short of class 2 */
+      for (i = 3; i >= 2; i--) {
+        const gchar *expected = (c < i) ? labels[c] : NULL;
+        if (!get_detected_objects_yolo (&params, grid, labels, i, output, arena, &n) || n != 1 ||
+            arena->detections[0].class_id != c || arena->detections[0].class_label != expected) {
+          g_printerr ("%s class %u with %u labels: got %u detections, class %u, label %s\n", planes ? "YOLOv8" : "YOLOv5",
+              c, i, n, n ? arena->detections[0].class_id : 0, n && arena->detections[0].class_label ? arena->detections[0].class_label : "(none)");
+          ok = FALSE;
+        }
+      }
+    }
+    g_free (output);
+    decode_arena_free (arena);
+    anchor_table_free (grid);
+  }
+  return ok;
+}
+
+/**
+ * @brief Check that a YOLOv5 row scoring 0.3 is kept at the default threshold and dropped at 0.5.
+ */
+static gboolean
+check_score_threshold (void)
+{
+  YoloParams params;
+  AnchorTable *grid;
+  DecodeArena *arena;
+  gfloat *output;
+  guint num_rows, n = 0, i;
+  gboolean ok = TRUE;
+  yolo_params_init (&params);
+  yolo_params_set_input_size (&params, "64");
+  num_rows = yolo_grid_count (&params);
+  grid = anchor_table_generate_yolo (&params);
+  arena = decode_arena_new (num_rows, 3, YOLO_FIRST_CLASS, DEFAULT_MAX_DETECTIONS, DEFAULT_MAX_PER_CLASS);
+  output = g_new (gfloat, num_rows * (YOLO_ROW_CLASSES + 3));
+  for (i = 0; i < num_rows * (YOLO_ROW_CLASSES + 3); i++)
+    output[i] = -20.f;
+  /* objectness 0.6 x class score 0.5 */
+  i = 5 * (YOLO_ROW_CLASSES + 3);
+  output[i] = output[i + 1] = output[i + 2] = output[i + 3] = 0.f;
+  output[i + 4] = logf (0.6f / 0.4f);
+  output[i + YOLO_ROW_CLASSES] = 0.f;
+  if (params.score_threshold != DEFAULT_YOLO_SCORE_THRESHOLD ||
+      !get_detected_objects_yolo (&params, grid, NULL, 0, output, arena, &n) || n != 1 ||
+      fabsf (arena->detections[0].score - 0.3f) > 1e-5f) {
+    g_printerr ("score threshold %g: expected 1 detection scoring 0.3, got %u\n", params.score_threshold, n);
+    ok = FALSE;
+  }
+  params.score_threshold = 0.5f;
+  if (!get_detected_objects_yolo (&params, grid, NULL, 0, output, arena, &n) || n != 0) {
+    g_printerr ("score threshold 0.5: expected no detection, got %u\n", n);
+    ok = FALSE;
+  }
+  g_free (output);
+  decode_arena_free (arena);
+  anchor_table_free (grid);
+  return ok;
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  static const gfloat thresholds[] = { THRESHOLD_SCORE, 0.f, 0.05f, 0.25f, 0.7f, 0.99f, 1.f };
+  gsize size = (gsize) NUM_ROWS * (YOLO_ROW_CLASSES + NUM_CLASSES);
+  gfloat *output = g_new (gfloat, size);
+  ScoredCandidate *expected = g_new (ScoredCandidate, NUM_ROWS * NUM_CLASSES);
+  ScoredCandidate *actual = g_new (ScoredCandidate, NUM_ROWS * NUM_CLASSES);
+  guint32 seed = 0x2545f491;
+  guint h, l, t;
+  gsize i;
+  gboolean ok = TRUE;
+  gst_init (&argc, &argv);
+  /* Both layouts fit the same buffer: rows of 85 values or 84 planes of NUM_ROWS */
+  for (h = YOLO_HEAD_ANCHORS; h <= YOLO_HEAD_ANCHOR_FREE; h++) {
+    for (l = 0; l < 2; l++) {
+      gboolean logits = l == 0;
+      for (i = 0; i < size; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        output[i] = (gfloat) (seed >> 8) / (1 << 24);
+        /* Mostly negative logits like a real frame */
+        if (logits)
+          output[i] = output[i] * 20.f - 14.f;
+      }
+      for (t = 0; t < G_N_ELEMENTS (thresholds); t++)
+        ok = check_threshold (h, output, logits, thresholds[t], expected, actual) && ok;
+    }
+  }
+  ok = check_grid_decode () && ok;
+  ok = check_labels () && ok;
+  ok = check_score_threshold () && ok;
+  g_free (output);
+  g_free (expected);
+  g_free (actual);
+  if (!ok)
+    return 1;
+  g_print ("yolo_score_candidates matches the score product, both heads decode against the grid with the model's class ids and labels, and the score threshold holds\n");
+  return 0;
+}
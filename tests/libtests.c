@@ -169,49 +169,41 @@ parse_qos_message (GstMessage * message)
 }
 
 /**
- * @brief Callback for handling a sample containing boundary-boxes stored as GstMeta-based ROIs.
+ * @brief Callback for handling a sample containing boundary-boxes stored in a GstTensorDetectionsMeta.
  */
 void
 handle_bb_sample (GstElement * element, GstBuffer * buffer, gpointer user_data)
 {
-  guint i = 0;
+  guint i;
   clock_t now, tdelta;
-  gpointer state = NULL;
   GST_LOG_OBJECT(element, "called handle_bb_sample");
-  GstVideoRegionOfInterestMeta *meta;
+  GstTensorDetectionsMeta *meta = gst_buffer_get_tensor_detections_meta(buffer);
   g_mutex_lock (&g_app.mutex);
   g_app.num_detections[0] = 0;
   g_app.num_detections[1] = 0;
-  while((meta = (GstVideoRegionOfInterestMeta *)gst_buffer_iterate_meta(buffer, &state)) && i<MAX_OBJECT_DETECTION)
+  for(i=0; meta && i<meta->num_detections; i++)
   {
-    gdouble score;
-    GstStructure *s = gst_video_region_of_interest_meta_get_param(meta, "detection");
-    const gchar *label = gst_structure_get_string(s, "label_name");
-    guint label_id, stream_id;
-    gst_structure_get_uint(s, "label_id", &label_id);
-    gst_structure_get_uint(s, "stream_id", &stream_id);
-    gst_structure_get_double(s, "confidence", &score);
-    DetectedObject *o = &g_app.detected_objects[stream_id*MAX_OBJECT_DETECTION + g_app.num_detections[stream_id]];
-    g_app.num_detections[stream_id]++;
-    gfloat wscale = (gfloat)VIDEO_WIDTH / UINT_MAX;
-    gfloat hscale = (gfloat)VIDEO_HEIGHT / UINT_MAX;
-    o->x = (guint)(meta->x * wscale);
-    o->y = (guint)(meta->y * hscale);
-    o->width  = (guint)(meta->w * wscale);
-    o->height = (guint)(meta->h * hscale);
-    o->class_id = label_id;
-    o->score = score;
+    const GstTensorDetection *d = &meta->detections[i];
+    if (d->stream_id > 1 || g_app.num_detections[d->stream_id] >= MAX_OBJECT_DETECTION)
+      continue;
+    DetectedObject *o = &g_app.detected_objects[d->stream_id*MAX_OBJECT_DETECTION + g_app.num_detections[d->stream_id]];
+    g_app.num_detections[d->stream_id]++;
+    o->x = (guint)(d->x * VIDEO_WIDTH);
+    o->y = (guint)(d->y * VIDEO_HEIGHT);
+    o->width  = (guint)(d->width * VIDEO_WIDTH);
+    o->height = (guint)(d->height * VIDEO_HEIGHT);
+    o->class_id = d->class_id;
+    o->score = d->score;
     GST_LOG_OBJECT(element, "    handle_bb_sample: got detection %u: %s (%u): %.2f%%: (%u, %u): %u x %u",
       i,
-      label,
-      label_id,
-      100.0 * score,
+      g_quark_to_string(d->label),
+      d->class_id,
+      100.0 * d->score,
       o->x,
       o->y,
       o->width,
       o->height
       );
-    i++;
   }
   /* Calculate FPS and log time of detections update */
   //g_app.fps = 1.0 / (time(NULL) - g_app.prev_update_time);
@@ -225,29 +217,34 @@ handle_bb_sample (GstElement * element, GstBuffer * buffer, gpointer user_data)
   g_mutex_unlock (&g_app.mutex);
 }
 
+/**
+ * @brief Hand the class indices in `segmap_scratch` to the draw callback.
+ */
+static void
+publish_segmap (void)
+{
+  g_mutex_lock (&g_app.mutex);
+  memcpy (g_app.segmap_classes, g_app.segmap_scratch, sizeof (g_app.segmap_classes));
+  g_mutex_unlock (&g_app.mutex);
+}
+
 /**
  * @brief Callback for handling a segmentation-mapped sample, which consists of one frame per class.
+ *
+ * Only the class index of each pixel is kept, so the draw callback does no argmax.
  */
 void
 handle_segmap_sample (GstElement * element, GstBuffer * buffer, gpointer user_data)
 {
-  guint y, x, c;
   GstMemory *in_mem;
   GstMapInfo in_info;
-  gfloat *segmap;
   GST_LOG_OBJECT(element, "called handle_segmap_sample");
   in_mem = gst_buffer_peek_memory (buffer, 0);
   g_assert (gst_memory_map (in_mem, &in_info, GST_MAP_READ));
-  segmap = (gfloat *)in_info.data;
-  for(y = 0; y < SEGMAP_HEIGHT; y++)
-    for(x = 0; x < SEGMAP_WIDTH; x++)
-      for(c = 0; c < SEGMAP_CLASSES; c++)
-      {
-        guint32 yi = y * SEGMAP_WIDTH * SEGMAP_CLASSES,
-                xi = x * SEGMAP_CLASSES;
-        g_app.segmap[y][x][c] = segmap[yi + xi + c];
-      }
+  segmap_argmax ((const gfloat *)in_info.data, SEGMAP_HEIGHT * SEGMAP_WIDTH, SEGMAP_CLASSES,
+      &g_app.segmap_scratch[0][0], NULL);
   gst_memory_unmap (in_mem, &in_info);
+  publish_segmap ();
 }
 
 /**
@@ -256,22 +253,14 @@ handle_segmap_sample (GstElement * element, GstBuffer * buffer, gpointer user_da
 void
 handle_segmap_argmaxed_sample (GstElement * element, GstBuffer * buffer, gpointer user_data)
 {
-  guint y, x;
   GstMemory *in_mem;
   GstMapInfo in_info;
-  gint64 *segmap;
   GST_LOG_OBJECT(element, "called handle_segmap_argmaxed_sample");
   in_mem = gst_buffer_peek_memory (buffer, 0);
   g_assert (gst_memory_map (in_mem, &in_info, GST_MAP_READ));
-  segmap = (gint64 *)in_info.data;
-  for(y = 0; y < SEGMAP_HEIGHT; y++)
-    for(x = 0; x < SEGMAP_WIDTH; x++)
-    {
-      guint64 yi = y * SEGMAP_WIDTH,
-              xi = x;
-        g_app.segmap[y][x][0] = (gfloat)segmap[yi + xi];
-    }
+  segmap_from_indices (in_info.data, _NNS_INT64, SEGMAP_HEIGHT * SEGMAP_WIDTH, &g_app.segmap_scratch[0][0]);
   gst_memory_unmap (in_mem, &in_info);
+  publish_segmap ();
 }
 
 /**
@@ -429,61 +418,6 @@ translate_segmap_index_to_argb (uint8_t index)
  */
 void
 draw_segmap_overlay_cb (GstElement * overlay, cairo_t * cr, guint64 timestamp, guint64 duration, gpointer user_data)
-{
-  CairoOverlayState *state = &g_app.overlay_state[0];
-  cairo_surface_t *mask = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, VIDEO_WIDTH, VIDEO_HEIGHT);
-  guint y, x, c;
-  guint stride;
-  char str[32];
-  guchar *current_row;
-  GST_LOG_OBJECT(overlay, "called draw_segmap_overlay_cb");
-  g_return_if_fail (state->valid);
-  g_return_if_fail (g_app.running);
-  g_mutex_lock (&g_app.mutex);
-  /* set font props */
-  cairo_select_font_face (cr, "Sans", CAIRO_FONT_SLANT_NORMAL,
-      CAIRO_FONT_WEIGHT_BOLD);
-  cairo_set_font_size (cr, 20.0);
-  /* draw FPS */
-  snprintf(str, 32, "FPS=%.2f", g_app.fps);
-  cairo_move_to (cr, 50, 50);
-  cairo_text_path (cr, str);
-  cairo_set_source_rgb (cr, 1, 1, 1);
-  cairo_fill_preserve (cr);
-  cairo_set_source_rgb (cr, 1, 1, 1);
-  cairo_set_line_width (cr, .3);
-  cairo_stroke (cr);
-  cairo_fill_preserve (cr);
-  cairo_surface_flush(mask);
-  current_row = cairo_image_surface_get_data(mask);
-  stride = cairo_image_surface_get_stride(mask);
-  for(y = 0; y < SEGMAP_HEIGHT; y++)
-  {
-    uint32_t *row = (void *)current_row;
-    for(x = 0; x < SEGMAP_WIDTH; x++)
-    {
-      uint8_t max_index = 0;
-      for(c = 1; c < SEGMAP_CLASSES; c++)
-      {
-        if(g_app.segmap[y][x][c] > g_app.segmap[y][x][max_index])
-          max_index = c;
-        row[x] = translate_segmap_index_to_argb(max_index);
-      }
-    }
-    current_row += stride;
-  }
-  cairo_surface_mark_dirty(mask);
-  cairo_set_source_surface(cr, mask, 0, 0);
-  cairo_paint(cr);
-  cairo_surface_destroy(mask);
-  g_mutex_unlock (&g_app.mutex);
-}
-
-/**
- * @brief Callback to draw an overlay of arg-maxed segmentation maps.
- */
-void
-draw_segmap_argmaxed_overlay_cb (GstElement * overlay, cairo_t * cr, guint64 timestamp, guint64 duration, gpointer user_data)
 {
   CairoOverlayState *state = &g_app.overlay_state[0];
   cairo_surface_t *mask = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, VIDEO_WIDTH, VIDEO_HEIGHT);
@@ -516,10 +450,7 @@ draw_segmap_argmaxed_overlay_cb (GstElement * overlay, cairo_t * cr, guint64 tim
   {
     uint32_t *row = (void *)current_row;
     for(x = 0; x < SEGMAP_WIDTH; x++)
-    {
-      uint8_t max_index = g_app.segmap[y][x][0];
-      row[x] = translate_segmap_index_to_argb(max_index);
-    }
+      row[x] = translate_segmap_index_to_argb(g_app.segmap_classes[y][x]);
     current_row += stride;
   }
   cairo_surface_mark_dirty(mask);
@@ -6,6 +6,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <glib.h>
 #include <gst/gst.h>
@@ -98,7 +99,8 @@ typedef struct
   CairoOverlayState overlay_state[2]; /**< Cairo state >**/
   guint num_detections[2]; /**< actual number of detections in `detected_objects` >**/
   DetectedObject detected_objects[2*MAX_OBJECT_DETECTION]; /**< BB-encoded detections >**/
-  gfloat segmap[SEGMAP_HEIGHT][SEGMAP_WIDTH][SEGMAP_CLASSES]; /**< segmentation map; depending on model, class-index-0 may be used to store an arg-maxed output >**/
+  guint8 segmap_classes[SEGMAP_HEIGHT][SEGMAP_WIDTH]; /**< class index of each pixel of the latest segmentation map >**/
+  guint8 segmap_scratch[SEGMAP_HEIGHT][SEGMAP_WIDTH]; /**< class indices of the sample being handled, outside `mutex` >**/
   GstElement *appsink;
   GstElement *tensor_res;
   GstElement *tensor_res0;
@@ -121,5 +123,4 @@ void set_window_title (const gchar * name, const gchar * title);
 void prepare_overlay_cb (GstElement * overlay, GstCaps * caps, gpointer user_data);
 void draw_bb_overlay_cb (GstElement * overlay, cairo_t * cr, guint64 timestamp, guint64 duration, gpointer user_data);
 void draw_segmap_overlay_cb (GstElement * overlay, cairo_t * cr, guint64 timestamp, guint64 duration, gpointer user_data);
-void draw_segmap_argmaxed_overlay_cb (GstElement * overlay, cairo_t * cr, guint64 timestamp, guint64 duration, gpointer user_data);
 void bus_message_cb (GstBus * bus, GstMessage * message, gpointer user_data);
@@ -0,0 +1,141 @@
+/**
+ * @file	tensordecode_bundle.c
+ * @brief	Convert text labels and box-priors files into an asset bundle
+ *
+ * Usage: tensordecode-bundle -l coco_labels_list.txt -b box_priors.txt -o ssd.bundle
+ *
+ * Without -b, the priors are generated from the SSD anchor grid options.
+ *
+ * The bundle holds the priors in decode-ready layout with the given box-coder
+ * scales folded in, the labels, and the model's tensor dimensions, and is
+ * loaded by the decoders' `bundle` property with a single mmap.
+ */
+
+#include <stdio.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include "../src/libtensordecode.h"
+
+static gchar *labels_path = NULL;
+static gchar *box_priors_path = NULL;
+static gchar *output_path = NULL;
+static gchar *boxes_dim_str = NULL;
+static gchar *predictions_dim_str = NULL;
+static gchar *feature_maps = NULL;
+static gchar *aspect_ratios = NULL;
+static gdouble min_scale = DEFAULT_ANCHOR_MIN_SCALE;
+static gdouble max_scale = DEFAULT_ANCHOR_MAX_SCALE;
+static gdouble y_scale = Y_SCALE;
+static gdouble x_scale = X_SCALE;
+static gdouble h_scale = H_SCALE;
+static gdouble w_scale = W_SCALE;
+
+static GOptionEntry entries[] = {
+  { "labels", 'l', 0, G_OPTION_ARG_FILENAME, &labels_path, "Labels file, one label per line", "FILE" },
+  { "boxpriors", 'b', 0, G_OPTION_ARG_FILENAME, &box_priors_path, "Box-priors file, four rows of one value per anchor (default: generate)", "FILE" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path, "Bundle to write", "FILE" },
+  { "boxes-dim", 0, 0, G_OPTION_ARG_STRING, &boxes_dim_str, "Box tensor dimensions (default 4:<anchors>:1:1)", "DIM" },
+  { "predictions-dim", 0, 0, G_OPTION_ARG_STRING, &predictions_dim_str, "Prediction tensor dimensions (default <labels>:<anchors>:1:1)", "DIM" },
+  { "feature-maps", 0, 0, G_OPTION_ARG_STRING, &feature_maps, "Feature map sizes of generated anchors (default " DEFAULT_ANCHOR_FEATURE_MAPS ")", "N,HxW,..." },
+  { "aspect-ratios", 0, 0, G_OPTION_ARG_STRING, &aspect_ratios, "Aspect ratios of generated anchors (default " DEFAULT_ANCHOR_ASPECT_RATIOS ")", "R,..." },
+  { "min-scale", 0, 0, G_OPTION_ARG_DOUBLE, &min_scale, "Scale of generated anchors on the first feature map", "SCALE" },
+  { "max-scale", 0, 0, G_OPTION_ARG_DOUBLE, &max_scale, "Scale of generated anchors on the last feature map", "SCALE" },
+  { "y-scale", 0, 0, G_OPTION_ARG_DOUBLE, &y_scale, "Box-coder scale of the y-centre offsets", "SCALE" },
+  { "x-scale", 0, 0, G_OPTION_ARG_DOUBLE, &x_scale, "Box-coder scale of the x-centre offsets", "SCALE" },
+  { "h-scale", 0, 0, G_OPTION_ARG_DOUBLE, &h_scale, "Box-coder scale of the log-height offsets", "SCALE" },
+  { "w-scale", 0, 0, G_OPTION_ARG_DOUBLE, &w_scale, "Box-coder scale of the log-width offsets", "SCALE" },
+  { NULL }
+};
+
+/**
+ * @brief Parse `str` into `dim`, or default to `inner`:`anchors`:1:1.
+ */
+static gboolean
+parse_dim (const gchar *str, guint inner, guint anchors, tensor_dim dim)
+{
+  guint r;
+  if (str)
+    return tensor_dim_from_string (str, dim);
+  for (r = 0; r < NNS_TENSOR_RANK_LIMIT; r++)
+    dim[r] = 1;
+  dim[0] = inner;
+  dim[1] = anchors;
+  return TRUE;
+}
+
+/**
+ * @brief Generate the priors from the anchor grid options.
+ */
+static AnchorTable *
+generate_anchors (void)
+{
+  SsdAnchorParams params;
+  ssd_anchor_params_init (&params);
+  if ((feature_maps && !ssd_anchor_params_set_feature_maps (&params, feature_maps)) ||
+      (aspect_ratios && !ssd_anchor_params_set_aspect_ratios (&params, aspect_ratios))) {
+    g_printerr ("Invalid anchor grid\n");
+    return NULL;
+  }
+  params.min_scale = min_scale;
+  params.max_scale = max_scale;
+  return anchor_table_generate_ssd (&params);
+}
+
+/**
+ * @brief Main function.
+ */
+int
+main (int argc, char ** argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  AnchorTable *anchors = NULL;
+  gchar **labels = NULL;
+  guint num_labels = 0;
+  tensor_dim boxes_dim, predictions_dim;
+  int ret = 1;
+
+  context = g_option_context_new ("- convert decoder assets into a bundle");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    goto done;
+  }
+  if (!labels_path || !output_path) {
+    g_printerr ("--labels and --output are required\n");
+    goto done;
+  }
+  labels = tflite_read_labels (labels_path, &num_labels);
+  if (!labels) {
+    g_printerr ("Failed to read %s\n", labels_path);
+    goto done;
+  }
+  anchors = box_priors_path ? anchor_table_load_box_priors (box_priors_path) : generate_anchors ();
+  if (!anchors) {
+    g_printerr ("Failed to %s box priors\n", box_priors_path ? "read" : "generate");
+    goto done;
+  }
+  if (!parse_dim (boxes_dim_str, BOX_SIZE, anchors->num_anchors, boxes_dim) ||
+      !parse_dim (predictions_dim_str, num_labels, anchors->num_anchors, predictions_dim)) {
+    g_printerr ("Invalid tensor dimensions\n");
+    goto done;
+  }
+  if (boxes_dim[1] != anchors->num_anchors || predictions_dim[1] != anchors->num_anchors) {
+    g_printerr ("Tensor dimensions do not match the %u box priors\n", anchors->num_anchors);
+    goto done;
+  }
+  anchor_table_set_scales (anchors, y_scale, x_scale, h_scale, w_scale);
+  if (!asset_bundle_write (output_path, anchors, (const gchar * const *) labels, num_labels, boxes_dim, predictions_dim)) {
+    g_printerr ("Failed to write %s\n", output_path);
+    goto done;
+  }
+  g_print ("Wrote %u anchors and %u labels to %s\n", anchors->num_anchors, num_labels, output_path);
+  ret = 0;
+done:
+  anchor_table_free (anchors);
+  g_strfreev (labels);
+  g_option_context_free (context);
+  return ret;
+}